@@ -37,6 +37,7 @@
 #include <map>
 
 #include "policy/kasp.pb.h"
+#include "policy/policy_cache.h"
 #include "keystate/keystate.pb.h"
 
 #include "enforcer/enforcerdata.h"
@@ -122,25 +123,6 @@ public:
     }
 };
 
-static bool
-load_kasp_policy(OrmConn conn,const std::string &name,
-				 ::ods::kasp::Policy &policy)
-{
-	std::string qname;
-	if (!OrmQuoteStringValue(conn, name, qname))
-		return false;
-	
-	OrmResultRef rows;
-	if (!OrmMessageEnumWhere(conn,policy.descriptor(),rows,
-							 "name=%s",qname.c_str()))
-		return false;
-	
-	if (!OrmFirst(rows))
-		return false;
-	
-	return OrmGetMessage(rows, policy, true);
-}
-
 static time_t 
 reschedule_enforce(task_type *task, time_t t_when, const char *z_when)
 {
@@ -203,6 +185,7 @@ time_t perform_enforce(int sockfd, engine_type *engine, int bForceUpdate,
 
 	OrmResultRef rows;
 	::ods::keystate::EnforcerZone enfzone;
+	KaspPolicyCache policies;
 
 	bool ok;
 	if (bForceUpdate)
@@ -233,8 +216,9 @@ time_t perform_enforce(int sockfd, engine_type *engine, int bForceUpdate,
 			OrmContextRef context;
 			if (!OrmGetMessage(rows, enfzone, /*zones + keys*/true, context))
 				LOG_AND_RESCHEDULE_15SECS("retrieving zone from database failed");
-			::ods::kasp::Policy policy;
-			if (!load_kasp_policy(conn, enfzone.policy(), policy)) {
+			const ::ods::kasp::Policy *policy =
+				cached_kasp_policy(conn, enfzone.policy(), policies);
+			if (!policy) {
 				/* Policy for this zone not found, don't reschedule */
 				ods_printf(sockfd, 
 					"Next update for zone %s NOT scheduled "
@@ -243,7 +227,7 @@ time_t perform_enforce(int sockfd, engine_type *engine, int bForceUpdate,
 					enfzone.policy().c_str());
 				enfzone.set_next_change((time_t)-1);
 			} else {
-				EnforcerZonePB enfZone(&enfzone, policy);
+				EnforcerZonePB enfZone(&enfzone, *policy);
 				time_t t_next = update(enfZone, t_now, keyfactory);
 				if (enfZone.signerConfNeedsWriting())
 					bSignerConfNeedsWriting = true;
@@ -221,6 +221,50 @@ HsmKeyFactoryPB::HsmKeyFactoryPB(OrmConn conn,
 {
 }
 
+/* Find the id of a key that matches the given parameters exactly and is
+ either unused or already in use. Only a single row is selected using the
+ HsmKey_match_index, so this doesn't depend on the size of the key pool.
+ id is set to 0 when no key matches. */
+static bool
+FindMatchingKeyId(OrmConn conn, bool used, int bits,
+                  const std::string &repository, const std::string &policy,
+                  int algorithm, KeyRole role, pb::uint64 &id)
+{
+	id = 0;
+
+	std::string qpolicy, qrepository, qrole;
+	if (!OrmQuoteStringValue(conn, policy, qpolicy))
+		return false;
+	if (!OrmQuoteStringValue(conn, repository, qrepository))
+		return false;
+	if (!OrmQuoteStringValue(conn,
+			::ods::hsmkey::keyrole_Name((::ods::hsmkey::keyrole)role), qrole))
+		return false;
+
+	// A key without a repository matches an empty repository.
+	std::string where_repository;
+	if (repository.empty())
+		where_repository = "(repository IS NULL OR repository='')";
+	else
+		where_repository = "repository=" + qrepository;
+
+	std::string statement;
+	if (!OrmFormat(statement,
+				   "SELECT id FROM %s WHERE policy=%s AND %s AND algorithm=%d"
+				   " AND bits=%d AND role=%s AND inception IS %sNULL LIMIT 1",
+				   ::ods::hsmkey::HsmKey::descriptor()->name().c_str(),
+				   qpolicy.c_str(), where_repository.c_str(), algorithm,
+				   bits, qrole.c_str(), used ? "NOT " : ""))
+		return false;
+
+	OrmResultRef rows;
+	if (!OrmConnQuery(conn, statement, rows))
+		return false;
+	if (OrmFirst(rows) && !OrmGetId(rows, id))
+		return false;
+	return true;
+}
+
 /* Create a new key with the specified number of bits (or retrieve it 
  from a pre-generated keypool)  */
 bool HsmKeyFactoryPB::CreateNewKey(int bits, const std::string &repository,
@@ -235,60 +279,47 @@ bool HsmKeyFactoryPB::CreateNewKey(int bits, const std::string &repository,
 		return false;
 #endif
 	
-    // Find keys that are available and match exactly with the given parameters.
-	{	OrmResultRef rows;
-		if (!OrmMessageEnumWhere(_conn, ::ods::hsmkey::HsmKey::descriptor(),
-								 rows, "inception IS NULL"))
-			return false;
+    // Find a key that is available and matches exactly with the given parameters.
+	pb::uint64 keyid;
+	if (!FindMatchingKeyId(_conn, false, bits, repository, policy, algorithm,
+						   role, keyid))
+		return false;
 
+	if (keyid) {
 		::ods::hsmkey::HsmKey *pbkey = new ::ods::hsmkey::HsmKey;
+		OrmContextRef context;
+		if (!OrmMessageRead(_conn, *pbkey, keyid, true, context)) {
+			delete pbkey;
+			return false;
+		}
+
+		pbkey->set_inception(time_now());
+		HsmKeyPB pbkey_ref(pbkey);
 		
-		for (bool next=OrmFirst(rows); next; next=OrmNext(rows)) {
-			OrmContextRef context;
-			if (OrmGetMessage(rows, *pbkey, true, context)) {
-				if (!pbkey->has_inception() 
-					&& pbkey->bits() == bits
-					&& pbkey->repository() == repository
-					&& pbkey->policy() == policy
-					&& pbkey->algorithm() == algorithm
-					&& pbkey->role() == (::ods::hsmkey::keyrole)role
-					)
-				{
-					// found a candidate, so we no longer need the rows
-					rows.release();
-
-					pbkey->set_inception(time_now());
-					HsmKeyPB pbkey_ref(pbkey);
-					
-					// Fixate unset attributes that returned their default value.
-					// Otherwise when we list the keys those values will show 
-					// up as 'not set'
-					if (!pbkey->has_policy())
-						pbkey_ref.setPolicy(policy);
-					if (!pbkey->has_algorithm())
-						pbkey_ref.setAlgorithm(algorithm);
-					if (!pbkey->has_role())
-						pbkey_ref.setKeyRole(role);
-					
-					pbkey = NULL;
-
-					// We have modified the key and need to update it.
-					if (!OrmMessageUpdate(context)) 
-						return false;
+		// Fixate unset attributes that returned their default value.
+		// Otherwise when we list the keys those values will show 
+		// up as 'not set'
+		if (!pbkey->has_policy())
+			pbkey_ref.setPolicy(policy);
+		if (!pbkey->has_algorithm())
+			pbkey_ref.setAlgorithm(algorithm);
+		if (!pbkey->has_role())
+			pbkey_ref.setKeyRole(role);
+		
+		pbkey = NULL;
+
+		// We have modified the key and need to update it.
+		if (!OrmMessageUpdate(context)) 
+			return false;
 #if 0
-					if (!transaction.commit())
-						return false;
+		if (!transaction.commit())
+			return false;
 #endif
-					std::pair<std::map<std::string,HsmKeyPB>::iterator,bool> ret;
-					ret = _keys.insert(std::pair<std::string,HsmKeyPB>(
-										pbkey_ref.locator(),pbkey_ref));
-					*ppKey = &ret.first->second;
-					return true;
-				}
-			}
-		}
-
-		delete pbkey;
+		std::pair<std::map<std::string,HsmKeyPB>::iterator,bool> ret;
+		ret = _keys.insert(std::pair<std::string,HsmKeyPB>(
+							pbkey_ref.locator(),pbkey_ref));
+		*ppKey = &ret.first->second;
+		return true;
     }
 
 #if 0
@@ -328,32 +359,27 @@ bool HsmKeyFactoryPB::GetHsmKeyByLocator(const std::string loc, HsmKey **ppKey)
         return true;
     }
     
-    // Now enumerate keys in the document try to find a key that matches the
-    // parameters exactly and is not yet present in the _keys vector field.
-	OrmResultRef rows;
-	if (OrmMessageEnum(_conn, ::ods::hsmkey::HsmKey::descriptor(), rows)) {
+    // Now select the key with the locator from the database, the locator
+    // column is indexed.
+	std::string qloc;
+	if (!OrmQuoteStringValue(_conn, loc, qloc))
+		return false;
 
-		::ods::hsmkey::HsmKey *pbkey = NULL;
+	OrmResultRef rows;
+	if (OrmMessageEnumWhere(_conn, ::ods::hsmkey::HsmKey::descriptor(), rows,
+							"locator=%s", qloc.c_str())) {
 
-		for (bool next=OrmFirst(rows); next; next=OrmNext(rows)) {
-			
-			if (!pbkey)
-				pbkey = new ::ods::hsmkey::HsmKey;
-			
+		if (OrmFirst(rows)) {
+			::ods::hsmkey::HsmKey *pbkey = new ::ods::hsmkey::HsmKey;
 			if (OrmGetMessage(rows, *pbkey, true)) {
-				if (pbkey->locator() == loc) {
-					std::pair<std::map<std::string,HsmKeyPB>::iterator,bool> ret;
-					ret = _keys.insert(
-						std::pair<std::string,HsmKeyPB>(loc,HsmKeyPB(pbkey)) );
-					pbkey = NULL;
-					*ppKey = &ret.first->second;
-					return true;
-				}
+				std::pair<std::map<std::string,HsmKeyPB>::iterator,bool> ret;
+				ret = _keys.insert(
+					std::pair<std::string,HsmKeyPB>(loc,HsmKeyPB(pbkey)) );
+				*ppKey = &ret.first->second;
+				return true;
 			}
-		}
-
-		if (pbkey)
 			delete pbkey;
+		}
     }
     return false;
 }
@@ -386,72 +412,52 @@ bool HsmKeyFactoryPB::UseSharedKey(int bits, const std::string &repository,
 	OrmTransactionRW trans(_conn);
 #endif
 	
-    // Now enumerate keys in the document try to find a key that matches the
-    // parameters exactly and is not yet present in the _keys vector field.
-	OrmResultRef rows;
-	if (OrmMessageEnum(_conn, ::ods::hsmkey::HsmKey::descriptor(), rows)) {
+    // Now select a key from the database that is in use and matches the
+    // parameters exactly.
+	pb::uint64 keyid;
+	if (FindMatchingKeyId(_conn, true, bits, repository, policy, algorithm,
+						  role, keyid) && keyid) {
 
-		::ods::hsmkey::HsmKey *pbkey = NULL;
-		
-		for (bool next=OrmFirst(rows); next; next=OrmNext(rows)) {
+		::ods::hsmkey::HsmKey *pbkey = new ::ods::hsmkey::HsmKey;
 
-			if (!pbkey)
-				pbkey = new ::ods::hsmkey::HsmKey;
+		OrmContextRef context;
+		if (OrmMessageRead(_conn, *pbkey, keyid, true, context)) {
+			pbkey->set_inception(time_now());
+			HsmKeyPB pbkey_ref(pbkey);
+			
 			
-			OrmContextRef context;
-			if (OrmGetMessage(rows, *pbkey, true, context)) {
-				if (pbkey->has_inception()
-					&& pbkey->bits() == bits
-					&& pbkey->repository() == repository
-					&& pbkey->policy() == policy
-					&& pbkey->algorithm() == algorithm
-					&& pbkey->role() == (::ods::hsmkey::keyrole)role
-					)
-				{
-					pbkey->set_inception(time_now());
-					HsmKeyPB pbkey_ref(pbkey);
-					
-					
-					// Fixate unset attributes that returned their default value.
-					// Otherwise when we list the keys those values will show 
-					// up as 'not set'
-					if (!pbkey->has_policy())
-						pbkey_ref.setPolicy(policy);
-					if (!pbkey->has_algorithm())
-						pbkey_ref.setAlgorithm(algorithm);
-					if (!pbkey->has_role())
-						pbkey_ref.setKeyRole(role);
-
-					pbkey = NULL;
-					
-					// We have modified the key and need to update it.
-					if (OrmMessageUpdate(context)) {
-						
-						// we won't be needing the result anymore, so release it
-						rows.release();
+			// Fixate unset attributes that returned their default value.
+			// Otherwise when we list the keys those values will show 
+			// up as 'not set'
+			if (!pbkey->has_policy())
+				pbkey_ref.setPolicy(policy);
+			if (!pbkey->has_algorithm())
+				pbkey_ref.setAlgorithm(algorithm);
+			if (!pbkey->has_role())
+				pbkey_ref.setKeyRole(role);
+
+			pbkey = NULL;
+			
+			// We have modified the key and need to update it.
+			if (OrmMessageUpdate(context)) {
 #if 0
-						// now more active queries, so commit should work.
-						if (trans.commit()) {
+				// now more active queries, so commit should work.
+				if (trans.commit()) {
 #endif
-							std::pair<std::map<std::string,HsmKeyPB>::iterator,bool> ret;
-							ret = _keys.insert(std::pair<std::string,HsmKeyPB>(
-												pbkey_ref.locator(),pbkey_ref));
-							*ppKey = &ret.first->second;
-							(*ppKey)->setUsedByZone(zone,true);
-							return true;
+					std::pair<std::map<std::string,HsmKeyPB>::iterator,bool> ret;
+					ret = _keys.insert(std::pair<std::string,HsmKeyPB>(
+										pbkey_ref.locator(),pbkey_ref));
+					*ppKey = &ret.first->second;
+					(*ppKey)->setUsedByZone(zone,true);
+					return true;
 #if 0
-						}
-#endif
-					}
 				}
+#endif
 			}
 		}
 
 		if (pbkey)
 			delete pbkey;
-
-		rows.release();
-		
     }
 
 #if 0	
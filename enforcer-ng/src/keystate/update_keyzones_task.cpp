@@ -171,6 +171,8 @@ perform_update_keyzones(int sockfd, engineconfig_type *config)
 				"error starting a database transaction for updating zones");
 			return 0;
 		}
+		// Zones not yet in the database are inserted together afterwards.
+		std::vector< ::ods::keystate::EnforcerZone > zones_new;
 		for (int i=0; i<zonelistDoc->zonelist().zones_size(); ++i) {
 			const ::ods::keystate::ZoneData &zl_zone = 
 				zonelistDoc->zonelist().zones(i);
@@ -262,17 +264,27 @@ perform_update_keyzones(int sockfd, engineconfig_type *config)
 				ods_printf(sockfd, "Updated zone %s in database\n", zl_zone.name().c_str());
 			} else {
 				/* insert */
-				ods_printf(sockfd, "Zone %s not found in database. ", zl_zone.name().c_str());
-				pb::uint64 zoneid;
-				if (!OrmMessageInsert(conn, ks_zone, zoneid)) {
-					ods_log_error_and_printf(sockfd, module_str,
-						"inserting zone into the database failed");
-					return 0;
-				}
-				ods_printf(sockfd, "Added zone %s to database\n", zl_zone.name().c_str());
+				ods_printf(sockfd, "Zone %s not found in database.\n", zl_zone.name().c_str());
+				zones_new.push_back(ks_zone);
 			}
 			rows.release();
         }
+		if (!zones_new.empty()) {
+			/* insert with several rows per statement, the whole batch is
+			 * checked before anything is written. */
+			std::vector<const pb::Message*> batch;
+			std::vector<pb::uint64> zoneids;
+			for (size_t z=0; z<zones_new.size(); ++z)
+				batch.push_back(&zones_new[z]);
+			if (!OrmMessageInsertBatch(conn, batch, zoneids)) {
+				ods_log_error_and_printf(sockfd, module_str,
+					"inserting zones into the database failed");
+				return 0;
+			}
+			for (size_t z=0; z<zones_new.size(); ++z)
+				ods_printf(sockfd, "Added zone %s to database\n",
+					zones_new[z].name().c_str());
+		}
 		if (!transaction.commit()) {
 			ods_log_error_and_printf(sockfd, module_str,
 				"committing zone to the database failed");
@@ -0,0 +1,64 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2011 Surfnet 
+ * Copyright (c) 2011 .SE (The Internet Infrastructure Foundation).
+ * Copyright (c) 2011 OpenDNSSEC AB (svb)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "policy/policy_cache.h"
+
+bool
+load_kasp_policy(OrmConn conn,const std::string &name,
+				 ::ods::kasp::Policy &policy)
+{
+	std::string qname;
+	if (!OrmQuoteStringValue(conn, name, qname))
+		return false;
+	
+	OrmResultRef rows;
+	if (!OrmMessageEnumWhere(conn,policy.descriptor(),rows,
+							 "name=%s",qname.c_str()))
+		return false;
+
+	if (!OrmFirst(rows))
+		return false;
+	
+	return OrmGetMessage(rows, policy, true);
+}
+
+const ::ods::kasp::Policy *
+cached_kasp_policy(OrmConn conn, const std::string &name,
+				   KaspPolicyCache &policies)
+{
+	KaspPolicyCache::iterator it = policies.find(name);
+	if (it == policies.end()) {
+		it = policies.insert(std::make_pair(name, ::ods::kasp::Policy())).first;
+		if (!load_kasp_policy(conn, name, it->second))
+			it->second.Clear();
+	}
+	return it->second.has_name() ? &it->second : NULL;
+}
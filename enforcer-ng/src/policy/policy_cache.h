@@ -0,0 +1,62 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2011 Surfnet 
+ * Copyright (c) 2011 .SE (The Internet Infrastructure Foundation).
+ * Copyright (c) 2011 OpenDNSSEC AB (svb)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _POLICY_POLICY_CACHE_H_
+#define _POLICY_POLICY_CACHE_H_
+
+#include <map>
+#include <string>
+
+#include "policy/kasp.pb.h"
+#include "protobuf-orm/pb-orm.h"
+
+/*
+ * Read the policy with the given name from the database.
+ * Returns false if there is no such policy or it could not be read.
+ */
+bool load_kasp_policy(OrmConn conn, const std::string &name,
+					  ::ods::kasp::Policy &policy);
+
+// Policies loaded during a single run, keyed by name. A handful of
+// policies is shared by all zones, so every policy is only read from the
+// database once per run. A policy that could not be loaded is kept as an
+// empty message, which has no name.
+typedef std::map<std::string, ::ods::kasp::Policy> KaspPolicyCache;
+
+/*
+ * Look up a policy in the cache, reading it from the database the first
+ * time it is asked for. Returns NULL if the policy could not be loaded.
+ */
+const ::ods::kasp::Policy *cached_kasp_policy(OrmConn conn,
+											  const std::string &name,
+											  KaspPolicyCache &policies);
+
+#endif
@@ -111,3 +111,10 @@ void OrmConnClose(OrmConn handle)
 {
 	delete ((DB::OrmConnT *)handle);
 }
+
+pb::uint64 OrmConnStatementCount(OrmConn handle)
+{
+	if (!handle)
+		return 0;
+	return ((DB::OrmConnT *)handle)->statement_count();
+}
@@ -60,6 +60,14 @@ bool OrmConnectSQLite3(const std::string &dbdir,
 
 void OrmConnClose(OrmConn conn);
 
+/**
+ * Number of SQL statements sent to the database over a connection.
+ * \param[in] conn the connection
+ * \return pb::uint64 statements executed since the connection was opened
+ *
+ */
+pb::uint64 OrmConnStatementCount(OrmConn conn);
+
 
 class OrmConnRef {
 public:
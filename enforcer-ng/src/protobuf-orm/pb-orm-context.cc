@@ -31,7 +31,7 @@
 
 #include "pb-orm-context.h"
 
-OrmContextT::OrmContextT() : conn(0), id(0), message(NULL)
+OrmContextT::OrmContextT() : conn(0), id(0), message(NULL), has_snapshot(false)
 {
 }
 
@@ -33,6 +33,7 @@
 #define pb_orm_context_h
 
 #include <map>
+#include <string>
 
 #include "pb-orm-common.h"
 
@@ -44,6 +45,15 @@ public:
 	
 	// maps field tag number to record id for a message or repeated value
 	std::map< int, std::map<pb::uint64,OrmContext> > fields;
+
+	// Snapshot taken when the message was read. OrmMessageUpdate uses it
+	// to skip unchanged messages and to only assign changed columns.
+	bool has_snapshot;
+	std::string snapshot;
+
+	// maps field tag number to the SQL value the column had when read,
+	// for a repeated value the value of the row itself.
+	std::map<int, std::string> values;
 	
 	OrmContextT();
 	~OrmContextT();
@@ -36,6 +36,8 @@
 #include "pb-orm-database.h"
 #include "orm.pb.h"
 
+#include <set>
+
 static const char * const
 pb_type_to_orm_type[] =
 {
@@ -246,12 +248,92 @@ pb_field_to_orm_type(OrmConn conn,
 	return true;
 }
 
+static bool
+pb_create_index(OrmConn conn,
+				const std::string &table,
+				const std::string &name,
+				const std::string &columns,
+				bool unique)
+{
+	if (CONN->index_exists(table, name))
+		return true;
+	DB::OrmResultT result( CONN->CreateIndex(name, table, columns, unique) );
+	if (!result.assigned()) {
+		OrmLogError("failed to create index %s on table: %s",
+					name.c_str(), table.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Create the indexes declared for the message and the indexes on the
+// tables of its repeated fields. Indexes that already exist are kept, so
+// this also adds new indexes to tables created by an earlier version.
+static bool
+pb_create_indexes(OrmConn conn,
+				  const pb::Descriptor* descriptor,
+				  std::set<const pb::Descriptor*> &visited)
+{
+	if (!visited.insert(descriptor).second)
+		return true;
+
+	const std::string &table = descriptor->name();
+	if (descriptor->options().HasExtension(orm::index)) {
+		const orm::Index index = descriptor->options().GetExtension(orm::index);
+		if (index.has_spec()) {
+			std::string name = index.name();
+			if (name.empty()) {
+				name = table + "_" + index.spec() + "_index";
+				for (size_t i=0; i<name.size(); ++i)
+					if (name[i] == ',' || name[i] == ' ')
+						name[i] = '_';
+			}
+			if (!pb_create_index(conn, table, name, index.spec(), index.unique()))
+				return false;
+		}
+	}
+
+	for (int f=0; f<descriptor->field_count(); ++f) {
+		const pb::FieldDescriptor *field = descriptor->field(f);
+		if (field->is_repeated()) {
+			// Repeated fields are looked up by the id of the message they
+			// belong to. The relation table of a repeated message field has
+			// a primary key starting with parent_id, but deleting a message
+			// looks up its relation by child_id.
+			std::string orm_name = table + "_" + field->name();
+			const char *column =
+				field->type() == pb::FieldDescriptor::TYPE_MESSAGE
+					? "child_id" : "parent_id";
+			if (!pb_create_index(conn, orm_name,
+								 orm_name + "_" + column + "_index",
+								 column, false))
+				return false;
+		} else if (field->options().HasExtension(orm::column)) {
+			const orm::Column column = field->options().GetExtension(orm::column);
+			if (column.index() || column.unique()) {
+				std::string name;
+				pb_field_name(field,name);
+				if (!pb_create_index(conn, table, table + "_" + name + "_index",
+									 name, column.unique()))
+					return false;
+			}
+		}
+		if (field->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
+			if (!pb_create_indexes(conn, field->message_type(), visited))
+				return false;
+		}
+	}
+	return true;
+}
+
 bool OrmCreateTable(OrmConn conn, const pb::Descriptor* descriptor)
 {	
 	// Create a table based on the meta information of a protocol buffer message
 
-	if (CONN->table_exists(descriptor->name()))
-		return true;
+	if (CONN->table_exists(descriptor->name())) {
+		std::set<const pb::Descriptor*> visited;
+		return pb_create_indexes(conn, descriptor, visited);
+	}
 
 	std::string fields;
 	for (int f=0; f<descriptor->field_count(); ++f) {
@@ -309,5 +391,7 @@ bool OrmCreateTable(OrmConn conn, const pb::Descriptor* descriptor)
 		OrmLogError("failed to create table: %s",descriptor->name().c_str());
 		return false;
 	}
-	return true;
+	
+	std::set<const pb::Descriptor*> visited;
+	return pb_create_indexes(conn, descriptor, visited);
 }
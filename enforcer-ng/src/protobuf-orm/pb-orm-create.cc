@@ -31,6 +31,7 @@
 
 #include <math.h>
 #include <time.h>
+#include <map>
 
 #include "pb-orm-create.h"
 #include "pb-orm-value.h"
@@ -43,19 +44,24 @@ static bool
 pb_insert_names_and_values_into_table(OrmConn conn,
 									  const std::string &table,
 									  const std::string &names,
-									  const std::string &values)
+									  const DB::OrmParams &values)
 {
-	DB::OrmResultT result;
+	// The values are bound to placeholders so the statement only depends on
+	// the table and the names of the columns and can be reused.
+	std::string statement;
 	if (names.size() > 0) {
-		result = CONN->queryf("INSERT INTO %s (%s) VALUES (%s)",
-							  table.c_str(),
-							  names.c_str(),
-							  values.c_str());
+		std::string placeholders;
+		for (size_t i=0; i<values.size(); ++i)
+			OrmChain(placeholders,"?",',');
+		OrmFormat(statement,"INSERT INTO %s (%s) VALUES (%s)",
+				  table.c_str(),
+				  names.c_str(),
+				  placeholders.c_str());
 	} else {
-		result = CONN->queryf("INSERT INTO %s (id) VALUES (NULL)",
-							  table.c_str());
-		
+		OrmFormat(statement,"INSERT INTO %s (id) VALUES (NULL)",
+				  table.c_str());
 	}
+	DB::OrmResultT result = CONN->query_params(statement,values);
 	if (!result.assigned()) {
 		OrmLogError("failed to insert values into table: %s",table.c_str());
 		return false; // valid id is never 0
@@ -72,13 +78,9 @@ pb_field_add_repeated_message(OrmConn conn,
 	// insert new parent_id,child_id pair into the repeated field table.
 	std::string table = field->containing_type()->name() + "_" + field->name();
 	std::string names("parent_id,child_id");
-	std::string values;
-	if (!pb_field_uint64_value(id,values))
-		return false;
-	std::string childidstr;
-	if (!pb_field_uint64_value(childid,childidstr))
-		return false;
-	OrmChain(values,childidstr,',');
+	DB::OrmParams values;
+	values.push_back(DB::OrmParam((unsigned long long)id));
+	values.push_back(DB::OrmParam((unsigned long long)childid));
 	
 	return pb_insert_names_and_values_into_table(conn, table, names, values);
 }
@@ -87,17 +89,15 @@ static bool
 pb_field_add_repeated_value(OrmConn conn,
 							pb::uint64 id,
 							const pb::FieldDescriptor *field,
-							const std::string &value,
+							const DB::OrmParam &value,
 							pb::uint64 &fieldid)
 {
 	// insert both value and parent_id into the repeated field table
 	std::string table = field->containing_type()->name() + "_" + field->name();
 	std::string names = "value,parent_id";
-	std::string values = value;
-	std::string parentidstr;
-	if (!pb_field_uint64_value(id,parentidstr))
-		return false;
-	OrmChain(values,parentidstr,',');	
+	DB::OrmParams values;
+	values.push_back(value);
+	values.push_back(DB::OrmParam((unsigned long long)id));
 	
 	// when failed to insert aggregated value, don't continue.
 	if (!pb_insert_names_and_values_into_table(conn,table,names,values))
@@ -131,7 +131,7 @@ pb_field_type_valid(const pb::FieldDescriptor *field)
 bool OrmMessageInsert(OrmConn conn, const pb::Message &message, pb::uint64 &id)
 {
 	std::string names;
-	std::string values;
+	DB::OrmParams values;
 	const pb::Descriptor *descriptor = message.GetDescriptor();
 	const pb::Reflection *reflection = message.GetReflection();
 	
@@ -162,23 +162,21 @@ bool OrmMessageInsert(OrmConn conn, const pb::Message &message, pb::uint64 &id)
 		pb_field_name(fields[fi],name);
 		OrmChain(names,name,',');
 		
-		std::string value;
+		DB::OrmParam value;
 		if (fields[fi]->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
 			// Handle MESSAGE value
 			pb::uint64 fieldid;
 			if (!OrmMessageInsert(conn,reflection->GetMessage(message, fields[fi]),fieldid))
 				return false; // failed to insert aggregated message, don't continue.
 			
-			// failed to format field, don't continue.
-			if (!pb_field_uint64_value(fieldid,value))
-				return false;
+			value = DB::OrmParam((unsigned long long)fieldid);
 		} else {
 			// Handle other types of values.
-			if (!pb_field_value(conn,&message,fields[fi],value))
+			if (!pb_field_param(&message,fields[fi],value))
 				return false;
 		}
 		
-		OrmChain(values,value,',');
+		values.push_back(value);
 		
 	}
 	
@@ -213,6 +211,273 @@ bool OrmMessageInsert(OrmConn conn, const pb::Message &message, pb::uint64 &id)
 	return true;
 }
 
+// Limits on the rows written by a single insert statement. SQLite limits
+// both the number of parameters of a statement and the number of terms in
+// a compound SELECT.
+#define MAX_ROWS_PER_INSERT 64
+#define MAX_PARAMS_PER_INSERT 512
+
+static bool
+pb_insert_rows_into_table(OrmConn conn,
+						  const std::string &table,
+						  const std::string &names,
+						  size_t ncolumns,
+						  size_t nrows,
+						  const DB::OrmParams &values,
+						  std::vector<pb::uint64> *ids)
+{
+	// Rows are inserted with several rows per statement unless the ids of
+	// the rows are needed and the database can't tell them afterwards.
+	size_t maxrows = 1;
+	if (!ids || CONN->sequence_consecutive()) {
+		maxrows = MAX_ROWS_PER_INSERT;
+		while (maxrows > 1 && maxrows*ncolumns > MAX_PARAMS_PER_INSERT)
+			maxrows /= 2;
+	}
+
+	// A message without any column values only gets an id.
+	std::string columns(ncolumns ? names : std::string("id"));
+	std::string row;
+	for (size_t c=0; c<ncolumns; ++c)
+		OrmChain(row,"?",',');
+	if (!ncolumns)
+		row = "NULL";
+
+	// The number of rows per statement is always a power of two, so only
+	// a few different statements are needed for any number of rows.
+	DB::OrmParams params;
+	for (size_t r=0; r<nrows; ) {
+		size_t n = maxrows;
+		while (n > nrows-r)
+			n /= 2;
+
+		// INSERT ... SELECT ... UNION ALL SELECT ... is used instead of
+		// multiple rows in VALUES, as older versions of SQLite don't
+		// support the latter.
+		std::string statement = "INSERT INTO " + table + " (" + columns + ")";
+		for (size_t i=0; i<n; ++i)
+			statement += (i ? " UNION ALL SELECT " : " SELECT ") + row;
+		params.assign(values.begin()+r*ncolumns, values.begin()+(r+n)*ncolumns);
+
+		DB::OrmResultT result = CONN->query_params(statement,params);
+		if (!result.assigned()) {
+			OrmLogError("failed to insert rows into table: %s",table.c_str());
+			return false;
+		}
+		if (ids) {
+			pb::uint64 last = CONN->sequence_last();
+			for (size_t i=0; i<n; ++i)
+				ids->push_back(last-(n-1)+i);
+		}
+		r += n;
+	}
+	return true;
+}
+
+// Check a message and the messages it contains before anything of a batch
+// is written: it is of the expected type, its required fields are assigned
+// a value and all of its fields can be stored.
+static bool
+pb_message_insert_valid(const pb::Descriptor *descriptor,
+						const pb::Message &message)
+{
+	if (message.GetDescriptor() != descriptor) {
+		OrmLogError("batch contains messages of different types");
+		return false;
+	}
+	const pb::Reflection *reflection = message.GetReflection();
+	for (int f=0; f<descriptor->field_count(); ++f) {
+		const pb::FieldDescriptor *field = descriptor->field(f);
+		if (field->is_repeated()) {
+			// tables for repeated fields are written even when empty.
+			if (!pb_field_type_valid(field))
+				return false;
+			if (field->type() != pb::FieldDescriptor::TYPE_MESSAGE)
+				continue;
+			int size = reflection->FieldSize(message, field);
+			for (int index=0; index<size; ++index) {
+				if (!pb_message_insert_valid(field->message_type(),
+						reflection->GetRepeatedMessage(message, field, index)))
+					return false;
+			}
+		} else if (reflection->HasField(message, field)) {
+			if (!pb_field_type_valid(field))
+				return false;
+			if (field->type() == pb::FieldDescriptor::TYPE_MESSAGE
+				&& !pb_message_insert_valid(field->message_type(),
+						reflection->GetMessage(message, field)))
+				return false;
+		} else if (field->is_required()) {
+			OrmLogError("required field %s was not assigned a value",
+						field->full_name().c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+// The rows of a batch of messages that have values for the same columns.
+struct pb_insert_rows {
+	size_t ncolumns;
+	DB::OrmParams values;
+	std::vector<size_t> messages;
+};
+
+static bool
+pb_message_insert_batch(OrmConn conn,
+						const pb::Descriptor *descriptor,
+						const std::vector<const pb::Message*> &messages,
+						std::vector<pb::uint64> &ids)
+{
+	ids.assign(messages.size(), 0);
+	if (messages.empty())
+		return true;
+
+	// Insert the messages of singular message fields first, the rows of
+	// the messages refer to them by id.
+	std::map<const pb::FieldDescriptor*, std::vector<pb::uint64> > childids;
+	for (int f=0; f<descriptor->field_count(); ++f) {
+		const pb::FieldDescriptor *field = descriptor->field(f);
+		if (field->is_repeated()
+			|| field->type() != pb::FieldDescriptor::TYPE_MESSAGE)
+			continue;
+
+		std::vector<const pb::Message*> children;
+		std::vector<size_t> owners;
+		for (size_t m=0; m<messages.size(); ++m) {
+			const pb::Reflection *reflection = messages[m]->GetReflection();
+			if (reflection->HasField(*messages[m], field)) {
+				children.push_back(&reflection->GetMessage(*messages[m], field));
+				owners.push_back(m);
+			}
+		}
+		std::vector<pb::uint64> cids;
+		if (!pb_message_insert_batch(conn,field->message_type(),children,cids))
+			return false;
+		std::vector<pb::uint64> &fids = childids[field];
+		fids.assign(messages.size(), 0);
+		for (size_t c=0; c<cids.size(); ++c)
+			fids[owners[c]] = cids[c];
+	}
+
+	// Group the messages by the columns they have values for, so they can
+	// be inserted with several rows per statement.
+	std::map<std::string, pb_insert_rows> groups;
+	for (size_t m=0; m<messages.size(); ++m) {
+		const pb::Message &message = *messages[m];
+		std::vector<const pb::FieldDescriptor*> fields;
+		message.GetReflection()->ListFields(message,&fields);
+
+		std::string names;
+		DB::OrmParams values;
+		for (size_t fi=0; fi<fields.size(); ++fi) {
+			if (fields[fi]->is_repeated())
+				continue;
+
+			std::string name;
+			pb_field_name(fields[fi],name);
+			OrmChain(names,name,',');
+
+			DB::OrmParam value;
+			if (fields[fi]->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
+				value = DB::OrmParam((unsigned long long)childids[fields[fi]][m]);
+			} else {
+				if (!pb_field_param(&message,fields[fi],value))
+					return false;
+			}
+			values.push_back(value);
+		}
+
+		pb_insert_rows &rows = groups[names];
+		rows.ncolumns = values.size();
+		rows.values.insert(rows.values.end(), values.begin(), values.end());
+		rows.messages.push_back(m);
+	}
+
+	std::map<std::string, pb_insert_rows>::const_iterator g;
+	for (g=groups.begin(); g!=groups.end(); ++g) {
+		const pb_insert_rows &rows = g->second;
+		std::vector<pb::uint64> rowids;
+		if (!pb_insert_rows_into_table(conn, descriptor->name(), g->first,
+									   rows.ncolumns, rows.messages.size(),
+									   rows.values, &rowids))
+			return false;
+		for (size_t r=0; r<rowids.size(); ++r)
+			ids[rows.messages[r]] = rowids[r];
+	}
+
+	// Insert repeated fields that reference the messages by id.
+	for (int f=0; f<descriptor->field_count(); ++f) {
+		const pb::FieldDescriptor *field = descriptor->field(f);
+		if (!field->is_repeated())
+			continue;
+
+		std::string table = descriptor->name() + "_" + field->name();
+		DB::OrmParams values;
+		if (field->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
+			std::vector<const pb::Message*> children;
+			std::vector<pb::uint64> parents;
+			for (size_t m=0; m<messages.size(); ++m) {
+				const pb::Reflection *reflection = messages[m]->GetReflection();
+				int size = reflection->FieldSize(*messages[m], field);
+				for (int index=0; index<size; ++index) {
+					children.push_back(
+						&reflection->GetRepeatedMessage(*messages[m], field, index));
+					parents.push_back(ids[m]);
+				}
+			}
+			std::vector<pb::uint64> cids;
+			if (!pb_message_insert_batch(conn,field->message_type(),children,cids))
+				return false;
+			for (size_t c=0; c<cids.size(); ++c) {
+				values.push_back(DB::OrmParam((unsigned long long)parents[c]));
+				values.push_back(DB::OrmParam((unsigned long long)cids[c]));
+			}
+			if (!pb_insert_rows_into_table(conn, table, "parent_id,child_id", 2,
+										   cids.size(), values, NULL))
+				return false;
+		} else {
+			for (size_t m=0; m<messages.size(); ++m) {
+				int size = messages[m]->GetReflection()->FieldSize(*messages[m], field);
+				for (int index=0; index<size; ++index) {
+					DB::OrmParam value;
+					if (!pb_field_repeated_param(messages[m],field,index,value))
+						return false;
+					values.push_back(value);
+					values.push_back(DB::OrmParam((unsigned long long)ids[m]));
+				}
+			}
+			if (!pb_insert_rows_into_table(conn, table, "value,parent_id", 2,
+										   values.size()/2, values, NULL))
+				return false;
+		}
+	}
+	return true;
+}
+
+bool OrmMessageInsertBatch(OrmConn conn,
+						   const std::vector<const pb::Message*> &messages,
+						   std::vector<pb::uint64> &ids)
+{
+	// Insert a batch of messages of the same type. Instead of a statement
+	// for every row like OrmMessageInsert, the rows for a table are written
+	// together with several rows per statement. The ids are returned in the
+	// order of the messages. The whole batch, including the messages it
+	// contains, is checked before anything is written. Should still be
+	// called inside a transaction so a database error doesn't leave part
+	// of the batch behind.
+	if (messages.empty()) {
+		ids.clear();
+		return true;
+	}
+	const pb::Descriptor *descriptor = messages[0]->GetDescriptor();
+	for (size_t m=0; m<messages.size(); ++m) {
+		if (!pb_message_insert_valid(descriptor, *messages[m]))
+			return false;
+	}
+	return pb_message_insert_batch(conn, descriptor, messages, ids);
+}
+
 bool OrmFieldAddRepeatedValue(OrmConn conn,
 							  pb::uint64 id,
 							  const pb::Message &message,
@@ -227,8 +492,8 @@ bool OrmFieldAddRepeatedValue(OrmConn conn,
 		if (!OrmFieldAddRepeatedMessage(conn,id,field,value,fieldid))
 			return false;
 	} else {
-		std::string value;
-		if (!pb_field_repeated_value(conn,&message,field,index,value))
+		DB::OrmParam value;
+		if (!pb_field_repeated_param(&message,field,index,value))
 			return false;
 		if (!pb_field_add_repeated_value(conn, id, field, value, fieldid))
 			return false;
@@ -242,10 +507,8 @@ bool OrmFieldAddRepeatedBool(OrmConn conn,
 							 bool value,
 							 pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_bool_value(value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam(value?1LL:0LL);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 bool OrmFieldAddRepeatedFloat(OrmConn conn,
@@ -254,10 +517,8 @@ bool OrmFieldAddRepeatedFloat(OrmConn conn,
 							  float value,
 							  pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_float_value(value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam((double)value);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 bool OrmFieldAddRepeatedDouble(OrmConn conn,
@@ -266,10 +527,8 @@ bool OrmFieldAddRepeatedDouble(OrmConn conn,
 							   double value,
 							   pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_double_value(value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam(value);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 
@@ -279,10 +538,8 @@ bool OrmFieldAddRepeatedInt32(OrmConn conn,
 							  pb::int32 value,
 							  pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_int32_value(value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam((long long)value);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 
@@ -292,10 +549,8 @@ bool OrmFieldAddRepeatedInt64(OrmConn conn,
 							  pb::int64 value,
 							  pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_int64_value(value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam((long long)value);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 bool OrmFieldAddRepeatedUint32(OrmConn conn,
@@ -304,10 +559,8 @@ bool OrmFieldAddRepeatedUint32(OrmConn conn,
 							   pb::uint32 value,
 							   pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_uint32_value(value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam((long long)value);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 bool OrmFieldAddRepeatedUint64(OrmConn conn,
@@ -316,10 +569,8 @@ bool OrmFieldAddRepeatedUint64(OrmConn conn,
 							   pb::uint64 value,
 							   pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_uint64_value(value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam((unsigned long long)value);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 
@@ -329,10 +580,8 @@ bool OrmFieldAddRepeatedString(OrmConn conn,
 							   const std::string &value,
 							   pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_string_value(conn,value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam(value);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 bool OrmFieldAddRepeatedBinary(OrmConn conn,
@@ -341,10 +590,8 @@ bool OrmFieldAddRepeatedBinary(OrmConn conn,
 							   const std::string &value,
 							   pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_binary_value(conn,value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam(value,DB::OrmParam::PARAM_BLOB);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 bool OrmFieldAddRepeatedMessage(OrmConn conn,
@@ -366,10 +613,8 @@ bool OrmFieldAddRepeatedEnum(OrmConn conn,
 							 const std::string &value,
 							 pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_enum_value(value,valuestr))
-		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	DB::OrmParam valueparam(value);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 
@@ -379,10 +624,10 @@ bool OrmFieldAddRepeatedDateTime(OrmConn conn,
 								 time_t value,
 								 pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_datetime_value(value,valuestr))
+	DB::OrmParam valueparam;
+	if (!pb_field_datetime_param(value,valueparam))
 		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 
@@ -392,10 +637,10 @@ bool OrmFieldAddRepeatedDate(OrmConn conn,
 							 time_t value,
 							 pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_date_value(value,valuestr))
+	DB::OrmParam valueparam;
+	if (!pb_field_date_param(value,valueparam))
 		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 
@@ -405,10 +650,10 @@ bool OrmFieldAddRepeatedTime(OrmConn conn,
 							 time_t value,
 							 pb::uint64 &fieldid)
 {
-	std::string valuestr;
-	if (!pb_field_time_value(value,valuestr))
+	DB::OrmParam valueparam;
+	if (!pb_field_time_param(value,valueparam))
 		return false;
-	return pb_field_add_repeated_value(conn, id, field, valuestr, fieldid);
+	return pb_field_add_repeated_value(conn, id, field, valueparam, fieldid);
 }
 
 
@@ -33,11 +33,16 @@
 #define pb_orm_create_h
 
 #include "pb-orm-common.h"
+#include <vector>
 
 bool OrmMessageInsert(OrmConn conn,
 					  const pb::Message &message,
 					  pb::uint64 &id);
 
+bool OrmMessageInsertBatch(OrmConn conn,
+						   const std::vector<const pb::Message*> &messages,
+						   std::vector<pb::uint64> &ids);
+
 bool OrmFieldAddRepeatedValue(OrmConn conn,
 							  pb::uint64 id,
 							  const pb::Message &message,
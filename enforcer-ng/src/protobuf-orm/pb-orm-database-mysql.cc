@@ -563,6 +563,8 @@ namespace DB {
 			virtual OrmResultT query(const char *statement, int len);
 			
 			virtual bool table_exists(const std::string &name);
+			virtual bool index_exists(const std::string &table,
+									  const std::string &name);
 			virtual bool quote_string(const std::string &value, std::string &dest);
 			virtual bool quote_binary(const std::string &value, std::string &dest);
 			
@@ -573,6 +575,10 @@ namespace DB {
 			virtual OrmResultT CreateTableRelation(const std::string &name);
 			virtual OrmResultT CreateTableRepeatedValue(const std::string &name,
 														  const std::string &type);
+			virtual OrmResultT CreateIndex(const std::string &name,
+										   const std::string &table,
+										   const std::string &columns,
+										   bool unique);
 			
 		protected:
 			unsigned int _transaction_level;
@@ -765,6 +771,7 @@ namespace DB {
 	{
 		MYSQL_RES *result = NULL;
 
+		++_statements;
 		if (mysql_real_query(db, statement, len)) {
 			OrmLogError("Unable to execute statement: %s", mysql_error(db));
 			OrmLogError("%*s", len, statement);
@@ -794,6 +801,18 @@ namespace DB {
 			return false;
 	}
 	
+	bool MySQL::OrmConnT::index_exists(const std::string &table,
+									   const std::string &name)
+	{
+		OrmResultT exists = queryf("SHOW INDEX FROM %s WHERE Key_name='%s'",
+								   table.c_str(), name.c_str());
+
+		if (exists.assigned())
+			return exists->first_row();
+		else
+			return false;
+	}
+	
 	bool MySQL::OrmConnT::quote_string(const std::string &value,
 										 std::string &dest)
 	{
@@ -894,6 +913,18 @@ namespace DB {
 					  _options["encoding"].c_str());
 	}
 
+	OrmResultT MySQL::OrmConnT::CreateIndex(const std::string &name,
+											const std::string &table,
+											const std::string &columns,
+											bool unique)
+	{
+		return queryf("CREATE %sINDEX %s ON %s (%s)",
+					  unique ? "UNIQUE " : "",
+					  name.c_str(),
+					  table.c_str(),
+					  columns.c_str());
+	}
+
 	///////////////////////////
 	//
 	// MySQL::NewOrmConnT
@@ -45,6 +45,9 @@
 
 #define HAVE_SILENT_BUSY_AND_LOCKED_ERRORS 1
 
+// Maximum number of prepared statements kept per connection.
+#define MAX_CACHED_STATEMENTS 256
+
 namespace DB {
 
 	bool SQLite3::initialize()
@@ -65,6 +68,17 @@ namespace DB {
 
 	namespace SQLite3 {
 		
+		// Prepared statement owned by the statement cache of a connection.
+		// While a result set is reading from the statement it is busy and
+		// cannot be handed out again. When the connection is closed while
+		// the statement is busy it becomes orphaned and is finalized by the
+		// result set instead.
+		struct CachedStatement {
+			sqlite3_stmt *stmt;
+			bool busy;
+			bool orphaned;
+		};
+
 		///////////////////////////
 		//
 		// SQLite3::OrmResultImpl
@@ -75,9 +89,10 @@ namespace DB {
 		class OrmResultImpl : public ::DB::OrmResultImpl {
 		public:
 			sqlite3_stmt *stmt;
+			CachedStatement *cached;
 			std::map<std::string, int> fields;
 			
-			OrmResultImpl(sqlite3_stmt * stmt_);
+			OrmResultImpl(sqlite3_stmt * stmt_, CachedStatement *cached_);
 			virtual ~OrmResultImpl();
 			
 			virtual bool assigned();
@@ -128,16 +143,32 @@ namespace DB {
 	//
 	///////////////////////////
 	
-	SQLite3::OrmResultImpl::OrmResultImpl(sqlite3_stmt * stmt_)
-	: stmt(stmt_)
+	static void
+	release_statement(sqlite3_stmt *stmt, SQLite3::CachedStatement *cached)
+	{
+		if (!cached || cached->orphaned) {
+			sqlite3_finalize(stmt);
+			delete cached;
+			return;
+		}
+		// keep the compiled statement for reuse by the connection.
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		cached->busy = false;
+	}
+
+	SQLite3::OrmResultImpl::OrmResultImpl(sqlite3_stmt * stmt_,
+										  CachedStatement *cached_)
+	: stmt(stmt_), cached(cached_)
 	{
 	}
 	
 	SQLite3::OrmResultImpl::~OrmResultImpl()
 	{
 		if (stmt) {
-			sqlite3_finalize(stmt);
+			release_statement(stmt, cached);
 			stmt = NULL;
+			cached = NULL;
 		}
 	}
 	
@@ -543,23 +574,34 @@ namespace DB {
 			virtual bool rollback_transaction();
 			
 			virtual OrmResultT query(const char *statement, int len);
+			virtual OrmResultT query_params(const std::string &statement,
+											const OrmParams &params);
 			
 			virtual bool table_exists(const std::string &name);
+			virtual bool index_exists(const std::string &table,
+									  const std::string &name);
 			virtual bool quote_string(const std::string &value, std::string &dest);
 			virtual bool quote_binary(const std::string &value, std::string &dest);
 			
 			virtual unsigned long long sequence_last();
+			virtual bool sequence_consecutive();
 			const char *idfield();
 			virtual OrmResultT CreateTableMessage(const std::string &name,
 													const std::string &fields);
 			virtual OrmResultT CreateTableRelation(const std::string &name);
 			virtual OrmResultT CreateTableRepeatedValue(const std::string &name,
 														  const std::string &type);
+			virtual OrmResultT CreateIndex(const std::string &name,
+										   const std::string &table,
+										   const std::string &columns,
+										   bool unique);
 			
 		protected:
 			std::map< std::string, std::string >_options;
 			std::map< std::string, int>_numoptions;
+			std::map< std::string, CachedStatement *>_statement_cache;
 			bool successful(int rv);
+			bool bind_params(sqlite3_stmt *stmt, const OrmParams &params);
 		};
 
 	}
@@ -617,6 +659,18 @@ namespace DB {
 	
 	void SQLite3::OrmConnT::close()
 	{
+		std::map<std::string, CachedStatement *>::iterator it;
+		for (it=_statement_cache.begin(); it!=_statement_cache.end(); ++it) {
+			// a busy statement is finalized when its result set goes away.
+			if (it->second->busy) {
+				it->second->orphaned = true;
+			} else {
+				sqlite3_finalize(it->second->stmt);
+				delete it->second;
+			}
+		}
+		_statement_cache.clear();
+
 		if (db) {
 			sqlite3_close(db);
 			db = NULL;
@@ -652,6 +706,7 @@ namespace DB {
 	{
 		sqlite3_stmt *stmt = NULL;
 
+		++_statements;
 		int rv = sqlite3_prepare_v2(db,
 									statement,
 									(len<0) ? (int)-1 : (int)len+1,
@@ -675,7 +730,122 @@ namespace DB {
 			return OrmResultT();
 		}
 	
-		return OrmResultT((OrmConn)this, new SQLite3::OrmResultImpl(stmt));
+		return OrmResultT((OrmConn)this, new SQLite3::OrmResultImpl(stmt,NULL));
+	}
+
+	OrmResultT SQLite3::OrmConnT::query_params(const std::string &statement,
+											   const OrmParams &params)
+	{
+		// Statements without params typically have their values embedded
+		// and are not worth keeping around.
+		if (params.empty())
+			return query(statement.c_str(),(int)statement.size());
+
+		sqlite3_stmt *stmt = NULL;
+		CachedStatement *cached = NULL;
+
+		++_statements;
+		std::map<std::string, CachedStatement *>::iterator it =
+			_statement_cache.find(statement);
+		if (it != _statement_cache.end() && !it->second->busy) {
+			cached = it->second;
+			stmt = cached->stmt;
+		} else {
+			int rv = sqlite3_prepare_v2(db,
+										statement.c_str(),
+										(int)statement.size()+1,
+										&stmt,
+										NULL);
+			if (!successful(rv)) {
+				if (stmt)
+					sqlite3_finalize(stmt);
+				return OrmResultT();
+			}
+
+			if (!stmt) {
+				OrmLogError("expected sqlite3_prepare_v2 to return a compiled "
+							"statement, got NULL, out of memory ?");
+				return OrmResultT();
+			}
+
+			// When the cached statement is busy, e.g. because the same
+			// query is nested inside the enumeration of its results, the
+			// freshly prepared statement is used once and finalized.
+			if (it == _statement_cache.end()
+				&& _statement_cache.size() < MAX_CACHED_STATEMENTS)
+			{
+				cached = new CachedStatement;
+				cached->stmt = stmt;
+				cached->busy = false;
+				cached->orphaned = false;
+				_statement_cache[statement] = cached;
+			}
+		}
+
+		if (!bind_params(stmt, params)) {
+			release_statement(stmt, cached);
+			return OrmResultT();
+		}
+
+		int step = sqlite3_step(stmt);
+		if (!successful(step)) {
+			release_statement(stmt, cached);
+			return OrmResultT();
+		}
+
+		if (cached)
+			cached->busy = true;
+		return OrmResultT((OrmConn)this, new SQLite3::OrmResultImpl(stmt,cached));
+	}
+
+	bool SQLite3::OrmConnT::bind_params(sqlite3_stmt *stmt,
+										const OrmParams &params)
+	{
+		if (sqlite3_bind_parameter_count(stmt) != (int)params.size()) {
+			OrmLogError("statement expects %d parameters, got %d: %s",
+						sqlite3_bind_parameter_count(stmt),
+						(int)params.size(),
+						sqlite3_sql(stmt));
+			return false;
+		}
+
+		for (size_t i=0; i<params.size(); ++i) {
+			const OrmParam &param = params[i];
+			int idx = (int)i+1;
+			int rv;
+			switch (param.type) {
+				case OrmParam::PARAM_NULL:
+					rv = sqlite3_bind_null(stmt, idx);
+					break;
+				case OrmParam::PARAM_INTEGER:
+				case OrmParam::PARAM_UINTEGER:
+					rv = sqlite3_bind_int64(stmt, idx, param.integer);
+					break;
+				case OrmParam::PARAM_REAL:
+					rv = sqlite3_bind_double(stmt, idx, param.real);
+					break;
+				case OrmParam::PARAM_TEXT:
+					rv = sqlite3_bind_text(stmt, idx, param.text.data(),
+										   (int)param.text.size(),
+										   SQLITE_TRANSIENT);
+					break;
+				case OrmParam::PARAM_BLOB:
+					// encode empty value as a NULL, like quote_binary does.
+					if (param.text.size() == 0)
+						rv = sqlite3_bind_null(stmt, idx);
+					else
+						rv = sqlite3_bind_blob(stmt, idx, param.text.data(),
+											   (int)param.text.size(),
+											   SQLITE_TRANSIENT);
+					break;
+				default:
+					OrmLogError("unknown parameter type %d",param.type);
+					return false;
+			}
+			if (!successful(rv))
+				return false;
+		}
+		return true;
 	}
 		
 	bool SQLite3::OrmConnT::table_exists(const std::string &name)
@@ -689,6 +859,19 @@ namespace DB {
 			return false;
 	}
 	
+	bool SQLite3::OrmConnT::index_exists(const std::string &table,
+										 const std::string &name)
+	{
+		OrmResultT exists = queryf(
+			"SELECT name FROM sqlite_master WHERE type='index' AND tbl_name='%s'"
+			" AND name='%s';",
+			table.c_str(), name.c_str());
+		if (exists.assigned())
+			return exists->first_row();
+		else
+			return false;
+	}
+	
 	bool SQLite3::OrmConnT::quote_string(const std::string &value,
 										 std::string &dest)
 	{
@@ -732,6 +915,13 @@ namespace DB {
 		return sqlite3_last_insert_rowid(db);
 	}
 
+	bool SQLite3::OrmConnT::sequence_consecutive()
+	{
+		// There is only a single writer and every row of an insert gets
+		// the next id, so the ids of the rows follow each other.
+		return true;
+	}
+
 	const char *SQLite3::OrmConnT::idfield()
 	{
 		// To get maximum performance on SQLite the form below is choosen deliberately.
@@ -769,6 +959,18 @@ namespace DB {
 					  idfield());
 	}
 
+	OrmResultT SQLite3::OrmConnT::CreateIndex(const std::string &name,
+											  const std::string &table,
+											  const std::string &columns,
+											  bool unique)
+	{
+		return queryf("CREATE %sINDEX %s ON %s (%s)",
+					  unique ? "UNIQUE " : "",
+					  name.c_str(),
+					  table.c_str(),
+					  columns.c_str());
+	}
+
 	bool SQLite3::OrmConnT::successful(int rv)
 	{
 		if (rv == SQLITE_OK || rv == SQLITE_ROW || rv == SQLITE_DONE)
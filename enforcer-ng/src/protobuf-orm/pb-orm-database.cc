@@ -38,19 +38,68 @@
 
 namespace DB {
 
+	///////////////////////////
+	//
+	// OrmParam
+	//
+	///////////////////////////
+
+	OrmParam::OrmParam() : type(PARAM_NULL), integer(0), real(0.0)
+	{
+	}
+
+	OrmParam::OrmParam(long long value)
+	: type(PARAM_INTEGER), integer(value), real(0.0)
+	{
+	}
+
+	OrmParam::OrmParam(unsigned long long value)
+	: type(PARAM_UINTEGER), integer((long long)value), real(0.0)
+	{
+	}
+
+	OrmParam::OrmParam(double value)
+	: type(PARAM_REAL), integer(0), real(value)
+	{
+	}
+
+	OrmParam::OrmParam(const std::string &value, Type type_)
+	: type(type_), integer(0), real(0.0), text(value)
+	{
+	}
+
+	///////////////////////////
+	//
+	// OrmResultAttachment
+	//
+	///////////////////////////
+
+	OrmResultAttachment::~OrmResultAttachment()
+	{
+	}
+
 	///////////////////////////
 	//
 	// OrmResultImpl
 	//
 	///////////////////////////
 	
-	OrmResultImpl::OrmResultImpl() : _refcount(1)
+	OrmResultImpl::OrmResultImpl() : attachment(NULL), _refcount(1)
 	{
 	}
 	
 	OrmResultImpl::~OrmResultImpl()
 	{
-		
+		delete attachment;
+	}
+
+	void OrmResultImpl::set_source(const std::string &table,
+								   const std::string &where,
+								   const OrmParams &params)
+	{
+		source_table = table;
+		source_where = where;
+		source_params = params;
 	}
 
 	OrmResultImpl *OrmResultImpl::retain(OrmResultImpl* self)
@@ -128,7 +177,7 @@ namespace DB {
 	//
 	///////////////////////////
 		
-	OrmConnT::OrmConnT()
+	OrmConnT::OrmConnT() : _statements(0)
 	{
 	}
 
@@ -140,7 +189,17 @@ namespace DB {
 	{
 		return (OrmConn)this;
 	}
+
+	unsigned long long OrmConnT::statement_count() const
+	{
+		return _statements;
+	}
 	
+	bool OrmConnT::sequence_consecutive()
+	{
+		return false;
+	}
+
 	OrmResultT OrmConnT::queryf(const char *format, ...)
 	{
 		// short form
@@ -170,4 +229,96 @@ namespace DB {
 		return result;
 	}
 
+	OrmResultT OrmConnT::queryf_params(const OrmParams &params,
+									   const char *format, ...)
+	{
+		// The format should only fill in names of tables and columns, the
+		// values go into params.
+		char statement[128];
+		va_list args;
+		va_start(args, format);
+		int cneeded = vsnprintf(statement,sizeof(statement),format,args);
+		va_end(args);
+		if (cneeded<0) {
+			OrmLogError("vsnprintf error");
+			return OrmResultT();
+		}
+		size_t needed = (size_t)cneeded;
+		if (needed<sizeof(statement))
+			return query_params(std::string(statement,needed),params);
+
+		std::string pstatement(needed+1,'\0');
+		va_start(args, format);
+		bool ok = vsnprintf(&pstatement[0],needed+1,format,args)==cneeded;
+		va_end(args);
+		if (!ok) {
+			OrmLogError("vsnprintf error");
+			return OrmResultT();
+		}
+		pstatement.resize(needed);
+		return query_params(pstatement,params);
+	}
+
+	bool OrmConnT::quote_param(const OrmParam &param, std::string &dest)
+	{
+		switch (param.type) {
+			case OrmParam::PARAM_NULL:
+				dest = "NULL";
+				return true;
+			case OrmParam::PARAM_INTEGER:
+				return OrmFormat(dest,"%lld",param.integer);
+			case OrmParam::PARAM_UINTEGER:
+				return OrmFormat(dest,"%llu",(unsigned long long)param.integer);
+			case OrmParam::PARAM_REAL:
+				return OrmFormat(dest,"%.17g",param.real);
+			case OrmParam::PARAM_TEXT:
+				return quote_string(param.text,dest);
+			case OrmParam::PARAM_BLOB:
+				return quote_binary(param.text,dest);
+		}
+		OrmLogError("unknown parameter type %d",param.type);
+		return false;
+	}
+
+	OrmResultT OrmConnT::query_params(const std::string &statement,
+									  const OrmParams &params)
+	{
+		if (params.empty())
+			return query(statement.c_str(),(int)statement.size());
+
+		// Default implementation for backends without native parameter
+		// binding: substitute the quoted params for the placeholders.
+		std::string expanded;
+		std::string value;
+		size_t p = 0;
+		bool quoted = false;
+		expanded.reserve(statement.size());
+		for (size_t i=0; i<statement.size(); ++i) {
+			char ch = statement[i];
+			if (quoted || ch != '?') {
+				// skip over string literals, they may contain a '?'
+				if (ch == '\\' && quoted && i+1<statement.size())
+					expanded.push_back(statement[i++]);
+				else if (ch == '\'')
+					quoted = !quoted;
+				expanded.push_back(statement[i]);
+				continue;
+			}
+			if (p >= params.size()) {
+				OrmLogError("not enough parameters for statement: %s",
+							statement.c_str());
+				return OrmResultT();
+			}
+			if (!quote_param(params[p++],value))
+				return OrmResultT();
+			expanded.append(value);
+		}
+		if (p != params.size()) {
+			OrmLogError("too many parameters for statement: %s",
+						statement.c_str());
+			return OrmResultT();
+		}
+		return query(expanded.c_str(),(int)expanded.size());
+	}
+
 } // namespace DB
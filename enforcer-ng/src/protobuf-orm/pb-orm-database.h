@@ -34,8 +34,46 @@
 
 #include "pb-orm-common.h"
 
+#include <string>
+#include <vector>
+
 namespace DB {
 
+	// Value that is bound to a '?' placeholder of a statement passed to
+	// OrmConnT::query_params(). Backends that support it bind the value
+	// natively, others substitute it as a quoted literal.
+	class OrmParam {
+	public:
+		enum Type {
+			PARAM_NULL,
+			PARAM_INTEGER,
+			PARAM_UINTEGER,
+			PARAM_REAL,
+			PARAM_TEXT,
+			PARAM_BLOB
+		};
+
+		OrmParam();
+		OrmParam(long long value);
+		OrmParam(unsigned long long value);
+		OrmParam(double value);
+		OrmParam(const std::string &value, Type type_ = PARAM_TEXT);
+
+		Type type;
+		long long integer;
+		double real;
+		std::string text;
+	};
+
+	typedef std::vector<OrmParam> OrmParams;
+
+	// Data an upper layer associates with a result set, it is deleted
+	// together with the result set.
+	class OrmResultAttachment {
+	public:
+		virtual ~OrmResultAttachment();
+	};
+
 	class OrmResultImpl {
 	public:
 		OrmResultImpl();
@@ -82,6 +120,18 @@ namespace DB {
 		virtual const unsigned char *get_binary(const std::string &fieldname) = 0;
 		virtual size_t get_field_length(const std::string &fieldname) = 0;
 
+		// Table and where clause the rows were selected with. Allows the
+		// repeated fields of all rows to be read with one query per field.
+		// The table is empty when the origin of the rows is not known.
+		std::string source_table;
+		std::string source_where;
+		OrmParams source_params;
+		void set_source(const std::string &table,
+						const std::string &where,
+						const OrmParams &params);
+
+		OrmResultAttachment *attachment;
+
 	private:
 		// disable evil constructors
 		OrmResultImpl(const OrmResultImpl&);
@@ -133,18 +183,42 @@ namespace DB {
 		
 		virtual OrmResultT query(const char *statement, int len) = 0;
 		OrmResultT queryf(const char *format, ...);
+
+		// Execute a statement with '?' placeholders for the params. The
+		// statement text should not contain any values, so backends can
+		// cache the compiled statement and reuse it for different params.
+		virtual OrmResultT query_params(const std::string &statement,
+										const OrmParams &params);
+		OrmResultT queryf_params(const OrmParams &params,
+								 const char *format, ...);
+		bool quote_param(const OrmParam &param, std::string &dest);
 		
 		virtual bool table_exists(const std::string &name) = 0;
+		virtual bool index_exists(const std::string &table,
+								  const std::string &name) = 0;
 		virtual bool quote_string(const std::string &value, std::string &dest) = 0;
 		virtual bool quote_binary(const std::string &value, std::string &dest) = 0;
 
 		virtual unsigned long long sequence_last() = 0;
 
+		// Whether the rows of a single insert statement with several rows
+		// get consecutive ids ending at sequence_last().
+		virtual bool sequence_consecutive();
+
 		virtual OrmResultT CreateTableMessage(const std::string &name,
 											  const std::string &fields) = 0;
 		virtual OrmResultT CreateTableRelation(const std::string &name) = 0;
 		virtual OrmResultT CreateTableRepeatedValue(const std::string &name,
 													const std::string &type) = 0;
+		virtual OrmResultT CreateIndex(const std::string &name,
+									   const std::string &table,
+									   const std::string &columns,
+									   bool unique) = 0;
+
+		// Number of statements sent to the database on this connection.
+		unsigned long long statement_count() const;
+	protected:
+		unsigned long long _statements;
 	private:
 		// disable evil constructors
 		OrmConnT(const OrmConnT&);
@@ -42,26 +42,16 @@
 #include <stdio.h> 
 #include <stdarg.h>
 
-bool OrmMessageDelete(OrmConn conn,const pb::Descriptor *descriptor,pb::uint64 id)
-{
-	return OrmMessageDeleteWhere(conn,descriptor,"id=%llu",id);
-}
-
-bool OrmMessageDeleteWhere(OrmConn conn,
-						   const pb::Descriptor *descriptor,
-						   const char *format, va_list ap)
+static bool
+pb_message_delete_where(OrmConn conn,
+						const pb::Descriptor *descriptor,
+						const char *where,
+						const DB::OrmParams &params)
 {
-	// 256 bytes for where clause must be sufficient
-	char where[256];
-	int cneeded = vsnprintf(where,sizeof(where),format,ap);
-	if (cneeded>=sizeof(where)) {
-		OrmLogError("where clause overflow in OrmMessageDeleteWhere");
-		return false;
-	}
-
 	// enumerate the ids of the messages that should be deleted
-	DB::OrmResultT r( CONN->queryf("SELECT id FROM %s WHERE %s",
-									descriptor->name().c_str(),where) );
+	DB::OrmResultT r( CONN->queryf_params(params,
+										  "SELECT id FROM %s WHERE %s",
+										  descriptor->name().c_str(),where) );
 	if (!r.assigned()) {
 		OrmLogError("expected to be able to select from table: %s",
 					descriptor->name().c_str());
@@ -101,9 +91,10 @@ bool OrmMessageDeleteWhere(OrmConn conn,
 	}
 
 	// Delete the actual messages in one go.
-	DB::OrmResultT result( CONN->queryf("DELETE FROM %s WHERE %s",
-										descriptor->name().c_str(),
-										where) );
+	DB::OrmResultT result( CONN->queryf_params(params,
+											   "DELETE FROM %s WHERE %s",
+											   descriptor->name().c_str(),
+											   where) );
 	if (!result.assigned()) {
 		OrmLogError("failed to delete messages where \"%s\" from table: %s",
 					where, descriptor->name().c_str());
@@ -113,6 +104,26 @@ bool OrmMessageDeleteWhere(OrmConn conn,
 	return true;
 }
 
+bool OrmMessageDelete(OrmConn conn,const pb::Descriptor *descriptor,pb::uint64 id)
+{
+	DB::OrmParams params(1, DB::OrmParam((unsigned long long)id));
+	return pb_message_delete_where(conn,descriptor,"id=?",params);
+}
+
+bool OrmMessageDeleteWhere(OrmConn conn,
+						   const pb::Descriptor *descriptor,
+						   const char *format, va_list ap)
+{
+	// 256 bytes for where clause must be sufficient
+	char where[256];
+	int cneeded = vsnprintf(where,sizeof(where),format,ap);
+	if (cneeded>=sizeof(where)) {
+		OrmLogError("where clause overflow in OrmMessageDeleteWhere");
+		return false;
+	}
+
+	return pb_message_delete_where(conn,descriptor,where,DB::OrmParams());
+}
 
 bool OrmMessageDeleteWhere(OrmConn conn,
 						   const pb::Descriptor *descriptor,
@@ -148,9 +159,10 @@ bool OrmFieldDeleteAllRepeatedValues(OrmConn conn,
 	if (field->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
 		std::string fld = field->containing_type()->name() + "_" + field->name();
 		
-		DB::OrmResultT result( CONN->queryf("SELECT child_id FROM %s WHERE parent_id=%llu",
-											fld.c_str(),
-											id) );
+		DB::OrmParams params(1, DB::OrmParam((unsigned long long)id));
+		DB::OrmResultT result( CONN->queryf_params(params,
+												   "SELECT child_id FROM %s WHERE parent_id=?",
+												   fld.c_str()) );
 		if (!result.assigned()) {
 			OrmLogError("failed select child ids with parent_id: %llu from table: %s",
 					  id,fld.c_str());
@@ -175,9 +187,10 @@ bool OrmFieldDeleteAllRepeatedValues(OrmConn conn,
 	}
 	
 	std::string table = field->containing_type()->name() + "_" + field->name();
-	DB::OrmResultT result( CONN->queryf("DELETE FROM %s WHERE parent_id=%llu",
-										table.c_str(),
-										id) );
+	DB::OrmParams params(1, DB::OrmParam((unsigned long long)id));
+	DB::OrmResultT result( CONN->queryf_params(params,
+											   "DELETE FROM %s WHERE parent_id=?",
+											   table.c_str()) );
 	if (!result.assigned()) {
 		OrmLogError("failed to delete all records with parent_id: %llu from table: %s",
 				  id,
@@ -199,17 +212,18 @@ bool OrmFieldDeleteRepeatedValue(OrmConn conn,
 	std::string table = field->containing_type()->name() + "_" + field->name();
 
 	// Also delete the referenced message
+	DB::OrmParams params(1, DB::OrmParam((unsigned long long)fieldid));
 	DB::OrmResultT result;
 	if (field->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
 		if (!OrmMessageDelete(conn, field->message_type(), fieldid))
 			return false;
-		result = CONN->queryf("DELETE FROM %s WHERE child_id=%llu",
-							  table.c_str(),
-							  fieldid);
+		result = CONN->queryf_params(params,
+									 "DELETE FROM %s WHERE child_id=?",
+									 table.c_str());
 	} else {
-		result = CONN->queryf("DELETE FROM %s WHERE id=%llu",
-							  table.c_str(),
-							  fieldid);
+		result = CONN->queryf_params(params,
+									 "DELETE FROM %s WHERE id=?",
+									 table.c_str());
 	}
 	if (!result.assigned()) {
 		OrmLogError("failed to delete record with child_id: %llu from table: %s",
@@ -48,9 +48,10 @@ bool OrmMessageFind(OrmConn conn,
 					const pb::Descriptor *descriptor,
 					pb::uint64 id)
 {
-	DB::OrmResultT r( CONN->queryf("SELECT id FROM %s WHERE id=%llu",
-								   descriptor->name().c_str(),
-								   id) );
+	DB::OrmParams params(1, DB::OrmParam((unsigned long long)id));
+	DB::OrmResultT r( CONN->queryf_params(params,
+										  "SELECT id FROM %s WHERE id=?",
+										  descriptor->name().c_str()) );
 	if (!r.assigned()) {
 		OrmLogError("failed select from table: %s",descriptor->name().c_str());
 		return false;
@@ -64,9 +65,10 @@ bool OrmMessageSelect(OrmConn conn,
 					  pb::uint64 id,
 					  OrmResult &result)
 {
-	DB::OrmResultT r( CONN->queryf("SELECT * FROM %s WHERE id=%llu",
-							   descriptor->name().c_str(),
-							   id) );
+	DB::OrmParams params(1, DB::OrmParam((unsigned long long)id));
+	DB::OrmResultT r( CONN->queryf_params(params,
+										  "SELECT * FROM %s WHERE id=?",
+										  descriptor->name().c_str()) );
 	if (!r.assigned()) {
 		OrmLogError("failed select from table: %s",descriptor->name().c_str());
 		return false;
@@ -90,6 +92,7 @@ bool OrmMessageEnum(OrmConn conn,
 			  descriptor->name().c_str());
 		return false;
 	}
+	r->set_source(descriptor->name(), "", DB::OrmParams());
 	return r.new_handle(result);
 }
 
@@ -113,6 +116,7 @@ bool OrmMessageEnumWhere(OrmConn conn,
 					descriptor->name().c_str());
 		return false;
 	}
+	r->set_source(descriptor->name(), where, DB::OrmParams());
 	return r.new_handle(result);
 }
 
@@ -220,10 +224,11 @@ bool OrmFieldSelectMessage(OrmConn conn,
 	pb_field_name(field,field_name);
 
 	// Single field; containing table stores id for the field's message table
-	DB::OrmResultT r( CONN->queryf("SELECT %s FROM %s WHERE id=%llu",
-							   field_name.c_str(),
-							   field->containing_type()->name().c_str(),
-							   id) );
+	DB::OrmParams params(1, DB::OrmParam((unsigned long long)id));
+	DB::OrmResultT r( CONN->queryf_params(params,
+										  "SELECT %s FROM %s WHERE id=?",
+										  field_name.c_str(),
+										  field->containing_type()->name().c_str()) );
 	if (!r.assigned()) {
 		OrmLogError("expected to be able to select a message");
 		return false;
@@ -244,9 +249,10 @@ bool OrmFieldSelectMessage(OrmConn conn,
 	if (fieldid==0)
 		return false;
 	
-	r = CONN->queryf("SELECT * FROM %s WHERE id=%llu",
-					 field->message_type()->name().c_str(),
-					 fieldid);
+	params[0] = DB::OrmParam((unsigned long long)fieldid);
+	r = CONN->queryf_params(params,
+							"SELECT * FROM %s WHERE id=?",
+							field->message_type()->name().c_str());
 	if (!r.assigned()) {
 		OrmLogError("expected to be able to select message");
 		return false;
@@ -272,24 +278,31 @@ bool OrmFieldEnumAllRepeatedValues(OrmConn conn,
 
 	std::string fld = field->containing_type()->name() + "_" + field->name();
 	
+	DB::OrmParams params(1, DB::OrmParam((unsigned long long)id));
 	DB::OrmResultT r;
 	if (field->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
 		std::string msg = field->message_type()->name();
 		// Repeated field; containing table id is stored in child table as parent_id
 		// We need to join the table for the field relation with the table for the
 		// field value message type.
-		r = CONN->queryf("SELECT msg.*"
-						 " FROM %s msg INNER JOIN %s fld ON msg.id=fld.child_id"
-						 " WHERE fld.parent_id=%llu",
-						 msg.c_str(),
-						 fld.c_str(),id);
+		r = CONN->queryf_params(params,
+								"SELECT msg.*"
+								" FROM %s msg INNER JOIN %s fld ON msg.id=fld.child_id"
+								" WHERE fld.parent_id=?",
+								msg.c_str(),
+								fld.c_str());
+		// the messages can read their own repeated fields in one go.
+		if (r.assigned())
+			r->set_source(msg,
+						  "id IN (SELECT child_id FROM " + fld + " WHERE parent_id=?)",
+						  params);
 	} else {
 		// Repeated field; containing table id is stored in child table as parent_id
-		r = CONN->queryf("SELECT fld.*"
-						 " FROM %s fld"
-						 " WHERE fld.parent_id=%llu",
-						 fld.c_str(),
-						 id);
+		r = CONN->queryf_params(params,
+								"SELECT fld.*"
+								" FROM %s fld"
+								" WHERE fld.parent_id=?",
+								fld.c_str());
 	}
 	if (!r.assigned()) {
 		OrmLogError("expected to be able to enumerate values");
@@ -34,8 +34,11 @@
 #include "pb-orm-log.h"
 #include "pb-orm-database.h"
 #include "pb-orm-context.h"
+#include "pb-orm-value.h"
 #include "orm.pb.h"
 
+#include <set>
+
 
 static bool
 pb_reflection_set_datetime(const pb::Reflection *reflection,
@@ -103,6 +106,14 @@ pb_reflection_set_repeated_datetime(const pb::Reflection *reflection,
 	return false;	
 }
 
+static bool
+pb_prefetch_message(DB::OrmResultT &result,
+					pb::uint64 fieldid,
+					pb::Message &message,
+					const pb::FieldDescriptor *field,
+					bool recurse,
+					OrmContextT *context);
+
 static bool
 pb_assign_field(OrmResult result,
 				pb::Message &message,
@@ -234,6 +245,11 @@ pb_assign_field(OrmResult result,
 			 * here to prevent many database lookups. It however seems
 			 * to cause pb-orm-test failures. */
 			/** if (!recurse) return true; */
+
+			// read the message for all rows of the result set at once.
+			if (pb_prefetch_message(RESULT, id, message, field, recurse, context))
+				return true;
+
 			pb::Message *value = reflection->MutableMessage(&message, field);
 			if (!context)
 				return OrmMessageRead(RESULT.conn, *value, id, recurse);
@@ -294,7 +310,10 @@ pb_create_context(OrmResult result,
 	}
 	int index = message.GetReflection()->FieldSize(message, field)-1;
 	context->fields[field->number()][index] = (OrmContext)fcontext;
-	return true;			
+
+	// remember the value so an update can skip it when unchanged.
+	return pb_field_repeated_value(context->conn, &message, field, index,
+								   fcontext->values[field->number()]);			
 }
 
 static bool
@@ -597,6 +616,354 @@ bool OrmGetBinary(OrmResult result, std::string &value)
 	return true;
 }
 
+// Values of a message field read ahead for all rows of a result set.
+// For a repeated field they are kept per parent row in a holder message
+// with only that field set, for a singular field per child row in a message
+// of the field's type. When update contexts are needed every holder
+// has a context too.
+struct pb_prefetch_field {
+	bool recurse;
+	bool with_context;
+	std::map<pb::uint64, std::pair<pb::Message*,OrmContextT*> > holders;
+};
+
+class pb_prefetch : public DB::OrmResultAttachment {
+public:
+	bool ids_loaded;
+	std::set<pb::uint64> ids; // rows covered by the read ahead
+	std::set< std::pair<pb::uint64,int> > consumed; // (row,field) handed out
+	std::map<int, pb_prefetch_field> fields;
+
+	pb_prefetch() : ids_loaded(false) {
+	}
+	virtual ~pb_prefetch() {
+		std::map<int, pb_prefetch_field>::iterator fit;
+		for (fit=fields.begin(); fit!=fields.end(); ++fit)
+			clear(fit->second);
+	}
+	static void clear(pb_prefetch_field &pf) {
+		std::map<pb::uint64, std::pair<pb::Message*,OrmContextT*> >::iterator it;
+		for (it=pf.holders.begin(); it!=pf.holders.end(); ++it) {
+			delete it->second.first;
+			delete it->second.second;
+		}
+		pf.holders.clear();
+	}
+};
+
+// Contexts of aggregated messages are keyed by the address of the message.
+// Move the context tree of message 'from' over to its copy 'to'.
+static void
+pb_context_rebind(OrmContextT *context,
+				  const pb::Message &from,
+				  pb::Message &to)
+{
+	context->message = &to;
+	const pb::Descriptor *descriptor = to.GetDescriptor();
+	const pb::Reflection *reflection = to.GetReflection();
+	for (int f=0; f<descriptor->field_count(); ++f) {
+		const pb::FieldDescriptor *field = descriptor->field(f);
+		if (field->type() != pb::FieldDescriptor::TYPE_MESSAGE)
+			continue;
+		std::map< int, std::map<pb::uint64,OrmContext> >::iterator it =
+			context->fields.find(field->number());
+		if (it == context->fields.end())
+			continue;
+		
+		std::map<pb::uint64,OrmContext> &fc = it->second;
+		std::map<pb::uint64,OrmContext> rebound;
+		int size = field->is_repeated() ? reflection->FieldSize(from, field)
+					: (reflection->HasField(from, field) ? 1 : 0);
+		for (int i=0; i<size; ++i) {
+			const pb::Message *fromval;
+			pb::Message *toval;
+			if (field->is_repeated()) {
+				fromval = &reflection->GetRepeatedMessage(from, field, i);
+				toval = reflection->MutableRepeatedMessage(&to, field, i);
+			} else {
+				fromval = &reflection->GetMessage(from, field);
+				toval = reflection->MutableMessage(&to, field);
+			}
+			std::map<pb::uint64,OrmContext>::iterator cit =
+				fc.find((pb::uint64)fromval);
+			if (cit == fc.end())
+				continue;
+			pb_context_rebind((OrmContextT*)cit->second, *fromval, *toval);
+			rebound[(pb::uint64)toval] = cit->second;
+			fc.erase(cit);
+		}
+		// anything left was not keyed by a message, keep it as it is.
+		rebound.insert(fc.begin(), fc.end());
+		fc.swap(rebound);
+	}
+}
+
+static pb_prefetch *
+pb_prefetch_get(DB::OrmResultT &result)
+{
+	if (result->source_table.empty())
+		return NULL;
+	if (result->attachment)
+		return dynamic_cast<pb_prefetch*>(result->attachment);
+	pb_prefetch *prefetch = new pb_prefetch;
+	result->attachment = prefetch;
+	return prefetch;
+}
+
+// Check whether the read ahead of repeated fields covers the row. Rows
+// that are not covered, e.g. because they were inserted during the
+// enumeration, read their repeated fields one row at a time.
+static bool
+pb_prefetch_covers(DB::OrmResultT &result, pb_prefetch *prefetch, pb::uint64 id)
+{
+	if (!prefetch->ids_loaded) {
+		prefetch->ids_loaded = true;
+		OrmConn conn = result.conn;
+		DB::OrmResultT ids( CONN->queryf_params(result->source_params,
+												"SELECT id FROM %s%s%s",
+												result->source_table.c_str(),
+												result->source_where.empty() ? "" : " WHERE ",
+												result->source_where.c_str()) );
+		if (!ids.assigned())
+			return false;
+		for (bool ok=ids->first_row(); ok; ok=ids->next_row()) {
+			pb::uint64 rowid = ids->get_ulonglong_idx(1);
+			if (ids->failed()) {
+				prefetch->ids.clear();
+				return false;
+			}
+			prefetch->ids.insert(rowid);
+		}
+	}
+	return prefetch->ids.count(id) != 0;
+}
+
+static bool
+pb_prefetch_load(DB::OrmResultT &result,
+				 pb_prefetch *prefetch,
+				 const pb::Message &message,
+				 const pb::FieldDescriptor *field,
+				 bool recurse,
+				 bool with_context)
+{
+	OrmConn conn = result.conn;
+	std::string from = " FROM " + result->source_table;
+	if (!result->source_where.empty())
+		from += " WHERE " + result->source_where;
+	std::string parents = "SELECT id" + from;
+	
+	DB::OrmResultT r;
+	if (!field->is_repeated()) {
+		// Select the messages referenced by the field from all rows.
+		std::string msg = field->message_type()->name();
+		std::string name;
+		pb_field_name(field, name);
+		std::string children = "SELECT " + name + from;
+		r = CONN->queryf_params(result->source_params,
+								"SELECT * FROM %s WHERE id IN (%s)",
+								msg.c_str(),
+								children.c_str());
+		if (r.assigned())
+			r->set_source(msg, "id IN (" + children + ")", result->source_params);
+	} else if (field->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
+		std::string fld = field->containing_type()->name() + "_" + field->name();
+		std::string msg = field->message_type()->name();
+		r = CONN->queryf_params(result->source_params,
+								"SELECT fld.parent_id AS orm_parent_id,msg.*"
+								" FROM %s msg INNER JOIN %s fld ON msg.id=fld.child_id"
+								" WHERE fld.parent_id IN (%s)"
+								" ORDER BY fld.parent_id,fld.child_id",
+								msg.c_str(),
+								fld.c_str(),
+								parents.c_str());
+		// the messages can read their own fields in one go.
+		if (r.assigned())
+			r->set_source(msg,
+						  "id IN (SELECT child_id FROM " + fld
+						  + " WHERE parent_id IN (" + parents + "))",
+						  result->source_params);
+	} else {
+		std::string fld = field->containing_type()->name() + "_" + field->name();
+		r = CONN->queryf_params(result->source_params,
+								"SELECT fld.*,fld.parent_id AS orm_parent_id"
+								" FROM %s fld"
+								" WHERE fld.parent_id IN (%s)"
+								" ORDER BY fld.parent_id,fld.id",
+								fld.c_str(),
+								parents.c_str());
+	}
+	if (!r.assigned())
+		return false;
+
+	pb_prefetch_field &pf = prefetch->fields[field->number()];
+	pf.recurse = recurse;
+	pf.with_context = with_context;
+	bool ok = true;
+	for (bool row=r->first_row(); ok && row; row=r->next_row()) {
+		if (!field->is_repeated()) {
+			pb::uint64 id;
+			ok = OrmGetId((OrmResult)&r, id);
+			if (!ok)
+				break;
+			std::pair<pb::Message*,OrmContextT*> &holder = pf.holders[id];
+			if (holder.first)
+				continue;
+			holder.first = message.GetReflection()->GetMessage(message, field).New();
+			if (with_context) {
+				OrmContext fctx;
+				ok = OrmGetMessage((OrmResult)&r, *holder.first, recurse, fctx);
+				holder.second = (OrmContextT*)fctx;
+			} else
+				ok = OrmGetMessage((OrmResult)&r, *holder.first, recurse);
+		} else {
+			pb::uint64 parent = r->get_ulonglong("orm_parent_id");
+			ok = !r->failed();
+			if (!ok)
+				break;
+			std::pair<pb::Message*,OrmContextT*> &holder = pf.holders[parent];
+			if (!holder.first) {
+				holder.first = message.New();
+				if (with_context) {
+					holder.second = new OrmContextT;
+					holder.second->conn = conn;
+				}
+			}
+			ok = pb_add_repeated_field((OrmResult)&r, *holder.first, field,
+									   holder.second);
+		}
+	}
+	if (!ok) {
+		pb_prefetch::clear(pf);
+		prefetch->fields.erase(field->number());
+		return false;
+	}
+	return true;
+}
+
+// Find the values read ahead for the field, reading them when this is the
+// first row that asks for them.
+static pb_prefetch_field *
+pb_prefetch_field_get(DB::OrmResultT &result,
+					  pb_prefetch *prefetch,
+					  const pb::Message &message,
+					  const pb::FieldDescriptor *field,
+					  bool recurse,
+					  OrmContextT *context)
+{
+	std::map<int, pb_prefetch_field>::iterator fit =
+		prefetch->fields.find(field->number());
+	if (fit == prefetch->fields.end()) {
+		if (!pb_prefetch_load(result, prefetch, message, field, recurse,
+							  context!=NULL))
+			return NULL;
+		fit = prefetch->fields.find(field->number());
+	}
+	pb_prefetch_field &pf = fit->second;
+	if (pf.recurse != recurse || (context && !pf.with_context))
+		return NULL;
+	return &pf;
+}
+
+// Assign a singular message field from the messages read ahead for all rows
+// of the result set. Returns false when the message has to be read for
+// this row individually.
+static bool
+pb_prefetch_message(DB::OrmResultT &result,
+					pb::uint64 fieldid,
+					pb::Message &message,
+					const pb::FieldDescriptor *field,
+					bool recurse,
+					OrmContextT *context)
+{
+	pb_prefetch *prefetch = pb_prefetch_get(result);
+	if (!prefetch)
+		return false;
+	pb_prefetch_field *pf =
+		pb_prefetch_field_get(result, prefetch, message, field, recurse, context);
+	if (!pf)
+		return false;
+	
+	// The message is moved into the row, so a row read a second time
+	// reads it from the database again.
+	std::map<pb::uint64, std::pair<pb::Message*,OrmContextT*> >::iterator it =
+		pf->holders.find(fieldid);
+	if (it == pf->holders.end())
+		return false;
+	
+	pb::Message *value = message.GetReflection()->MutableMessage(&message, field);
+	value->CopyFrom(*it->second.first);
+	if (context && it->second.second) {
+		pb_context_rebind(it->second.second, *it->second.first, *value);
+		context->fields[field->number()][(pb::uint64)value] = it->second.second;
+		it->second.second = NULL;
+	}
+	delete it->second.first;
+	delete it->second.second;
+	pf->holders.erase(it);
+	return true;
+}
+
+// Assign the values of a repeated field from the values read ahead for all
+// rows of the result set. Returns false when the field has to be read for
+// this row individually.
+static bool
+pb_prefetch_repeated(DB::OrmResultT &result,
+					 pb::uint64 id,
+					 pb::Message &message,
+					 const pb::FieldDescriptor *field,
+					 OrmContextT *context)
+{
+	pb_prefetch *prefetch = pb_prefetch_get(result);
+	if (!prefetch || !pb_prefetch_covers(result, prefetch, id))
+		return false;
+
+	// The values are moved into the message, so a row read a second time
+	// reads them from the database again.
+	int number = field->number();
+	std::pair<pb::uint64,int> key(id, number);
+	if (prefetch->consumed.count(key))
+		return false;
+	pb_prefetch_field *pf =
+		pb_prefetch_field_get(result, prefetch, message, field, true, context);
+	if (!pf)
+		return false;
+
+	prefetch->consumed.insert(key);
+	std::map<pb::uint64, std::pair<pb::Message*,OrmContextT*> >::iterator it =
+		pf->holders.find(id);
+	if (it == pf->holders.end())
+		return true; // no values for this row
+	
+	pb::Message *holder = it->second.first;
+	OrmContextT *hcontext = it->second.second;
+	message.MergeFrom(*holder);
+	if (context && hcontext) {
+		std::map<pb::uint64,OrmContext> &hfc = hcontext->fields[number];
+		std::map<pb::uint64,OrmContext> &fc = context->fields[number];
+		if (field->type() == pb::FieldDescriptor::TYPE_MESSAGE) {
+			const pb::Reflection *reflection = message.GetReflection();
+			for (int i=0; i<reflection->FieldSize(*holder, field); ++i) {
+				const pb::Message &from = reflection->GetRepeatedMessage(*holder, field, i);
+				pb::Message *to = reflection->MutableRepeatedMessage(&message, field, i);
+				std::map<pb::uint64,OrmContext>::iterator cit = hfc.find((pb::uint64)&from);
+				if (cit == hfc.end())
+					continue;
+				pb_context_rebind((OrmContextT*)cit->second, from, *to);
+				fc[(pb::uint64)to] = cit->second;
+				hfc.erase(cit);
+			}
+		} else {
+			// repeated values are keyed by their index in the field.
+			fc.insert(hfc.begin(), hfc.end());
+			hfc.clear();
+		}
+	}
+	delete holder;
+	delete hcontext;
+	pf->holders.erase(it);
+	return true;
+}
+
 static bool
 _OrmGetMessage(OrmResult result, pb::Message &message, bool recurse, OrmContextT *context)
 {
@@ -614,6 +981,10 @@ _OrmGetMessage(OrmResult result, pb::Message &message, bool recurse, OrmContextT
 				if (!OrmGetId(result, id))
 					return false;
 				
+				// read the field for all rows of the result set at once.
+				if (pb_prefetch_repeated(RESULT, id, message, field, context))
+					continue;
+				
 				OrmResult fieldres;
 				if (!OrmFieldEnumAllRepeatedValues(RESULT.conn,
 												   id,
@@ -634,6 +1005,14 @@ _OrmGetMessage(OrmResult result, pb::Message &message, bool recurse, OrmContextT
 		} else {
 			if (!pb_assign_field(result, message, field, recurse, context))
 				return false;
+
+			// remember the column value so an update can skip it when
+			// unchanged, aggregated messages have a context of their own.
+			if (context && field->type() != pb::FieldDescriptor::TYPE_MESSAGE) {
+				if (!pb_field_value(RESULT.conn, &message, field,
+									context->values[field->number()]))
+					return false;
+			}
 		}
 		
 	}
@@ -663,6 +1042,7 @@ bool OrmGetMessage(OrmResult result,
 	ctx->conn = RESULT.conn;
 	ctx->message = &message;
 	if (OrmGetId(result, ctx->id) && _OrmGetMessage(result, message, recurse, ctx)) {
+		ctx->has_snapshot = message.SerializePartialToString(&ctx->snapshot);
 		context = (OrmContext)ctx;
 		return true;
 	}
@@ -46,7 +46,7 @@
 static bool
 pb_field_set_repeated_value(OrmConn conn,
 							const pb::FieldDescriptor *field,
-							const std::string value,
+							const DB::OrmParam &value,
 							pb::uint64 fieldid)
 {
 	if (!field->is_repeated()) {
@@ -55,12 +55,14 @@ pb_field_set_repeated_value(OrmConn conn,
 	}
 	std::string table = field->containing_type()->name() + "_" + field->name();
 	
-	std::string assignment = "value=" + value;
+	std::string statement;
+	if (!OrmFormat(statement,"UPDATE %s SET value=? WHERE id=?",table.c_str()))
+		return false;
+	DB::OrmParams params;
+	params.push_back(value);
+	params.push_back(DB::OrmParam((unsigned long long)fieldid));
 	
-	DB::OrmResultT result( CONN->queryf("UPDATE %s SET %s WHERE id=%llu",
-									table.c_str(),
-									assignment.c_str(),
-									fieldid) );
+	DB::OrmResultT result( CONN->query_params(statement,params) );
 	if (!result.assigned())
 		return false;
 	return true;
@@ -121,7 +123,19 @@ pb_field_update_repeated_value(OrmContextT *context,
 		// update first fieldsize number of fields in the db from message field values
 		for (int i=0; i<fieldsize; ++i) {
 			OrmContextT *fcontext = (OrmContextT*)fc[i];
-			if (!OrmFieldSetRepeatedValue(context->conn, context->id, *context->message, field, i, fcontext->id))
+			std::string value;
+			if (!pb_field_repeated_value(context->conn,context->message,field,i,value))
+				return false;
+
+			// skip values that did not change since they were read.
+			std::map<int,std::string>::iterator vit = fcontext->values.find(field->number());
+			if (vit != fcontext->values.end() && vit->second == value)
+				continue;
+
+			DB::OrmParam param;
+			if (!pb_field_repeated_param(context->message,field,i,param))
+				return false;
+			if (!pb_field_set_repeated_value(context->conn, field, param, fcontext->id))
 				return false;
 		}
 		
@@ -150,7 +164,8 @@ pb_field_update_repeated_value(OrmContextT *context,
 static bool
 pb_field_update_value(OrmContextT *context,
 					  const pb::FieldDescriptor *field,
-					  std::string &assignments)
+					  std::string &assignments,
+					  DB::OrmParams &params)
 {
 	const pb::Reflection *reflection = context->message->GetReflection();
 
@@ -181,7 +196,7 @@ pb_field_update_value(OrmContextT *context,
 	std::string name;
 	pb_field_name(field,name);
 	
-	std::string value;
+	DB::OrmParam param;
 	if (type == pb::FieldDescriptor::TYPE_MESSAGE) {
 		// Handle MESSAGE value
 		
@@ -222,7 +237,7 @@ pb_field_update_value(OrmContextT *context,
 				// Field is not present in message => Delete existing.
 				if (!OrmMessageDelete(context->conn,field->message_type(),fieldid))
 					return false; // Failed to delete aggregated message, don't continue.
-				value = "NULL";
+				param = DB::OrmParam();
 			}
 		} else {
 			// The field is currently not present in the table
@@ -234,8 +249,7 @@ pb_field_update_value(OrmContextT *context,
 				if (!OrmMessageInsert(context->conn, reflection->GetMessage(*context->message, field), fieldid))
 					return false;
 				
-				if (!pb_field_uint64_value(fieldid, value))
-					return false;
+				param = DB::OrmParam((unsigned long long)fieldid);
 				
 			} else {
 				// Field is not present in message => nothing to do
@@ -244,10 +258,20 @@ pb_field_update_value(OrmContextT *context,
 		}
 	} else {
 		// Handle other types of values.
+		std::string value;
 		if (!pb_field_value(context->conn,context->message,field,value))
 			return false;
+
+		// Skip columns that did not change since the message was read.
+		std::map<int,std::string>::iterator vit = context->values.find(field->number());
+		if (vit != context->values.end() && vit->second == value)
+			return true;
+
+		if (!pb_field_param(context->message,field,param))
+			return false;
 	}
-	OrmChain(assignments,name + "=" + value,',');
+	OrmChain(assignments,name + "=?",',');
+	params.push_back(param);
 	return true;
 }
 
@@ -267,10 +291,20 @@ bool OrmMessageUpdate(OrmContext context)
 		return false;
 	}
 
+	// Nothing changed since the message was read, so there is nothing to
+	// write for the message and all the messages and values it aggregates.
+	if (ctx->has_snapshot) {
+		std::string current;
+		if (ctx->message->SerializePartialToString(&current)
+			&& current == ctx->snapshot)
+			return true;
+	}
+
 	// Recursively update aggregated messages and repeated values
 	// For values stored in the table associated with the current message create
 	// a string with assignments.
 	std::string assignments;
+	DB::OrmParams params;
 	const pb::Descriptor *descriptor = ctx->message->GetDescriptor();
 	for (int f=0; f<descriptor->field_count(); ++f) {
 		const pb::FieldDescriptor*field = descriptor->field(f);
@@ -278,7 +312,7 @@ bool OrmMessageUpdate(OrmContext context)
 			if (!pb_field_update_repeated_value(ctx,field))
 				return false;
 		} else {
-			if (!pb_field_update_value(ctx,field,assignments))
+			if (!pb_field_update_value(ctx,field,assignments,params))
 				return false;
 		}
 	}
@@ -286,10 +320,14 @@ bool OrmMessageUpdate(OrmContext context)
 	if (assignments.size() > 0) {
 		OrmConn conn = ctx->conn;
 		
-		DB::OrmResultT result( CONN->queryf("UPDATE %s SET %s WHERE id=%llu",
-										ctx->message->GetDescriptor()->name().c_str(),
-										assignments.c_str(),
-										ctx->id) );
+		std::string statement;
+		if (!OrmFormat(statement,"UPDATE %s SET %s WHERE id=?",
+					   ctx->message->GetDescriptor()->name().c_str(),
+					   assignments.c_str()))
+			return false;
+		params.push_back(DB::OrmParam((unsigned long long)ctx->id));
+		
+		DB::OrmResultT result( CONN->query_params(statement,params) );
 		if (!result.assigned())
 			return false;
 	}
@@ -303,8 +341,11 @@ bool OrmFieldSetRepeatedValue(OrmConn conn,
 							  int index,
 							  pb::uint64 fieldid)
 {
-	std::string value;			
-	if (!pb_field_repeated_value(conn,&message,field,index,value))
+	// The row of the value is known by fieldid, id is kept to match
+	// OrmFieldAddRepeatedValue.
+	(void)id;
+	DB::OrmParam value;
+	if (!pb_field_repeated_param(&message,field,index,value))
 		return false;
 	return pb_field_set_repeated_value(conn, field, value, fieldid);
 }
@@ -314,9 +355,7 @@ bool OrmFieldSetRepeatedBool(OrmConn conn,
 							 bool value,
 							 pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_bool_value(value,assignment))
-		return false;
+	DB::OrmParam assignment(value?1LL:0LL);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -325,9 +364,7 @@ bool OrmFieldSetRepeatedFloat(OrmConn conn,
 							  float value,
 							  pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_float_value(value,assignment))
-		return false;
+	DB::OrmParam assignment((double)value);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -336,9 +373,7 @@ bool OrmFieldSetRepeatedDouble(OrmConn conn,
 							   double value,
 							   pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_double_value(value,assignment))
-		return false;
+	DB::OrmParam assignment(value);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -347,9 +382,7 @@ bool OrmFieldSetRepeatedInt32(OrmConn conn,
 							  pb::int32 value,
 							  pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_int32_value(value,assignment))
-		return false;
+	DB::OrmParam assignment((long long)value);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -358,9 +391,7 @@ bool OrmFieldSetRepeatedInt64(OrmConn conn,
 							  pb::int64 value,
 							  pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_int64_value(value,assignment))
-		return false;
+	DB::OrmParam assignment((long long)value);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -369,9 +400,7 @@ bool OrmFieldSetRepeatedUint32(OrmConn conn,
 							   pb::uint32 value,
 							   pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_uint32_value(value,assignment))
-		return false;
+	DB::OrmParam assignment((long long)value);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -380,9 +409,7 @@ bool OrmFieldSetRepeatedUint64(OrmConn conn,
 							   pb::uint64 value,
 							   pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_uint64_value(value,assignment))
-		return false;
+	DB::OrmParam assignment((unsigned long long)value);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -391,9 +418,7 @@ bool OrmFieldSetRepeatedString(OrmConn conn,
 							   const std::string &value,
 							   pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_string_value(conn,value,assignment))
-		return false;
+	DB::OrmParam assignment(value);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -402,9 +427,7 @@ bool OrmFieldSetRepeatedBinary(OrmConn conn,
 							   const std::string &value,
 							   pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_binary_value(conn,value,assignment))
-		return false;
+	DB::OrmParam assignment(value,DB::OrmParam::PARAM_BLOB);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -425,9 +448,7 @@ bool OrmFieldSetRepeatedEnum(OrmConn conn,
 							 const std::string &value,
 							 pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_enum_value(value,assignment))
-		return false;
+	DB::OrmParam assignment(value);
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
 
@@ -436,8 +457,8 @@ bool OrmFieldSetRepeatedDateTime(OrmConn conn,
 								 time_t value,
 								 pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_datetime_value(value,assignment))
+	DB::OrmParam assignment;
+	if (!pb_field_datetime_param(value,assignment))
 		return false;
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
@@ -447,8 +468,8 @@ bool OrmFieldSetRepeatedDate(OrmConn conn,
 							 time_t value,
 							 pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_date_value(value,assignment))
+	DB::OrmParam assignment;
+	if (!pb_field_date_param(value,assignment))
 		return false;
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
@@ -458,8 +479,8 @@ bool OrmFieldSetRepeatedTime(OrmConn conn,
 							 time_t value,
 							 pb::uint64 fieldid)
 {
-	std::string assignment;
-	if (!pb_field_time_value(value,assignment))
+	DB::OrmParam assignment;
+	if (!pb_field_time_param(value,assignment))
 		return false;
 	return pb_field_set_repeated_value(conn, field, assignment, fieldid);
 }
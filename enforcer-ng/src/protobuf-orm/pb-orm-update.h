@@ -41,6 +41,8 @@
 // may introduce differences between the message in memory and the message in 
 // the db. So you first need to use OrmMessageRead again to refresh the message
 // from the db before calling OrmMessageUpdate again.
+// Only columns, repeated values and aggregated messages that changed since the
+// message was read are written to the db.
 bool OrmMessageUpdate(OrmContext context);
 
 // NOTE: does not handle repeated message values.
@@ -385,3 +385,214 @@ pb_field_repeated_value(OrmConn conn,
 	OrmLogError("ERROR: UNKNOWN FIELD TYPE");
 	return false;
 }
+
+static bool
+pb_time_param(const char *format, time_t value, DB::OrmParam &dest)
+{
+	char timestr[32];
+	struct tm timestruct;
+	if (value==-1)
+		return false;
+	strftime(timestr, sizeof(timestr), format, gmtime_r(&value, &timestruct));
+	dest = DB::OrmParam(std::string(timestr));
+	return true;
+}
+
+bool pb_field_datetime_param(time_t value, DB::OrmParam &dest)
+{
+	return pb_time_param("%Y-%m-%d %H:%M:%S", value, dest);
+}
+
+bool pb_field_date_param(time_t value, DB::OrmParam &dest)
+{
+	return pb_time_param("%Y-%m-%d", value, dest);
+}
+
+bool pb_field_time_param(time_t value, DB::OrmParam &dest)
+{
+	return pb_time_param("%H:%M:%S", value, dest);
+}
+
+bool pb_field_param(const pb::Message *message,
+					const pb::FieldDescriptor *field,
+					DB::OrmParam &dest)
+{
+	const pb::Reflection *reflection = message->GetReflection();
+	
+	// A type that is not present should be represented by NULL
+	if (!reflection->HasField(*message, field)) {
+		dest = DB::OrmParam();
+		return true;
+	}
+	
+	orm::Column	column;
+	if (field->options().HasExtension(orm::column)) {
+		column = field->options().GetExtension(orm::column);
+	}
+	if (column.has_type()) {
+		switch (column.type()) {
+			case orm::DATETIME: {
+				time_t value = pb_reflection_get_time(reflection, *message, field);
+				return pb_field_datetime_param(value,dest);
+			}
+			case orm::DATE: {
+				time_t value = pb_reflection_get_time(reflection, *message, field);
+				return pb_field_date_param(value,dest);
+			}
+			case orm::TIME: {
+				time_t value = pb_reflection_get_time(reflection, *message, field);
+				return pb_field_time_param(value,dest);
+			}
+			case orm::YEAR: {
+				break;
+			}
+			default:
+				OrmLogError("unknown ormoption.type");
+				return false;
+		}
+	}
+	
+	switch (field->type()) {
+		case pb::FieldDescriptor::TYPE_BOOL:
+			dest = DB::OrmParam(reflection->GetBool(*message,field)?1LL:0LL);
+			return true;
+		case pb::FieldDescriptor::TYPE_FLOAT:
+			dest = DB::OrmParam((double)reflection->GetFloat(*message,field));
+			return true;
+		case pb::FieldDescriptor::TYPE_DOUBLE:
+			dest = DB::OrmParam(reflection->GetDouble(*message,field));
+			return true;
+		case pb::FieldDescriptor::TYPE_INT32:
+		case pb::FieldDescriptor::TYPE_SFIXED32:
+		case pb::FieldDescriptor::TYPE_SINT32:
+			dest = DB::OrmParam((long long)reflection->GetInt32(*message,field));
+			return true;
+		case pb::FieldDescriptor::TYPE_INT64:
+		case pb::FieldDescriptor::TYPE_SFIXED64:
+		case pb::FieldDescriptor::TYPE_SINT64:
+			dest = DB::OrmParam((long long)reflection->GetInt64(*message,field));
+			return true;
+		case pb::FieldDescriptor::TYPE_UINT32:
+		case pb::FieldDescriptor::TYPE_FIXED32:
+			dest = DB::OrmParam((long long)reflection->GetUInt32(*message,field));
+			return true;
+		case pb::FieldDescriptor::TYPE_UINT64:
+		case pb::FieldDescriptor::TYPE_FIXED64:
+			dest = DB::OrmParam((unsigned long long)reflection->GetUInt64(*message,field));
+			return true;
+		case pb::FieldDescriptor::TYPE_STRING:
+			dest = DB::OrmParam(reflection->GetString(*message,field));
+			return true;
+		case pb::FieldDescriptor::TYPE_GROUP:
+			OrmLogError("cannot create parameter for TYPE_GROUP");
+			return false;
+		case pb::FieldDescriptor::TYPE_MESSAGE:
+			OrmLogError("cannot create parameter for TYPE_MESSAGE");
+			return false;
+		case pb::FieldDescriptor::TYPE_BYTES:
+			dest = DB::OrmParam(reflection->GetString(*message,field),
+								DB::OrmParam::PARAM_BLOB);
+			return true;
+		case pb::FieldDescriptor::TYPE_ENUM:
+			dest = DB::OrmParam(reflection->GetEnum(*message,field)->name());
+			return true;
+	}
+	OrmLogError("ERROR: UNKNOWN FIELD TYPE");
+	return false;
+}
+
+bool
+pb_field_repeated_param(const pb::Message *message,
+						const pb::FieldDescriptor *field,
+						int index,
+						DB::OrmParam &dest)
+{
+	const pb::Reflection *reflection = message->GetReflection();
+	
+	orm::Column column;
+	if (field->options().HasExtension(orm::column)) {
+		column = field->options().GetExtension(orm::column);
+	}
+	if (column.has_type()) {
+		switch (column.type()) {
+			case orm::DATETIME: {
+				time_t value = 
+				pb_reflection_get_repeated_time_at_index(reflection,
+														 *message,
+														 field,
+														 index);
+				return pb_field_datetime_param(value, dest);
+			}
+			case orm::DATE: {
+				time_t value = 
+				pb_reflection_get_repeated_time_at_index(reflection,
+														 *message,
+														 field,
+														 index);
+				return pb_field_date_param(value, dest);
+			}
+			case orm::TIME: {
+				time_t value = 
+				pb_reflection_get_repeated_time_at_index(reflection,
+														 *message,
+														 field,
+														 index);
+				return pb_field_time_param(value, dest);
+			}
+			case orm::YEAR: {
+				break;
+			}
+			default:
+				OrmLogError("unknown ormoption.type");
+				return false;
+		}
+	}
+	
+	switch (field->type()) {
+		case pb::FieldDescriptor::TYPE_BOOL:
+			dest = DB::OrmParam(reflection->GetRepeatedBool(*message,field,index)?1LL:0LL);
+			return true;
+		case pb::FieldDescriptor::TYPE_FLOAT:
+			dest = DB::OrmParam((double)reflection->GetRepeatedFloat(*message,field,index));
+			return true;
+		case pb::FieldDescriptor::TYPE_DOUBLE:
+			dest = DB::OrmParam(reflection->GetRepeatedDouble(*message,field,index));
+			return true;
+		case pb::FieldDescriptor::TYPE_INT32:
+		case pb::FieldDescriptor::TYPE_SFIXED32:
+		case pb::FieldDescriptor::TYPE_SINT32:
+			dest = DB::OrmParam((long long)reflection->GetRepeatedInt32(*message,field,index));
+			return true;
+		case pb::FieldDescriptor::TYPE_INT64:
+		case pb::FieldDescriptor::TYPE_SFIXED64:
+		case pb::FieldDescriptor::TYPE_SINT64:
+			dest = DB::OrmParam((long long)reflection->GetRepeatedInt64(*message,field,index));
+			return true;
+		case pb::FieldDescriptor::TYPE_UINT32:
+		case pb::FieldDescriptor::TYPE_FIXED32:
+			dest = DB::OrmParam((long long)reflection->GetRepeatedUInt32(*message,field,index));
+			return true;
+		case pb::FieldDescriptor::TYPE_UINT64:
+		case pb::FieldDescriptor::TYPE_FIXED64:
+			dest = DB::OrmParam((unsigned long long)reflection->GetRepeatedUInt64(*message,field,index));
+			return true;
+		case pb::FieldDescriptor::TYPE_STRING:
+			dest = DB::OrmParam(reflection->GetRepeatedString(*message,field,index));
+			return true;
+		case pb::FieldDescriptor::TYPE_GROUP:
+			OrmLogError("cannot create parameter for TYPE_GROUP");
+			return false;
+		case pb::FieldDescriptor::TYPE_MESSAGE:
+			OrmLogError("cannot create parameter for TYPE_MESSAGE");
+			return false;
+		case pb::FieldDescriptor::TYPE_BYTES:
+			dest = DB::OrmParam(reflection->GetRepeatedString(*message,field,index),
+								DB::OrmParam::PARAM_BLOB);
+			return true;
+		case pb::FieldDescriptor::TYPE_ENUM:
+			dest = DB::OrmParam(reflection->GetRepeatedEnum(*message,field,index)->name());
+			return true;
+	}
+	OrmLogError("ERROR: UNKNOWN FIELD TYPE");
+	return false;
+}
@@ -35,6 +35,7 @@
 #define pb_orm_value_h
 
 #include "pb-orm-common.h"
+#include "pb-orm-database.h"
 
 void pb_field_name(const pb::FieldDescriptor *field,
 				   std::string &name);
@@ -91,4 +92,25 @@ bool pb_field_repeated_value(OrmConn conn,
 							 int index,
 							 std::string &dest);
 
+// Same as above, but extracting the values as parameters to be bound to a
+// statement passed to OrmConnT::query_params().
+
+bool pb_field_param(const pb::Message *message,
+					const pb::FieldDescriptor *field,
+					DB::OrmParam &dest);
+
+bool pb_field_datetime_param(time_t value,
+							 DB::OrmParam &dest);
+
+bool pb_field_date_param(time_t value,
+						 DB::OrmParam &dest);
+
+bool pb_field_time_param(time_t value,
+						 DB::OrmParam &dest);
+
+bool pb_field_repeated_param(const pb::Message *message,
+							 const pb::FieldDescriptor *field,
+							 int index,
+							 DB::OrmParam &dest);
+
 #endif
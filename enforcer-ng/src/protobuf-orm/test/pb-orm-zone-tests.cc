@@ -32,10 +32,13 @@
  Contains test cases to test with messages defined in the zone.proto file
  *****************************************************************************/
 
+#include <stdio.h>
+
 #include "pb-orm-zone-tests.h"
 #include "timecollector.h"
 #include "pbormtest.h"
 
+#include "pb-orm-database.h"
 #include "zone.pb.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(ZoneTests);
@@ -118,3 +121,269 @@ void ZoneTests::testZonesCRUD()
 
 	CPPUNIT_ASSERT(OrmMessageRead(conn, zone, zoneid, true));
 }
+
+static void
+set_keystate(pb_orm_test::KeyState *keystate)
+{
+	keystate->set_state(pb_orm_test::sohidden);
+	keystate->set_last_change(0);
+	keystate->set_minimize(false);
+	keystate->set_ttl(3600);
+}
+
+static void
+set_zone(pb_orm_test::EnforcerZone &zone, const char *name, int nkeys)
+{
+	zone.set_name(name);
+	zone.set_policy("default");
+	zone.set_signconf_needs_writing(false);
+	zone.set_signconf_path(std::string("/var/opendnssec/signconf/") + name);
+	zone.set_next_change(0);
+	for (int k=0; k<nkeys; ++k) {
+		pb_orm_test::KeyData *keydata = zone.add_keys();
+		char locator[32];
+		snprintf(locator, sizeof(locator), "%d", 1000+k);
+		keydata->set_locator(locator);
+		keydata->set_algorithm(8);
+		keydata->set_inception((pb::uint32)time(NULL));
+		keydata->set_role(pb_orm_test::ZSK);
+		set_keystate(keydata->mutable_ds());
+		set_keystate(keydata->mutable_rrsig());
+		set_keystate(keydata->mutable_dnskey());
+		set_keystate(keydata->mutable_rrsigdnskey());
+	}
+}
+
+void ZoneTests::testZoneUpdateDirty()
+{
+	Stopwatch swatch("ZoneTests::testZoneUpdateDirty");
+
+	const int nkeys = 20;
+	pb_orm_test::EnforcerZone zone;
+	set_zone(zone, "example.com", nkeys);
+	pb::uint64 zoneid;
+	CPPUNIT_ASSERT(OrmMessageInsert(conn, zone, zoneid));
+
+	// Updating a message that was not changed should not touch the db.
+	{
+		OrmContextRef context;
+		zone.Clear();
+		CPPUNIT_ASSERT(OrmMessageRead(conn, zone, zoneid, true, context));
+		CPPUNIT_ASSERT_EQUAL(nkeys, zone.keys_size());
+
+		pb::uint64 before = OrmConnStatementCount(conn);
+		CPPUNIT_ASSERT(OrmMessageUpdate(context));
+		CPPUNIT_ASSERT_EQUAL((pb::uint64)0, OrmConnStatementCount(conn)-before);
+	}
+
+	// Changing a single column of a single key should only update that row.
+	{
+		OrmContextRef context;
+		zone.Clear();
+		CPPUNIT_ASSERT(OrmMessageRead(conn, zone, zoneid, true, context));
+		zone.mutable_keys(nkeys/2)->set_keytag(12345);
+
+		pb::uint64 before = OrmConnStatementCount(conn);
+		CPPUNIT_ASSERT(OrmMessageUpdate(context));
+		CPPUNIT_ASSERT_EQUAL((pb::uint64)1, OrmConnStatementCount(conn)-before);
+	}
+
+	// Changing a nested key state should only update the key state row.
+	{
+		OrmContextRef context;
+		zone.Clear();
+		CPPUNIT_ASSERT(OrmMessageRead(conn, zone, zoneid, true, context));
+		CPPUNIT_ASSERT_EQUAL((pb::uint32)12345, zone.keys(nkeys/2).keytag());
+		zone.mutable_keys(0)->mutable_ds()->set_ttl(7200);
+
+		pb::uint64 before = OrmConnStatementCount(conn);
+		CPPUNIT_ASSERT(OrmMessageUpdate(context));
+		CPPUNIT_ASSERT_EQUAL((pb::uint64)1, OrmConnStatementCount(conn)-before);
+	}
+
+	zone.Clear();
+	CPPUNIT_ASSERT(OrmMessageRead(conn, zone, zoneid, true));
+	CPPUNIT_ASSERT_EQUAL((pb::uint32)7200, zone.keys(0).ds().ttl());
+	CPPUNIT_ASSERT_EQUAL((pb::uint32)12345, zone.keys(nkeys/2).keytag());
+	CPPUNIT_ASSERT_EQUAL((pb::uint32)0, zone.keys(1).keytag());
+}
+
+// Count the statements needed to enumerate all zones with their keys.
+static pb::uint64
+enum_zones(OrmConn conn, int nzones, int nkeys)
+{
+	pb::uint64 before = OrmConnStatementCount(conn);
+	OrmResult rows;
+	CPPUNIT_ASSERT(OrmMessageEnum(conn,
+								  pb_orm_test::EnforcerZone::descriptor(),
+								  rows));
+	int count = 0;
+	for (bool next=OrmFirst(rows); next; next=OrmNext(rows)) {
+		pb_orm_test::EnforcerZone zone;
+		OrmContextRef context;
+		CPPUNIT_ASSERT(OrmGetMessage(rows, zone, true, context));
+		CPPUNIT_ASSERT_EQUAL(nkeys, zone.keys_size());
+		CPPUNIT_ASSERT_EQUAL(std::string("1000"), zone.keys(0).locator());
+		CPPUNIT_ASSERT_EQUAL((pb::uint32)3600, zone.keys(nkeys-1).rrsigdnskey().ttl());
+		++count;
+	}
+	OrmFreeResult(rows);
+	CPPUNIT_ASSERT_EQUAL(nzones, count);
+	return OrmConnStatementCount(conn)-before;
+}
+
+void ZoneTests::testZonesEnumBatched()
+{
+	Stopwatch swatch("ZoneTests::testZonesEnumBatched");
+
+	const int nkeys = 5;
+	int nzones = 0;
+	pb::uint64 statements[2];
+	for (int pass=0; pass<2; ++pass) {
+		for (int z=0; z<(pass ? 40 : 4); ++z, ++nzones) {
+			char name[32];
+			snprintf(name, sizeof(name), "zone%d.example", nzones);
+			pb_orm_test::EnforcerZone zone;
+			set_zone(zone, name, nkeys);
+			pb::uint64 zoneid;
+			CPPUNIT_ASSERT(OrmMessageInsert(conn, zone, zoneid));
+		}
+		statements[pass] = enum_zones(conn, nzones, nkeys);
+	}
+
+	// The number of queries should not depend on the number of zones.
+	CPPUNIT_ASSERT_EQUAL(statements[0], statements[1]);
+
+	// Messages read ahead should still be updatable through their context.
+	OrmResult rows;
+	CPPUNIT_ASSERT(OrmMessageEnumWhere(conn,
+									   pb_orm_test::EnforcerZone::descriptor(),
+									   rows, "name='zone7.example'"));
+	CPPUNIT_ASSERT(OrmFirst(rows));
+	pb_orm_test::EnforcerZone zone;
+	{
+		OrmContextRef context;
+		CPPUNIT_ASSERT(OrmGetMessage(rows, zone, true, context));
+		zone.mutable_keys(2)->mutable_ds()->set_ttl(7200);
+		pb::uint64 before = OrmConnStatementCount(conn);
+		CPPUNIT_ASSERT(OrmMessageUpdate(context));
+		CPPUNIT_ASSERT_EQUAL((pb::uint64)1, OrmConnStatementCount(conn)-before);
+	}
+	OrmFreeResult(rows);
+
+	pb::uint64 zoneid;
+	CPPUNIT_ASSERT(OrmMessageEnumWhere(conn,
+									   pb_orm_test::EnforcerZone::descriptor(),
+									   rows, "name='zone7.example'"));
+	CPPUNIT_ASSERT(OrmFirst(rows));
+	CPPUNIT_ASSERT(OrmGetId(rows, zoneid));
+	OrmFreeResult(rows);
+	zone.Clear();
+	CPPUNIT_ASSERT(OrmMessageRead(conn, zone, zoneid, true));
+	CPPUNIT_ASSERT_EQUAL((pb::uint32)7200, zone.keys(2).ds().ttl());
+	CPPUNIT_ASSERT_EQUAL((pb::uint32)3600, zone.keys(1).ds().ttl());
+}
+
+void ZoneTests::testZoneIndexes()
+{
+	Stopwatch swatch("ZoneTests::testZoneIndexes");
+
+	CPPUNIT_ASSERT(CONN->index_exists("KeyData", "KeyData_locator_index"));
+	CPPUNIT_ASSERT(CONN->index_exists("EnforcerZone_keys",
+									  "EnforcerZone_keys_child_id_index"));
+
+	// Indexes missing from an existing table are added when the table is
+	// created again.
+	DB::OrmResultT result( CONN->queryf("DROP INDEX KeyData_locator_index") );
+	if (!result.assigned()) // MySQL
+		result = CONN->queryf("DROP INDEX KeyData_locator_index ON KeyData");
+	CPPUNIT_ASSERT(result.assigned());
+	result = DB::OrmResultT();
+	CPPUNIT_ASSERT(!CONN->index_exists("KeyData", "KeyData_locator_index"));
+	CPPUNIT_ASSERT(OrmCreateTable(conn,::pb_orm_test::EnforcerZone::descriptor()));
+	CPPUNIT_ASSERT(CONN->index_exists("KeyData", "KeyData_locator_index"));
+}
+
+void ZoneTests::testZonesInsertBatch()
+{
+	Stopwatch swatch("ZoneTests::testZonesInsertBatch");
+
+	const int nzones = 200;
+	const int nkeys = 3;
+	std::vector<pb_orm_test::EnforcerZone> zones(nzones);
+	std::vector<const pb::Message*> batch;
+	for (int z=0; z<nzones; ++z) {
+		char name[32];
+		snprintf(name, sizeof(name), "zone%d.example", z);
+		set_zone(zones[z], name, nkeys+z%2);
+		// Leave out an optional column for some zones.
+		if (z%3 == 0)
+			zones[z].clear_next_change();
+		batch.push_back(&zones[z]);
+	}
+
+	// Insert the zones one by one.
+	std::vector<pb::uint64> rowids(nzones);
+	pb::uint64 rowstatements;
+	{
+		Stopwatch insert("ZoneTests::testZonesInsertBatch OrmMessageInsert");
+		OrmTransactionRW transaction(conn);
+		CPPUNIT_ASSERT(transaction.started());
+		pb::uint64 before = OrmConnStatementCount(conn);
+		for (int z=0; z<nzones; ++z)
+			CPPUNIT_ASSERT(OrmMessageInsert(conn, zones[z], rowids[z]));
+		rowstatements = OrmConnStatementCount(conn)-before;
+		CPPUNIT_ASSERT(transaction.commit());
+	}
+
+	// Insert the same zones as a batch.
+	std::vector<pb::uint64> batchids;
+	pb::uint64 batchstatements;
+	{
+		Stopwatch insert("ZoneTests::testZonesInsertBatch OrmMessageInsertBatch");
+		OrmTransactionRW transaction(conn);
+		CPPUNIT_ASSERT(transaction.started());
+		pb::uint64 before = OrmConnStatementCount(conn);
+		CPPUNIT_ASSERT(OrmMessageInsertBatch(conn, batch, batchids));
+		batchstatements = OrmConnStatementCount(conn)-before;
+		CPPUNIT_ASSERT(transaction.commit());
+	}
+	CPPUNIT_ASSERT_EQUAL((size_t)nzones, batchids.size());
+	CPPUNIT_ASSERT(batchstatements*10 < rowstatements);
+
+	// Both ways of inserting should store the same zones.
+	for (int z=0; z<nzones; ++z) {
+		pb_orm_test::EnforcerZone row, batched;
+		CPPUNIT_ASSERT(OrmMessageRead(conn, row, rowids[z], true));
+		CPPUNIT_ASSERT(OrmMessageRead(conn, batched, batchids[z], true));
+		CPPUNIT_ASSERT_EQUAL(zones[z].name(), batched.name());
+		CPPUNIT_ASSERT_EQUAL(zones[z].keys_size(), batched.keys_size());
+		CPPUNIT_ASSERT_EQUAL(row.DebugString(), batched.DebugString());
+	}
+
+	// A batch with a message missing a required field writes nothing.
+	pb_orm_test::EnforcerZone incomplete;
+	incomplete.set_name("incomplete.example");
+	batch.push_back(&incomplete);
+	pb::uint64 count;
+	CPPUNIT_ASSERT(OrmMessageCount(conn, pb_orm_test::EnforcerZone::descriptor(), count));
+	CPPUNIT_ASSERT(!OrmMessageInsertBatch(conn, batch, batchids));
+	pb::uint64 after;
+	CPPUNIT_ASSERT(OrmMessageCount(conn, pb_orm_test::EnforcerZone::descriptor(), after));
+	CPPUNIT_ASSERT_EQUAL(count, after);
+
+	// So does a batch with a nested message missing a required field, even
+	// when the parent message is complete.
+	batch.pop_back();
+	pb_orm_test::EnforcerZone nested;
+	set_zone(nested, "nested.example", nkeys);
+	nested.mutable_keys(nkeys-1)->clear_locator();
+	batch.push_back(&nested);
+	pb::uint64 keycount;
+	CPPUNIT_ASSERT(OrmMessageCount(conn, pb_orm_test::KeyData::descriptor(), keycount));
+	CPPUNIT_ASSERT(!OrmMessageInsertBatch(conn, batch, batchids));
+	CPPUNIT_ASSERT(OrmMessageCount(conn, pb_orm_test::EnforcerZone::descriptor(), after));
+	CPPUNIT_ASSERT_EQUAL(count, after);
+	CPPUNIT_ASSERT(OrmMessageCount(conn, pb_orm_test::KeyData::descriptor(), after));
+	CPPUNIT_ASSERT_EQUAL(keycount, after);
+}
@@ -43,10 +43,18 @@ class ZoneTests : public CppUnit::TestFixture
 {
 	CPPUNIT_TEST_SUITE(ZoneTests);
 	CPPUNIT_TEST(testZonesCRUD);
+	CPPUNIT_TEST(testZoneUpdateDirty);
+	CPPUNIT_TEST(testZonesEnumBatched);
+	CPPUNIT_TEST(testZoneIndexes);
+	CPPUNIT_TEST(testZonesInsertBatch);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void testZonesCRUD();
+	void testZoneUpdateDirty();
+	void testZonesEnumBatched();
+	void testZoneIndexes();
+	void testZonesInsertBatch();
 
 	void setUp();
 	void tearDown();
@@ -30,6 +30,7 @@
  */
 
 #include <memory>
+#include <map>
 #include <fcntl.h>
 
 #include "signconf/signconf_task.h"
@@ -43,6 +44,7 @@
 #include "xmlext-pb/xmlext-wr.h"
 #include "signconf/signconf.pb.h"
 #include "policy/kasp.pb.h"
+#include "policy/policy_cache.h"
 #include "keystate/keystate.pb.h"
 
 #include "protobuf-orm/pb-orm.h"
@@ -50,25 +52,6 @@
 
 static const char *module_str = "signconf_task";
 
-static bool
-load_kasp_policy(OrmConn conn,const std::string &name,
-				 ::ods::kasp::Policy &policy)
-{
-	std::string qname;
-	if (!OrmQuoteStringValue(conn, name, qname))
-		return false;
-	
-	OrmResultRef rows;
-	if (!OrmMessageEnumWhere(conn,policy.descriptor(),rows,
-							 "name=%s",qname.c_str()))
-		return false;
-
-	if (!OrmFirst(rows))
-		return false;
-	
-	return OrmGetMessage(rows, policy, true);
-}
-
 static bool
 write_signer_configuration_to_file(int sockfd,
 								   const ::ods::kasp::Policy *policy,
@@ -250,6 +233,7 @@ perform_signconf(int sockfd, engineconfig_type *config, int bforce)
 
 			// Go through all the enumerated zones that need to be written.
 			bool bZonesUpdated = false;
+			KaspPolicyCache policies;
 			for (bool next=OrmFirst(rows); next; next=OrmNext(rows)) {
 				
 				OrmContextRef context;
@@ -259,8 +243,9 @@ perform_signconf(int sockfd, engineconfig_type *config, int bforce)
 					return;
 				}
 
-				::ods::kasp::Policy policy;
-				if (!load_kasp_policy(conn, zone.policy(), policy)) {
+				const ::ods::kasp::Policy *policy =
+					cached_kasp_policy(conn, zone.policy(), policies);
+				if (!policy) {
 					ods_log_error_and_printf(sockfd,module_str,
 											 "failed to find kasp "
 											 "policy \"%s\"",
@@ -268,7 +253,7 @@ perform_signconf(int sockfd, engineconfig_type *config, int bforce)
 					continue; // skip to next zone
 				}
 
-				if (!write_signer_configuration_to_file(sockfd,&policy,&zone))
+				if (!write_signer_configuration_to_file(sockfd,policy,&zone))
 					continue; // skip to next zone
 					
 				
@@ -33,6 +33,7 @@
 
 #include "config.h"
 #include "adapter/adapi.h"
+#include "daemon/worker.h"
 #include "shared/duration.h"
 #include "shared/log.h"
 #include "shared/status.h"
@@ -123,11 +124,18 @@ void
 adapi_trans_full(zone_type* zone, unsigned more_coming)
 {
     time_t start = 0;
-    time_t end = 0;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
     uint32_t num_added = 0;
     if (!zone || !zone->db) {
         return;
     }
+    if (zone->stats) {
+        /* NSEC3 owner names are hashed while applying the differences */
+        lock_basic_lock(&zone->stats->stats_lock);
+        zone->stats->nsec3_time = 0;
+        lock_basic_unlock(&zone->stats->stats_lock);
+    }
     namedb_diff(zone->db, 0, more_coming);
 
     if (zone->stats) {
@@ -137,15 +145,16 @@ adapi_trans_full(zone_type* zone, unsigned more_coming)
         lock_basic_unlock(&zone->stats->stats_lock);
     }
     start = time(NULL);
+    start_ns = time_monotonic_ns();
     /* nsecify(3) */
     namedb_nsecify(zone->db, &num_added);
-    end = time(NULL);
+    end_ns = time_monotonic_ns();
     if (zone->stats) {
         lock_basic_lock(&zone->stats->stats_lock);
         if (!zone->stats->start_time) {
             zone->stats->start_time = start;
         }
-        zone->stats->nsec_time = (end-start);
+        zone->stats->nsec_time = (end_ns-start_ns);
         zone->stats->nsec_count = num_added;
         lock_basic_unlock(&zone->stats->stats_lock);
     }
@@ -161,11 +170,18 @@ void
 adapi_trans_diff(zone_type* zone, unsigned more_coming)
 {
     time_t start = 0;
-    time_t end = 0;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
     uint32_t num_added = 0;
     if (!zone || !zone->db) {
         return;
     }
+    if (zone->stats) {
+        /* NSEC3 owner names are hashed while applying the differences */
+        lock_basic_lock(&zone->stats->stats_lock);
+        zone->stats->nsec3_time = 0;
+        lock_basic_unlock(&zone->stats->stats_lock);
+    }
     namedb_diff(zone->db, 1, more_coming);
 
    if (zone->stats) {
@@ -175,15 +191,16 @@ adapi_trans_diff(zone_type* zone, unsigned more_coming)
         lock_basic_unlock(&zone->stats->stats_lock);
     }
     start = time(NULL);
+    start_ns = time_monotonic_ns();
     /* nsecify(3) */
     namedb_nsecify(zone->db, &num_added);
-    end = time(NULL);
+    end_ns = time_monotonic_ns();
     if (zone->stats) {
         lock_basic_lock(&zone->stats->stats_lock);
         if (!zone->stats->start_time) {
             zone->stats->start_time = start;
         }
-        zone->stats->nsec_time = (end-start);
+        zone->stats->nsec_time = (end_ns-start_ns);
         zone->stats->nsec_count = num_added;
         lock_basic_unlock(&zone->stats->stats_lock);
     }
@@ -191,6 +208,117 @@ adapi_trans_diff(zone_type* zone, unsigned more_coming)
 }
 
 
+/**
+ * Hand a completed domain to the drudgers.
+ *
+ */
+static void
+adapi_pipeline_domain(zone_type* zone, ldns_rdf* dname)
+{
+    domain_type* domain = NULL;
+    domain = namedb_lookup_domain(zone->db, dname);
+    if (!domain || domain->is_apex) {
+        /* the apex is signed after the serial has been updated */
+        return;
+    }
+    domain_commit_added(domain);
+    /**
+     * Names that follow in canonical order cannot change the status of
+     * this domain. Resolve it now, so that the drudgers do not need the
+     * namedb that is still being filled.
+     */
+    domain_seal(domain);
+    worker_pipeline_domain((worker_type*) zone->pipeline, domain);
+    return;
+}
+
+
+/**
+ * Hand completed domains to the drudgers while reading a sorted zone.
+ *
+ */
+void
+adapi_pipeline_rr(zone_type* zone, ldns_rr* rr)
+{
+    ldns_rdf* owner = NULL;
+    int cmp = 0;
+    if (!zone || !zone->pipeline || !rr) {
+        return;
+    }
+    owner = ldns_rr_owner(rr);
+    if (zone->pipeline_owner) {
+        cmp = ldns_dname_compare(owner, zone->pipeline_owner);
+        if (cmp == 0) {
+            return;
+        } else if (cmp < 0) {
+            /**
+             * Input is not in canonical order: this owner might already be
+             * in the hands of the drudgers. Stop pipelining, the sign task
+             * will take care of the rest.
+             */
+            ods_log_verbose("[%s] zone %s is not sorted, stop pipelined "
+                "signing", adapi_str, zone->name);
+            adapi_pipeline_end(zone, 0);
+            return;
+        }
+        adapi_pipeline_domain(zone, zone->pipeline_owner);
+        ldns_rdf_deep_free(zone->pipeline_owner);
+    } else if (zone->stats) {
+        lock_basic_lock(&zone->stats->stats_lock);
+        zone->stats->pipe_start = time_monotonic_ns();
+        lock_basic_unlock(&zone->stats->stats_lock);
+    }
+    zone->pipeline_owner = ldns_rdf_clone(owner);
+    return;
+}
+
+
+/**
+ * Stop handing domains to the drudgers and wait for them to finish.
+ *
+ */
+void
+adapi_pipeline_end(zone_type* zone, int flush)
+{
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    if (!zone || !zone->pipeline) {
+        return;
+    }
+    if (zone->pipeline_owner) {
+        if (flush) {
+            adapi_pipeline_domain(zone, zone->pipeline_owner);
+        }
+        ldns_rdf_deep_free(zone->pipeline_owner);
+        zone->pipeline_owner = NULL;
+    }
+    start = time_monotonic_ns();
+    worker_pipeline_drain((worker_type*) zone->pipeline, flush);
+    end = time_monotonic_ns();
+    zone->pipeline = NULL;
+    /* the drudgers are done, statuses may change again */
+    if (zone->db && zone->db->domains) {
+        node = ldns_rbtree_first(zone->db->domains);
+    }
+    while (node && node != LDNS_RBTREE_NULL) {
+        domain_unseal((domain_type*) node->data);
+        node = ldns_rbtree_next(node);
+    }
+    if (zone->stats) {
+        stats_sig_sync(zone->stats);
+        lock_basic_lock(&zone->stats->stats_lock);
+        if (zone->stats->pipe_start) {
+            zone->stats->pipe_time = (start - zone->stats->pipe_start);
+        }
+        zone->stats->pipe_drain = (end - start);
+        zone->stats->pipe_count = zone->stats->sig_count;
+        lock_basic_unlock(&zone->stats->stats_lock);
+    }
+    return;
+}
+
+
 /**
  * Process SOA.
  *
@@ -394,6 +522,76 @@ adapi_del_rr(zone_type* zone, ldns_rr* rr, int backup)
 }
 
 
+/**
+ * Stage dynamic update.
+ *
+ */
+void
+adapi_stage_update(zone_type* zone, ldns_rr_list* changes)
+{
+    size_t i = 0;
+    if (!changes) {
+        return;
+    }
+    if (!zone || !zone->db) {
+        ldns_rr_list_deep_free(changes);
+        return;
+    }
+    if (!zone->db->staged) {
+        zone->db->staged = changes;
+        return;
+    }
+    for (i=0; i < ldns_rr_list_rr_count(changes); i++) {
+        (void)ldns_rr_list_push_rr(zone->db->staged,
+            ldns_rr_list_rr(changes, i));
+    }
+    ldns_rr_list_free(changes);
+    return;
+}
+
+
+/**
+ * Rollback differences in zone.
+ *
+ */
+void
+adapi_rollback(zone_type* zone, unsigned keepsc)
+{
+    ldns_rr* rr = NULL;
+    ods_status status = ODS_STATUS_OK;
+    size_t i = 0;
+    if (!zone || !zone->db) {
+        return;
+    }
+    namedb_rollback(zone->db, keepsc);
+    if (!zone->db->staged) {
+        return;
+    }
+    ods_log_debug("[%s] zone %s rollback: apply %u staged update changes "
+        "again", adapi_str, zone->name,
+        (unsigned) ldns_rr_list_rr_count(zone->db->staged));
+    for (i=0; i < ldns_rr_list_rr_count(zone->db->staged); i++) {
+        rr = ldns_rr_clone(ldns_rr_list_rr(zone->db->staged, i));
+        if (!rr) {
+            ods_log_error("[%s] zone %s rollback: unable to apply staged "
+                "update changes again", adapi_str, zone->name);
+            return;
+        }
+        if (ldns_rr_get_class(rr) == LDNS_RR_CLASS_NONE) {
+            ldns_rr_set_class(rr, zone->klass);
+            (void)adapi_del_rr(zone, rr, 0);
+            ldns_rr_free(rr);
+            continue;
+        }
+        status = adapi_add_rr(zone, rr, 0);
+        if (status != ODS_STATUS_OK) {
+            ldns_rr_free(rr);
+        }
+    }
+    return;
+}
+
+
 /**
  * Print zone.
  *
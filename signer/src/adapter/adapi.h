@@ -96,6 +96,23 @@ void adapi_trans_full(zone_type* zone, unsigned more_coming);
  */
 void adapi_trans_diff(zone_type* zone, unsigned more_coming);
 
+/**
+ * Hand completed domains to the drudgers while reading a sorted zone.
+ * \param[in] zone zone
+ * \param[in] rr RR that is about to be added
+ *
+ */
+void adapi_pipeline_rr(zone_type* zone, ldns_rr* rr);
+
+/**
+ * Stop handing domains to the drudgers and wait for them to finish.
+ * \param[in] zone zone
+ * \param[in] flush if true, also hand over the last domain read: the zone
+ *            was read completely with pipelined signing
+ *
+ */
+void adapi_pipeline_end(zone_type* zone, int flush);
+
 /**
  * Add RR.
  * \param[in] zone zone
@@ -116,6 +133,25 @@ ods_status adapi_add_rr(zone_type* zone, ldns_rr* rr, int backup);
  */
 ods_status adapi_del_rr(zone_type* zone, ldns_rr* rr, int backup);
 
+/**
+ * Keep the changes of an accepted dynamic update until the next diff, so
+ * that a rollback before then does not lose them.
+ * \param[in] zone zone
+ * \param[in] changes RRs added, and RRs deleted with class NONE; the RRs
+ *            are taken over, the list is freed
+ *
+ */
+void adapi_stage_update(zone_type* zone, ldns_rr_list* changes);
+
+/**
+ * Rollback differences in the zone. The staged changes of accepted
+ * dynamic updates are applied again.
+ * \param[in] zone zone
+ * \param[in] keepsc keep RRs that did not came from the adapter.
+ *
+ */
+void adapi_rollback(zone_type* zone, unsigned keepsc);
+
 /**
  * Print zonefile.
  * \param[in] fd file descriptor
@@ -370,7 +370,7 @@ begin_pkt:
     } else {
         ods_log_warning("[%s] xfr zone %s on disk incomplete, rollback",
             adapter_str, zone->name);
-        namedb_rollback(zone->db, 1);
+        adapi_rollback(zone, 1);
         if (ods_strcmp(";;BEGINPACKET", line) == 0) {
             result = ODS_STATUS_OK;
             startpos = fpos;
@@ -501,6 +501,7 @@ dnsin_create(void)
     addns->allocator = allocator;
     addns->request_xfr = NULL;
     addns->allow_notify = NULL;
+    addns->allow_update = NULL;
     addns->tsig = NULL;
     return addns;
 }
@@ -562,6 +563,8 @@ dnsin_read(dnsin_type* addns, const char* filename)
             filename, addns->tsig);
         addns->allow_notify = parse_addns_allow_notify(addns->allocator,
             filename, addns->tsig);
+        addns->allow_update = parse_addns_allow_update(addns->allocator,
+            filename, addns->tsig);
         ods_fclose(fd);
         return ODS_STATUS_OK;
     }
@@ -911,6 +914,7 @@ dnsin_cleanup(dnsin_type* addns)
     allocator = addns->allocator;
     acl_cleanup(addns->request_xfr, allocator);
     acl_cleanup(addns->allow_notify, allocator);
+    acl_cleanup(addns->allow_update, allocator);
     tsig_cleanup(addns->tsig, allocator);
     allocator_deallocate(allocator, (void*) addns);
     allocator_cleanup(allocator);
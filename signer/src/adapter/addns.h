@@ -53,6 +53,7 @@ struct dnsin_struct {
     allocator_type* allocator;
     acl_type* request_xfr;
     acl_type* allow_notify;
+    acl_type* allow_update;
     tsig_type* tsig;
     time_t last_modified;
 };
@@ -247,6 +247,8 @@ adfile_read_file(FILE* fd, zone_type* zone)
             new_serial =
               ldns_rdf2native_int32(ldns_rr_rdf(rr, SE_SOA_RDATA_SERIAL));
         }
+        /* hand completed domains to the drudgers */
+        adapi_pipeline_rr(zone, rr);
         /* add to the database */
         result = adapi_add_rr(zone, rr, 0);
         if (result == ODS_STATUS_UNCHANGED) {
@@ -313,6 +315,8 @@ adfile_read(void* zone)
     }
     status = adfile_read_file(fd, adzone);
     ods_fclose(fd);
+    /* wait for the drudgers before the transaction touches the domains */
+    adapi_pipeline_end(adzone, status == ODS_STATUS_OK);
     if (status == ODS_STATUS_OK) {
         adapi_trans_full(zone, 0);
     }
@@ -94,7 +94,13 @@ engine_config(allocator_type* allocator, const char* cfgfile,
         ecfg->username = parse_conf_username(allocator, cfgfile);
         ecfg->group = parse_conf_group(allocator, cfgfile);
         ecfg->chroot = parse_conf_chroot(allocator, cfgfile);
+        ecfg->metrics_filename = parse_conf_metrics_filename(allocator,
+            cfgfile);
+        ecfg->metrics_interval = parse_conf_metrics_interval(cfgfile);
+        ecfg->xfr_coalesce = parse_conf_xfr_coalesce(cfgfile);
         ecfg->use_syslog = parse_conf_use_syslog(cfgfile);
+        ecfg->async_logging = parse_conf_async_logging(cfgfile);
+        ecfg->deadline_scheduling = parse_conf_deadline_scheduling(cfgfile);
         ecfg->num_worker_threads = parse_conf_worker_threads(cfgfile);
         ecfg->num_signer_threads = parse_conf_signer_threads(cfgfile);
         /* If any verbosity has been specified at cmd line we will use that */
@@ -237,6 +243,20 @@ engine_config_print(FILE* out, engineconfig_type* config)
             fprintf(out, "\t\t<NotifyCommand>%s</NotifyCommand>\n",
                 config->notify_command);
         }
+        if (config->metrics_filename) {
+            fprintf(out, "\t\t<MetricsFile>%s</MetricsFile>\n",
+                config->metrics_filename);
+            fprintf(out, "\t\t<MetricsInterval>PT%uS</MetricsInterval>\n",
+                (unsigned) config->metrics_interval);
+        }
+        fprintf(out, "\t\t<TransferCoalesce>PT%uS</TransferCoalesce>\n",
+            (unsigned) config->xfr_coalesce);
+        if (config->async_logging) {
+            fprintf(out, "\t\t<AsyncLogging/>\n");
+        }
+        if (config->deadline_scheduling) {
+            fprintf(out, "\t\t<DeadlineScheduling/>\n");
+        }
         fprintf(out, "\t</Signer>\n");
 
         fprintf(out, "</Configuration>\n");
@@ -274,6 +294,7 @@ engine_config_cleanup(engineconfig_type* config)
     allocator_deallocate(allocator, (void*) config->username);
     allocator_deallocate(allocator, (void*) config->group);
     allocator_deallocate(allocator, (void*) config->chroot);
+    allocator_deallocate(allocator, (void*) config->metrics_filename);
     allocator_deallocate(allocator, (void*) config);
     return;
 }
@@ -62,7 +62,12 @@ struct engineconfig_struct {
     const char* username;
     const char* group;
     const char* chroot;
+    const char* metrics_filename;
+    time_t metrics_interval;
+    time_t xfr_coalesce;
     int use_syslog;
+    int async_logging;
+    int deadline_scheduling;
     int num_worker_threads;
     int num_signer_threads;
     int verbosity;
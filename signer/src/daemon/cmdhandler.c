@@ -33,6 +33,7 @@
 
 #include "daemon/cmdhandler.h"
 #include "daemon/engine.h"
+#include "daemon/metrics.h"
 #include "shared/allocator.h"
 #include "shared/file.h"
 #include "shared/locks.h"
@@ -67,12 +68,47 @@ static int count = 0;
 static char* cmdh_str = "cmdhandler";
 
 
+/**
+ * Queue output for a client. The select loop writes it out, so commands
+ * never wait on a client. After the first failure the output is dropped.
+ *
+ */
+static void
+cmdhandler_client_write(cmdclient_type* client, const char* data, size_t len)
+{
+    char* out = NULL;
+    size_t size = 0;
+    ods_log_assert(client);
+    if (client->failed || !len) {
+        return;
+    }
+    if (client->out_len + len > client->out_size) {
+        size = client->out_size ? client->out_size : ODS_SE_MAXLINE;
+        while (size < client->out_len + len) {
+            size *= 2;
+        }
+        out = (char*) realloc(client->out, size);
+        if (!out) {
+            ods_log_error("[%s] unable to write to client %i: realloc() "
+                "failed", cmdh_str, client->fd);
+            client->failed = 1;
+            return;
+        }
+        client->out = out;
+        client->out_size = size;
+    }
+    memcpy(client->out + client->out_len, data, len);
+    client->out_len += len;
+    return;
+}
+
+
 /**
  * Handle the 'help' command.
  *
  */
 static void
-cmdhandler_handle_cmd_help(int sockfd)
+cmdhandler_handle_cmd_help(cmdclient_type* client)
 {
     char buf[ODS_SE_MAXLINE];
 
@@ -86,7 +122,7 @@ cmdhandler_handle_cmd_help(int sockfd)
         "sign --all                  Read all zones and schedule all for "
                                     "immediate (re-)sign.\n"
     );
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
 
     (void) snprintf(buf, ODS_SE_MAXLINE,
         "clear <zone>                Delete the internal storage of this "
@@ -96,21 +132,37 @@ cmdhandler_handle_cmd_help(int sockfd)
         "queue                       Show the current task queue.\n"
         "flush                       Execute all scheduled tasks "
                                     "immediately.\n"
+        "metrics                     Show signer metrics (Prometheus "
+                                    "format).\n"
     );
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
 
     (void) snprintf(buf, ODS_SE_MAXLINE,
         "update <zone>               Update this zone signer "
                                     "configurations.\n"
         "update [--all]              Update zone list and all signer "
                                     "configurations.\n"
+    );
+    cmdhandler_client_write(client, buf, strlen(buf));
+
+    (void) snprintf(buf, ODS_SE_MAXLINE,
+        "add <zone> <policy> <signconf> <input> <output>\n"
+        "                            Add or update a single zone with file "
+                                    "adapters,\n"
+        "                            and write it to the zone list file.\n"
+        "remove <zone>               Remove a single zone, also from the "
+                                    "zone list file.\n"
+    );
+    cmdhandler_client_write(client, buf, strlen(buf));
+
+    (void) snprintf(buf, ODS_SE_MAXLINE,
         "start                       Start the engine.\n"
         "running                     Check if the engine is running.\n"
         "reload                      Reload the engine.\n"
         "stop                        Stop the engine.\n"
         "verbosity <nr>              Set verbosity.\n"
     );
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -120,7 +172,7 @@ cmdhandler_handle_cmd_help(int sockfd)
  *
  */
 static void
-cmdhandler_handle_cmd_zones(int sockfd, cmdhandler_type* cmdc)
+cmdhandler_handle_cmd_zones(cmdclient_type* client, cmdhandler_type* cmdc)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -132,14 +184,14 @@ cmdhandler_handle_cmd_zones(int sockfd, cmdhandler_type* cmdc)
     engine = (engine_type*) cmdc->engine;
     if (!engine->zonelist || !engine->zonelist->zones) {
         (void)snprintf(buf, ODS_SE_MAXLINE, "There are no zones configured\n");
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_client_write(client, buf, strlen(buf));
         return;
     }
     /* how many zones */
     lock_basic_lock(&engine->zonelist->zl_lock);
     (void)snprintf(buf, ODS_SE_MAXLINE, "There are %i zones configured\n",
         (int) engine->zonelist->zones->count);
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     /* list zones */
     node = ldns_rbtree_first(engine->zonelist->zones);
     while (node && node != LDNS_RBTREE_NULL) {
@@ -148,7 +200,7 @@ cmdhandler_handle_cmd_zones(int sockfd, cmdhandler_type* cmdc)
             buf[i] = 0;
         }
         (void)snprintf(buf, ODS_SE_MAXLINE, "- %s\n", zone->name);
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_client_write(client, buf, strlen(buf));
         node = ldns_rbtree_next(node);
     }
     lock_basic_unlock(&engine->zonelist->zl_lock);
@@ -161,7 +213,7 @@ cmdhandler_handle_cmd_zones(int sockfd, cmdhandler_type* cmdc)
  *
  */
 static void
-cmdhandler_handle_cmd_update(int sockfd, cmdhandler_type* cmdc,
+cmdhandler_handle_cmd_update(cmdclient_type* client, cmdhandler_type* cmdc,
     const char* tbd)
 {
     engine_type* engine = NULL;
@@ -175,37 +227,36 @@ cmdhandler_handle_cmd_update(int sockfd, cmdhandler_type* cmdc,
     engine = (engine_type*) cmdc->engine;
     ods_log_assert(engine->taskq);
     if (ods_strcmp(tbd, "--all") == 0) {
-        lock_basic_lock(&engine->zonelist->zl_lock);
+        lock_basic_lock(&engine->zonelist->commit_lock);
         zl_changed = zonelist_update(engine->zonelist,
             engine->config->zonelist_filename);
         if (zl_changed == ODS_STATUS_UNCHANGED) {
             (void)snprintf(buf, ODS_SE_MAXLINE, "Zone list has not changed."
                 " Signer configurations updated.\n");
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
         } else if (zl_changed == ODS_STATUS_OK) {
             (void)snprintf(buf, ODS_SE_MAXLINE, "Zone list updated: %i "
             "removed, %i added, %i updated.\n",
                 engine->zonelist->just_removed,
                 engine->zonelist->just_added,
                 engine->zonelist->just_updated);
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
         } else {
-            lock_basic_unlock(&engine->zonelist->zl_lock);
             (void)snprintf(buf, ODS_SE_MAXLINE, "Zone list has errors.\n");
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
         }
         if (zl_changed == ODS_STATUS_OK ||
             zl_changed == ODS_STATUS_UNCHANGED) {
             engine->zonelist->just_removed = 0;
             engine->zonelist->just_added = 0;
             engine->zonelist->just_updated = 0;
-            lock_basic_unlock(&engine->zonelist->zl_lock);
             /**
               * Always update the signconf for zones, even if zonelist has
               * not changed: ODS_STATUS_OK.
               */
             engine_update_zones(engine, ODS_STATUS_OK);
         }
+        lock_basic_unlock(&engine->zonelist->commit_lock);
         return;
     } else {
         /* look up zone */
@@ -222,9 +273,9 @@ cmdhandler_handle_cmd_update(int sockfd, cmdhandler_type* cmdc,
         if (!zone) {
             (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Zone %s not found.\n",
                 tbd);
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
             /* update all */
-            cmdhandler_handle_cmd_update(sockfd, cmdc, "--all");
+            cmdhandler_handle_cmd_update(client, cmdc, "--all");
             return;
         }
 
@@ -235,13 +286,13 @@ cmdhandler_handle_cmd_update(int sockfd, cmdhandler_type* cmdc,
         if (status != ODS_STATUS_OK) {
             (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Unable to reschedule "
                 "task for zone %s.\n", tbd);
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
             ods_log_crit("[%s] unable to reschedule task for zone %s: %s",
                 cmdh_str, zone->name, ods_status2str(status));
         } else {
             (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s config being updated.\n",
             tbd);
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
             ods_log_verbose("[%s] zone %s scheduled for immediate update signconf",
                 cmdh_str, tbd);
             engine_wakeup_workers(engine);
@@ -251,6 +302,131 @@ cmdhandler_handle_cmd_update(int sockfd, cmdhandler_type* cmdc,
 }
 
 
+/**
+ * Handle the 'add' command.
+ *
+ */
+static void
+cmdhandler_handle_cmd_add(cmdclient_type* client, cmdhandler_type* cmdc, char* tbd)
+{
+    engine_type* engine = NULL;
+    char buf[ODS_SE_MAXLINE];
+    char* args[5];
+    char* last = NULL;
+    zone_type* zone = NULL;
+    ods_status status = ODS_STATUS_OK;
+    int i = 0;
+    ods_log_assert(tbd);
+    ods_log_assert(cmdc);
+    ods_log_assert(cmdc->engine);
+    engine = (engine_type*) cmdc->engine;
+    /* <zone> <policy> <signconf> <input> <output> */
+    for (i=0; i < 5; i++) {
+        args[i] = strtok_r(i?NULL:tbd, " ", &last);
+        if (!args[i]) {
+            (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Expecting <zone> "
+                "<policy> <signconf> <input> <output>.\n");
+            cmdhandler_client_write(client, buf, strlen(buf));
+            return;
+        }
+    }
+    zone = zone_create(args[0], LDNS_RR_CLASS_IN);
+    if (zone) {
+        zone->policy_name = strdup(args[1]);
+        zone->signconf_filename = strdup(args[2]);
+        zone->adinbound = adapter_create(args[3], ADAPTER_FILE, 1);
+        zone->adoutbound = adapter_create(args[4], ADAPTER_FILE, 0);
+        if (!zone->policy_name || !zone->signconf_filename ||
+            !zone->adinbound || !zone->adoutbound) {
+            zone_cleanup(zone);
+            zone = NULL;
+        }
+    }
+    if (!zone) {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Unable to create zone "
+            "%s.\n", args[0]);
+        cmdhandler_client_write(client, buf, strlen(buf));
+        return;
+    }
+    /* only this zone is committed, the zone list file is not read */
+    lock_basic_lock(&engine->zonelist->commit_lock);
+    lock_basic_lock(&engine->zonelist->zl_lock);
+    status = zonelist_update_zone(engine->zonelist, zone);
+    lock_basic_unlock(&engine->zonelist->zl_lock);
+    if (status == ODS_STATUS_OK) {
+        engine_update_zones(engine, ODS_STATUS_UNCHANGED);
+    }
+    lock_basic_unlock(&engine->zonelist->commit_lock);
+    /* the change must survive a restart */
+    if (status == ODS_STATUS_OK && zonelist_write(engine->zonelist,
+        engine->config->zonelist_filename) != ODS_STATUS_OK) {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s added, but the zone "
+            "list %s could not be written.\n", args[0],
+            engine->config->zonelist_filename);
+    } else if (status == ODS_STATUS_OK) {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s added.\n", args[0]);
+        ods_log_verbose("[%s] zone %s added", cmdh_str, args[0]);
+    } else if (status == ODS_STATUS_UNCHANGED) {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s has not changed.\n",
+            args[0]);
+    } else {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Unable to add zone "
+            "%s.\n", args[0]);
+    }
+    cmdhandler_client_write(client, buf, strlen(buf));
+    return;
+}
+
+
+/**
+ * Handle the 'remove' command.
+ *
+ */
+static void
+cmdhandler_handle_cmd_remove(cmdclient_type* client, cmdhandler_type* cmdc,
+    const char* tbd)
+{
+    engine_type* engine = NULL;
+    char buf[ODS_SE_MAXLINE];
+    zone_type* zone = NULL;
+    int found = 0;
+    ods_log_assert(tbd);
+    ods_log_assert(cmdc);
+    ods_log_assert(cmdc->engine);
+    engine = (engine_type*) cmdc->engine;
+    lock_basic_lock(&engine->zonelist->commit_lock);
+    lock_basic_lock(&engine->zonelist->zl_lock);
+    zone = zonelist_lookup_zone_by_name(engine->zonelist, tbd,
+        LDNS_RR_CLASS_IN);
+    if (zone) {
+        found = 1;
+        zonelist_remove_zone(engine->zonelist, zone);
+        zone = NULL; /* may be gone already */
+    }
+    lock_basic_unlock(&engine->zonelist->zl_lock);
+    if (found) {
+        engine_update_zones(engine, ODS_STATUS_UNCHANGED);
+    }
+    lock_basic_unlock(&engine->zonelist->commit_lock);
+
+    if (!found) {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Zone %s not found.\n",
+            tbd);
+    } else if (zonelist_write(engine->zonelist,
+        engine->config->zonelist_filename) != ODS_STATUS_OK) {
+        /* the change must survive a restart */
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s removed, but the zone "
+            "list %s could not be written.\n", tbd,
+            engine->config->zonelist_filename);
+    } else {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s removed.\n", tbd);
+        ods_log_verbose("[%s] zone %s removed", cmdh_str, tbd);
+    }
+    cmdhandler_client_write(client, buf, strlen(buf));
+    return;
+}
+
+
 static uint32_t
 max(uint32_t a, uint32_t b)
 {
@@ -263,7 +439,7 @@ max(uint32_t a, uint32_t b)
  *
  */
 static void
-cmdhandler_handle_cmd_sign(int sockfd, cmdhandler_type* cmdc, const char* tbd)
+cmdhandler_handle_cmd_sign(cmdclient_type* client, cmdhandler_type* cmdc, const char* tbd)
 {
     engine_type* engine = NULL;
     zone_type* zone = NULL;
@@ -282,7 +458,7 @@ cmdhandler_handle_cmd_sign(int sockfd, cmdhandler_type* cmdc, const char* tbd)
         engine_wakeup_workers(engine);
         (void)snprintf(buf, ODS_SE_MAXLINE, "All zones scheduled for "
             "immediate re-sign.\n");
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_client_write(client, buf, strlen(buf));
         ods_log_verbose("[%s] all zones scheduled for immediate re-sign",
             cmdh_str);
         return;
@@ -297,20 +473,20 @@ cmdhandler_handle_cmd_sign(int sockfd, cmdhandler_type* cmdc, const char* tbd)
             if (strncmp(delim1+1, "--serial ", 9) != 0) {
                 (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Expecting <zone> "
                     "--serial <nr>, got %s.\n", tbd);
-                ods_writen(sockfd, buf, strlen(buf));
+                cmdhandler_client_write(client, buf, strlen(buf));
                 return;
             }
             delim2 = strchr(delim1+1, ' ');
             if (!delim2) {
                 (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Expecting serial.\n");
-                ods_writen(sockfd, buf, strlen(buf));
+                cmdhandler_client_write(client, buf, strlen(buf));
                 return;
             }
             serial = (uint32_t) strtol(delim2+1, &end, 10);
             if (*end != '\0') {
                 (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Expecting serial, "
                     "got %s.\n", delim2+1);
-                ods_writen(sockfd, buf, strlen(buf));
+                cmdhandler_client_write(client, buf, strlen(buf));
                 return;
             }
             force_serial = 1;
@@ -330,7 +506,7 @@ cmdhandler_handle_cmd_sign(int sockfd, cmdhandler_type* cmdc, const char* tbd)
         if (!zone) {
             (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Zone %s not found.\n",
                 tbd);
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
             return;
         }
 
@@ -342,7 +518,7 @@ cmdhandler_handle_cmd_sign(int sockfd, cmdhandler_type* cmdc, const char* tbd)
                 lock_basic_unlock(&zone->zone_lock);
                 (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Unable to enforce "
                     "serial %u for zone %s.\n", serial, tbd);
-                ods_writen(sockfd, buf, strlen(buf));
+                cmdhandler_client_write(client, buf, strlen(buf));
                 return;
             }
             zone->db->altserial = serial;
@@ -354,13 +530,13 @@ cmdhandler_handle_cmd_sign(int sockfd, cmdhandler_type* cmdc, const char* tbd)
         if (status != ODS_STATUS_OK) {
             (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Unable to reschedule "
                 "task for zone %s.\n", tbd);
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
             ods_log_crit("[%s] unable to reschedule task for zone %s: %s",
                 cmdh_str, zone->name, ods_status2str(status));
         } else {
             (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s scheduled for "
                 "immediate re-sign.\n", tbd);
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
             ods_log_verbose("[%s] zone %s scheduled for immediate re-sign",
                 cmdh_str, tbd);
             engine_wakeup_workers(engine);
@@ -391,7 +567,7 @@ unlink_backup_file(const char* filename, const char* extension)
  *
  */
 static void
-cmdhandler_handle_cmd_clear(int sockfd, cmdhandler_type* cmdc, const char* tbd)
+cmdhandler_handle_cmd_clear(cmdclient_type* client, cmdhandler_type* cmdc, const char* tbd)
 {
     ods_status status = ODS_STATUS_OK;
     engine_type* engine = NULL;
@@ -456,7 +632,7 @@ cmdhandler_handle_cmd_clear(int sockfd, cmdhandler_type* cmdc, const char* tbd)
         ods_log_warning("[%s] cannot clear zone %s, zone not found",
             cmdh_str, tbd?tbd:"(null)");
     }
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -466,7 +642,7 @@ cmdhandler_handle_cmd_clear(int sockfd, cmdhandler_type* cmdc, const char* tbd)
  *
  */
 static void
-cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc)
+cmdhandler_handle_cmd_queue(cmdclient_type* client, cmdhandler_type* cmdc)
 {
     engine_type* engine = NULL;
     char* strtime = NULL;
@@ -480,7 +656,7 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc)
     engine = (engine_type*) cmdc->engine;
     if (!engine->taskq || !engine->taskq->tasks) {
         (void)snprintf(buf, ODS_SE_MAXLINE, "There are no tasks scheduled.\n");
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_client_write(client, buf, strlen(buf));
         return;
     }
     /* current time */
@@ -488,7 +664,7 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc)
     strtime = ctime(&now);
     (void)snprintf(buf, ODS_SE_MAXLINE, "It is now %s",
         strtime?strtime:"(null)");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     /* current work */
     lock_basic_lock(&engine->taskq->schedule_lock);
     for (i=0; i < (size_t) engine->config->num_worker_threads; i++) {
@@ -498,35 +674,72 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc)
                 "zone %s\n",
                 task_what2str(engine->workers[i]->working_with),
                 task_who2str(task));
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_client_write(client, buf, strlen(buf));
         }
     }
     /* how many tasks */
     (void)snprintf(buf, ODS_SE_MAXLINE, "\nThere are %i tasks scheduled.\n",
-        (int) engine->taskq->tasks->count);
-    ods_writen(sockfd, buf, strlen(buf));
-    /* list tasks */
-    node = ldns_rbtree_first(engine->taskq->tasks);
+        (int) schedule_count(engine->taskq));
+    cmdhandler_client_write(client, buf, strlen(buf));
+    /* list tasks, the due tasks first */
+    node = ldns_rbtree_first(engine->taskq->due);
+    if (!node || node == LDNS_RBTREE_NULL) {
+        node = ldns_rbtree_first(engine->taskq->tasks);
+    }
     while (node && node != LDNS_RBTREE_NULL) {
         task = (task_type*) node->data;
         for (i=0; i < ODS_SE_MAXLINE; i++) {
             buf[i] = 0;
         }
         (void)task2str(task, (char*) &buf[0]);
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_client_write(client, buf, strlen(buf));
         node = ldns_rbtree_next(node);
+        if ((!node || node == LDNS_RBTREE_NULL) && task->due) {
+            node = ldns_rbtree_first(engine->taskq->tasks);
+        }
     }
     lock_basic_unlock(&engine->taskq->schedule_lock);
     return;
 }
 
 
+/**
+ * Handle the 'metrics' command.
+ *
+ */
+static void
+cmdhandler_handle_cmd_metrics(cmdclient_type* client, cmdhandler_type* cmdc)
+{
+    FILE* fd = NULL;
+    char* out = NULL;
+    size_t len = 0;
+    char buf[ODS_SE_MAXLINE];
+    ods_log_assert(cmdc);
+    ods_log_assert(cmdc->engine);
+    /* print to memory, the client gets it from the select loop */
+    fd = open_memstream(&out, &len);
+    if (!fd) {
+        ods_log_error("[%s] unable to print metrics: %s", cmdh_str,
+            strerror(errno));
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Error: Unable to print "
+            "metrics.\n");
+        cmdhandler_client_write(client, buf, strlen(buf));
+        return;
+    }
+    metrics_print(fd, cmdc->engine);
+    fclose(fd);
+    cmdhandler_client_write(client, out, len);
+    free((void*) out);
+    return;
+}
+
+
 /**
  * Handle the 'flush' command.
  *
  */
 static void
-cmdhandler_handle_cmd_flush(int sockfd, cmdhandler_type* cmdc)
+cmdhandler_handle_cmd_flush(cmdclient_type* client, cmdhandler_type* cmdc)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -539,7 +752,7 @@ cmdhandler_handle_cmd_flush(int sockfd, cmdhandler_type* cmdc)
     lock_basic_unlock(&engine->taskq->schedule_lock);
     engine_wakeup_workers(engine);
     (void)snprintf(buf, ODS_SE_MAXLINE, "All tasks scheduled immediately.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     ods_log_verbose("[%s] all tasks scheduled immediately", cmdh_str);
     return;
 }
@@ -550,7 +763,7 @@ cmdhandler_handle_cmd_flush(int sockfd, cmdhandler_type* cmdc)
  *
  */
 static void
-cmdhandler_handle_cmd_reload(int sockfd, cmdhandler_type* cmdc)
+cmdhandler_handle_cmd_reload(cmdclient_type* client, cmdhandler_type* cmdc)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -562,7 +775,7 @@ cmdhandler_handle_cmd_reload(int sockfd, cmdhandler_type* cmdc)
     lock_basic_alarm(&engine->signal_cond);
     lock_basic_unlock(&engine->signal_lock);
     (void)snprintf(buf, ODS_SE_MAXLINE, "Reloading engine.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -572,7 +785,7 @@ cmdhandler_handle_cmd_reload(int sockfd, cmdhandler_type* cmdc)
  *
  */
 static void
-cmdhandler_handle_cmd_stop(int sockfd, cmdhandler_type* cmdc)
+cmdhandler_handle_cmd_stop(cmdclient_type* client, cmdhandler_type* cmdc)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -584,7 +797,7 @@ cmdhandler_handle_cmd_stop(int sockfd, cmdhandler_type* cmdc)
     lock_basic_alarm(&engine->signal_cond);
     lock_basic_unlock(&engine->signal_lock);
     (void)snprintf(buf, ODS_SE_MAXLINE, ODS_SE_STOP_RESPONSE);
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -594,11 +807,11 @@ cmdhandler_handle_cmd_stop(int sockfd, cmdhandler_type* cmdc)
  *
  */
 static void
-cmdhandler_handle_cmd_start(int sockfd)
+cmdhandler_handle_cmd_start(cmdclient_type* client)
 {
     char buf[ODS_SE_MAXLINE];
     (void)snprintf(buf, ODS_SE_MAXLINE, "Engine already running.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -608,11 +821,11 @@ cmdhandler_handle_cmd_start(int sockfd)
  *
  */
 static void
-cmdhandler_handle_cmd_running(int sockfd)
+cmdhandler_handle_cmd_running(cmdclient_type* client)
 {
     char buf[ODS_SE_MAXLINE];
     (void)snprintf(buf, ODS_SE_MAXLINE, "Engine running.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -622,7 +835,7 @@ cmdhandler_handle_cmd_running(int sockfd)
  *
  */
 static void
-cmdhandler_handle_cmd_verbosity(int sockfd, cmdhandler_type* cmdc, int val)
+cmdhandler_handle_cmd_verbosity(cmdclient_type* client, cmdhandler_type* cmdc, int val)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -633,7 +846,7 @@ cmdhandler_handle_cmd_verbosity(int sockfd, cmdhandler_type* cmdc, int val)
     ods_log_init(engine->config->log_filename, engine->config->use_syslog,
         val);
     (void)snprintf(buf, ODS_SE_MAXLINE, "Verbosity level set to %i.\n", val);
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -643,11 +856,11 @@ cmdhandler_handle_cmd_verbosity(int sockfd, cmdhandler_type* cmdc, int val)
  *
  */
 static void
-cmdhandler_handle_cmd_error(int sockfd, const char* str)
+cmdhandler_handle_cmd_error(cmdclient_type* client, const char* str)
 {
     char buf[ODS_SE_MAXLINE];
     (void)snprintf(buf, ODS_SE_MAXLINE, "Error: %s.\n", str?str:"(null)");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -657,12 +870,12 @@ cmdhandler_handle_cmd_error(int sockfd, const char* str)
  *
  */
 static void
-cmdhandler_handle_cmd_unknown(int sockfd, const char* str)
+cmdhandler_handle_cmd_unknown(cmdclient_type* client, const char* str)
 {
     char buf[ODS_SE_MAXLINE];
     (void)snprintf(buf, ODS_SE_MAXLINE, "Unknown command %s.\n",
         str?str:"(null)");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
 
@@ -671,11 +884,11 @@ cmdhandler_handle_cmd_unknown(int sockfd, const char* str)
  * Handle not implemented.
  *
 static void
-cmdhandler_handle_cmd_notimpl(int sockfd, const char* str)
+cmdhandler_handle_cmd_notimpl(cmdclient_type* client, const char* str)
 {
     char buf[ODS_SE_MAXLINE];
     (void)snprintf(buf, ODS_SE_MAXLINE, "Command %s not implemented.\n", str);
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_client_write(client, buf, strlen(buf));
     return;
 }
  */
@@ -683,137 +896,431 @@ cmdhandler_handle_cmd_notimpl(int sockfd, const char* str)
 
 /**
  * Handle client command.
+ * Returns 1 if the client connection should be closed.
  *
  */
-static void
-cmdhandler_handle_cmd(cmdhandler_type* cmdc)
+static int
+cmdhandler_handle_cmd(cmdhandler_type* cmdc, cmdclient_type* client, char* buf)
 {
     ssize_t n = 0;
-    int sockfd = 0;
-    char buf[ODS_SE_MAXLINE];
 
     ods_log_assert(cmdc);
-    sockfd = cmdc->client_fd;
-
-again:
-    while ((n = read(sockfd, buf, ODS_SE_MAXLINE)) > 0) {
-        /* what if this number is smaller than the number of bytes requested? */
-        buf[n-1] = '\0';
-        n--;
-        ods_log_verbose("[%s] received command %s[%i]", cmdh_str, buf, n);
-        ods_str_trim(buf);
-        n = strlen(buf);
-
-        if (n == 4 && strncmp(buf, "help", n) == 0) {
-            ods_log_debug("[%s] help command", cmdh_str);
-            cmdhandler_handle_cmd_help(sockfd);
-        } else if (n == 5 && strncmp(buf, "zones", n) == 0) {
-            ods_log_debug("[%s] list zones command", cmdh_str);
-            cmdhandler_handle_cmd_zones(sockfd, cmdc);
-        } else if (n >= 4 && strncmp(buf, "sign", 4) == 0) {
-            ods_log_debug("[%s] sign zone command", cmdh_str);
-            if (buf[4] == '\0') {
-                /* NOTE: wouldn't it be nice that we default to --all? */
-                cmdhandler_handle_cmd_error(sockfd, "sign command needs "
-                    "an argument (either '--all' or a zone name)");
-            } else if (buf[4] != ' ') {
-                cmdhandler_handle_cmd_unknown(sockfd, buf);
-            } else {
-                cmdhandler_handle_cmd_sign(sockfd, cmdc, &buf[5]);
-            }
-        } else if (n >= 5 && strncmp(buf, "clear", 5) == 0) {
-            ods_log_debug("[%s] clear zone command", cmdh_str);
-            if (buf[5] == '\0') {
-                cmdhandler_handle_cmd_error(sockfd, "clear command needs "
-                    "a zone name");
-            } else if (buf[5] != ' ') {
-                cmdhandler_handle_cmd_unknown(sockfd, buf);
-            } else {
-                cmdhandler_handle_cmd_clear(sockfd, cmdc, &buf[6]);
-            }
-        } else if (n == 5 && strncmp(buf, "queue", n) == 0) {
-            ods_log_debug("[%s] list tasks command", cmdh_str);
-            cmdhandler_handle_cmd_queue(sockfd, cmdc);
-        } else if (n == 5 && strncmp(buf, "flush", n) == 0) {
-            ods_log_debug("[%s] flush tasks command", cmdh_str);
-            cmdhandler_handle_cmd_flush(sockfd, cmdc);
-        } else if (n >= 6 && strncmp(buf, "update", 6) == 0) {
-            ods_log_debug("[%s] update command", cmdh_str);
-            if (buf[6] == '\0') {
-                cmdhandler_handle_cmd_update(sockfd, cmdc, "--all");
-            } else if (buf[6] != ' ') {
-                cmdhandler_handle_cmd_unknown(sockfd, buf);
-            } else {
-                cmdhandler_handle_cmd_update(sockfd, cmdc, &buf[7]);
-            }
-        } else if (n == 4 && strncmp(buf, "stop", n) == 0) {
-            ods_log_debug("[%s] shutdown command", cmdh_str);
-            cmdhandler_handle_cmd_stop(sockfd, cmdc);
-            return;
-        } else if (n == 5 && strncmp(buf, "start", n) == 0) {
-            ods_log_debug("[%s] start command", cmdh_str);
-            cmdhandler_handle_cmd_start(sockfd);
-        } else if (n == 6 && strncmp(buf, "reload", n) == 0) {
-            ods_log_debug("[%s] reload command", cmdh_str);
-            cmdhandler_handle_cmd_reload(sockfd, cmdc);
-        } else if (n == 7 && strncmp(buf, "running", n) == 0) {
-            ods_log_debug("[%s] running command", cmdh_str);
-            cmdhandler_handle_cmd_running(sockfd);
-        } else if (n >= 9 && strncmp(buf, "verbosity", 9) == 0) {
-            ods_log_debug("[%s] verbosity command", cmdh_str);
-            if (buf[9] == '\0') {
-                cmdhandler_handle_cmd_error(sockfd, "verbosity command "
-                    "an argument (verbosity level)");
-            } else if (buf[9] != ' ') {
-                cmdhandler_handle_cmd_unknown(sockfd, buf);
-            } else {
-                cmdhandler_handle_cmd_verbosity(sockfd, cmdc, atoi(&buf[10]));
-            }
-        } else if (n > 0) {
-            ods_log_debug("[%s] unknown command", cmdh_str);
-            cmdhandler_handle_cmd_unknown(sockfd, buf);
+    ods_log_assert(buf);
+    ods_log_verbose("[%s] received command %s", cmdh_str, buf);
+    ods_str_trim(buf);
+    n = strlen(buf);
+
+    if (n == 4 && strncmp(buf, "help", n) == 0) {
+        ods_log_debug("[%s] help command", cmdh_str);
+        cmdhandler_handle_cmd_help(client);
+    } else if (n == 5 && strncmp(buf, "zones", n) == 0) {
+        ods_log_debug("[%s] list zones command", cmdh_str);
+        cmdhandler_handle_cmd_zones(client, cmdc);
+    } else if (n >= 4 && strncmp(buf, "sign", 4) == 0) {
+        ods_log_debug("[%s] sign zone command", cmdh_str);
+        if (buf[4] == '\0') {
+            /* NOTE: wouldn't it be nice that we default to --all? */
+            cmdhandler_handle_cmd_error(client, "sign command needs "
+                "an argument (either '--all' or a zone name)");
+        } else if (buf[4] != ' ') {
+            cmdhandler_handle_cmd_unknown(client, buf);
+        } else {
+            cmdhandler_handle_cmd_sign(client, cmdc, &buf[5]);
+        }
+    } else if (n >= 5 && strncmp(buf, "clear", 5) == 0) {
+        ods_log_debug("[%s] clear zone command", cmdh_str);
+        if (buf[5] == '\0') {
+            cmdhandler_handle_cmd_error(client, "clear command needs "
+                "a zone name");
+        } else if (buf[5] != ' ') {
+            cmdhandler_handle_cmd_unknown(client, buf);
+        } else {
+            cmdhandler_handle_cmd_clear(client, cmdc, &buf[6]);
+        }
+    } else if (n == 5 && strncmp(buf, "queue", n) == 0) {
+        ods_log_debug("[%s] list tasks command", cmdh_str);
+        cmdhandler_handle_cmd_queue(client, cmdc);
+    } else if (n == 7 && strncmp(buf, "metrics", n) == 0) {
+        ods_log_debug("[%s] metrics command", cmdh_str);
+        cmdhandler_handle_cmd_metrics(client, cmdc);
+    } else if (n == 5 && strncmp(buf, "flush", n) == 0) {
+        ods_log_debug("[%s] flush tasks command", cmdh_str);
+        cmdhandler_handle_cmd_flush(client, cmdc);
+    } else if (n >= 6 && strncmp(buf, "update", 6) == 0) {
+        ods_log_debug("[%s] update command", cmdh_str);
+        if (buf[6] == '\0') {
+            cmdhandler_handle_cmd_update(client, cmdc, "--all");
+        } else if (buf[6] != ' ') {
+            cmdhandler_handle_cmd_unknown(client, buf);
+        } else {
+            cmdhandler_handle_cmd_update(client, cmdc, &buf[7]);
         }
-        ods_log_debug("[%s] done handling command %s[%i]", cmdh_str, buf, n);
-        (void)snprintf(buf, SE_CMDH_CMDLEN, "\ncmd> ");
-        ods_writen(sockfd, buf, strlen(buf));
+    } else if (n >= 3 && strncmp(buf, "add", 3) == 0) {
+        ods_log_debug("[%s] add zone command", cmdh_str);
+        if (buf[3] == '\0') {
+            cmdhandler_handle_cmd_error(client, "add command needs "
+                "a zone name, policy, signconf, input and output");
+        } else if (buf[3] != ' ') {
+            cmdhandler_handle_cmd_unknown(client, buf);
+        } else {
+            cmdhandler_handle_cmd_add(client, cmdc, &buf[4]);
+        }
+    } else if (n >= 6 && strncmp(buf, "remove", 6) == 0) {
+        ods_log_debug("[%s] remove zone command", cmdh_str);
+        if (buf[6] == '\0') {
+            cmdhandler_handle_cmd_error(client, "remove command needs "
+                "a zone name");
+        } else if (buf[6] != ' ') {
+            cmdhandler_handle_cmd_unknown(client, buf);
+        } else {
+            cmdhandler_handle_cmd_remove(client, cmdc, &buf[7]);
+        }
+    } else if (n == 4 && strncmp(buf, "stop", n) == 0) {
+        ods_log_debug("[%s] shutdown command", cmdh_str);
+        cmdhandler_handle_cmd_stop(client, cmdc);
+        return 1;
+    } else if (n == 5 && strncmp(buf, "start", n) == 0) {
+        ods_log_debug("[%s] start command", cmdh_str);
+        cmdhandler_handle_cmd_start(client);
+    } else if (n == 6 && strncmp(buf, "reload", n) == 0) {
+        ods_log_debug("[%s] reload command", cmdh_str);
+        cmdhandler_handle_cmd_reload(client, cmdc);
+    } else if (n == 7 && strncmp(buf, "running", n) == 0) {
+        ods_log_debug("[%s] running command", cmdh_str);
+        cmdhandler_handle_cmd_running(client);
+    } else if (n >= 9 && strncmp(buf, "verbosity", 9) == 0) {
+        ods_log_debug("[%s] verbosity command", cmdh_str);
+        if (buf[9] == '\0') {
+            cmdhandler_handle_cmd_error(client, "verbosity command "
+                "an argument (verbosity level)");
+        } else if (buf[9] != ' ') {
+            cmdhandler_handle_cmd_unknown(client, buf);
+        } else {
+            cmdhandler_handle_cmd_verbosity(client, cmdc, atoi(&buf[10]));
+        }
+    } else if (n > 0) {
+        ods_log_debug("[%s] unknown command", cmdh_str);
+        cmdhandler_handle_cmd_unknown(client, buf);
+    }
+    ods_log_debug("[%s] done handling command %s[%i]", cmdh_str, buf, n);
+    cmdhandler_client_write(client, "\ncmd> ", SE_CMDH_CMDLEN-1);
+    if (client->failed) {
+        ods_log_debug("[%s] unable to write to client %i, drop it",
+            cmdh_str, client->fd);
+        return 1;
     }
+    return 0;
+}
 
-    if (n < 0 && (errno == EINTR || errno == EWOULDBLOCK || errno == EAGAIN) ) {
-        goto again;
-    } else if (n < 0 && errno == ECONNRESET) {
-        ods_log_debug("[%s] done handling client: %s", cmdh_str,
-            strerror(errno));
-    } else if (n < 0 ) {
-        ods_log_error("[%s] read error: %s", cmdh_str, strerror(errno));
+
+/**
+ * Set client socket blocking or non-blocking.
+ *
+ */
+static int
+cmdhandler_client_nonblock(int fd, int on)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    if (on) {
+        flags |= O_NONBLOCK;
+    } else {
+        flags &= ~O_NONBLOCK;
     }
+    return fcntl(fd, F_SETFL, flags);
+}
+
+
+/**
+ * Close client.
+ *
+ */
+static void
+cmdhandler_client_close(cmdclient_type* client)
+{
+    ods_log_assert(client);
+    if (client->fd < 0) {
+        return;
+    }
+    ods_log_debug("[%s] close client %i", cmdh_str, client->fd);
+    shutdown(client->fd, SHUT_RDWR);
+    close(client->fd);
+    client->fd = -1;
+    client->busy = 0;
+    client->eof = 0;
+    client->failed = 0;
+    client->len = 0;
+    free((void*) client->out);
+    client->out = NULL;
+    client->out_size = 0;
+    client->out_len = 0;
+    client->out_pos = 0;
+    count--;
     return;
 }
 
 
+/**
+ * Write queued output to the client, as much as it takes without waiting.
+ * Returns -1 if the client connection failed.
+ *
+ */
+static int
+cmdhandler_client_flush(cmdclient_type* client)
+{
+    ssize_t n = 0;
+    while (client->out_pos < client->out_len) {
+        n = write(client->fd, client->out + client->out_pos,
+            client->out_len - client->out_pos);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                return 0;
+            }
+            ods_log_debug("[%s] unable to write to client %i: %s", cmdh_str,
+                client->fd, strerror(errno));
+            return -1;
+        }
+        client->out_pos += n;
+        client->last = time_now();
+    }
+    client->out_pos = 0;
+    client->out_len = 0;
+    return 0;
+}
+
+
 /**
  * Accept client.
  *
  */
-static void*
-cmdhandler_accept_client(void* arg)
+static void
+cmdhandler_accept_client(cmdhandler_type* cmdhandler)
 {
-    cmdhandler_type* cmdc = (cmdhandler_type*) arg;
+    struct sockaddr_un cliaddr;
+    socklen_t clilen = sizeof(cliaddr);
+    int connfd = 0;
+    int i = 0;
+
+    connfd = accept(cmdhandler->listen_fd, (struct sockaddr *) &cliaddr,
+        &clilen);
+    if (connfd < 0) {
+        if (errno != EINTR && errno != EWOULDBLOCK && errno != EAGAIN) {
+            ods_log_warning("[%s] accept() error: %s", cmdh_str,
+                strerror(errno));
+        }
+        return;
+    }
+    for (i = 0; i < ODS_SE_MAX_CLIENTS; i++) {
+        if (cmdhandler->clients[i].fd < 0) {
+            break;
+        }
+    }
+    if (i == ODS_SE_MAX_CLIENTS || connfd >= FD_SETSIZE) {
+        ods_log_warning("[%s] unable to accept client: too many clients",
+            cmdh_str);
+        close(connfd);
+        return;
+    }
+    if (cmdhandler_client_nonblock(connfd, 1) < 0) {
+        ods_log_warning("[%s] unable to accept client: fcntl() failed (%s)",
+            cmdh_str, strerror(errno));
+        close(connfd);
+        return;
+    }
+    cmdhandler->clients[i].fd = connfd;
+    cmdhandler->clients[i].busy = 0;
+    cmdhandler->clients[i].eof = 0;
+    cmdhandler->clients[i].failed = 0;
+    cmdhandler->clients[i].len = 0;
+    cmdhandler->clients[i].last = time_now();
+    count++;
+    ods_log_debug("[%s] accept client %i, %i clients in progress...",
+        cmdh_str, connfd, count);
+    return;
+}
 
-    ods_thread_blocksigs();
-    ods_thread_detach(cmdc->thread_id);
 
-    ods_log_debug("[%s] accept client %i", cmdh_str, cmdc->client_fd);
-    cmdhandler_handle_cmd(cmdc);
-    if (cmdc->client_fd) {
-        shutdown(cmdc->client_fd, SHUT_RDWR);
-        close(cmdc->client_fd);
+/**
+ * Whether the command may have to wait for a zone or the zone list.
+ *
+ */
+static int
+cmdhandler_cmd_may_block(const char* buf)
+{
+    while (*buf == ' ' || *buf == '\t') {
+        buf++;
     }
-    free(cmdc);
-    count--;
+    return (strncmp(buf, "sign ", 5) == 0 ||
+        strncmp(buf, "clear ", 6) == 0 ||
+        strncmp(buf, "update", 6) == 0 ||
+        strncmp(buf, "add ", 4) == 0 ||
+        strncmp(buf, "remove ", 7) == 0);
+}
+
+
+/**
+ * Whether the client is being served by the waiter.
+ *
+ */
+static int
+cmdhandler_client_busy(cmdhandler_type* cmdhandler, cmdclient_type* client)
+{
+    int busy = 0;
+    lock_basic_lock(&cmdhandler->client_lock);
+    busy = client->busy;
+    lock_basic_unlock(&cmdhandler->client_lock);
+    return busy;
+}
+
+
+/**
+ * Handle every complete command in the client buffer, stop at the first
+ * command that fails to write its output.
+ * Returns 1 if the client connection should be closed.
+ *
+ */
+static int
+cmdhandler_serve_client(cmdhandler_type* cmdhandler, cmdclient_type* client)
+{
+    size_t i = 0;
+    size_t start = 0;
+    int done = 0;
+
+    for (i = 0; i < client->len && !done; i++) {
+        if (client->buf[i] == '\n' || client->buf[i] == '\0') {
+            client->buf[i] = '\0';
+            done = cmdhandler_handle_cmd(cmdhandler, client,
+                &client->buf[start]);
+            start = i + 1;
+        }
+    }
+    if (done) {
+        return 1;
+    }
+    client->len -= start;
+    if (client->len > 0) {
+        memmove(client->buf, client->buf + start, client->len);
+    }
+    return 0;
+}
+
+
+/**
+ * Serve the clients whose commands may wait on a zone, one at a time,
+ * outside the select loop. Their output is queued like everyone else's.
+ *
+ */
+static void*
+cmdhandler_waiter_thread(void* arg)
+{
+    cmdhandler_type* cmdhandler = (cmdhandler_type*) arg;
+    cmdclient_type* client = NULL;
+    int done = 0;
+    int i = 0;
+    ods_thread_blocksigs();
+    lock_basic_lock(&cmdhandler->client_lock);
+    while (!cmdhandler->waiter_exit) {
+        client = NULL;
+        for (i = 0; i < ODS_SE_MAX_CLIENTS; i++) {
+            if (cmdhandler->clients[i].busy == CMDH_CLIENT_QUEUED) {
+                client = &cmdhandler->clients[i];
+                break;
+            }
+        }
+        if (!client) {
+            lock_basic_sleep(&cmdhandler->waiter_cond,
+                &cmdhandler->client_lock, 0);
+            continue;
+        }
+        client->busy = CMDH_CLIENT_SERVED;
+        lock_basic_unlock(&cmdhandler->client_lock);
+        done = cmdhandler_serve_client(cmdhandler, client);
+        lock_basic_lock(&cmdhandler->client_lock);
+        client->eof = done;
+        client->busy = 0;
+        /* wake up the select loop to write the output */
+        if (write(cmdhandler->wake_fd[1], "", 1) < 0 && errno != EAGAIN &&
+            errno != EWOULDBLOCK) {
+            ods_log_warning("[%s] unable to wake up command handler: %s",
+                cmdh_str, strerror(errno));
+        }
+    }
+    lock_basic_unlock(&cmdhandler->client_lock);
     return NULL;
 }
 
 
+/**
+ * Read from client and handle every complete command.
+ *
+ */
+static void
+cmdhandler_read_client(cmdhandler_type* cmdhandler, cmdclient_type* client)
+{
+    ssize_t n = 0;
+    size_t i = 0;
+    size_t start = 0;
+    int may_block = 0;
+
+    n = read(client->fd, client->buf + client->len,
+        ODS_SE_MAXLINE - 1 - client->len);
+    if (n < 0) {
+        if (errno == EINTR || errno == EWOULDBLOCK || errno == EAGAIN) {
+            return;
+        } else if (errno != ECONNRESET) {
+            ods_log_error("[%s] read error: %s", cmdh_str, strerror(errno));
+        }
+        cmdhandler_client_close(client);
+        return;
+    } else if (n == 0) {
+        ods_log_debug("[%s] done handling client %i", cmdh_str, client->fd);
+        /* what is left to write still goes out */
+        client->eof = 1;
+        return;
+    }
+    client->len += n;
+    client->last = time_now();
+    /**
+     * Commands end with a newline or a nul byte. Whatever is left when the
+     * client has nothing more to send, or fills the buffer, is taken as
+     * a command as well: clients write each command in one go.
+     */
+    if ((n < (ssize_t) (ODS_SE_MAXLINE - 1 - (client->len - n)) ||
+        client->len == ODS_SE_MAXLINE - 1) &&
+        client->buf[client->len-1] != '\n' &&
+        client->buf[client->len-1] != '\0') {
+        client->buf[client->len++] = '\0';
+    }
+    for (i = 0; i < client->len && !may_block; i++) {
+        if (client->buf[i] == '\n' || client->buf[i] == '\0') {
+            may_block = cmdhandler_cmd_may_block(&client->buf[start]);
+            start = i + 1;
+        }
+    }
+    if (may_block) {
+        /**
+         * Commands that take a zone lock or the commit lock may wait for a
+         * worker to finish a zone. Hand them to the waiter, so that other
+         * clients (stop, queue, ...) are not held up.
+         */
+        lock_basic_lock(&cmdhandler->client_lock);
+        client->busy = CMDH_CLIENT_QUEUED;
+        lock_basic_alarm(&cmdhandler->waiter_cond);
+        lock_basic_unlock(&cmdhandler->client_lock);
+        return;
+    }
+    client->eof = cmdhandler_serve_client(cmdhandler, client);
+    if (cmdhandler_client_flush(client) < 0) {
+        cmdhandler_client_close(client);
+    }
+    return;
+}
+
+
 /**
  * Create command handler.
  *
@@ -888,6 +1395,42 @@ cmdhandler_create(allocator_type* allocator, const char* filename)
         close(listenfd);
         return NULL;
     }
+    cmdh->clients = (cmdclient_type*) allocator_alloc(allocator,
+        ODS_SE_MAX_CLIENTS * sizeof(cmdclient_type));
+    if (!cmdh->clients) {
+        ods_log_error("[%s] unable to create cmdhandler: "
+            "allocator_alloc() failed", cmdh_str);
+        allocator_deallocate(allocator, (void*) cmdh);
+        close(listenfd);
+        return NULL;
+    }
+    /* the waiter wakes up the select loop when it is done with a client */
+    if (pipe(cmdh->wake_fd) != 0) {
+        ods_log_error("[%s] unable to create cmdhandler: "
+            "pipe() failed (%s)", cmdh_str, strerror(errno));
+        allocator_deallocate(allocator, (void*) cmdh->clients);
+        allocator_deallocate(allocator, (void*) cmdh);
+        close(listenfd);
+        return NULL;
+    }
+    (void)cmdhandler_client_nonblock(cmdh->wake_fd[0], 1);
+    (void)cmdhandler_client_nonblock(cmdh->wake_fd[1], 1);
+    for (ret = 0; ret < ODS_SE_MAX_CLIENTS; ret++) {
+        cmdh->clients[ret].cmdhandler = cmdh;
+        cmdh->clients[ret].fd = -1;
+        cmdh->clients[ret].busy = 0;
+        cmdh->clients[ret].eof = 0;
+        cmdh->clients[ret].failed = 0;
+        cmdh->clients[ret].len = 0;
+        cmdh->clients[ret].last = 0;
+        cmdh->clients[ret].out = NULL;
+        cmdh->clients[ret].out_size = 0;
+        cmdh->clients[ret].out_len = 0;
+        cmdh->clients[ret].out_pos = 0;
+    }
+    lock_basic_init(&cmdh->client_lock);
+    lock_basic_set(&cmdh->waiter_cond);
+    cmdh->waiter_exit = 0;
     cmdh->allocator = allocator;
     cmdh->listen_fd = listenfd;
     cmdh->listen_addr = servaddr;
@@ -903,23 +1446,55 @@ cmdhandler_create(allocator_type* allocator, const char* filename)
 void
 cmdhandler_start(cmdhandler_type* cmdhandler)
 {
-    struct sockaddr_un cliaddr;
-    socklen_t clilen;
-    cmdhandler_type* cmdc = NULL;
+    cmdclient_type* client = NULL;
     engine_type* engine = NULL;
+    struct timeval tv;
+    time_t now = 0;
     fd_set rset;
-    int connfd = 0;
+    fd_set wset;
+    char drain[64];
+    int maxfd = 0;
     int ret = 0;
+    int i = 0;
     ods_log_assert(cmdhandler);
     ods_log_assert(cmdhandler->engine);
+    ods_log_assert(cmdhandler->clients);
     ods_log_debug("[%s] start", cmdh_str);
     engine = (engine_type*) cmdhandler->engine;
     ods_thread_detach(cmdhandler->thread_id);
-    FD_ZERO(&rset);
+    ods_thread_create(&cmdhandler->waiter_id, cmdhandler_waiter_thread,
+        cmdhandler);
     while (cmdhandler->need_to_exit == 0) {
-        clilen = sizeof(cliaddr);
+        FD_ZERO(&rset);
+        FD_ZERO(&wset);
         FD_SET(cmdhandler->listen_fd, &rset);
-        ret = select(cmdhandler->listen_fd+1, &rset, NULL, NULL, NULL);
+        FD_SET(cmdhandler->wake_fd[0], &rset);
+        maxfd = cmdhandler->listen_fd;
+        if (cmdhandler->wake_fd[0] > maxfd) {
+            maxfd = cmdhandler->wake_fd[0];
+        }
+        for (i = 0; i < ODS_SE_MAX_CLIENTS; i++) {
+            client = &cmdhandler->clients[i];
+            if (client->fd < 0 || cmdhandler_client_busy(cmdhandler, client)) {
+                continue;
+            }
+            if (client->out_len > client->out_pos) {
+                /* no new commands until the output is out */
+                FD_SET(client->fd, &wset);
+            } else if (client->eof) {
+                cmdhandler_client_close(client);
+                continue;
+            } else {
+                FD_SET(client->fd, &rset);
+            }
+            if (client->fd > maxfd) {
+                maxfd = client->fd;
+            }
+        }
+        /* wake up now and then to drop idle clients */
+        tv.tv_sec = ODS_SE_CMDH_IDLE / 10;
+        tv.tv_usec = 0;
+        ret = select(maxfd+1, &rset, &wset, NULL, &tv);
         if (ret < 0) {
             if (errno != EINTR && errno != EWOULDBLOCK) {
                 ods_log_warning("[%s] select() error: %s", cmdh_str,
@@ -927,35 +1502,47 @@ cmdhandler_start(cmdhandler_type* cmdhandler)
             }
             continue;
         }
-        if (FD_ISSET(cmdhandler->listen_fd, &rset)) {
-            connfd = accept(cmdhandler->listen_fd,
-                (struct sockaddr *) &cliaddr, &clilen);
-            if (connfd < 0) {
-                if (errno != EINTR && errno != EWOULDBLOCK) {
-                    ods_log_warning("[%s] accept() error: %s", cmdh_str,
-                        strerror(errno));
-                }
+        if (ret > 0 && FD_ISSET(cmdhandler->wake_fd[0], &rset)) {
+            while (read(cmdhandler->wake_fd[0], drain, sizeof(drain)) > 0) {
+                ;
+            }
+        }
+        if (ret > 0 && FD_ISSET(cmdhandler->listen_fd, &rset)) {
+            cmdhandler_accept_client(cmdhandler);
+        }
+        now = time_now();
+        for (i = 0; i < ODS_SE_MAX_CLIENTS; i++) {
+            client = &cmdhandler->clients[i];
+            if (client->fd < 0 || cmdhandler_client_busy(cmdhandler, client)) {
                 continue;
             }
-            /* client accepted, create new thread */
-            cmdc = (cmdhandler_type*) malloc(sizeof(cmdhandler_type));
-            if (!cmdc) {
-                ods_log_crit("[%s] unable to create thread for client: "
-                    "malloc() failed", cmdh_str);
-                cmdhandler->need_to_exit = 1;
-                break;
+            if (ret > 0 && FD_ISSET(client->fd, &wset)) {
+                if (cmdhandler_client_flush(client) < 0) {
+                    cmdhandler_client_close(client);
+                }
+            } else if (ret > 0 && FD_ISSET(client->fd, &rset)) {
+                cmdhandler_read_client(cmdhandler, client);
+            } else if (now - client->last > ODS_SE_CMDH_IDLE) {
+                ods_log_debug("[%s] client %i idle for too long", cmdh_str,
+                    client->fd);
+                cmdhandler_client_close(client);
             }
-            cmdc->listen_fd = cmdhandler->listen_fd;
-            cmdc->client_fd = connfd;
-            cmdc->listen_addr = cmdhandler->listen_addr;
-            cmdc->engine = cmdhandler->engine;
-            cmdc->need_to_exit = cmdhandler->need_to_exit;
-            ods_thread_create(&cmdc->thread_id, &cmdhandler_accept_client,
-                (void*) cmdc);
-            count++;
-            ods_log_debug("[%s] %i clients in progress...", cmdh_str, count);
         }
     }
+    /* the waiter finishes the command it is serving */
+    lock_basic_lock(&cmdhandler->client_lock);
+    cmdhandler->waiter_exit = 1;
+    lock_basic_alarm(&cmdhandler->waiter_cond);
+    lock_basic_unlock(&cmdhandler->client_lock);
+    ods_thread_join(cmdhandler->waiter_id);
+    for (i = 0; i < ODS_SE_MAX_CLIENTS; i++) {
+        client = &cmdhandler->clients[i];
+        if (client->fd >= 0) {
+            /* last words, the stop response for one */
+            (void)cmdhandler_client_flush(client);
+        }
+        cmdhandler_client_close(client);
+    }
     ods_log_debug("[%s] shutdown", cmdh_str);
     engine = cmdhandler->engine;
     engine->cmdhandler_done = 1;
@@ -975,6 +1562,11 @@ cmdhandler_cleanup(cmdhandler_type* cmdhandler)
         return;
     }
     allocator = cmdhandler->allocator;
+    close(cmdhandler->wake_fd[0]);
+    close(cmdhandler->wake_fd[1]);
+    lock_basic_destroy(&cmdhandler->client_lock);
+    lock_basic_off(&cmdhandler->waiter_cond);
+    allocator_deallocate(allocator, (void*) cmdhandler->clients);
     allocator_deallocate(allocator, (void*) cmdhandler);
     return;
 }
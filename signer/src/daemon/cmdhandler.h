@@ -40,7 +40,34 @@
 
 #include <sys/un.h>
 
+#include <time.h>
+
 #define ODS_SE_MAX_HANDLERS 5
+#define ODS_SE_MAX_CLIENTS 256
+#define ODS_SE_CMDH_IDLE 600 /* seconds */
+
+#define CMDH_CLIENT_QUEUED 1 /* waiting for the waiter */
+#define CMDH_CLIENT_SERVED 2 /* being served by the waiter */
+
+/**
+ * Command handler client.
+ *
+ */
+typedef struct cmdclient_struct cmdclient_type;
+struct cmdclient_struct {
+    struct cmdhandler_struct* cmdhandler;
+    int fd; /* -1 if slot is free */
+    int busy; /* commands that may wait on a zone are queued or running */
+    int eof; /* the client is to be closed, once the output is out */
+    int failed; /* output could not be queued, the command is aborted */
+    size_t len;
+    time_t last;
+    char buf[ODS_SE_MAXLINE];
+    char* out; /* output, written by the select loop */
+    size_t out_size;
+    size_t out_len;
+    size_t out_pos;
+};
 
 typedef struct cmdhandler_struct cmdhandler_type;
 struct cmdhandler_struct {
@@ -48,8 +75,13 @@ struct cmdhandler_struct {
     void* engine;
     struct sockaddr_un listen_addr;
     ods_thread_type thread_id;
+    cmdclient_type* clients;
+    lock_basic_type client_lock;
+    ods_thread_type waiter_id;
+    cond_basic_type waiter_cond;
+    int waiter_exit;
     int listen_fd;
-    int client_fd;
+    int wake_fd[2];
     int need_to_exit;
 };
 
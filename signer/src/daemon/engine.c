@@ -34,7 +34,9 @@
 #include "config.h"
 #include "daemon/cfg.h"
 #include "daemon/engine.h"
+#include "daemon/metrics.h"
 #include "daemon/signal.h"
+#include "parser/confparser.h"
 #include "shared/allocator.h"
 #include "shared/duration.h"
 #include "shared/file.h"
@@ -44,6 +46,8 @@
 #include "shared/privdrop.h"
 #include "shared/status.h"
 #include "shared/util.h"
+#include "signer/stats.h"
+#include "signer/tools.h"
 #include "signer/zonelist.h"
 #include "wire/tsig.h"
 
@@ -61,6 +65,8 @@
 #include <time.h>
 #include <unistd.h>
 
+#define ENGINE_NOTIFY_NAP 1 /* seconds, while notify commands run */
+
 static const char* engine_str = "engine";
 
 
@@ -101,6 +107,11 @@ engine_create(void)
     engine->need_to_reload = 0;
     lock_basic_init(&engine->signal_lock);
     lock_basic_set(&engine->signal_cond);
+    engine->hsmpool = NULL;
+    engine->hsmcheck_started = 0;
+    engine->hsmcheck_exit = 0;
+    lock_basic_init(&engine->hsm_lock);
+    lock_basic_set(&engine->hsm_cond);
     lock_basic_lock(&engine->signal_lock);
     engine->signal = SIGNAL_INIT;
     lock_basic_unlock(&engine->signal_lock);
@@ -342,11 +353,20 @@ engine_create_workers(engine_type* engine)
     ods_log_assert(engine);
     ods_log_assert(engine->config);
     ods_log_assert(engine->allocator);
+    if (engine->taskq) {
+        engine->taskq->deadlines = engine->config->deadline_scheduling;
+    }
     engine->workers = (worker_type**) allocator_alloc(engine->allocator,
         ((size_t)engine->config->num_worker_threads) * sizeof(worker_type*));
     for (i=0; i < (size_t) engine->config->num_worker_threads; i++) {
         engine->workers[i] = worker_create(engine->allocator, i,
             WORKER_WORKER);
+        /* share the sign queue between the zones being signed */
+        if (engine->workers[i] && engine->config->deadline_scheduling &&
+            engine->config->num_worker_threads > 1) {
+            engine->workers[i]->jobs_cap = FIFOQ_MAX_COUNT /
+                (size_t) engine->config->num_worker_threads;
+        }
     }
     return;
 }
@@ -444,6 +464,64 @@ engine_stop_drudgers(engine_type* engine)
         ods_thread_join(engine->drudgers[i]->thread_id);
         engine->drudgers[i]->engine = NULL;
     }
+    /* close their sessions */
+    lhsm_pool_clear(engine->hsmpool);
+    return;
+}
+
+
+/**
+ * Start/stop HSM checker.
+ *
+ */
+static void*
+hsmcheck_thread_start(void* arg)
+{
+    engine_type* engine = (engine_type*) arg;
+    ods_thread_blocksigs();
+    lock_basic_lock(&engine->hsm_lock);
+    while (!engine->hsmcheck_exit) {
+        lock_basic_sleep(&engine->hsm_cond, &engine->hsm_lock,
+            LHSM_CHECK_INTERVAL);
+        if (engine->hsmcheck_exit) {
+            break;
+        }
+        /* the drudgers keep signing while their sessions are checked */
+        lock_basic_unlock(&engine->hsm_lock);
+        lhsm_check_connection((void*) engine);
+        lhsm_pool_check(engine->hsmpool);
+        lock_basic_lock(&engine->hsm_lock);
+    }
+    lock_basic_unlock(&engine->hsm_lock);
+    return NULL;
+}
+static void
+engine_start_hsmcheck(engine_type* engine)
+{
+    ods_log_assert(engine);
+    ods_log_debug("[%s] start hsm checker", engine_str);
+    lock_basic_lock(&engine->hsm_lock);
+    engine->hsmcheck_exit = 0;
+    lock_basic_unlock(&engine->hsm_lock);
+    ods_thread_create(&engine->hsmcheck_id, hsmcheck_thread_start, engine);
+    engine->hsmcheck_started = 1;
+    return;
+}
+static void
+engine_stop_hsmcheck(engine_type* engine)
+{
+    ods_log_assert(engine);
+    if (!engine->hsmcheck_started) {
+        return;
+    }
+    ods_log_debug("[%s] stop hsm checker", engine_str);
+    lock_basic_lock(&engine->hsm_lock);
+    engine->hsmcheck_exit = 1;
+    lock_basic_alarm(&engine->hsm_cond);
+    lock_basic_unlock(&engine->hsm_lock);
+    ods_log_debug("[%s] join hsm checker", engine_str);
+    ods_thread_join(engine->hsmcheck_id);
+    engine->hsmcheck_started = 0;
     return;
 }
 
@@ -583,7 +661,15 @@ engine_setup(engine_type* engine)
     sigaction(SIGCHLD, &action, NULL);
     action.sa_handler = SIG_IGN;
     sigaction(SIGPIPE, &action, NULL);
-    /* create workers/drudgers */
+    /* statistics, one slot per drudger */
+    stats_setup((size_t) engine->config->num_signer_threads,
+        engine->config->repositories);
+    /* create workers/drudgers, and the HSM sessions of the drudgers */
+    engine->hsmpool = lhsm_pool_create(
+        (size_t) engine->config->num_signer_threads);
+    if (!engine->hsmpool) {
+        return ODS_STATUS_MALLOC_ERR;
+    }
     engine_create_workers(engine);
     engine_create_drudgers(engine);
     /* start cmd/dns/xfr handlers */
@@ -611,7 +697,7 @@ engine_all_zones_processed(engine_type* engine)
 
     node = ldns_rbtree_first(engine->zonelist->zones);
     while (node && node != LDNS_RBTREE_NULL) {
-        zone = (zone_type*) node->key;
+        zone = (zone_type*) node->data;
         ods_log_assert(zone);
         ods_log_assert(zone->db);
         if (!zone->db->is_processed) {
@@ -630,11 +716,19 @@ engine_all_zones_processed(engine_type* engine)
 static void
 engine_run(engine_type* engine, int single_run)
 {
+    time_t metrics_due = 0;
+    time_t now = 0;
+    time_t nap = 3600;
     if (!engine) {
         return;
     }
+    if (engine->config->metrics_filename &&
+        engine->config->metrics_interval < nap) {
+        nap = engine->config->metrics_interval;
+    }
     engine_start_workers(engine);
     engine_start_drudgers(engine);
+    engine_start_hsmcheck(engine);
 
     lock_basic_lock(&engine->signal_lock);
     engine->signal = SIGNAL_RUN;
@@ -661,17 +755,34 @@ engine_run(engine_type* engine, int single_run)
         }
         lock_basic_unlock(&engine->signal_lock);
 
+        if (signal_capture_child() || tools_notify_pending()) {
+            /* notify commands that have finished */
+            tools_reap_notify();
+        }
         if (single_run) {
            engine->need_to_exit = engine_all_zones_processed(engine);
         }
+        if (engine->config->metrics_filename) {
+            now = time_now();
+            if (now >= metrics_due) {
+                if (metrics_write(engine) != ODS_STATUS_OK) {
+                    ods_log_warning("[%s] unable to write metrics file %s",
+                        engine_str, engine->config->metrics_filename);
+                }
+                metrics_due = now + engine->config->metrics_interval;
+            }
+        }
         lock_basic_lock(&engine->signal_lock);
         if (engine->signal == SIGNAL_RUN && !single_run) {
            ods_log_debug("[%s] taking a break", engine_str);
-           lock_basic_sleep(&engine->signal_cond, &engine->signal_lock, 3600);
+           /* the child exit signal does not wake us, look again soon */
+           lock_basic_sleep(&engine->signal_cond, &engine->signal_lock,
+               tools_notify_pending() ? ENGINE_NOTIFY_NAP : nap);
         }
         lock_basic_unlock(&engine->signal_lock);
     }
     ods_log_debug("[%s] signer halted", engine_str);
+    engine_stop_hsmcheck(engine);
     engine_stop_drudgers(engine);
     engine_stop_workers(engine);
     (void)lhsm_reopen(engine->config->repositories);
@@ -785,6 +896,22 @@ dnsconfig_zone(engine_type* engine, zone_type* zone)
 }
 
 
+/**
+ * Keep a zone in the zone list change set, to retry it on the next commit.
+ *
+ */
+static void
+engine_requeue_zone(engine_type* engine, zone_type* zone)
+{
+    ods_log_warning("[%s] zone %s stays pending, retry on next update",
+        engine_str, zone->name);
+    lock_basic_lock(&engine->zonelist->zl_lock);
+    zonelist_requeue_zone(engine->zonelist, zone);
+    lock_basic_unlock(&engine->zonelist->zl_lock);
+    return;
+}
+
+
 /**
  * Update zones.
  *
@@ -792,13 +919,14 @@ dnsconfig_zone(engine_type* engine, zone_type* zone)
 void
 engine_update_zones(engine_type* engine, ods_status zl_changed)
 {
-    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    zone_type** zones = NULL;
     zone_type* zone = NULL;
-    zone_type* delzone = NULL;
     task_type* task = NULL;
     ods_status status = ODS_STATUS_OK;
     unsigned wake_up = 0;
     int warnings = 0;
+    size_t count = 0;
+    size_t i = 0;
     time_t now = 0;
 
     if (!engine || !engine->zonelist || !engine->zonelist->zones) {
@@ -807,44 +935,52 @@ engine_update_zones(engine_type* engine, ods_status zl_changed)
     now = time_now();
 
     ods_log_debug("[%s] commit zone list changes", engine_str);
+    /* only hold the zonelist lock while taking the change set */
     lock_basic_lock(&engine->zonelist->zl_lock);
-    node = ldns_rbtree_first(engine->zonelist->zones);
-    while (node && node != LDNS_RBTREE_NULL) {
-        zone = (zone_type*) node->data;
+    zones = zonelist_commit(engine->zonelist, zl_changed == ODS_STATUS_OK,
+        &count);
+    lock_basic_unlock(&engine->zonelist->zl_lock);
+    for (i=0; i < count; i++) {
+        zone = zones[i];
         task = NULL; /* reset task */
 
         if (zone->zl_status == ZONE_ZL_REMOVED) {
-            node = ldns_rbtree_next(node);
+            /* already taken out of the zonelist */
             lock_basic_lock(&zone->zone_lock);
-            delzone = zonelist_del_zone(engine->zonelist, zone);
-            if (delzone) {
-                lock_basic_lock(&engine->taskq->schedule_lock);
-                task = unschedule_task(engine->taskq,
-                    (task_type*) zone->task);
-                lock_basic_unlock(&engine->taskq->schedule_lock);
-            }
+            lock_basic_lock(&engine->taskq->schedule_lock);
+            task = unschedule_task(engine->taskq, (task_type*) zone->task);
+            lock_basic_unlock(&engine->taskq->schedule_lock);
             task_cleanup(task);
             task = NULL;
             lock_basic_unlock(&zone->zone_lock);
-            netio_remove_handler(engine->xfrhandler->netio,
-                &zone->xfrd->handler);
+            if (zone->xfrd) {
+                netio_remove_handler(engine->xfrhandler->netio,
+                    &zone->xfrd->handler);
+            }
+            if (zone->notify) {
+                netio_remove_handler(engine->xfrhandler->netio,
+                    &zone->notify->handler);
+            }
+            ods_log_debug("[%s] removed zone %s", engine_str, zone->name);
             zone_cleanup(zone);
             zone = NULL;
             continue;
         } else if (zone->zl_status == ZONE_ZL_ADDED) {
             lock_basic_lock(&zone->zone_lock);
-            ods_log_assert(!zone->task);
             /* set notify nameserver command */
             if (engine->config->notify_command && !zone->notify_ns) {
                 set_notify_ns(zone, engine->config->notify_command);
             }
-            /* create task */
-            task = task_create(TASK_SIGNCONF, now, zone);
+            /* create task, unless an earlier commit failed to schedule it */
+            task = (task_type*) zone->task;
+            if (!task) {
+                task = task_create(TASK_SIGNCONF, now, zone);
+            }
             lock_basic_unlock(&zone->zone_lock);
             if (!task) {
                 ods_log_crit("[%s] unable to create task for zone %s: "
                     "task_create() failed", engine_str, zone->name);
-                node = ldns_rbtree_next(node);
+                engine_requeue_zone(engine, zone);
                 continue;
             }
         }
@@ -872,7 +1008,8 @@ engine_update_zones(engine_type* engine, ods_status zl_changed)
             lock_basic_lock(&engine->taskq->schedule_lock);
             status = schedule_task(engine->taskq, task, 0);
             lock_basic_unlock(&engine->taskq->schedule_lock);
-        } else if (zl_changed == ODS_STATUS_OK) {
+        } else if (zl_changed == ODS_STATUS_OK ||
+            zone->zl_status == ZONE_ZL_UPDATED) {
             /* always try to update signconf */
             lock_basic_lock(&zone->zone_lock);
             status = zone_reschedule_task(zone, engine->taskq, TASK_SIGNCONF);
@@ -881,13 +1018,13 @@ engine_update_zones(engine_type* engine, ods_status zl_changed)
         if (status != ODS_STATUS_OK) {
             ods_log_crit("[%s] unable to schedule task for zone %s: %s",
                 engine_str, zone->name, ods_status2str(status));
+            engine_requeue_zone(engine, zone);
         } else {
             wake_up = 1;
             zone->zl_status = ZONE_ZL_OK;
         }
-        node = ldns_rbtree_next(node);
     }
-    lock_basic_unlock(&engine->zonelist->zl_lock);
+    free((void*)zones);
     if (engine->dnshandler) {
         dnshandler_fwd_notify(engine->dnshandler,
             (uint8_t*) ODS_SE_NOTIFY_CMD, strlen(ODS_SE_NOTIFY_CMD));
@@ -999,6 +1136,7 @@ engine_start(const char* cfgfile, int cmdline_verbosity, int daemonize,
     xmlInitGlobals();
     xmlInitParser();
     xmlInitThreads();
+    parse_rng_init();
     engine = engine_create();
     if (!engine) {
         ods_fatal_exit("[%s] create failed", engine_str);
@@ -1041,17 +1179,20 @@ engine_start(const char* cfgfile, int cmdline_verbosity, int daemonize,
         ret = 1;
         close_hsm = 1;
     }
+    /* after daemonizing, the log writer thread does not survive fork() */
+    if (engine->config->async_logging) {
+        ods_log_async_start();
+    }
 
     /* run */
     while (engine->need_to_exit == 0) {
         /* update zone list */
-        lock_basic_lock(&engine->zonelist->zl_lock);
+        lock_basic_lock(&engine->zonelist->commit_lock);
         zl_changed = zonelist_update(engine->zonelist,
             engine->config->zonelist_filename);
         engine->zonelist->just_removed = 0;
         engine->zonelist->just_added = 0;
         engine->zonelist->just_updated = 0;
-        lock_basic_unlock(&engine->zonelist->zl_lock);
         /* start/reload */
         if (engine->need_to_reload) {
             ods_log_info("[%s] signer reloading", engine_str);
@@ -1063,8 +1204,10 @@ engine_start(const char* cfgfile, int cmdline_verbosity, int daemonize,
         }
         if (zl_changed == ODS_STATUS_OK ||
             zl_changed == ODS_STATUS_UNCHANGED) {
-            engine_update_zones(engine, zl_changed);
+            /* only the zones in the change set need to be touched */
+            engine_update_zones(engine, ODS_STATUS_UNCHANGED);
         }
+        lock_basic_unlock(&engine->zonelist->commit_lock);
         engine_run(engine, single_run);
     }
 
@@ -1093,6 +1236,7 @@ earlyexit:
     engine_cleanup(engine);
     engine = NULL;
     ods_log_close();
+    parse_rng_cleanup();
     xmlCleanupParser();
     xmlCleanupGlobals();
     xmlCleanupThreads();
@@ -1111,12 +1255,16 @@ engine_cleanup(engine_type* engine)
     allocator_type* allocator;
     cond_basic_type signal_cond;
     lock_basic_type signal_lock;
+    cond_basic_type hsm_cond;
+    lock_basic_type hsm_lock;
     if (!engine) {
         return;
     }
     allocator = engine->allocator;
     signal_cond = engine->signal_cond;
     signal_lock = engine->signal_lock;
+    hsm_cond = engine->hsm_cond;
+    hsm_lock = engine->hsm_lock;
     if (engine->workers && engine->config) {
         for (i=0; i < (size_t) engine->config->num_worker_threads; i++) {
             worker_cleanup(engine->workers[i]);
@@ -1130,6 +1278,8 @@ engine_cleanup(engine_type* engine)
         allocator_deallocate(allocator, (void*) engine->drudgers);
     }
     zonelist_cleanup(engine->zonelist);
+    lhsm_pool_cleanup(engine->hsmpool);
+    stats_teardown();
     schedule_cleanup(engine->taskq);
     fifoq_cleanup(engine->signq);
     cmdhandler_cleanup(engine->cmdhandler);
@@ -1139,6 +1289,8 @@ engine_cleanup(engine_type* engine)
     allocator_deallocate(allocator, (void*) engine);
     lock_basic_destroy(&signal_lock);
     lock_basic_off(&signal_cond);
+    lock_basic_destroy(&hsm_lock);
+    lock_basic_off(&hsm_cond);
     allocator_cleanup(allocator);
     return;
 }
@@ -43,6 +43,7 @@
 #include "scheduler/fifoq.h"
 #include "scheduler/schedule.h"
 #include "shared/allocator.h"
+#include "shared/hsm.h"
 #include "shared/locks.h"
 #include "signer/zonelist.h"
 #include "wire/edns.h"
@@ -79,6 +80,12 @@ struct engine_struct {
     sig_atomic_t signal;
     cond_basic_type signal_cond;
     lock_basic_type signal_lock;
+    lhsm_pool_type* hsmpool; /* HSM sessions of the drudgers */
+    ods_thread_type hsmcheck_id;
+    int hsmcheck_started;
+    int hsmcheck_exit;
+    cond_basic_type hsm_cond;
+    lock_basic_type hsm_lock;
 };
 
 /**
@@ -116,9 +123,12 @@ void engine_stop_drudgers(engine_type* engine);
 void engine_wakeup_workers(engine_type* engine);
 
 /**
- * Update zones.
+ * Update zones. Only the zones in the zonelist change set are touched,
+ * unless all zones need to reload their signer configuration.
+ * Caller must hold the zonelist commit lock.
  * \param[in] engine engine
- * \param[in] zl_changed whether the zonelist has changed or not
+ * \param[in] zl_changed ODS_STATUS_OK to update the signer configuration
+ *            of all zones, ODS_STATUS_UNCHANGED for the change set only
  *
  */
 void engine_update_zones(engine_type* engine, ods_status zl_changed);
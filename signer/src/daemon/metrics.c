@@ -0,0 +1,431 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Signer metrics, in Prometheus text exposition format.
+ *
+ */
+
+#include "config.h"
+#include "daemon/engine.h"
+#include "daemon/metrics.h"
+#include "shared/duration.h"
+#include "shared/file.h"
+#include "shared/log.h"
+#include "signer/stats.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* metrics_str = "metrics";
+
+#define NS2SECF(ns) ((double) (ns) / 1000000000.0)
+
+
+/**
+ * Print a label value, escaped.
+ *
+ */
+static void
+metrics_label(FILE* fd, const char* str)
+{
+    const char* s = NULL;
+    for (s = str; s && *s; s++) {
+        switch (*s) {
+            case '\\':
+                fputs("\\\\", fd);
+                break;
+            case '"':
+                fputs("\\\"", fd);
+                break;
+            case '\n':
+                fputs("\\n", fd);
+                break;
+            default:
+                fputc(*s, fd);
+                break;
+        }
+    }
+    return;
+}
+
+
+/**
+ * Print metric header.
+ *
+ */
+static void
+metrics_header(FILE* fd, const char* name, const char* type,
+    const char* help)
+{
+    fprintf(fd, "# HELP %s %s\n", name, help);
+    fprintf(fd, "# TYPE %s %s\n", name, type);
+    return;
+}
+
+
+/**
+ * Per zone values, copied while holding the zone list lock.
+ *
+ */
+typedef struct metrics_zone_struct metrics_zone_type;
+struct metrics_zone_struct {
+    char* name;
+    uint64_t total_sig_count;
+    uint64_t total_sig_reuse;
+    uint64_t xfr_in;
+    uint64_t xfr_out;
+    uint32_t last_sig_count;
+    uint64_t last_sig_time;
+    time_t last_publish;
+};
+
+
+/**
+ * Print a per zone metric sample.
+ *
+ */
+static void
+metrics_zone_sample(FILE* fd, const char* name, metrics_zone_type* zone,
+    const char* extra, double value)
+{
+    fprintf(fd, "%s{zone=\"", name);
+    metrics_label(fd, zone->name);
+    fprintf(fd, "\"%s} %.17g\n", extra?extra:"", value);
+    return;
+}
+
+
+/**
+ * Copy the per zone values. The zone list lock is only held while
+ * copying, not while the values are printed.
+ *
+ */
+static metrics_zone_type*
+metrics_snapshot_zones(engine_type* engine, size_t* count)
+{
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    zone_type* zone = NULL;
+    metrics_zone_type* zones = NULL;
+    size_t n = 0;
+    *count = 0;
+    lock_basic_lock(&engine->zonelist->zl_lock);
+    if (engine->zonelist->zones->count) {
+        zones = (metrics_zone_type*) calloc(engine->zonelist->zones->count,
+            sizeof(metrics_zone_type));
+    }
+    if (!zones) {
+        lock_basic_unlock(&engine->zonelist->zl_lock);
+        return NULL;
+    }
+    node = ldns_rbtree_first(engine->zonelist->zones);
+    while (node && node != LDNS_RBTREE_NULL) {
+        zone = (zone_type*) node->data;
+        node = ldns_rbtree_next(node);
+        if (!zone->stats || !zone->name) {
+            continue;
+        }
+        zones[n].name = strdup(zone->name);
+        if (!zones[n].name) {
+            continue;
+        }
+        lock_basic_lock(&zone->stats->stats_lock);
+        zones[n].total_sig_count = zone->stats->total_sig_count;
+        zones[n].total_sig_reuse = zone->stats->total_sig_reuse;
+        zones[n].xfr_in = zone->stats->xfr_in;
+        zones[n].xfr_out = zone->stats->xfr_out;
+        zones[n].last_sig_count = zone->stats->last_sig_count;
+        zones[n].last_sig_time = zone->stats->last_sig_time;
+        zones[n].last_publish = zone->stats->last_publish;
+        lock_basic_unlock(&zone->stats->stats_lock);
+        n++;
+    }
+    lock_basic_unlock(&engine->zonelist->zl_lock);
+    *count = n;
+    return zones;
+}
+
+
+/**
+ * Print per zone metrics.
+ *
+ */
+static void
+metrics_print_zones(FILE* fd, engine_type* engine)
+{
+    metrics_zone_type* zones = NULL;
+    metrics_zone_type* zone = NULL;
+    size_t count = 0;
+    size_t j = 0;
+    time_t now = time_now();
+    int i = 0;
+    static const char* names[] = {
+        "ods_signer_zone_signatures_total",
+        "ods_signer_zone_signatures_per_second",
+        "ods_signer_zone_sign_duration_seconds",
+        "ods_signer_zone_xfr_bytes_total",
+        "ods_signer_zone_last_publish_age_seconds"
+    };
+    static const char* types[] = {
+        "counter", "gauge", "gauge", "counter", "gauge"
+    };
+    static const char* helps[] = {
+        "Signatures in published zones, new or reused.",
+        "Signing throughput of the last published run.",
+        "Time spent signing in the last published run.",
+        "Zone transfer bytes, received from the master or sent out.",
+        "Seconds since the zone was last published."
+    };
+    if (!engine->zonelist || !engine->zonelist->zones) {
+        return;
+    }
+    zones = metrics_snapshot_zones(engine, &count);
+    if (!zones) {
+        return;
+    }
+    for (i=0; i < 5; i++) {
+        metrics_header(fd, names[i], types[i], helps[i]);
+        for (j=0; j < count; j++) {
+            zone = &zones[j];
+            switch (i) {
+                case 0:
+                    metrics_zone_sample(fd, names[i], zone, ",type=\"new\"",
+                        (double) zone->total_sig_count);
+                    metrics_zone_sample(fd, names[i], zone,
+                        ",type=\"reused\"", (double) zone->total_sig_reuse);
+                    break;
+                case 1:
+                    metrics_zone_sample(fd, names[i], zone, NULL,
+                        zone->last_sig_time ? (double) zone->last_sig_count /
+                        NS2SECF(zone->last_sig_time) : 0.0);
+                    break;
+                case 2:
+                    metrics_zone_sample(fd, names[i], zone, NULL,
+                        NS2SECF(zone->last_sig_time));
+                    break;
+                case 3:
+                    metrics_zone_sample(fd, names[i], zone,
+                        ",direction=\"in\"", (double) zone->xfr_in);
+                    metrics_zone_sample(fd, names[i], zone,
+                        ",direction=\"out\"", (double) zone->xfr_out);
+                    break;
+                case 4:
+                    /* never published zones have no age */
+                    if (zone->last_publish) {
+                        metrics_zone_sample(fd, names[i], zone, NULL,
+                            (double) (now - zone->last_publish));
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    for (j=0; j < count; j++) {
+        free((void*) zones[j].name);
+    }
+    free((void*) zones);
+    return;
+}
+
+
+/**
+ * Print drudger metrics.
+ *
+ */
+static void
+metrics_print_drudgers(FILE* fd, engine_type* engine)
+{
+    worker_type* drudger = NULL;
+    uint64_t* busy = NULL;
+    uint64_t* idle = NULL;
+    size_t num = 0;
+    size_t i = 0;
+    if (!engine->drudgers || engine->config->num_signer_threads <= 0) {
+        return;
+    }
+    num = (size_t) engine->config->num_signer_threads;
+    busy = (uint64_t*) calloc(num, sizeof(uint64_t));
+    idle = (uint64_t*) calloc(num, sizeof(uint64_t));
+    if (!busy || !idle) {
+        free((void*) busy);
+        free((void*) idle);
+        return;
+    }
+    /* the drudgers keep counting while we read, this is a snapshot */
+    for (i=0; i < num; i++) {
+        drudger = engine->drudgers[i];
+        lock_basic_lock(&drudger->worker_lock);
+        busy[i] = drudger->busy_time;
+        idle[i] = drudger->idle_time;
+        lock_basic_unlock(&drudger->worker_lock);
+    }
+    metrics_header(fd, "ods_signer_drudger_busy_seconds_total", "counter",
+        "Time a drudger spent signing.");
+    for (i=0; i < num; i++) {
+        fprintf(fd, "ods_signer_drudger_busy_seconds_total{drudger=\"%i\"} "
+            "%.3f\n", engine->drudgers[i]->thread_num, NS2SECF(busy[i]));
+    }
+    metrics_header(fd, "ods_signer_drudger_idle_seconds_total", "counter",
+        "Time a drudger spent waiting for work.");
+    for (i=0; i < num; i++) {
+        fprintf(fd, "ods_signer_drudger_idle_seconds_total{drudger=\"%i\"} "
+            "%.3f\n", engine->drudgers[i]->thread_num, NS2SECF(idle[i]));
+    }
+    free((void*) busy);
+    free((void*) idle);
+    return;
+}
+
+
+/**
+ * Print HSM metrics.
+ *
+ */
+static void
+metrics_print_hsm(FILE* fd)
+{
+    stats_hsm_type hsm;
+    const char* name = NULL;
+    size_t i = 0;
+    size_t j = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t saved = 0;
+    static const unsigned pcts[] = { 50, 90, 99 };
+    stats_keycache_get(&hits, &misses, &saved);
+    metrics_header(fd, "ods_signer_key_cache_hits_total", "counter",
+        "Keys found in the HSM key cache.");
+    fprintf(fd, "ods_signer_key_cache_hits_total %lu\n",
+        (unsigned long) hits);
+    metrics_header(fd, "ods_signer_key_cache_misses_total", "counter",
+        "Keys that had to be looked up in the HSM.");
+    fprintf(fd, "ods_signer_key_cache_misses_total %lu\n",
+        (unsigned long) misses);
+    metrics_header(fd, "ods_signer_key_cache_saved_seconds_total", "counter",
+        "HSM time saved by the HSM key cache.");
+    fprintf(fd, "ods_signer_key_cache_saved_seconds_total %.6f\n",
+        NS2SECF(saved));
+    if (!stats_hsm_count()) {
+        return;
+    }
+    metrics_header(fd, "ods_signer_hsm_sign_latency_seconds", "summary",
+        "Latency of HSM sign calls per repository.");
+    for (i=0; i < stats_hsm_count(); i++) {
+        name = stats_hsm_sum(i, &hsm);
+        if (!name) {
+            continue;
+        }
+        for (j=0; j < sizeof(pcts)/sizeof(pcts[0]); j++) {
+            fputs("ods_signer_hsm_sign_latency_seconds{repository=\"", fd);
+            metrics_label(fd, name);
+            fprintf(fd, "\",quantile=\"0.%02u\"} %.6f\n", pcts[j],
+                NS2SECF(stats_hsm_percentile(&hsm, pcts[j])));
+        }
+        fputs("ods_signer_hsm_sign_latency_seconds_sum{repository=\"", fd);
+        metrics_label(fd, name);
+        fprintf(fd, "\"} %.6f\n", NS2SECF(hsm.total));
+        fputs("ods_signer_hsm_sign_latency_seconds_count{repository=\"", fd);
+        metrics_label(fd, name);
+        fprintf(fd, "\"} %lu\n", (unsigned long) hsm.count);
+    }
+    return;
+}
+
+
+/**
+ * Print metrics.
+ *
+ */
+void
+metrics_print(FILE* fd, void* engineptr)
+{
+    engine_type* engine = (engine_type*) engineptr;
+    size_t depth = 0;
+    if (!fd || !engine || !engine->config) {
+        return;
+    }
+    if (engine->signq) {
+        lock_basic_lock(&engine->signq->q_lock);
+        depth = engine->signq->count;
+        lock_basic_unlock(&engine->signq->q_lock);
+    }
+    metrics_header(fd, "ods_signer_signq_depth", "gauge",
+        "RRsets waiting in the sign queue.");
+    fprintf(fd, "ods_signer_signq_depth %lu\n", (unsigned long) depth);
+    metrics_print_drudgers(fd, engine);
+    if (engine->xfrhandler) {
+        metrics_header(fd, "ods_signer_xfr_total", "counter",
+            "Incoming zone transfers committed to disk.");
+        fprintf(fd, "ods_signer_xfr_total %lu\n",
+            (unsigned long) engine->xfrhandler->xfr_count);
+        metrics_header(fd, "ods_signer_xfr_coalesced_total", "counter",
+            "Incoming zone transfers read together with an earlier one.");
+        fprintf(fd, "ods_signer_xfr_coalesced_total %lu\n",
+            (unsigned long) engine->xfrhandler->xfr_coalesced);
+    }
+    metrics_print_hsm(fd);
+    metrics_print_zones(fd, engine);
+    return;
+}
+
+
+/**
+ * Write metrics to the configured metrics file.
+ *
+ */
+ods_status
+metrics_write(void* engineptr)
+{
+    engine_type* engine = (engine_type*) engineptr;
+    char* tmpfile = NULL;
+    FILE* fd = NULL;
+    ods_status status = ODS_STATUS_OK;
+    if (!engine || !engine->config || !engine->config->metrics_filename) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    tmpfile = ods_build_path(engine->config->metrics_filename, ".tmp", 0, 0);
+    if (!tmpfile) {
+        return ODS_STATUS_MALLOC_ERR;
+    }
+    fd = ods_fopen(tmpfile, NULL, "w");
+    if (fd) {
+        metrics_print(fd, engine);
+        ods_fclose(fd);
+        if (rename(tmpfile, engine->config->metrics_filename) != 0) {
+            ods_log_error("[%s] unable to rename %s to %s: %s", metrics_str,
+                tmpfile, engine->config->metrics_filename, strerror(errno));
+            status = ODS_STATUS_RENAME_ERR;
+        }
+    } else {
+        status = ODS_STATUS_FOPEN_ERR;
+    }
+    free((void*) tmpfile);
+    return status;
+}
@@ -41,6 +41,7 @@
 
 static int signal_hup_recvd = 0;
 static int signal_term_recvd = 0;
+static volatile sig_atomic_t signal_chld_recvd = 0;
 static engine_type* signal_engine = NULL;
 static const char* signal_str = "signal";
 
@@ -87,6 +88,13 @@ signal_handler(sig_atomic_t sig)
                 lock_basic_unlock(&signal_engine->signal_lock);
             }
             break;
+        case SIGCHLD:
+            /**
+             * Only set the flag, nothing else is async-signal-safe. The
+             * engine naps briefly while notify commands are running.
+             */
+            signal_chld_recvd = 1;
+            break;
         default:
             break;
     }
@@ -110,3 +118,18 @@ signal_capture(sig_atomic_t dflsig)
     }
     return dflsig;
 }
+
+
+/**
+ * Capture child exits.
+ *
+ */
+int
+signal_capture_child(void)
+{
+    if (signal_chld_recvd) {
+        signal_chld_recvd = 0;
+        return 1;
+    }
+    return 0;
+}
@@ -65,4 +65,11 @@ void signal_handler(sig_atomic_t sig);
  */
 sig_atomic_t signal_capture(sig_atomic_t dflsig);
 
+/**
+ * Capture child exits.
+ * \return int 1 if a child process exited since the last call
+ *
+ */
+int signal_capture_child(void);
+
 #endif /* DAEMON_SIGNAL_H */
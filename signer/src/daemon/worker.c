@@ -31,6 +31,7 @@
  *
  */
 
+#include "adapter/adapi.h"
 #include "daemon/engine.h"
 #include "daemon/worker.h"
 #include "shared/allocator.h"
@@ -96,8 +97,13 @@ worker_create(allocator_type* allocator, int num, worker_id type)
     worker->jobs_appointed = 0;
     worker->jobs_completed = 0;
     worker->jobs_failed = 0;
+    worker->jobs_cap = 0;
+    worker->busy_time = 0;
+    worker->idle_time = 0;
     worker->sleeping = 0;
     worker->waiting = 0;
+    worker->throttled = 0;
+    worker->pipelined = 0;
     lock_basic_unlock(&worker->worker_lock);
     return worker;
 }
@@ -134,6 +140,41 @@ worker_fulfilled(worker_type* worker)
 }
 
 
+/**
+ * Number of jobs that this worker has queued and that are not done yet.
+ *
+ */
+static size_t
+worker_outstanding(worker_type* worker)
+{
+    return worker->jobs_appointed - worker->jobs_completed -
+        worker->jobs_failed;
+}
+
+
+/**
+ * Wait until the worker may queue another job. A worker may only have
+ * jobs_cap jobs outstanding, so that a single large zone does not occupy
+ * all of the sign queue, and thereby all the drudgers, while other zones
+ * are waiting to be signed.
+ *
+ */
+static void
+worker_throttle(worker_type* worker)
+{
+    lock_basic_lock(&worker->worker_lock);
+    while (!worker->need_to_exit && worker->jobs_cap &&
+        worker_outstanding(worker) >= worker->jobs_cap) {
+        worker->throttled = 1;
+        worker->sleeping = 1;
+        lock_basic_sleep(&worker->worker_alarm, &worker->worker_lock, 1);
+    }
+    worker->throttled = 0;
+    lock_basic_unlock(&worker->worker_lock);
+    return;
+}
+
+
 /**
  * Clear jobs.
  *
@@ -164,6 +205,7 @@ worker_queue_rrset(worker_type* worker, fifoq_type* q, rrset_type* rrset)
     ods_log_assert(q);
     ods_log_assert(rrset);
 
+    worker_throttle(worker);
     lock_basic_lock(&q->q_lock);
     status = fifoq_push(q, (void*) rrset, worker, &tries);
     while (status == ODS_STATUS_UNCHANGED) {
@@ -225,6 +267,10 @@ worker_queue_zone(worker_type* worker, fifoq_type* q, zone_type* zone)
 {
     ldns_rbnode_t* node = LDNS_RBTREE_NULL;
     domain_type* domain = NULL;
+    denial_type* denial = NULL;
+    rrset_type* rrset = NULL;
+    time_t resign = 0;
+    size_t queued = 0;
     ods_log_assert(worker);
     ods_log_assert(q);
     ods_log_assert(zone);
@@ -232,6 +278,41 @@ worker_queue_zone(worker_type* worker, fifoq_type* q, zone_type* zone)
     if (!zone->db || !zone->db->domains) {
         return;
     }
+    if (zone->signconf) {
+        resign = duration2time(zone->signconf->sig_resign_interval);
+    }
+    if (!zone->db->dirty_all && resign && zone->db->full_sign_time &&
+        worker->clock_in < zone->db->full_sign_time + resign) {
+        /**
+         * Signatures were refreshed less than a resign interval ago, only
+         * the changed domains and denials, and the apex for the new SOA
+         * serial, need to be queued.
+         */
+        for (domain = zone->db->dirty_domains; domain;
+            domain = domain->dirty_next) {
+            for (rrset = domain->rrsets; rrset; rrset = rrset->next) {
+                worker_queue_rrset(worker, q, rrset);
+            }
+            queued++;
+        }
+        domain = namedb_lookup_domain(zone->db, zone->apex);
+        if (domain && !domain->is_dirty) {
+            for (rrset = domain->rrsets; rrset; rrset = rrset->next) {
+                worker_queue_rrset(worker, q, rrset);
+            }
+        }
+        for (denial = zone->db->dirty_denials; denial;
+            denial = denial->dirty_next) {
+            if (denial->rrset) {
+                worker_queue_rrset(worker, q, denial->rrset);
+            }
+        }
+        ods_log_debug("[%s[%i]] queued %u of %u domains of zone %s",
+            worker2str(worker->type), worker->thread_num, (unsigned) queued,
+            (unsigned) zone->db->domains->count, zone->name);
+        namedb_clear_dirty(zone->db);
+        return;
+    }
     if (zone->db->domains->root != LDNS_RBTREE_NULL) {
         node = ldns_rbtree_first(zone->db->domains);
     }
@@ -240,6 +321,91 @@ worker_queue_zone(worker_type* worker, fifoq_type* q, zone_type* zone)
         worker_queue_domain(worker, q, domain);
         node = ldns_rbtree_next(node);
     }
+    zone->db->full_sign_time = worker->clock_in;
+    namedb_clear_dirty(zone->db);
+    return;
+}
+
+
+/**
+ * Start pipelined signing. Domains are handed to the drudgers as soon as
+ * they have been read completely. This is only done for the initial read
+ * of a zone file, when nothing has to be compared to a previous version.
+ *
+ */
+static int
+worker_pipeline_start(worker_type* worker, zone_type* zone)
+{
+    ods_log_assert(worker);
+    ods_log_assert(zone);
+    if (!zone->adinbound || zone->adinbound->type != ADAPTER_FILE) {
+        return 0;
+    }
+    if (!zone->db || !zone->db->domains || zone->db->is_initialized ||
+        zone->db->domains->count > 1) {
+        /* only the apex may have been created, by publishing the keys */
+        return 0;
+    }
+    if (zone_prepare_keys(zone) != ODS_STATUS_OK) {
+        return 0;
+    }
+    if (zone->stats) {
+        stats_sig_reset(zone->stats);
+        lock_basic_lock(&zone->stats->stats_lock);
+        zone->stats->sig_time = 0;
+        zone->stats->pipe_count = 0;
+        zone->stats->pipe_start = 0;
+        zone->stats->pipe_time = 0;
+        zone->stats->pipe_drain = 0;
+        lock_basic_unlock(&zone->stats->stats_lock);
+    }
+    worker_clear_jobs(worker);
+    lock_basic_lock(&worker->worker_lock);
+    worker->pipelined = 1;
+    lock_basic_unlock(&worker->worker_lock);
+    zone->pipeline = (void*) worker;
+    ods_log_debug("[%s[%i]] pipelined signing zone %s",
+        worker2str(worker->type), worker->thread_num, zone->name);
+    return 1;
+}
+
+
+/**
+ * Queue a completed domain for signing while the zone is being read.
+ *
+ */
+void
+worker_pipeline_domain(worker_type* worker, domain_type* domain)
+{
+    engine_type* engine = NULL;
+    ods_log_assert(worker);
+    ods_log_assert(worker->engine);
+    ods_log_assert(domain);
+    engine = (engine_type*) worker->engine;
+    worker_queue_domain(worker, engine->signq, domain);
+    return;
+}
+
+
+/**
+ * Wait until the domains queued while reading the zone have been signed.
+ *
+ */
+void
+worker_pipeline_drain(worker_type* worker, int complete)
+{
+    ods_log_assert(worker);
+    worker_sleep_unless(worker, 0);
+    lock_basic_lock(&worker->worker_lock);
+    worker->pipelined = (complete != 0);
+    if (worker->jobs_failed) {
+        /* not fatal, the sign task will try these RRsets again */
+        ods_log_warning("[%s[%i]] %u RRsets failed during pipelined signing",
+            worker2str(worker->type), worker->thread_num,
+            (unsigned) worker->jobs_failed);
+    }
+    lock_basic_unlock(&worker->worker_lock);
+    worker_clear_jobs(worker);
     return;
 }
 
@@ -299,8 +465,10 @@ worker_perform_task(worker_type* worker)
     time_t never = (3600*24*365);
     ods_status status = ODS_STATUS_OK;
     int backup = 0;
+    int pipelined = 0;
     time_t start = 0;
-    time_t end = 0;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
 
     if (!worker || !worker->task || !worker->task->zone || !worker->engine) {
         return;
@@ -352,8 +520,17 @@ worker_perform_task(worker_type* worker)
                     task_who2str(task));
                 status = ODS_STATUS_ERR;
             } else {
-                lhsm_check_connection((void*)engine);
+                pipelined = worker_pipeline_start(worker, zone);
                 status = tools_input(zone);
+                /* in case the adapter did not finish the pipeline */
+                adapi_pipeline_end(zone, 0);
+                if (pipelined) {
+                    /* pipelining may have stopped early, unsorted input */
+                    lock_basic_lock(&worker->worker_lock);
+                    pipelined = worker->pipelined;
+                    worker->pipelined = 0;
+                    lock_basic_unlock(&worker->worker_lock);
+                }
             }
 
             if (status == ODS_STATUS_UNCHANGED) {
@@ -398,19 +575,22 @@ worker_perform_task(worker_type* worker)
 
             /* start timer */
             start = time(NULL);
+            start_ns = time_monotonic_ns();
             if (zone->stats) {
+                if (!pipelined) {
+                    /* keep the signatures made while reading */
+                    stats_sig_reset(zone->stats);
+                }
                 lock_basic_lock(&zone->stats->stats_lock);
                 if (!zone->stats->start_time) {
                     zone->stats->start_time = start;
                 }
-                zone->stats->sig_count = 0;
-                zone->stats->sig_soa_count = 0;
-                zone->stats->sig_reuse = 0;
+                if (!pipelined) {
+                    zone->stats->pipe_count = 0;
+                }
                 zone->stats->sig_time = 0;
                 lock_basic_unlock(&zone->stats->stats_lock);
             }
-            /* check the HSM connection before queuing sign operations */
-            lhsm_check_connection((void*)engine);
             /* prepare keys */
             status = zone_prepare_keys(zone);
             if (status == ODS_STATUS_OK) {
@@ -423,15 +603,61 @@ worker_perform_task(worker_type* worker)
                 worker_sleep_unless(worker, 0);
             }
             /* stop timer */
-            end = time(NULL);
+            end_ns = time_monotonic_ns();
             /* check status and jobs */
             if (status == ODS_STATUS_OK) {
                 status = worker_check_jobs(worker, task);
             }
             worker_clear_jobs(worker);
+            if (status != ODS_STATUS_OK) {
+                /* the changes have been forgotten, next time sign all */
+                zone->db->dirty_all = 1;
+            }
             if (status == ODS_STATUS_OK && zone->stats) {
+                /* drudgers are done, collect their counters */
+                stats_sig_sync(zone->stats);
                 lock_basic_lock(&zone->stats->stats_lock);
-                zone->stats->sig_time = (end-start);
+                zone->stats->sig_time = (end_ns-start_ns);
+                if (pipelined) {
+                    /**
+                     * Signatures made while reading are recycled in this
+                     * run, don't count them twice.
+                     */
+                    if (zone->stats->sig_reuse > zone->stats->pipe_count) {
+                        zone->stats->sig_reuse -= zone->stats->pipe_count;
+                    } else {
+                        zone->stats->sig_reuse = 0;
+                    }
+                    zone->stats->sig_time += (zone->stats->pipe_time +
+                        zone->stats->pipe_drain);
+                }
+                /**
+                 * Earliest signature expiration in the zone. A full sign
+                 * visited every RRset, an incremental one only some: it
+                 * can lower the earliest expiration, but if it replaced
+                 * the signatures that expired first, the earliest one
+                 * is unknown until the next full sign.
+                 */
+                if (zone->db->full_sign_time == worker->clock_in) {
+                    zone->stats->last_sig_expire =
+                        (time_t) zone->stats->sig_expire;
+                } else if (zone->stats->last_sig_expire &&
+                    zone->stats->sig_replaced &&
+                    (time_t) zone->stats->sig_replaced <=
+                    zone->stats->last_sig_expire) {
+                    zone->stats->last_sig_expire = 0;
+                } else if (zone->stats->last_sig_expire &&
+                    zone->stats->sig_expire &&
+                    (time_t) zone->stats->sig_expire <
+                    zone->stats->last_sig_expire) {
+                    zone->stats->last_sig_expire =
+                        (time_t) zone->stats->sig_expire;
+                }
+                task->deadline = 0;
+                if (zone->stats->last_sig_expire && zone->signconf) {
+                    task->deadline = zone->stats->last_sig_expire -
+                        duration2time(zone->signconf->sig_refresh_interval);
+                }
                 lock_basic_unlock(&zone->stats->stats_lock);
             }
             if (status != ODS_STATUS_OK) {
@@ -470,6 +696,13 @@ worker_perform_task(worker_type* worker)
                 what = TASK_SIGN;
                 when = worker->clock_in +
                     duration2time(zone->signconf->sig_resign_interval);
+                /* incremental signs do not postpone the full resign */
+                if (zone->db->full_sign_time && when >
+                    zone->db->full_sign_time +
+                    duration2time(zone->signconf->sig_resign_interval)) {
+                    when = zone->db->full_sign_time +
+                        duration2time(zone->signconf->sig_resign_interval);
+                }
             } else {
                 ods_log_error("[%s[%i]] unable to retrieve resign interval "
                     "for zone %s: duration2time() failed",
@@ -523,7 +756,17 @@ worker_perform_task(worker_type* worker)
     }
     /* backup the last successful run */
     if (backup) {
+        start_ns = time_monotonic_ns();
         status = zone_backup2(zone);
+        end_ns = time_monotonic_ns();
+        if (zone->stats) {
+            lock_basic_lock(&zone->stats->stats_lock);
+            zone->stats->backup_time = (end_ns-start_ns);
+            lock_basic_unlock(&zone->stats->stats_lock);
+        }
+        ods_log_debug("[%s[%i]] backup zone %s took %u(msec)",
+            worker2str(worker->type), worker->thread_num, task_who2str(task),
+            (uint32_t) ((end_ns-start_ns) / 1000000));
         if (status != ODS_STATUS_OK) {
             ods_log_warning("[%s[%i]] unable to backup zone %s: %s",
             worker2str(worker->type), worker->thread_num,
@@ -662,12 +905,18 @@ worker_drudge(worker_type* worker)
     ods_status status = ODS_STATUS_OK;
     worker_type* superior = NULL;
     hsm_ctx_t* ctx = NULL;
+    size_t slot = 0;
+    int retry = 0;
+    uint64_t start_ns = 0;
+    uint64_t idle_ns = 0;
 
     ods_log_assert(worker);
     ods_log_assert(worker->engine);
     ods_log_assert(worker->type == WORKER_DRUDGER);
 
     engine = (engine_type*) worker->engine;
+    /* drudgers are numbered from 1, so are the session pool slots from 0 */
+    slot = (size_t) worker->thread_num - 1;
     while (worker->need_to_exit == 0) {
         ods_log_deeebug("[%s[%i]] report for duty", worker2str(worker->type),
             worker->thread_num);
@@ -676,6 +925,7 @@ worker_drudge(worker_type* worker)
         zone = NULL;
         task = NULL;
         /* get item */
+        idle_ns = 0;
         lock_basic_lock(&engine->signq->q_lock);
         rrset = (rrset_type*) fifoq_pop(engine->signq, &superior);
         if (!rrset) {
@@ -687,19 +937,23 @@ worker_drudge(worker_type* worker)
              * will automatically grab the lock when the threshold is reached.
              * Threshold is at 1 and MAX (after a number of tries).
              */
+            start_ns = time_monotonic_ns();
             lock_basic_sleep(&engine->signq->q_threshold,
                 &engine->signq->q_lock, 0);
+            idle_ns = (time_monotonic_ns() - start_ns);
             rrset = (rrset_type*) fifoq_pop(engine->signq, &superior);
         }
         lock_basic_unlock(&engine->signq->q_lock);
+        if (idle_ns) {
+            /* the counters are read by the metrics */
+            lock_basic_lock(&worker->worker_lock);
+            worker->idle_time += idle_ns;
+            lock_basic_unlock(&worker->worker_lock);
+        }
         /* do some work */
         if (rrset) {
             ods_log_assert(superior);
-            if (!ctx) {
-                ods_log_debug("[%s[%i]] create hsm context",
-                    worker2str(worker->type), worker->thread_num);
-                ctx = hsm_create_context();
-            }
+            ctx = lhsm_pool_acquire(engine->hsmpool, slot);
             if (!ctx) {
                 ods_log_crit("[%s[%i]] error creating libhsm context",
                     worker2str(worker->type), worker->thread_num);
@@ -718,7 +972,30 @@ worker_drudge(worker_type* worker)
                 ods_log_assert(zone->apex);
                 ods_log_assert(zone->signconf);
                 worker->clock_in = time(NULL);
-                status = rrset_sign(ctx, rrset, superior->clock_in);
+                start_ns = time_monotonic_ns();
+                status = rrset_sign(ctx, rrset, superior->clock_in,
+                    (size_t) worker->thread_num);
+                for (retry = 0; status == ODS_STATUS_HSM_ERR &&
+                    retry < LHSM_SIGN_RETRIES; retry++) {
+                    /**
+                     * Retire the sessions of this drudger only and retry.
+                     * Signatures made before the error are recycled.
+                     */
+                    ods_log_warning("[%s[%i]] hsm error, retry %i with new "
+                        "sessions", worker2str(worker->type),
+                        worker->thread_num, retry+1);
+                    ctx = lhsm_pool_renew(engine->hsmpool, slot);
+                    if (!ctx) {
+                        break;
+                    }
+                    status = rrset_sign(ctx, rrset, superior->clock_in,
+                        (size_t) worker->thread_num);
+                }
+                lhsm_pool_release(engine->hsmpool, slot);
+                ctx = NULL;
+                lock_basic_lock(&worker->worker_lock);
+                worker->busy_time += (time_monotonic_ns() - start_ns);
+                lock_basic_unlock(&worker->worker_lock);
                 lock_basic_lock(&superior->worker_lock);
                 if (status == ODS_STATUS_OK) {
                     superior->jobs_completed++;
@@ -732,6 +1009,12 @@ worker_drudge(worker_type* worker)
                     "done", worker2str(worker->type), worker->thread_num,
                     superior->thread_num);
                 worker_wakeup(superior);
+            } else if (superior->throttled &&
+                worker_outstanding(superior) <= superior->jobs_cap / 2) {
+                ods_log_deeebug("[%s[%i]] wake up superior[%u], below its "
+                    "share of the sign queue", worker2str(worker->type),
+                    worker->thread_num, superior->thread_num);
+                worker_wakeup(superior);
             }
             superior = NULL;
             rrset = NULL;
@@ -744,10 +1027,6 @@ worker_drudge(worker_type* worker)
             worker2str(worker->type), worker->thread_num, superior->thread_num);
          worker_wakeup(superior);
     }
-    /* cleanup open HSM sessions */
-    if (ctx) {
-        hsm_destroy_context(ctx);
-    }
     return;
 }
 
@@ -37,6 +37,7 @@
 #include "scheduler/task.h"
 #include "shared/allocator.h"
 #include "shared/locks.h"
+#include "signer/domain.h"
 
 #include <time.h>
 
@@ -60,10 +61,15 @@ struct worker_struct {
     size_t jobs_appointed;
     size_t jobs_completed;
     size_t jobs_failed;
+    size_t jobs_cap; /* max jobs in the sign queue at once, 0 if no cap */
+    uint64_t busy_time; /* ns, drudgers only */
+    uint64_t idle_time;
     cond_basic_type worker_alarm;
     lock_basic_type worker_lock;
     unsigned sleeping : 1;
     unsigned waiting : 1;
+    unsigned throttled : 1; /* waiting for its jobs to drop below the cap */
+    unsigned pipelined : 1; /* last zone read was signed while reading */
     unsigned need_to_exit : 1;
 };
 
@@ -85,6 +91,23 @@ worker_type* worker_create(allocator_type* allocator, int num,
  */
 void worker_start(worker_type* worker);
 
+/**
+ * Queue a completed domain for signing while the zone is still being read.
+ * \param[in] worker worker that is reading the zone
+ * \param[in] domain domain
+ *
+ */
+void worker_pipeline_domain(worker_type* worker, domain_type* domain);
+
+/**
+ * Wait until the domains queued while reading the zone have been signed.
+ * \param[in] worker worker that is reading the zone
+ * \param[in] complete if false, pipelining stopped before the end of the
+ *            zone and the sign task has to count all signatures itself
+ *
+ */
+void worker_pipeline_drain(worker_type* worker, int complete);
+
 /**
  * Put worker to sleep.
  * \param[in] worker put this worker to sleep
@@ -72,6 +72,8 @@ xfrhandler_create(allocator_type* allocator)
     xfrh->udp_waiting_first = NULL;
     xfrh->udp_waiting_last = NULL;
     xfrh->udp_use_num = 0;
+    xfrh->xfr_count = 0;
+    xfrh->xfr_coalesced = 0;
     xfrh->start_time = 0;
     xfrh->current_time = 0;
     xfrh->got_time = 0;
@@ -81,6 +83,7 @@ xfrhandler_create(allocator_type* allocator)
     xfrh->notify_waiting_first = NULL;
     xfrh->notify_waiting_last = NULL;
     xfrh->notify_udp_num = 0;
+    memset(xfrh->notify_ids, 0, sizeof(xfrh->notify_ids));
     /* setup */
     xfrh->netio = netio_create(allocator);
     if (!xfrh->netio) {
@@ -108,6 +111,13 @@ xfrhandler_create(allocator_type* allocator)
     xfrh->dnshandler.timeout = 0;
     xfrh->dnshandler.event_types = NETIO_EVENT_READ;
     xfrh->dnshandler.event_handler = xfrhandler_handle_dns;
+    /* notifies share one socket per address family, opened on first use */
+    xfrh->notify_udp.fd = -1;
+    xfrh->notify_udp.user_data = (void*) xfrh;
+    xfrh->notify_udp.timeout = 0;
+    xfrh->notify_udp.event_types = NETIO_EVENT_READ;
+    xfrh->notify_udp.event_handler = notify_handle_udp;
+    xfrh->notify_udp6 = xfrh->notify_udp;
     return xfrh;
 }
 
@@ -126,6 +136,8 @@ xfrhandler_start(xfrhandler_type* xfrhandler)
     xfrhandler->start_time = time_now();
     /* handlers */
     netio_add_handler(xfrhandler->netio, &xfrhandler->dnshandler);
+    netio_add_handler(xfrhandler->netio, &xfrhandler->notify_udp);
+    netio_add_handler(xfrhandler->netio, &xfrhandler->notify_udp6);
     /* service */
     while (xfrhandler->need_to_exit == 0) {
         /* dispatch may block for a longer period, so current is gone */
@@ -220,6 +232,12 @@ xfrhandler_cleanup(xfrhandler_type* xfrhandler)
         return;
     }
     allocator = xfrhandler->allocator;
+    if (xfrhandler->notify_udp.fd != -1) {
+        close(xfrhandler->notify_udp.fd);
+    }
+    if (xfrhandler->notify_udp6.fd != -1) {
+        close(xfrhandler->notify_udp6.fd);
+    }
     netio_cleanup(xfrhandler->netio);
     buffer_cleanup(xfrhandler->packet, allocator);
     tcp_set_cleanup(xfrhandler->tcp_set, allocator);
@@ -63,9 +63,14 @@ struct xfrhandler_struct {
     xfrd_type* udp_waiting_first;
     xfrd_type* udp_waiting_last;
     size_t udp_use_num;
+    uint64_t xfr_count; /* transfers committed to disk */
+    uint64_t xfr_coalesced; /* of which read with an earlier transfer */
     notify_type* notify_waiting_first;
     notify_type* notify_waiting_last;
+    notify_type* notify_ids[NOTIFY_ID_HASH];
     int notify_udp_num;
+    netio_handler_type notify_udp;
+    netio_handler_type notify_udp6;
     netio_handler_type dnshandler;
     unsigned got_time : 1;
     unsigned need_to_exit : 1;
@@ -349,6 +349,20 @@ parse_addns_allow_notify(allocator_type* allocator, const char* filename,
 }
 
 
+/**
+ * Parse <AllowUpdate/>.
+ *
+ */
+acl_type*
+parse_addns_allow_update(allocator_type* allocator, const char* filename,
+    tsig_type* tsig)
+{
+    return parse_addns_acl(allocator, filename, tsig,
+        "//Adapter/DNS/Inbound/AllowUpdate/Peer"
+        );
+}
+
+
 /**
  * Parse <ProvideTransfer/>.
  *
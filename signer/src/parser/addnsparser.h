@@ -62,6 +62,17 @@ acl_type* parse_addns_request_xfr(allocator_type* allocator,
 acl_type* parse_addns_allow_notify(allocator_type* allocator,
     const char* filename, tsig_type* tsig);
 
+/**
+ * Parse <AllowUpdate/>.
+ * \param[in] allocator memory allocator
+ * \param[in] filename filename
+ * \param[in] tsig list of TSIGs
+ * \return acl_type* ACL
+ *
+ */
+acl_type* parse_addns_allow_update(allocator_type* allocator,
+    const char* filename, tsig_type* tsig);
+
 /**
  * Parse <ProvideTransfer/>.
  * \param[in] allocator memory allocator
@@ -36,6 +36,7 @@
 #include "parser/confparser.h"
 #include "parser/zonelistparser.h"
 #include "shared/allocator.h"
+#include "shared/locks.h"
 #include "shared/log.h"
 #include "shared/status.h"
 #include "wire/acl.h"
@@ -49,39 +50,60 @@
 static const char* parser_str = "parser";
 
 
+time_t
+parse_conf_xfr_coalesce(const char* cfgfile)
+{
+    time_t window = ODS_SE_XFR_COALESCE;
+    duration_type* duration = NULL;
+    const char* str = parse_conf_string(cfgfile,
+        "//Configuration/Signer/TransferCoalesce",
+        0);
+    if (str) {
+        duration = duration_create_from_string(str);
+        if (duration) {
+            window = duration2time(duration);
+            duration_cleanup(duration);
+        }
+        free((void*)str);
+    }
+    if (window < 0) {
+        window = ODS_SE_XFR_COALESCE;
+    }
+    return window;
+}
+
+
 /**
- * Parse elements from the configuration file.
+ * Compiled RelaxNG schemas, one per rng file. The schemas are read-only
+ * once compiled and are shared by all validation contexts.
  *
  */
-ods_status
-parse_file_check(const char* cfgfile, const char* rngfile)
+#define PARSE_RNG_MAX 8
+static struct {
+    char* rngfile;
+    xmlRelaxNGPtr schema;
+} parse_rng_cache[PARSE_RNG_MAX];
+static lock_basic_type parse_rng_lock;
+static int parse_rng_inited = 0;
+
+
+/**
+ * Compile rng file.
+ *
+ */
+static xmlRelaxNGPtr
+parse_rng_compile(const char* rngfile)
 {
-    xmlDocPtr doc = NULL;
     xmlDocPtr rngdoc = NULL;
     xmlRelaxNGParserCtxtPtr rngpctx = NULL;
-    xmlRelaxNGValidCtxtPtr rngctx = NULL;
     xmlRelaxNGPtr schema = NULL;
-    int status = 0;
 
-    if (!cfgfile || !rngfile) {
-        return ODS_STATUS_ASSERT_ERR;
-    }
-    ods_log_debug("[%s] check cfgfile %s with rngfile %s", parser_str,
-        cfgfile, rngfile);
-    /* Load XML document */
-    doc = xmlParseFile(cfgfile);
-    if (doc == NULL) {
-        ods_log_error("[%s] unable to parse file: failed to load cfgfile %s",
-            parser_str, cfgfile);
-        return ODS_STATUS_XML_ERR;
-    }
     /* Load rng document */
     rngdoc = xmlParseFile(rngfile);
     if (rngdoc == NULL) {
         ods_log_error("[%s] unable to parse file: failed to load rngfile %s",
             parser_str, rngfile);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_XML_ERR;
+        return NULL;
     }
     /* Create an XML RelaxNGs parser context for the relax-ng document. */
     rngpctx = xmlRelaxNGNewDocParserCtxt(rngdoc);
@@ -89,8 +111,7 @@ parse_file_check(const char* cfgfile, const char* rngfile)
         ods_log_error("[%s] unable to parse file: "
            "xmlRelaxNGNewDocParserCtxt() failed", parser_str);
         xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_XML_ERR;
+        return NULL;
     }
     /* Parse a schema definition resource and
      * build an internal XML schema structure.
@@ -99,9 +120,109 @@ parse_file_check(const char* cfgfile, const char* rngfile)
     if (schema == NULL) {
         ods_log_error("[%s] unable to parse file: xmlRelaxNGParse() failed",
             parser_str);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
+    }
+    xmlRelaxNGFreeParserCtxt(rngpctx);
+    xmlFreeDoc(rngdoc);
+    return schema;
+}
+
+
+/**
+ * Get compiled rng file, compile it if it is not cached yet.
+ *
+ */
+static xmlRelaxNGPtr
+parse_rng_lookup(const char* rngfile, int* cached)
+{
+    xmlRelaxNGPtr schema = NULL;
+    int i = 0;
+
+    *cached = 0;
+    if (!parse_rng_inited) {
+        return parse_rng_compile(rngfile);
+    }
+    lock_basic_lock(&parse_rng_lock);
+    for (i = 0; i < PARSE_RNG_MAX && parse_rng_cache[i].rngfile; i++) {
+        if (strcmp(parse_rng_cache[i].rngfile, rngfile) == 0) {
+            schema = parse_rng_cache[i].schema;
+            *cached = 1;
+            lock_basic_unlock(&parse_rng_lock);
+            return schema;
+        }
+    }
+    schema = parse_rng_compile(rngfile);
+    if (schema && i < PARSE_RNG_MAX) {
+        parse_rng_cache[i].rngfile = strdup(rngfile);
+        if (parse_rng_cache[i].rngfile) {
+            parse_rng_cache[i].schema = schema;
+            *cached = 1;
+            ods_log_debug("[%s] compiled rngfile %s", parser_str, rngfile);
+        }
+    }
+    lock_basic_unlock(&parse_rng_lock);
+    return schema;
+}
+
+
+/**
+ * Initialize the compiled rng cache.
+ *
+ */
+void
+parse_rng_init(void)
+{
+    if (parse_rng_inited) {
+        return;
+    }
+    memset(parse_rng_cache, 0, sizeof(parse_rng_cache));
+    lock_basic_init(&parse_rng_lock);
+    parse_rng_inited = 1;
+    return;
+}
+
+
+/**
+ * Clean up the compiled rng cache.
+ *
+ */
+void
+parse_rng_cleanup(void)
+{
+    int i = 0;
+    if (!parse_rng_inited) {
+        return;
+    }
+    for (i = 0; i < PARSE_RNG_MAX; i++) {
+        if (parse_rng_cache[i].schema) {
+            xmlRelaxNGFree(parse_rng_cache[i].schema);
+        }
+        free((void*) parse_rng_cache[i].rngfile);
+        parse_rng_cache[i].rngfile = NULL;
+        parse_rng_cache[i].schema = NULL;
+    }
+    lock_basic_destroy(&parse_rng_lock);
+    parse_rng_inited = 0;
+    return;
+}
+
+
+/**
+ * Check a parsed document with rng file.
+ *
+ */
+ods_status
+parse_doc_check(xmlDocPtr doc, const char* rngfile)
+{
+    xmlRelaxNGValidCtxtPtr rngctx = NULL;
+    xmlRelaxNGPtr schema = NULL;
+    ods_status status = ODS_STATUS_OK;
+    int cached = 0;
+
+    if (!doc || !rngfile) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    schema = parse_rng_lookup(rngfile, &cached);
+    if (schema == NULL) {
         return ODS_STATUS_PARSE_ERR;
     }
     /* Create an XML RelaxNGs validation context. */
@@ -109,30 +230,48 @@ parse_file_check(const char* cfgfile, const char* rngfile)
     if (rngctx == NULL) {
         ods_log_error("[%s] unable to parse file: xmlRelaxNGNewValidCtxt() "
             "failed", parser_str);
-        xmlRelaxNGFree(schema);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_RNG_ERR;
-    }
-    /* Validate a document tree in memory. */
-    status = xmlRelaxNGValidateDoc(rngctx,doc);
-    if (status != 0) {
+        status = ODS_STATUS_RNG_ERR;
+    } else if (xmlRelaxNGValidateDoc(rngctx, doc) != 0) {
+        /* Validate a document tree in memory. */
         ods_log_error("[%s] unable to parse file: xmlRelaxNGValidateDoc() "
             "failed", parser_str);
+        status = ODS_STATUS_RNG_ERR;
+    }
+    if (rngctx) {
         xmlRelaxNGFreeValidCtxt(rngctx);
+    }
+    if (!cached) {
         xmlRelaxNGFree(schema);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_RNG_ERR;
     }
-    xmlRelaxNGFreeValidCtxt(rngctx);
-    xmlRelaxNGFree(schema);
-    xmlRelaxNGFreeParserCtxt(rngpctx);
-    xmlFreeDoc(rngdoc);
+    return status;
+}
+
+
+/**
+ * Parse elements from the configuration file.
+ *
+ */
+ods_status
+parse_file_check(const char* cfgfile, const char* rngfile)
+{
+    xmlDocPtr doc = NULL;
+    ods_status status = ODS_STATUS_OK;
+
+    if (!cfgfile || !rngfile) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    ods_log_debug("[%s] check cfgfile %s with rngfile %s", parser_str,
+        cfgfile, rngfile);
+    /* Load XML document */
+    doc = xmlParseFile(cfgfile);
+    if (doc == NULL) {
+        ods_log_error("[%s] unable to parse file: failed to load cfgfile %s",
+            parser_str, cfgfile);
+        return ODS_STATUS_XML_ERR;
+    }
+    status = parse_doc_check(doc, rngfile);
     xmlFreeDoc(doc);
-    return ODS_STATUS_OK;
+    return status;
 }
 
 /* TODO: look how the enforcer reads this now */
@@ -331,34 +470,25 @@ parse_conf_listener(allocator_type* allocator, const char* cfgfile)
 
 
 /**
- * Parse elements from the configuration file.
+ * Parse elements from a parsed document.
  *
  */
 const char*
-parse_conf_string(const char* cfgfile, const char* expr, int required)
+parse_doc_string(xmlDocPtr doc, const char* expr, int required)
 {
-    xmlDocPtr doc = NULL;
     xmlXPathContextPtr xpathCtx = NULL;
     xmlXPathObjectPtr xpathObj = NULL;
     xmlChar *xexpr = NULL;
     const char* string = NULL;
 
     ods_log_assert(expr);
-    ods_log_assert(cfgfile);
+    ods_log_assert(doc);
 
-    /* Load XML document */
-    doc = xmlParseFile(cfgfile);
-    if (doc == NULL) {
-        ods_log_error("[%s] unable to parse file %s: xmlParseFile() failed",
-            parser_str, cfgfile);
-        return NULL;
-    }
     /* Create xpath evaluation context */
     xpathCtx = xmlXPathNewContext(doc);
     if (xpathCtx == NULL) {
-        ods_log_error("[%s] unable to parse file %s: xmlXPathNewContext() "
-            "failed", parser_str, cfgfile);
-        xmlFreeDoc(doc);
+        ods_log_error("[%s] unable to parse document: xmlXPathNewContext() "
+            "failed", parser_str);
         return NULL;
     }
     /* Get string */
@@ -367,28 +497,46 @@ parse_conf_string(const char* cfgfile, const char* expr, int required)
     if (xpathObj == NULL || xpathObj->nodesetval == NULL ||
         xpathObj->nodesetval->nodeNr <= 0) {
         if (required) {
-            ods_log_error("[%s] unable to evaluate expression %s in cfgile %s",
-                parser_str, (char*) xexpr, cfgfile);
+            ods_log_error("[%s] unable to evaluate expression %s in "
+                "document %s", parser_str, (char*) xexpr,
+                doc->URL?(const char*) doc->URL:"(null)");
         }
         xmlXPathFreeContext(xpathCtx);
         if (xpathObj) {
             xmlXPathFreeObject(xpathObj);
         }
-        xmlFreeDoc(doc);
         return NULL;
     }
-    if (xpathObj->nodesetval != NULL &&
-        xpathObj->nodesetval->nodeNr > 0) {
-        string = (const char*) xmlXPathCastToString(xpathObj);
-        xmlXPathFreeContext(xpathCtx);
-        xmlXPathFreeObject(xpathObj);
-        xmlFreeDoc(doc);
-        return string;
-    }
+    string = (const char*) xmlXPathCastToString(xpathObj);
     xmlXPathFreeContext(xpathCtx);
     xmlXPathFreeObject(xpathObj);
+    return string;
+}
+
+
+/**
+ * Parse elements from the configuration file.
+ *
+ */
+const char*
+parse_conf_string(const char* cfgfile, const char* expr, int required)
+{
+    xmlDocPtr doc = NULL;
+    const char* string = NULL;
+
+    ods_log_assert(expr);
+    ods_log_assert(cfgfile);
+
+    /* Load XML document */
+    doc = xmlParseFile(cfgfile);
+    if (doc == NULL) {
+        ods_log_error("[%s] unable to parse file %s: xmlParseFile() failed",
+            parser_str, cfgfile);
+        return NULL;
+    }
+    string = parse_doc_string(doc, expr, required);
     xmlFreeDoc(doc);
-    return NULL;
+    return string;
 }
 
 
@@ -577,6 +725,46 @@ parse_conf_chroot(allocator_type* allocator, const char* cfgfile)
 }
 
 
+const char*
+parse_conf_metrics_filename(allocator_type* allocator, const char* cfgfile)
+{
+    const char* dup = NULL;
+    const char* str = parse_conf_string(
+        cfgfile,
+        "//Configuration/Signer/MetricsFile",
+        0);
+
+    if (str) {
+        dup = allocator_strdup(allocator, str);
+        free((void*)str);
+    }
+    return dup;
+}
+
+
+time_t
+parse_conf_metrics_interval(const char* cfgfile)
+{
+    time_t interval = ODS_SE_METRICS_INTERVAL;
+    duration_type* duration = NULL;
+    const char* str = parse_conf_string(cfgfile,
+        "//Configuration/Signer/MetricsInterval",
+        0);
+    if (str) {
+        duration = duration_create_from_string(str);
+        if (duration) {
+            interval = duration2time(duration);
+            duration_cleanup(duration);
+        }
+        free((void*)str);
+    }
+    if (interval <= 0) {
+        interval = ODS_SE_METRICS_INTERVAL;
+    }
+    return interval;
+}
+
+
 /**
  * Parse elements from the configuration file.
  *
@@ -611,6 +799,34 @@ parse_conf_verbosity(const char* cfgfile)
 }
 
 
+int
+parse_conf_async_logging(const char* cfgfile)
+{
+    const char* str = parse_conf_string(cfgfile,
+        "//Configuration/Signer/AsyncLogging",
+        0);
+    if (str) {
+        free((void*)str);
+        return 1;
+    }
+    return 0;
+}
+
+
+int
+parse_conf_deadline_scheduling(const char* cfgfile)
+{
+    const char* str = parse_conf_string(cfgfile,
+        "//Configuration/Signer/DeadlineScheduling",
+        0);
+    if (str) {
+        free((void*)str);
+        return 1;
+    }
+    return 0;
+}
+
+
 int
 parse_conf_worker_threads(const char* cfgfile)
 {
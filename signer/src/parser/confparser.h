@@ -37,11 +37,36 @@
 #include "config.h"
 #include "wire/listener.h"
 #include "shared/allocator.h"
+#include "shared/duration.h"
 #include "shared/hsm.h"
 #include "shared/status.h"
 
+#include <libxml/tree.h>
+
 #define ADMAX 6 /* Maximum number of adapters that can be initialized */
 
+/**
+ * Initialize the compiled rng cache. Until this is called, every check
+ * compiles its rng file anew.
+ *
+ */
+void parse_rng_init(void);
+
+/**
+ * Clean up the compiled rng cache.
+ *
+ */
+void parse_rng_cleanup(void);
+
+/**
+ * Check a parsed document with rng file.
+ * \param[in] doc the document
+ * \param[in] rngfile the rng file name
+ * \return ods_status status
+ *
+ */
+ods_status parse_doc_check(xmlDocPtr doc, const char* rngfile);
+
 /**
  * Check config file with rng file.
  * \param[in] cfgfile the configuration file name
@@ -62,6 +87,16 @@ ods_status parse_file_check(const char* cfgfile, const char* rngfile);
 const char* parse_conf_string(const char* cfgfile, const char* expr,
     int required);
 
+/**
+ * Parse elements from a parsed document.
+ * \param[in] doc the document
+ * \param[in] expr xml expression
+ * \param[in] required if the element is required
+ * \return const char* string value
+ *
+ */
+const char* parse_doc_string(xmlDocPtr doc, const char* expr, int required);
+
 /**
  * Parse the repository list.
  * \param[in] cfgfile the configuration file name
@@ -109,6 +144,17 @@ const char* parse_conf_group(allocator_type* allocator,
     const char* cfgfile);
 const char* parse_conf_chroot(allocator_type* allocator,
     const char* cfgfile);
+const char* parse_conf_metrics_filename(allocator_type* allocator,
+    const char* cfgfile);
+
+/**
+ * Parse elements from the configuration file.
+ * \param[in] cfgfile the configuration file name
+ * \return time_t number of seconds
+ *
+ */
+time_t parse_conf_metrics_interval(const char* cfgfile);
+time_t parse_conf_xfr_coalesce(const char* cfgfile);
 
 /**
  * Parse elements from the configuration file.
@@ -122,6 +168,8 @@ int parse_conf_use_syslog(const char* cfgfile);
 int parse_conf_verbosity(const char* cfgfile);
 
 /** Signer specific */
+int parse_conf_async_logging(const char* cfgfile);
+int parse_conf_deadline_scheduling(const char* cfgfile);
 int parse_conf_worker_threads(const char* cfgfile);
 int parse_conf_signer_threads(const char* cfgfile);
 
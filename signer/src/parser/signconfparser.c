@@ -50,9 +50,8 @@ static const char* parser_str = "parser";
  *
  */
 keylist_type*
-parse_sc_keys(void* sc, const char* cfgfile)
+parse_sc_keys(void* sc, xmlDocPtr doc)
 {
-    xmlDocPtr doc = NULL;
     xmlXPathContextPtr xpathCtx = NULL;
     xmlXPathObjectPtr xpathObj = NULL;
     xmlNode* curNode = NULL;
@@ -64,20 +63,12 @@ parse_sc_keys(void* sc, const char* cfgfile)
     char* algorithm = NULL;
     int ksk, zsk, publish, i;
 
-    if (!cfgfile || !sc) {
-        return NULL;
-    }
-    /* Load XML document */
-    doc = xmlParseFile(cfgfile);
-    if (doc == NULL) {
-        ods_log_error("[%s] unable to parse <Keys>: "
-            "xmlParseFile() failed", parser_str);
+    if (!doc || !sc) {
         return NULL;
     }
     /* Create xpath evaluation context */
     xpathCtx = xmlXPathNewContext(doc);
     if(xpathCtx == NULL) {
-        xmlFreeDoc(doc);
         ods_log_error("[%s] unable to parse <Keys>: "
             "xmlXPathNewContext() failed", parser_str);
         return NULL;
@@ -87,7 +78,6 @@ parse_sc_keys(void* sc, const char* cfgfile)
     xpathObj = xmlXPathEvalExpression(xexpr, xpathCtx);
     if(xpathObj == NULL) {
         xmlXPathFreeContext(xpathCtx);
-        xmlFreeDoc(doc);
         ods_log_error("[%s] unable to parse <Keys>: "
             "xmlXPathEvalExpression() failed", parser_str);
         return NULL;
@@ -150,9 +140,6 @@ parse_sc_keys(void* sc, const char* cfgfile)
     }
     xmlXPathFreeObject(xpathObj);
     xmlXPathFreeContext(xpathCtx);
-    if (doc) {
-        xmlFreeDoc(doc);
-    }
     return kl;
 }
 
@@ -162,10 +149,10 @@ parse_sc_keys(void* sc, const char* cfgfile)
  *
  */
 duration_type*
-parse_sc_sig_resign_interval(const char* cfgfile)
+parse_sc_sig_resign_interval(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Signatures/Resign",
         1);
     if (!str) {
@@ -178,10 +165,10 @@ parse_sc_sig_resign_interval(const char* cfgfile)
 
 
 duration_type*
-parse_sc_sig_refresh_interval(const char* cfgfile)
+parse_sc_sig_refresh_interval(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Signatures/Refresh",
         1);
     if (!str) {
@@ -194,10 +181,10 @@ parse_sc_sig_refresh_interval(const char* cfgfile)
 
 
 duration_type*
-parse_sc_sig_validity_default(const char* cfgfile)
+parse_sc_sig_validity_default(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Signatures/Validity/Default",
         1);
     if (!str) {
@@ -210,10 +197,10 @@ parse_sc_sig_validity_default(const char* cfgfile)
 
 
 duration_type*
-parse_sc_sig_validity_denial(const char* cfgfile)
+parse_sc_sig_validity_denial(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Signatures/Validity/Denial",
         1);
     if (!str) {
@@ -226,10 +213,10 @@ parse_sc_sig_validity_denial(const char* cfgfile)
 
 
 duration_type*
-parse_sc_sig_jitter(const char* cfgfile)
+parse_sc_sig_jitter(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Signatures/Jitter",
         1);
     if (!str) {
@@ -242,10 +229,10 @@ parse_sc_sig_jitter(const char* cfgfile)
 
 
 duration_type*
-parse_sc_sig_inception_offset(const char* cfgfile)
+parse_sc_sig_inception_offset(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Signatures/InceptionOffset",
         1);
     if (!str) {
@@ -258,10 +245,10 @@ parse_sc_sig_inception_offset(const char* cfgfile)
 
 
 duration_type*
-parse_sc_dnskey_ttl(const char* cfgfile)
+parse_sc_dnskey_ttl(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Keys/TTL",
         1);
     if (!str) {
@@ -274,10 +261,10 @@ parse_sc_dnskey_ttl(const char* cfgfile)
 
 
 duration_type*
-parse_sc_nsec3param_ttl(const char* cfgfile)
+parse_sc_nsec3param_ttl(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Denial/NSEC3/TTL",
         0);
     if (!str) {
@@ -290,10 +277,10 @@ parse_sc_nsec3param_ttl(const char* cfgfile)
 
 
 duration_type*
-parse_sc_soa_ttl(const char* cfgfile)
+parse_sc_soa_ttl(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/SOA/TTL",
         1);
     if (!str) {
@@ -306,10 +293,10 @@ parse_sc_soa_ttl(const char* cfgfile)
 
 
 duration_type*
-parse_sc_soa_min(const char* cfgfile)
+parse_sc_soa_min(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/SOA/Minimum",
         1);
     if (!str) {
@@ -322,10 +309,10 @@ parse_sc_soa_min(const char* cfgfile)
 
 
 duration_type*
-parse_sc_max_zone_ttl(const char* cfgfile)
+parse_sc_max_zone_ttl(xmlDocPtr doc)
 {
     duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Signatures/MaxZoneTTL",
         1);
     if (!str) {
@@ -342,16 +329,16 @@ parse_sc_max_zone_ttl(const char* cfgfile)
  *
  */
 ldns_rr_type
-parse_sc_nsec_type(const char* cfgfile)
+parse_sc_nsec_type(xmlDocPtr doc)
 {
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Denial/NSEC3",
         0);
     if (str) {
         free((void*)str);
         return LDNS_RR_TYPE_NSEC3;
     }
-    str = parse_conf_string(cfgfile,
+    str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Denial/NSEC",
         0);
     if (str) {
@@ -367,10 +354,10 @@ parse_sc_nsec_type(const char* cfgfile)
  *
  */
 uint32_t
-parse_sc_nsec3_algorithm(const char* cfgfile)
+parse_sc_nsec3_algorithm(xmlDocPtr doc)
 {
     int ret = 0;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Algorithm",
         1);
     if (str) {
@@ -384,10 +371,10 @@ parse_sc_nsec3_algorithm(const char* cfgfile)
 
 
 uint32_t
-parse_sc_nsec3_iterations(const char* cfgfile)
+parse_sc_nsec3_iterations(xmlDocPtr doc)
 {
     int ret = 0;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Iterations",
         1);
     if (str) {
@@ -401,10 +388,10 @@ parse_sc_nsec3_iterations(const char* cfgfile)
 
 
 int
-parse_sc_nsec3_optout(const char* cfgfile)
+parse_sc_nsec3_optout(xmlDocPtr doc)
 {
     int ret = 0;
-    const char* str = parse_conf_string(cfgfile,
+    const char* str = parse_doc_string(doc,
         "//SignerConfiguration/Zone/Denial/NSEC3/OptOut",
         0);
     if (str) {
@@ -420,11 +407,11 @@ parse_sc_nsec3_optout(const char* cfgfile)
  *
  */
 const char*
-parse_sc_soa_serial(allocator_type* allocator, const char* cfgfile)
+parse_sc_soa_serial(allocator_type* allocator, xmlDocPtr doc)
 {
     const char* dup = NULL;
-    const char* str = parse_conf_string(
-        cfgfile,
+    const char* str = parse_doc_string(
+        doc,
         "//SignerConfiguration/Zone/SOA/Serial",
         1);
 
@@ -437,11 +424,11 @@ parse_sc_soa_serial(allocator_type* allocator, const char* cfgfile)
 
 
 const char*
-parse_sc_nsec3_salt(allocator_type* allocator, const char* cfgfile)
+parse_sc_nsec3_salt(allocator_type* allocator, xmlDocPtr doc)
 {
     const char* dup = NULL;
-    const char* str = parse_conf_string(
-        cfgfile,
+    const char* str = parse_doc_string(
+        doc,
         "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Salt",
         1);
 
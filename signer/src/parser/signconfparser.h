@@ -45,64 +45,62 @@
 /**
  * Parse keys from the signer configuration file.
  * \param[in] sc signer configuration reference
- * \param[in] cfgfile the configuration file name.
+ * \param[in] doc the parsed signer configuration
  * \return keylist_type* key list
  *
  */
-keylist_type* parse_sc_keys(void* sc, const char* cfgfile);
+keylist_type* parse_sc_keys(void* sc, xmlDocPtr doc);
 
 /**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
+ * Parse elements from the signer configuration.
+ * \param[in] doc the parsed signer configuration
  * \return duration_type* duration
  *
  */
-duration_type* parse_sc_sig_resign_interval(const char* cfgfile);
-duration_type* parse_sc_sig_refresh_interval(const char* cfgfile);
-duration_type* parse_sc_sig_validity_default(const char* cfgfile);
-duration_type* parse_sc_sig_validity_denial(const char* cfgfile);
-duration_type* parse_sc_sig_jitter(const char* cfgfile);
-duration_type* parse_sc_sig_inception_offset(const char* cfgfile);
-duration_type* parse_sc_dnskey_ttl(const char* cfgfile);
-duration_type* parse_sc_nsec3param_ttl(const char* cfgfile);
-duration_type* parse_sc_soa_ttl(const char* cfgfile);
-duration_type* parse_sc_soa_min(const char* cfgfile);
-duration_type* parse_sc_max_zone_ttl(const char* cfgfile);
+duration_type* parse_sc_sig_resign_interval(xmlDocPtr doc);
+duration_type* parse_sc_sig_refresh_interval(xmlDocPtr doc);
+duration_type* parse_sc_sig_validity_default(xmlDocPtr doc);
+duration_type* parse_sc_sig_validity_denial(xmlDocPtr doc);
+duration_type* parse_sc_sig_jitter(xmlDocPtr doc);
+duration_type* parse_sc_sig_inception_offset(xmlDocPtr doc);
+duration_type* parse_sc_dnskey_ttl(xmlDocPtr doc);
+duration_type* parse_sc_nsec3param_ttl(xmlDocPtr doc);
+duration_type* parse_sc_soa_ttl(xmlDocPtr doc);
+duration_type* parse_sc_soa_min(xmlDocPtr doc);
+duration_type* parse_sc_max_zone_ttl(xmlDocPtr doc);
 
 /**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
+ * Parse elements from the signer configuration.
+ * \param[in] doc the parsed signer configuration
  * \return ldns_rr_type rr type
  *
  */
-ldns_rr_type parse_sc_nsec_type(const char* cfgfile);
+ldns_rr_type parse_sc_nsec_type(xmlDocPtr doc);
 
 /**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
+ * Parse elements from the signer configuration.
+ * \param[in] doc the parsed signer configuration
  * \return uint32_t integer
  *
  */
-uint32_t parse_sc_nsec3_algorithm(const char* cfgfile);
-uint32_t parse_sc_nsec3_iterations(const char* cfgfile);
+uint32_t parse_sc_nsec3_algorithm(xmlDocPtr doc);
+uint32_t parse_sc_nsec3_iterations(xmlDocPtr doc);
 
 /**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
+ * Parse elements from the signer configuration.
+ * \param[in] doc the parsed signer configuration
  * \return int integer
  *
  */
-int parse_sc_nsec3_optout(const char* cfgfile);
+int parse_sc_nsec3_optout(xmlDocPtr doc);
 
 /**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
+ * Parse elements from the signer configuration.
+ * \param[in] doc the parsed signer configuration
  * \return const char* string
  *
  */
-const char* parse_sc_soa_serial(allocator_type* allocator,
-    const char* cfgfile);
-const char* parse_sc_nsec3_salt(allocator_type* allocator,
-    const char* cfgfile);
+const char* parse_sc_soa_serial(allocator_type* allocator, xmlDocPtr doc);
+const char* parse_sc_nsec3_salt(allocator_type* allocator, xmlDocPtr doc);
 
 #endif /* PARSER_SIGNCONFPARSER_H */
@@ -41,8 +41,11 @@
 
 #include <libxml/xpath.h>
 #include <libxml/xmlreader.h>
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static const char* parser_str = "parser";
 
@@ -155,8 +158,8 @@ parse_zonelist_adapter(xmlXPathContextPtr xpathCtx, xmlChar* expr,
 static void
 parse_zonelist_adapters(xmlXPathContextPtr xpathCtx, zone_type* zone)
 {
-    xmlChar* i_expr = (xmlChar*) "//Zone/Adapters/Input";
-    xmlChar* o_expr = (xmlChar*) "//Zone/Adapters/Output";
+    xmlChar* i_expr = (xmlChar*) "Adapters/Input";
+    xmlChar* o_expr = (xmlChar*) "Adapters/Output";
 
     if (!xpathCtx || !zone) {
         return;
@@ -168,7 +171,10 @@ parse_zonelist_adapters(xmlXPathContextPtr xpathCtx, zone_type* zone)
 
 
 /**
- * Parse the zonelist file.
+ * Parse the zonelist file. The file is streamed: only the Zone element
+ * that is being read is expanded, expressions are evaluated relative to
+ * that element and the subtree is skipped afterwards, so memory and time
+ * stay linear in the number of zones.
  *
  */
 ods_status
@@ -182,9 +188,10 @@ parse_zonelist_zones(void* zlist, const char* zlfile)
     xmlTextReaderPtr reader = NULL;
     xmlDocPtr doc = NULL;
     xmlXPathContextPtr xpathCtx = NULL;
+    xmlNodePtr zone_node = NULL;
     xmlChar* name_expr = (unsigned char*) "name";
-    xmlChar* policy_expr = (unsigned char*) "//Zone/Policy";
-    xmlChar* signconf_expr = (unsigned char*) "//Zone/SignerConfiguration";
+    xmlChar* policy_expr = (unsigned char*) "Policy";
+    xmlChar* signconf_expr = (unsigned char*) "SignerConfiguration";
 
     if (!zlist || !zlfile) {
         return ODS_STATUS_ASSERT_ERR;
@@ -215,19 +222,22 @@ parse_zonelist_zones(void* zlist, const char* zlfile)
                 continue;
             }
             /* Expand this node to get the rest of the info */
-            xmlTextReaderExpand(reader);
-            doc = xmlTextReaderCurrentDoc(reader);
-            if (doc) {
+            zone_node = xmlTextReaderExpand(reader);
+            if (!doc) {
+                doc = xmlTextReaderCurrentDoc(reader);
+            }
+            if (doc && !xpathCtx) {
                 xpathCtx = xmlXPathNewContext(doc);
             }
-            if (doc == NULL || xpathCtx == NULL) {
+            if (zone_node == NULL || doc == NULL || xpathCtx == NULL) {
                 ods_log_alert("[%s] unable to read zone %s, skipping...",
                    parser_str, zone_name);
-                ret = xmlTextReaderRead(reader);
+                ret = xmlTextReaderNext(reader);
                 free((void*) zone_name);
                 free((void*) tag_name);
                 continue;
             }
+            xpathCtx->node = zone_node;
             /* That worked, now read out the contents... */
             new_zone = zone_create(zone_name, LDNS_RR_CLASS_IN);
             if (new_zone) {
@@ -256,8 +266,6 @@ parse_zonelist_zones(void* zlist, const char* zlfile)
                     zone_name);
                 error = 1;
             }
-            xmlXPathFreeContext(xpathCtx);
-            xpathCtx = NULL;
             free((void*) zone_name);
             if (error) {
                 free((void*) tag_name);
@@ -265,11 +273,18 @@ parse_zonelist_zones(void* zlist, const char* zlfile)
                 ret = 1;
                 break;
             }
-            ods_log_debug("[%s] zone %s added", parser_str, new_zone->name);
+            ods_log_deeebug("[%s] zone %s added", parser_str, new_zone->name);
+            /* done with this zone, skip its subtree */
+            free((void*) tag_name);
+            ret = xmlTextReaderNext(reader);
+            continue;
         }
         free((void*) tag_name);
         ret = xmlTextReaderRead(reader);
     }
+    if (xpathCtx) {
+        xmlXPathFreeContext(xpathCtx);
+    }
     /* no more zones */
     ods_log_debug("[%s] no more zones", parser_str);
     xmlFreeTextReader(reader);
@@ -283,3 +298,141 @@ parse_zonelist_zones(void* zlist, const char* zlfile)
     }
     return ODS_STATUS_OK;
 }
+
+
+/**
+ * Add the adapter element of a zone.
+ *
+ */
+static xmlNodePtr
+zlp_write_adapter(xmlNodePtr parent, const char* tag, adapter_type* adapter)
+{
+    xmlNodePtr node = NULL;
+    node = xmlNewChild(parent, NULL, (const xmlChar*) tag, NULL);
+    if (!node || !adapter || !adapter->configstr) {
+        return NULL;
+    }
+    if (adapter->type == ADAPTER_DNS) {
+        node = xmlNewTextChild(node, NULL, (const xmlChar*) "Adapter",
+            (const xmlChar*) adapter->configstr);
+        if (node) {
+            (void)xmlNewProp(node, (const xmlChar*) "type",
+                (const xmlChar*) "DNS");
+        }
+        return node;
+    }
+    return xmlNewTextChild(node, NULL, (const xmlChar*) "File",
+        (const xmlChar*) adapter->configstr);
+}
+
+
+/**
+ * Create the Zone element of a zone.
+ *
+ */
+static xmlNodePtr
+zlp_write_zone(zone_type* zone)
+{
+    xmlNodePtr node = NULL;
+    xmlNodePtr adapters = NULL;
+    node = xmlNewNode(NULL, (const xmlChar*) "Zone");
+    if (!node) {
+        return NULL;
+    }
+    adapters = xmlNewNode(NULL, (const xmlChar*) "Adapters");
+    if (!xmlNewProp(node, (const xmlChar*) "name",
+            (const xmlChar*) zone->name) ||
+        !xmlNewTextChild(node, NULL, (const xmlChar*) "Policy",
+            (const xmlChar*) zone->policy_name) ||
+        !xmlNewTextChild(node, NULL, (const xmlChar*) "SignerConfiguration",
+            (const xmlChar*) zone->signconf_filename) ||
+        !adapters || !xmlAddChild(node, adapters) ||
+        !zlp_write_adapter(adapters, "Input", zone->adinbound) ||
+        !zlp_write_adapter(adapters, "Output", zone->adoutbound)) {
+        if (adapters && !adapters->parent) {
+            xmlFreeNode(adapters);
+        }
+        xmlFreeNode(node);
+        return NULL;
+    }
+    return node;
+}
+
+
+/**
+ * Export the zone list.
+ *
+ */
+xmlDocPtr
+export_zonelist(void* zlist)
+{
+    zonelist_type* zl = (zonelist_type*) zlist;
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    zone_type* zone = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr root = NULL;
+    xmlNodePtr zone_node = NULL;
+
+    if (!zl || !zl->zones) {
+        return NULL;
+    }
+    doc = xmlNewDoc((const xmlChar*) "1.0");
+    root = doc ? xmlNewNode(NULL, (const xmlChar*) "ZoneList") : NULL;
+    if (!root) {
+        goto export_failed;
+    }
+    (void)xmlDocSetRootElement(doc, root);
+    node = ldns_rbtree_first(zl->zones);
+    while (node && node != LDNS_RBTREE_NULL) {
+        zone = (zone_type*) node->data;
+        node = ldns_rbtree_next(node);
+        if (zone->zl_status == ZONE_ZL_REMOVED) {
+            /* still in the change set, no longer in the zone list */
+            continue;
+        }
+        zone_node = zlp_write_zone(zone);
+        if (!zone_node) {
+            goto export_failed;
+        }
+        (void)xmlAddChild(root, zone_node);
+    }
+    return doc;
+
+export_failed:
+    ods_log_error("[%s] unable to export zonelist: out of memory",
+        parser_str);
+    if (doc) {
+        xmlFreeDoc(doc);
+    }
+    return NULL;
+}
+
+
+/**
+ * Write the zonelist file.
+ *
+ */
+ods_status
+write_zonelist_file(const char* zlfile, xmlDocPtr doc)
+{
+    char* tmpfile = NULL;
+    ods_status status = ODS_STATUS_OK;
+
+    if (!zlfile || !doc) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    /* replace the file in one go, readers never see half a zone list */
+    tmpfile = ods_build_path(zlfile, ".tmp", 0, 0);
+    if (!tmpfile || xmlSaveFormatFileEnc(tmpfile, doc, "UTF-8", 1) < 0) {
+        ods_log_error("[%s] unable to write zonelist file %s: write %s "
+            "failed", parser_str, zlfile, tmpfile?tmpfile:"(null)");
+        status = ODS_STATUS_FWRITE_ERR;
+    } else if (rename(tmpfile, zlfile) != 0) {
+        ods_log_error("[%s] unable to write zonelist file %s: rename() "
+            "failed (%s)", parser_str, zlfile, strerror(errno));
+        (void)unlink(tmpfile);
+        status = ODS_STATUS_FWRITE_ERR;
+    }
+    free((void*) tmpfile);
+    return status;
+}
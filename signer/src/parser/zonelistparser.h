@@ -41,6 +41,8 @@
 #include <libxml/xpath.h>
 #include <libxml/xmlreader.h>
 
+struct zone_struct;
+
 /**
  * Parse adapter.
  * \param[in] xpathCtx XPath Context Pointer
@@ -60,4 +62,22 @@ adapter_type* parse_zonelist_adapter(xmlXPathContextPtr xpathCtx,
  */
 ods_status parse_zonelist_zones(void* zlist, const char* zlfile);
 
+/**
+ * Export the zone list as a zonelist document. Zones that are marked for
+ * removal are left out. Caller must hold the zonelist lock.
+ * \param[in] zlist zone list
+ * \return xmlDocPtr document, NULL on failure
+ *
+ */
+xmlDocPtr export_zonelist(void* zlist);
+
+/**
+ * Write the zonelist file. The file is replaced in one go.
+ * \param[in] zlfile zonelist file name
+ * \param[in] doc zonelist document
+ * \return ods_status status
+ *
+ */
+ods_status write_zonelist_file(const char* zlfile, xmlDocPtr doc);
+
 #endif /* PARSER_ZONELISTPARSER_H */
@@ -63,10 +63,18 @@ schedule_create(allocator_type* allocator)
     schedule->allocator = allocator;
     schedule->loading = 0;
     schedule->flushcount = 0;
+    schedule->deadlines = 0;
     schedule->tasks = ldns_rbtree_create(task_compare);
-    if (!schedule->tasks) {
+    schedule->due = ldns_rbtree_create(task_compare_deadline);
+    if (!schedule->tasks || !schedule->due) {
         ods_log_error("[%s] unable to create schedule: ldns_rbtree_create() "
             "failed", schedule_str);
+        if (schedule->tasks) {
+            ldns_rbtree_free(schedule->tasks);
+        }
+        if (schedule->due) {
+            ldns_rbtree_free(schedule->due);
+        }
         allocator_deallocate(allocator, (void*) schedule);
         return NULL;
     }
@@ -89,6 +97,16 @@ schedule_flush(schedule_type* schedule, task_id override)
     if (!schedule || !schedule->tasks) {
         return;
     }
+    node = ldns_rbtree_first(schedule->due);
+    while (node && node != LDNS_RBTREE_NULL) {
+        task = (task_type*) node->data;
+        task->flush = 1;
+        schedule->flushcount++;
+        if (override != TASK_NONE) {
+            task->what = override;
+        }
+        node = ldns_rbtree_next(node);
+    }
     node = ldns_rbtree_first(schedule->tasks);
     while (node && node != LDNS_RBTREE_NULL) {
         task = (task_type*) node->data;
@@ -132,7 +150,8 @@ schedule_lookup_task(schedule_type* schedule, task_type* task)
         return NULL;
     }
     ods_log_assert(schedule->tasks);
-    node = ldns_rbtree_search(schedule->tasks, task);
+    node = ldns_rbtree_search(task->due ? schedule->due : schedule->tasks,
+        task);
     if (node && node != LDNS_RBTREE_NULL) {
         lookup = (task_type*) node->data;
     }
@@ -160,6 +179,7 @@ schedule_task(schedule_type* schedule, task_type* task, int log)
             task_who2str(task));
         return ODS_STATUS_ERR;
     }
+    task->due = 0;
     new_node = task2node(task);
     if (!new_node) {
         ods_log_error("[%s] unable to schedule task %s for zone %s: "
@@ -199,7 +219,8 @@ unschedule_task(schedule_type* schedule, task_type* task)
     }
     ods_log_debug("[%s] unschedule task %s for zone %s",
         schedule_str, task_what2str(task->what), task_who2str(task));
-    del_node = ldns_rbtree_delete(schedule->tasks, (const void*) task);
+    del_node = ldns_rbtree_delete(task->due ? schedule->due :
+        schedule->tasks, (const void*) task);
     if (del_node) {
         del_task = (task_type*) del_node->data;
         free((void*)del_node);
@@ -209,6 +230,7 @@ unschedule_task(schedule_type* schedule, task_type* task)
             task_who2str(task));
         return NULL;
     }
+    del_task->due = 0;
     if (del_task->flush) {
         del_task->flush = 0;
         schedule->flushcount--;
@@ -239,6 +261,41 @@ reschedule_task(schedule_type* schedule, task_type* task, task_id what,
 }
 
 
+/**
+ * Number of scheduled tasks.
+ *
+ */
+size_t
+schedule_count(schedule_type* schedule)
+{
+    if (!schedule || !schedule->tasks) {
+        return 0;
+    }
+    return schedule->tasks->count + schedule->due->count;
+}
+
+
+/**
+ * Find a task that is to be flushed.
+ *
+ */
+static task_type*
+schedule_find_flush(ldns_rbtree_t* tree)
+{
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    task_type* task = NULL;
+    node = ldns_rbtree_first(tree);
+    while (node && node != LDNS_RBTREE_NULL) {
+        task = (task_type*) node->data;
+        if (task->flush) {
+            return task;
+        }
+        node = ldns_rbtree_next(node);
+    }
+    return NULL;
+}
+
+
 /**
  * Get the first scheduled task.
  *
@@ -247,24 +304,18 @@ task_type*
 schedule_get_first_task(schedule_type* schedule)
 {
     ldns_rbnode_t* first_node = LDNS_RBTREE_NULL;
-    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
     task_type* pop = NULL;
     if (!schedule || !schedule->tasks) {
         return NULL;
     }
-    first_node = ldns_rbtree_first(schedule->tasks);
-    if (!first_node) {
-        return NULL;
-    }
     if (schedule->flushcount > 0) {
         /* find remaining to be flushed tasks */
-        node = first_node;
-        while (node && node != LDNS_RBTREE_NULL) {
-            pop = (task_type*) node->data;
-            if (pop->flush) {
-                return pop;
-            }
-            node = ldns_rbtree_next(node);
+        pop = schedule_find_flush(schedule->due);
+        if (!pop) {
+            pop = schedule_find_flush(schedule->tasks);
+        }
+        if (pop) {
+            return pop;
         }
         /* no more to be flushed tasks found */
         ods_log_warning("[%s] unable to get first scheduled task: could not "
@@ -273,12 +324,53 @@ schedule_get_first_task(schedule_type* schedule)
         ods_log_info("[%s] reset flush count to 0", schedule_str);
         schedule->flushcount = 0;
     }
-    /* no more tasks to be flushed, return first task in schedule */
+    /* no more tasks to be flushed, the most urgent due task comes first */
+    first_node = ldns_rbtree_first(schedule->due);
+    if (!first_node || first_node == LDNS_RBTREE_NULL) {
+        first_node = ldns_rbtree_first(schedule->tasks);
+    }
+    if (!first_node || first_node == LDNS_RBTREE_NULL) {
+        return NULL;
+    }
     pop = (task_type*) first_node->data;
     return pop;
 }
 
 
+/**
+ * Move the tasks that have become due to the due tasks, that are served
+ * earliest deadline first. Each task moves once, so this costs a tree
+ * operation per task and not a scan of all due tasks per pop.
+ *
+ */
+static void
+schedule_promote_due(schedule_type* schedule, time_t now)
+{
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    task_type* task = NULL;
+    while ((node = ldns_rbtree_first(schedule->tasks)) != NULL &&
+        node != LDNS_RBTREE_NULL) {
+        task = (task_type*) node->data;
+        if (task->when > now) {
+            break;
+        }
+        node = ldns_rbtree_delete(schedule->tasks, (const void*) task);
+        if (!node) {
+            break;
+        }
+        if (!ldns_rbtree_insert(schedule->due, node)) {
+            /* cannot happen, a task is in one tree only */
+            ods_log_error("[%s] unable to move task for zone %s to the due "
+                "tasks", schedule_str, task_who2str(task));
+            (void)ldns_rbtree_insert(schedule->tasks, node);
+            break;
+        }
+        task->due = 1;
+    }
+    return;
+}
+
+
 /**
  * Pop the first scheduled task.
  *
@@ -292,6 +384,9 @@ schedule_pop_task(schedule_type* schedule)
         return NULL;
     }
     now = time_now();
+    if (schedule->deadlines) {
+        schedule_promote_due(schedule, now);
+    }
     pop = schedule_get_first_task(schedule);
     if (pop && (pop->flush || pop->when <= now)) {
         if (pop->flush) {
@@ -300,6 +395,10 @@ schedule_pop_task(schedule_type* schedule)
         } else {
             ods_log_debug("[%s] pop task for zone %s", schedule_str,
                 task_who2str(pop));
+            if (pop->deadline && pop->deadline < now) {
+                ods_log_warning("[%s] zone %s is past its signature refresh "
+                    "deadline", schedule_str, task_who2str(pop));
+            }
         }
         return unschedule_task(schedule, pop);
     }
@@ -320,6 +419,12 @@ schedule_print(FILE* out, schedule_type* schedule)
     if (!out || !schedule || !schedule->tasks) {
         return;
     }
+    node = ldns_rbtree_first(schedule->due);
+    while (node && node != LDNS_RBTREE_NULL) {
+        task = (task_type*) node->data;
+        task_print(out, task);
+        node = ldns_rbtree_next(node);
+    }
     node = ldns_rbtree_first(schedule->tasks);
     while (node && node != LDNS_RBTREE_NULL) {
         task = (task_type*) node->data;
@@ -370,6 +475,11 @@ schedule_cleanup(schedule_type* schedule)
         ldns_rbtree_free(schedule->tasks);
         schedule->tasks = NULL;
     }
+    if (schedule->due) {
+        task_delfunc(schedule->due->root);
+        ldns_rbtree_free(schedule->due);
+        schedule->due = NULL;
+    }
     allocator = schedule->allocator;
     schedule_lock = schedule->schedule_lock;
     allocator_deallocate(allocator, (void*) schedule);
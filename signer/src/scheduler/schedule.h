@@ -59,9 +59,11 @@
 typedef struct schedule_struct schedule_type;
 struct schedule_struct {
     allocator_type* allocator;
-    ldns_rbtree_t* tasks;
+    ldns_rbtree_t* tasks; /* by time, not due yet */
+    ldns_rbtree_t* due; /* due, by deadline, only with deadlines on */
     int flushcount;
     int loading; /* to determine backoff */
+    int deadlines; /* serve due tasks earliest deadline first */
     lock_basic_type schedule_lock;
 };
 
@@ -129,6 +131,14 @@ ods_status reschedule_task(schedule_type* schedule, task_type* task,
  */
 task_type* schedule_pop_task(schedule_type* schedule);
 
+/**
+ * Number of scheduled tasks.
+ * \param[in] schedule schedule
+ * \return size_t number of tasks
+ *
+ */
+size_t schedule_count(schedule_type* schedule);
+
 /**
  * Get the first scheduled task.
  * \param[in] schedule schedule
@@ -75,7 +75,9 @@ task_create(task_id what, time_t when, void* zone)
     task->when = when;
     task->halted_when = 0;
     task->backoff = 0;
+    task->deadline = 0;
     task->flush = 0;
+    task->due = 0;
     task->zone = zone;
     return task;
 }
@@ -140,6 +142,32 @@ task_compare(const void* a, const void* b)
 }
 
 
+/**
+ * Compare tasks on deadline.
+ *
+ */
+int
+task_compare_deadline(const void* a, const void* b)
+{
+    task_type* x = (task_type*)a;
+    task_type* y = (task_type*)b;
+    time_t dx = 0;
+    time_t dy = 0;
+
+    ods_log_assert(x);
+    ods_log_assert(y);
+    if (x == y) {
+        return 0;
+    }
+    dx = x->deadline ? x->deadline : x->when;
+    dy = y->deadline ? y->deadline : y->when;
+    if (dx != dy) {
+        return dx < dy ? -1 : 1;
+    }
+    return task_compare(a, b);
+}
+
+
 /**
  * String-format of what.
  *
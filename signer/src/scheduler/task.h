@@ -61,7 +61,9 @@ struct task_struct {
     time_t when;
     time_t halted_when;
     time_t backoff;
+    time_t deadline; /* signatures must be refreshed by then, 0 if unknown */
     int flush;
+    int due; /* in the due tasks of the schedule */
     void* zone;
 };
 
@@ -92,6 +94,16 @@ void task_backup(FILE* fd, task_type* task);
  */
 int task_compare(const void* a, const void* b);
 
+/**
+ * Compare tasks on deadline. A task without a deadline counts its
+ * scheduled time as deadline, ties are ordered like task_compare().
+ * \param[in] a one task
+ * \param[in] b another task
+ * \return int -1, 0 or 1
+ *
+ */
+int task_compare_deadline(const void* a, const void* b);
+
 /**
  * Convert task to string.
  * \param[in] task task
@@ -39,6 +39,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
 
 static const char* duration_str = "duration";
 
@@ -525,6 +528,30 @@ time_now(void)
 }
 
 
+/**
+ * Return a monotonic timestamp, measured in nanoseconds.
+ *
+ */
+uint64_t
+time_monotonic_ns(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return ((uint64_t) time(NULL)) * 1000000000;
+    }
+    return ((uint64_t) ts.tv_sec) * 1000000000 + (uint64_t) ts.tv_nsec;
+#else
+    struct timeval tv;
+    if (gettimeofday(&tv, NULL) != 0) {
+        return ((uint64_t) time(NULL)) * 1000000000;
+    }
+    return ((uint64_t) tv.tv_sec) * 1000000000 +
+        ((uint64_t) tv.tv_usec) * 1000;
+#endif /* HAVE_CLOCK_GETTIME */
+}
+
+
 /**
  * copycode: This code is based on the EXAMPLE in the strftime manual.
  *
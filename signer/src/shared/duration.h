@@ -149,6 +149,14 @@ uint32_t time_datestamp(time_t tt, const char* format, char** str);
  */
 time_t time_now(void);
 
+/**
+ * Return a monotonic timestamp, measured in nanoseconds. Only useful for
+ * measuring intervals, it is not related to the wall clock.
+ * \return uint64_t nanoseconds since some unspecified starting point.
+ *
+ */
+uint64_t time_monotonic_ns(void);
+
 /**
  * Clean up duration.
  * \param[in] duration duration to be cleaned up
@@ -33,10 +33,170 @@
 
 #include "daemon/engine.h"
 #include "shared/hsm.h"
+#include "shared/duration.h"
 #include "shared/log.h"
+#include "signer/stats.h"
+
+#include <string.h>
 
 static const char* hsm_str = "hsm";
 
+#define LHSM_CACHE_SIZE 1024
+
+/**
+ * Process wide key cache, shared by all zones that are signed with the
+ * same key. Maps a locator to the key handle, the DNSKEY and its key tag.
+ * The cache is emptied when the HSM connection is (re)opened, as handles
+ * are only valid within a connection.
+ */
+typedef struct lhsm_cache_struct lhsm_cache_type;
+struct lhsm_cache_struct {
+    lhsm_cache_type* next;
+    char* locator;
+    uint8_t algorithm;
+    uint32_t flags;
+    hsm_key_t hsmkey;
+    ldns_rr* dnskey;
+    uint16_t keytag;
+    uint64_t cost; /* ns it took the HSM to find the key and its DNSKEY */
+};
+
+static lhsm_cache_type* lhsm_cache[LHSM_CACHE_SIZE];
+static lock_basic_type lhsm_cache_lock;
+static int lhsm_cache_ready = 0;
+
+
+/**
+ * Hash a locator.
+ *
+ */
+static size_t
+lhsm_cache_hash(const char* locator)
+{
+    size_t hash = 5381;
+    while (*locator) {
+        hash = hash * 33 + (unsigned char) *locator++;
+    }
+    return hash % LHSM_CACHE_SIZE;
+}
+
+
+/**
+ * Empty the key cache.
+ *
+ */
+static void
+lhsm_cache_clear(void)
+{
+    lhsm_cache_type* entry = NULL;
+    size_t i = 0;
+    if (!lhsm_cache_ready) {
+        lock_basic_init(&lhsm_cache_lock);
+        lhsm_cache_ready = 1;
+    }
+    lock_basic_lock(&lhsm_cache_lock);
+    for (i=0; i < LHSM_CACHE_SIZE; i++) {
+        while (lhsm_cache[i]) {
+            entry = lhsm_cache[i];
+            lhsm_cache[i] = entry->next;
+            ldns_rr_free(entry->dnskey);
+            free((void*) entry->locator);
+            free((void*) entry);
+        }
+    }
+    lock_basic_unlock(&lhsm_cache_lock);
+    return;
+}
+
+
+/**
+ * Look up key in the cache. The caller holds the cache lock.
+ *
+ */
+static lhsm_cache_type**
+lhsm_cache_lookup(key_type* key_id)
+{
+    lhsm_cache_type** entry = NULL;
+    entry = &lhsm_cache[lhsm_cache_hash(key_id->locator)];
+    while (*entry) {
+        if ((*entry)->algorithm == key_id->algorithm &&
+            (*entry)->flags == key_id->flags &&
+            strcmp((*entry)->locator, key_id->locator) == 0) {
+            return entry;
+        }
+        entry = &(*entry)->next;
+    }
+    return entry;
+}
+
+
+/**
+ * Add key to the cache.
+ *
+ */
+static void
+lhsm_cache_add(key_type* key_id, uint64_t cost)
+{
+    lhsm_cache_type** entry = NULL;
+    lhsm_cache_type* add = NULL;
+    if (!lhsm_cache_ready || !key_id->locator || !key_id->hsmkey ||
+        !key_id->dnskey || !key_id->params) {
+        return;
+    }
+    lock_basic_lock(&lhsm_cache_lock);
+    entry = lhsm_cache_lookup(key_id);
+    if (!*entry) {
+        add = (lhsm_cache_type*) calloc(1, sizeof(lhsm_cache_type));
+        if (add) {
+            add->locator = strdup(key_id->locator);
+            add->dnskey = ldns_rr_clone(key_id->dnskey);
+        }
+        if (!add || !add->locator || !add->dnskey) {
+            if (add) {
+                ldns_rr_free(add->dnskey);
+                free((void*) add->locator);
+                free((void*) add);
+            }
+            lock_basic_unlock(&lhsm_cache_lock);
+            return;
+        }
+        add->algorithm = key_id->algorithm;
+        add->flags = key_id->flags;
+        add->hsmkey = *key_id->hsmkey;
+        add->keytag = key_id->params->keytag;
+        add->cost = cost;
+        *entry = add;
+    }
+    lock_basic_unlock(&lhsm_cache_lock);
+    return;
+}
+
+
+/**
+ * Drop key from the cache.
+ *
+ */
+static void
+lhsm_cache_del(key_type* key_id)
+{
+    lhsm_cache_type** entry = NULL;
+    lhsm_cache_type* del = NULL;
+    if (!lhsm_cache_ready || !key_id->locator) {
+        return;
+    }
+    lock_basic_lock(&lhsm_cache_lock);
+    entry = lhsm_cache_lookup(key_id);
+    if (*entry) {
+        del = *entry;
+        *entry = del->next;
+        ldns_rr_free(del->dnskey);
+        free((void*) del->locator);
+        free((void*) del);
+    }
+    lock_basic_unlock(&lhsm_cache_lock);
+    return;
+}
+
 
 /**
  * Open HSM.
@@ -59,6 +219,8 @@ lhsm_open(hsm_repository_t* rlist)
     } else {
         ods_log_info("[%s] libhsm connection opened succesfully", hsm_str);
     }
+    /* key handles of a previous connection are no longer valid */
+    lhsm_cache_clear();
     return result;
 }
 
@@ -102,12 +264,13 @@ lhsm_clear_key_cache(key_type* key)
         hsm_sign_params_free(key->params);
         key->params = NULL;
     }
+    lhsm_cache_del(key);
     return;
 }
 
 
 /**
- * Check the HSM connection, reload engine if necessary.
+ * Check the HSM connection, restart the drudgers if necessary.
  *
  */
 void
@@ -117,10 +280,11 @@ lhsm_check_connection(void* engine)
     if (hsm_check_context(NULL) != HSM_OK) {
         ods_log_warning("[%s] idle libhsm connection, trying to reopen",
             hsm_str);
+        /* closing the connection invalidates every context */
         engine_stop_drudgers(e);
         hsm_close();
         (void)lhsm_open(e->config->repositories);
-        engine_start_drudgers((engine_type*) engine);
+        engine_start_drudgers(e);
     } else {
         ods_log_debug("[%s] libhsm connection ok", hsm_str);
     }
@@ -128,6 +292,291 @@ lhsm_check_connection(void* engine)
 }
 
 
+/**
+ * Replace a context with a new one.
+ *
+ */
+hsm_ctx_t*
+lhsm_renew_context(hsm_ctx_t* ctx)
+{
+    if (ctx) {
+        hsm_destroy_context(ctx);
+    }
+    ctx = hsm_create_context();
+    if (!ctx) {
+        ods_log_error("[%s] unable to renew context: hsm_create_context() "
+            "failed", hsm_str);
+    }
+    return ctx;
+}
+
+
+/**
+ * Check the sessions of a context.
+ *
+ */
+hsm_ctx_t*
+lhsm_check_context(hsm_ctx_t* ctx)
+{
+    char* error = NULL;
+    if (!ctx) {
+        return NULL;
+    }
+    if (hsm_check_context(ctx) != HSM_OK) {
+        error = hsm_get_error(ctx);
+        ods_log_warning("[%s] context failed check, renew sessions: %s",
+            hsm_str, error?error:"unknown error");
+        free((void*)error);
+        return lhsm_renew_context(ctx);
+    }
+    return ctx;
+}
+
+
+/**
+ * Create a session pool.
+ *
+ */
+lhsm_pool_type*
+lhsm_pool_create(size_t count)
+{
+    lhsm_pool_type* pool = (lhsm_pool_type*) calloc(1,
+        sizeof(lhsm_pool_type));
+    if (!pool) {
+        ods_log_error("[%s] unable to create session pool: malloc failed",
+            hsm_str);
+        return NULL;
+    }
+    if (count) {
+        pool->slots = (lhsm_slot_type*) calloc(count, sizeof(lhsm_slot_type));
+        if (!pool->slots) {
+            ods_log_error("[%s] unable to create session pool: malloc "
+                "failed", hsm_str);
+            free((void*) pool);
+            return NULL;
+        }
+    }
+    pool->count = count;
+    lock_basic_init(&pool->pool_lock);
+    lock_basic_set(&pool->pool_cond);
+    return pool;
+}
+
+
+/**
+ * Take the context of a slot.
+ *
+ */
+hsm_ctx_t*
+lhsm_pool_acquire(lhsm_pool_type* pool, size_t slot)
+{
+    hsm_ctx_t* ctx = NULL;
+    if (!pool || slot >= pool->count) {
+        return NULL;
+    }
+    lock_basic_lock(&pool->pool_lock);
+    while (pool->slots[slot].busy) {
+        /* the checker is testing the sessions of this slot */
+        lock_basic_sleep(&pool->pool_cond, &pool->pool_lock, 0);
+    }
+    pool->slots[slot].busy = 1;
+    ctx = pool->slots[slot].ctx;
+    lock_basic_unlock(&pool->pool_lock);
+    if (!ctx) {
+        ods_log_debug("[%s] create context for slot %u", hsm_str,
+            (unsigned) slot);
+        ctx = hsm_create_context();
+        pool->slots[slot].ctx = ctx;
+    }
+    if (!ctx) {
+        lhsm_pool_release(pool, slot);
+    }
+    return ctx;
+}
+
+
+/**
+ * Replace the context of a taken slot.
+ *
+ */
+hsm_ctx_t*
+lhsm_pool_renew(lhsm_pool_type* pool, size_t slot)
+{
+    if (!pool || slot >= pool->count) {
+        return NULL;
+    }
+    pool->slots[slot].ctx = lhsm_renew_context(pool->slots[slot].ctx);
+    return pool->slots[slot].ctx;
+}
+
+
+/**
+ * Give back a taken slot.
+ *
+ */
+void
+lhsm_pool_release(lhsm_pool_type* pool, size_t slot)
+{
+    if (!pool || slot >= pool->count) {
+        return;
+    }
+    lock_basic_lock(&pool->pool_lock);
+    pool->slots[slot].busy = 0;
+    lock_basic_broadcast(&pool->pool_cond);
+    lock_basic_unlock(&pool->pool_lock);
+    return;
+}
+
+
+/**
+ * Check the sessions of the idle slots.
+ *
+ */
+void
+lhsm_pool_check(lhsm_pool_type* pool)
+{
+    size_t i = 0;
+    if (!pool) {
+        return;
+    }
+    for (i=0; i < pool->count; i++) {
+        lock_basic_lock(&pool->pool_lock);
+        if (pool->slots[i].busy || !pool->slots[i].ctx) {
+            /* a slot in use shows its errors to the drudger */
+            lock_basic_unlock(&pool->pool_lock);
+            continue;
+        }
+        pool->slots[i].busy = 1;
+        lock_basic_unlock(&pool->pool_lock);
+        pool->slots[i].ctx = lhsm_check_context(pool->slots[i].ctx);
+        lhsm_pool_release(pool, i);
+    }
+    return;
+}
+
+
+/**
+ * Close all sessions in the pool.
+ *
+ */
+void
+lhsm_pool_clear(lhsm_pool_type* pool)
+{
+    size_t i = 0;
+    if (!pool) {
+        return;
+    }
+    lock_basic_lock(&pool->pool_lock);
+    for (i=0; i < pool->count; i++) {
+        if (pool->slots[i].ctx) {
+            hsm_destroy_context(pool->slots[i].ctx);
+            pool->slots[i].ctx = NULL;
+        }
+        pool->slots[i].busy = 0;
+    }
+    lock_basic_unlock(&pool->pool_lock);
+    return;
+}
+
+
+/**
+ * Clean up a session pool.
+ *
+ */
+void
+lhsm_pool_cleanup(lhsm_pool_type* pool)
+{
+    if (!pool) {
+        return;
+    }
+    lhsm_pool_clear(pool);
+    lock_basic_destroy(&pool->pool_lock);
+    lock_basic_off(&pool->pool_cond);
+    free((void*) pool->slots);
+    free((void*) pool);
+    return;
+}
+
+
+/**
+ * Get key from the process wide key cache.
+ *
+ */
+ods_status
+lhsm_get_cached_key(ldns_rdf* owner, key_type* key_id)
+{
+    lhsm_cache_type** entry = NULL;
+    hsm_key_t* hsmkey = NULL;
+    ldns_rr* dnskey = NULL;
+    ldns_rdf* old_owner = NULL;
+    ldns_rdf* new_owner = NULL;
+    hsm_sign_params_t* params = NULL;
+
+    if (!owner || !key_id || !key_id->locator) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    if (key_id->hsmkey && key_id->dnskey && key_id->params) {
+        /* already resolved for this signer configuration */
+        return ODS_STATUS_OK;
+    }
+    if (!lhsm_cache_ready) {
+        return ODS_STATUS_UNCHANGED;
+    }
+    lock_basic_lock(&lhsm_cache_lock);
+    entry = lhsm_cache_lookup(key_id);
+    if (!*entry) {
+        stats_keycache_record(0, 0);
+        lock_basic_unlock(&lhsm_cache_lock);
+        return ODS_STATUS_UNCHANGED;
+    }
+    if (!key_id->hsmkey) {
+        hsmkey = (hsm_key_t*) malloc(sizeof(hsm_key_t));
+        if (hsmkey) {
+            *hsmkey = (*entry)->hsmkey;
+        }
+    }
+    if (!key_id->dnskey) {
+        dnskey = ldns_rr_clone((*entry)->dnskey);
+        new_owner = ldns_rdf_clone(owner);
+    }
+    if (!key_id->params) {
+        params = hsm_sign_params_new();
+        if (params) {
+            params->owner = ldns_rdf_clone(owner);
+            params->algorithm = key_id->algorithm;
+            params->flags = key_id->flags;
+        }
+    }
+    if ((!key_id->hsmkey && !hsmkey) ||
+        (!key_id->dnskey && (!dnskey || !new_owner)) ||
+        (!key_id->params && (!params || !params->owner))) {
+        /* out of memory, let the HSM path deal with it */
+        lock_basic_unlock(&lhsm_cache_lock);
+        hsm_key_free(hsmkey);
+        ldns_rr_free(dnskey);
+        ldns_rdf_deep_free(new_owner);
+        hsm_sign_params_free(params);
+        return ODS_STATUS_UNCHANGED;
+    }
+    if (hsmkey) {
+        key_id->hsmkey = hsmkey;
+    }
+    if (dnskey) {
+        old_owner = ldns_rr_owner(dnskey);
+        ldns_rr_set_owner(dnskey, new_owner);
+        ldns_rdf_deep_free(old_owner);
+        key_id->dnskey = dnskey;
+    }
+    if (params) {
+        key_id->params = params;
+    }
+    key_id->params->keytag = (*entry)->keytag;
+    stats_keycache_record(1, (*entry)->cost);
+    lock_basic_unlock(&lhsm_cache_lock);
+    return ODS_STATUS_OK;
+}
+
+
 /**
  * Get key from one of the HSMs.
  *
@@ -137,12 +586,16 @@ lhsm_get_key(hsm_ctx_t* ctx, ldns_rdf* owner, key_type* key_id)
 {
     char *error = NULL;
     int retries = 0;
+    int cached = 0;
+    uint64_t start_ns = 0;
 
     if (!owner || !key_id) {
         ods_log_error("[%s] unable to get key: missing required elements",
             hsm_str);
         return ODS_STATUS_ASSERT_ERR;
     }
+    cached = (key_id->hsmkey && key_id->dnskey);
+    start_ns = time_monotonic_ns();
 
 lhsm_key_start:
 
@@ -207,6 +660,9 @@ lhsm_key_start:
         return ODS_STATUS_ERR;
     }
     key_id->params->keytag = ldns_calc_keytag(key_id->dnskey);
+    if (!cached) {
+        lhsm_cache_add(key_id, time_monotonic_ns() - start_ns);
+    }
     return ODS_STATUS_OK;
 }
 
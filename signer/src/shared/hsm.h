@@ -35,6 +35,7 @@
 #define SHARED_HSM_H
 
 #include "config.h"
+#include "shared/locks.h"
 #include "shared/status.h"
 #include "signer/keys.h"
 
@@ -45,6 +46,29 @@
 #include <libhsm.h>
 #include <libhsmdns.h>
 
+#define LHSM_CHECK_INTERVAL 60 /* seconds between connection checks */
+#define LHSM_SIGN_RETRIES 3 /* new sessions to try after a sign error */
+
+/**
+ * HSM session pool. Every drudger has a slot with a context of its own.
+ * The checker tests the sessions of the idle slots in the background and
+ * replaces the ones that failed, while the drudgers keep signing.
+ *
+ */
+typedef struct lhsm_slot_struct lhsm_slot_type;
+struct lhsm_slot_struct {
+    hsm_ctx_t* ctx;
+    int busy; /* in use by its drudger or by the checker */
+};
+
+typedef struct lhsm_pool_struct lhsm_pool_type;
+struct lhsm_pool_struct {
+    lhsm_slot_type* slots;
+    size_t count;
+    cond_basic_type pool_cond;
+    lock_basic_type pool_lock;
+};
+
 /**
  * Open HSM.
  * \param[in] rlist repository list
@@ -62,12 +86,95 @@ int lhsm_open(hsm_repository_t* rlist);
 int lhsm_reopen(hsm_repository_t* rlist);
 
 /**
- * Check the HSM connection, reload engine if necessary.
+ * Check the HSM connection, restart the drudgers on a new connection if
+ * it failed. Only the HSM checker calls this.
  * \param[in] engine signer engine.
  *
  */
 void lhsm_check_connection(void* engine);
 
+/**
+ * Create a session pool.
+ * \param[in] count number of slots, one per drudger
+ * \return lhsm_pool_type* session pool
+ *
+ */
+lhsm_pool_type* lhsm_pool_create(size_t count);
+
+/**
+ * Take the context of a slot, create it if there is none. Waits while the
+ * checker is testing the slot.
+ * \param[in] pool session pool
+ * \param[in] slot slot number
+ * \return hsm_ctx_t* context, NULL on failure
+ *
+ */
+hsm_ctx_t* lhsm_pool_acquire(lhsm_pool_type* pool, size_t slot);
+
+/**
+ * Retire the context of a taken slot and replace it with a new one.
+ * \param[in] pool session pool
+ * \param[in] slot slot number
+ * \return hsm_ctx_t* new context, NULL on failure
+ *
+ */
+hsm_ctx_t* lhsm_pool_renew(lhsm_pool_type* pool, size_t slot);
+
+/**
+ * Give back a taken slot.
+ * \param[in] pool session pool
+ * \param[in] slot slot number
+ *
+ */
+void lhsm_pool_release(lhsm_pool_type* pool, size_t slot);
+
+/**
+ * Check the sessions of the idle slots, replace the ones that failed.
+ * \param[in] pool session pool
+ *
+ */
+void lhsm_pool_check(lhsm_pool_type* pool);
+
+/**
+ * Close all sessions in the pool. Call this with the drudgers stopped.
+ * \param[in] pool session pool
+ *
+ */
+void lhsm_pool_clear(lhsm_pool_type* pool);
+
+/**
+ * Clean up a session pool.
+ * \param[in] pool session pool
+ *
+ */
+void lhsm_pool_cleanup(lhsm_pool_type* pool);
+
+/**
+ * Replace a context with a new one, with fresh sessions.
+ * \param[in] ctx context to retire, may be NULL
+ * \return hsm_ctx_t* new context, NULL on failure
+ *
+ */
+hsm_ctx_t* lhsm_renew_context(hsm_ctx_t* ctx);
+
+/**
+ * Check the sessions of a context, replace the context if they failed.
+ * \param[in] ctx HSM context
+ * \return hsm_ctx_t* the context, a new one, or NULL on failure
+ *
+ */
+hsm_ctx_t* lhsm_check_context(hsm_ctx_t* ctx);
+
+/**
+ * Get key from the process wide key cache, store the DNSKEY and HSM key.
+ * \param[in] owner the zone owner name
+ * \param[in] key_id key credentials
+ * \return ods_status ODS_STATUS_OK if found, ODS_STATUS_UNCHANGED if the
+ *         key has to be looked up in the HSM with lhsm_get_key()
+ *
+ */
+ods_status lhsm_get_cached_key(ldns_rdf* owner, key_type* key_id);
+
 /**
  * Get key from one of the HSMs, store the DNSKEY and HSM key.
  * \param[in] ctx HSM context
@@ -34,9 +34,15 @@
 #include "config.h"
 #include "shared/duration.h"
 #include "shared/file.h"
+#include "shared/locks.h"
 #include "shared/log.h"
 #include "shared/util.h"
 
+/* this file implements the functions behind the level check macros */
+#undef ods_log_deeebug
+#undef ods_log_debug
+#undef ods_log_verbose
+
 #ifdef HAVE_SYSLOG_H
 static int logging_to_syslog = 0;
 #endif /* !HAVE_SYSLOG_H */
@@ -45,12 +51,74 @@ static int logging_to_syslog = 0;
 #include <stdio.h> /* fflush, fprintf(), vsnprintf() */
 #include <stdlib.h> /* exit() */
 #include <string.h> /* strlen() */
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <signal.h> /* pthread_sigmask() */
+#endif
 
 static FILE* logfile = NULL;
-static int log_level = LOG_CRIT;
+int ods_log_level = LOG_CRIT;
 
 #define CTIME_LENGTH 26
 
+#ifdef HAVE_PTHREAD
+/* serializes writes to the log target with switching it */
+static lock_basic_type log_write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Asynchronous logging. Every thread that logs gets a ring buffer of its
+ * own, with one producer (the thread) and one consumer (the log writer).
+ * The producer formats the message into the ring, the writer adds the
+ * timestamp and writes the lines in batches. Lines are ordered per thread,
+ * not across threads. A producer that finds its ring full sleeps until the
+ * writer has made room.
+ *
+ * Lock order: log_write_lock, then ring_lock, then log_async_lock. The
+ * writer never holds log_async_lock while it takes a ring lock.
+ */
+#define LOG_RING_SIZE 128 /* power of two */
+#define LOG_BATCH_SIZE 65536
+
+typedef struct log_entry_struct log_entry_type;
+struct log_entry_struct {
+    time_t now;
+    int priority;
+    const char* t;
+    char message[ODS_SE_MAXLINE];
+};
+
+typedef struct log_ring_struct log_ring_type;
+struct log_ring_struct {
+    log_ring_type* next;
+    lock_basic_type ring_lock;
+    cond_basic_type ring_room; /* the writer made room */
+    unsigned head; /* producer */
+    unsigned tail; /* writer */
+    int closed; /* no writer, log synchronously */
+    int dead; /* thread has exited */
+    int gone; /* dead and empty, only used by the writer */
+    log_entry_type entries[LOG_RING_SIZE];
+};
+
+/* protected by log_async_lock */
+static int log_async = 0;
+static int log_wake = 0;
+static int log_writer_exit = 0;
+static unsigned log_drained = 0;
+static log_ring_type* log_rings = NULL;
+static lock_basic_type log_async_lock = PTHREAD_MUTEX_INITIALIZER;
+static cond_basic_type log_async_cond = PTHREAD_COND_INITIALIZER;
+static cond_basic_type log_drained_cond = PTHREAD_COND_INITIALIZER;
+/* only written by the thread that starts and stops the writer */
+static ods_thread_type log_writer;
+static ods_thread_type log_owner;
+static int log_atfork = 0;
+/* only set in a forked child, that has no writer */
+static int log_forked = 0;
+static pthread_key_t log_ring_key;
+static pthread_once_t log_ring_once = PTHREAD_ONCE_INIT;
+#endif /* HAVE_PTHREAD */
+
 /**
  * Use _r() functions on platforms that have. They are thread safe versions of
  * the normal syslog functions. Platforms without _r() usually have thread safe
@@ -76,22 +144,18 @@ struct syslog_data sdata = SYSLOG_DATA_INIT;
 static const char* log_str = "log";
 
 /**
- * Initialize logging.
+ * Switch to a new log target. The caller holds log_write_lock, so this does
+ * not log. The log file, if any, has been opened already.
  *
  */
-void
-ods_log_init(const char *filename, int use_syslog, int verbosity)
+static void
+ods_log_open(FILE* file, int use_syslog, int facility, int verbosity)
 {
-#ifdef HAVE_SYSLOG_H
-    int facility;
-#endif /* HAVE_SYSLOG_H */
-    ods_log_verbose("[%s] switching log to %s verbosity %i (log level %i)",
-        log_str, use_syslog?"syslog":(filename&&filename[0]?filename:"stderr"),
-        verbosity, verbosity+2);
     if (logfile && logfile != stderr) {
             ods_fclose(logfile);
 	}
-    log_level = verbosity + 2;
+    logfile = NULL;
+    ods_log_level = verbosity + 2;
 
 #ifdef HAVE_SYSLOG_H
     if(logging_to_syslog) {
@@ -103,7 +167,6 @@ ods_log_init(const char *filename, int use_syslog, int verbosity)
         logging_to_syslog = 0;
     }
     if(use_syslog) {
-       facility = ods_log_get_facility(filename);
 #ifdef HAVE_OPENLOG_R
        openlog_r(MY_PACKAGE_TARNAME, LOG_NDELAY, facility, &sdata);
 #else
@@ -112,19 +175,49 @@ ods_log_init(const char *filename, int use_syslog, int verbosity)
        logging_to_syslog = 1;
        return;
     }
+#else
+    (void) use_syslog;
+    (void) facility;
 #endif /* HAVE_SYSLOG_H */
 
-    if(filename && filename[0]) {
-        logfile = ods_fopen(filename, NULL, "a");
-        if (logfile) {
-            ods_log_debug("[%s] new logfile %s", log_str, filename);
-            return;
-        }
-        logfile = stderr;
+    logfile = file?file:stderr;
+    return;
+}
+
+
+/**
+ * Initialize logging. If asynchronous logging is running, the writer keeps
+ * running and continues on the new target, whichever thread calls this.
+ *
+ */
+void
+ods_log_init(const char *filename, int use_syslog, int verbosity)
+{
+    FILE* file = NULL;
+    int facility = 0;
+    int use_file = (!use_syslog && filename && filename[0]);
+    ods_log_verbose("[%s] switching log to %s verbosity %i (log level %i)",
+        log_str, use_syslog?"syslog":(filename&&filename[0]?filename:"stderr"),
+        verbosity, verbosity+2);
+#ifdef HAVE_SYSLOG_H
+    if (use_syslog) {
+        facility = ods_log_get_facility(filename);
+    }
+#else
+    use_file = (filename && filename[0]);
+#endif /* HAVE_SYSLOG_H */
+    if (use_file) {
+        /* ods_fopen() logs, do it before taking the write lock */
+        file = ods_fopen(filename, NULL, "a");
+    }
+    lock_basic_lock(&log_write_lock);
+    ods_log_open(file, use_syslog, facility, verbosity);
+    lock_basic_unlock(&log_write_lock);
+    if (use_file && file) {
+        ods_log_debug("[%s] new logfile %s", log_str, filename);
+    } else if (use_file) {
         ods_log_warning("[%s] cannot open %s for appending, logging to "
             "stderr", log_str, filename);
-    } else {
-        logfile = stderr;
     }
     return;
 }
@@ -138,6 +231,7 @@ void
 ods_log_close(void)
 {
     ods_log_debug("[%s] close log", log_str);
+    ods_log_async_stop();
     ods_log_init(NULL, 0, 0);
 }
 
@@ -208,21 +302,403 @@ ods_log_get_facility(const char* facility)
 int
 ods_log_get_level()
 {
-    return log_level;
+    return ods_log_level;
 }
 
+
+#ifdef HAVE_PTHREAD
 /**
- * Log message wrapper.
+ * Forget the ring buffer of an exiting thread, the writer frees it.
  *
  */
 static void
-ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
+ods_log_ring_release(void* arg)
+{
+    log_ring_type* ring = (log_ring_type*) arg;
+    if (ring) {
+        lock_basic_lock(&ring->ring_lock);
+        ring->dead = 1;
+        lock_basic_unlock(&ring->ring_lock);
+    }
+    return;
+}
+
+
+/**
+ * Create the thread key for the ring buffers, once per process.
+ *
+ */
+static void
+ods_log_ring_key(void)
+{
+    (void) pthread_key_create(&log_ring_key, ods_log_ring_release);
+    return;
+}
+
+
+/**
+ * Get the ring buffer of the calling thread. Rings are only handed out
+ * while the writer runs.
+ *
+ */
+static log_ring_type*
+ods_log_ring(void)
+{
+    log_ring_type* ring = NULL;
+    (void) pthread_once(&log_ring_once, ods_log_ring_key);
+    ring = (log_ring_type*) pthread_getspecific(log_ring_key);
+    if (ring) {
+        return ring;
+    }
+    lock_basic_lock(&log_async_lock);
+    if (log_async) {
+        ring = (log_ring_type*) calloc(1, sizeof(log_ring_type));
+    }
+    if (ring && pthread_setspecific(log_ring_key, ring) != 0) {
+        free((void*) ring);
+        ring = NULL;
+    }
+    if (ring) {
+        lock_basic_init(&ring->ring_lock);
+        lock_basic_set(&ring->ring_room);
+        ring->next = log_rings;
+        log_rings = ring;
+    }
+    lock_basic_unlock(&log_async_lock);
+    return ring;
+}
+
+
+/**
+ * Queue a message for the log writer.
+ * Return 0 if the message could not be queued.
+ *
+ */
+static int
+ods_log_enqueue(int priority, const char* t, const char* s, va_list args)
+{
+    log_ring_type* ring = NULL;
+    log_entry_type* entry = NULL;
+    unsigned used = 0;
+
+    if (log_forked || !(ring = ods_log_ring())) {
+        return 0;
+    }
+    lock_basic_lock(&ring->ring_lock);
+    while (!ring->closed && ring->head - ring->tail >= LOG_RING_SIZE) {
+        /* ring is full: kick the writer and wait for room */
+        lock_basic_lock(&log_async_lock);
+        log_wake = 1;
+        lock_basic_alarm(&log_async_cond);
+        lock_basic_unlock(&log_async_lock);
+        lock_basic_sleep(&ring->ring_room, &ring->ring_lock, 0);
+    }
+    if (ring->closed) {
+        lock_basic_unlock(&ring->ring_lock);
+        return 0;
+    }
+    entry = &ring->entries[ring->head & (LOG_RING_SIZE-1)];
+    entry->now = time_now();
+    entry->priority = priority;
+    entry->t = t;
+    vsnprintf(entry->message, sizeof(entry->message), s, args);
+    ring->head++;
+    used = ring->head - ring->tail;
+    lock_basic_unlock(&ring->ring_lock);
+    if (priority <= LOG_ERR || used >= LOG_RING_SIZE/2) {
+        lock_basic_lock(&log_async_lock);
+        log_wake = 1;
+        lock_basic_alarm(&log_async_cond);
+        lock_basic_unlock(&log_async_lock);
+    }
+    return 1;
+}
+
+
+/**
+ * Write a batch of formatted lines. The caller holds log_write_lock.
+ *
+ */
+static void
+ods_log_write_batch(char* batch, size_t len)
+{
+    if (len > 0 && logfile) {
+        (void) fwrite(batch, 1, len, logfile);
+    }
+    return;
+}
+
+
+/**
+ * Write the queued messages of all threads. If close is set, the rings
+ * are closed after they have been emptied, and their threads go back to
+ * logging for themselves.
+ *
+ */
+static void
+ods_log_drain(char* batch, time_t* cached, char* nowstr, int close)
+{
+    log_ring_type* ring = NULL;
+    log_ring_type* prev = NULL;
+    log_ring_type* next = NULL;
+    log_entry_type* entry = NULL;
+    size_t len = 0;
+    int n = 0;
+
+    lock_basic_lock(&log_async_lock);
+    ring = log_rings;
+    lock_basic_unlock(&log_async_lock);
+    lock_basic_lock(&log_write_lock);
+    /* rings are only added at the front and freed here, the walk is safe */
+    for (; ring; ring = ring->next) {
+        lock_basic_lock(&ring->ring_lock);
+        while (ring->tail != ring->head) {
+            entry = &ring->entries[ring->tail & (LOG_RING_SIZE-1)];
+#ifdef HAVE_SYSLOG_H
+            if (logging_to_syslog) {
+                /* switched to syslog while the writer was running */
+#ifdef HAVE_SYSLOG_R
+                syslog_r(entry->priority, &sdata, "%s", entry->message);
+#else
+                syslog(entry->priority, "%s", entry->message);
+#endif
+                ring->tail++;
+                continue;
+            }
+#endif /* HAVE_SYSLOG_H */
+            if (len + ODS_SE_MAXLINE + 64 > LOG_BATCH_SIZE) {
+                /* do not keep the producer waiting on the disk */
+                lock_basic_unlock(&ring->ring_lock);
+                ods_log_write_batch(batch, len);
+                len = 0;
+                lock_basic_lock(&ring->ring_lock);
+                continue;
+            }
+            if (entry->now != *cached) {
+                /* one ctime_r() per second of log */
+                (void) ctime_r(&entry->now, nowstr);
+                nowstr[CTIME_LENGTH-2] = '\0';
+                *cached = entry->now;
+            }
+            n = snprintf(batch + len, LOG_BATCH_SIZE - len,
+                "[%s] %s[%i] %s: %s\n", nowstr, MY_PACKAGE_TARNAME,
+                entry->priority, entry->t, entry->message);
+            if (n > 0) {
+                len += ((size_t) n < LOG_BATCH_SIZE - len) ?
+                    (size_t) n : LOG_BATCH_SIZE - len - 1;
+            }
+            ring->tail++;
+        }
+        if (close) {
+            ring->closed = 1;
+        }
+        ring->gone = ring->dead;
+        lock_basic_broadcast(&ring->ring_room);
+        lock_basic_unlock(&ring->ring_lock);
+    }
+    ods_log_write_batch(batch, len);
+    if (logfile) {
+        fflush(logfile);
+    }
+    lock_basic_unlock(&log_write_lock);
+    /* free the rings of threads that are gone */
+    lock_basic_lock(&log_async_lock);
+    prev = NULL;
+    for (ring = log_rings; ring; ring = next) {
+        next = ring->next;
+        /* the thread is gone, nobody else takes its lock */
+        if (ring->gone) {
+            if (prev) {
+                prev->next = next;
+            } else {
+                log_rings = next;
+            }
+            lock_basic_off(&ring->ring_room);
+            lock_basic_destroy(&ring->ring_lock);
+            free((void*) ring);
+        } else {
+            prev = ring;
+        }
+    }
+    log_drained++;
+    lock_basic_broadcast(&log_drained_cond);
+    lock_basic_unlock(&log_async_lock);
+    return;
+}
+
+
+/**
+ * A forked child has no log writer, let it write for itself.
+ *
+ */
+static void
+ods_log_atfork_child(void)
+{
+    log_forked = 1;
+    log_async = 0;
+    return;
+}
+
+
+/**
+ * Log writer thread.
+ *
+ */
+static void*
+ods_log_writer(void* arg)
+{
+    char* batch = (char*) arg;
+    char nowstr[CTIME_LENGTH];
+    time_t cached = 0;
+    int stop = 0;
+
+    nowstr[0] = '\0';
+    while (!stop) {
+        lock_basic_lock(&log_async_lock);
+        if (!log_wake && !log_writer_exit) {
+            /* errors and full rings wake us up sooner */
+            lock_basic_sleep(&log_async_cond, &log_async_lock, 1);
+        }
+        log_wake = 0;
+        stop = log_writer_exit;
+        lock_basic_unlock(&log_async_lock);
+        ods_log_drain(batch, &cached, nowstr, stop);
+    }
+    free((void*) batch);
+    return NULL;
+}
+
+
+/**
+ * Wait a little for the writer to write what has been queued so far.
+ *
+ */
+static void
+ods_log_async_flush(void)
+{
+    unsigned drained = 0;
+    int tries = 0;
+    lock_basic_lock(&log_async_lock);
+    /* a pass that is under way may have missed our messages */
+    drained = log_drained + 2;
+    while (log_async && (int) (drained - log_drained) > 0 && tries < 3) {
+        log_wake = 1;
+        lock_basic_alarm(&log_async_cond);
+        lock_basic_sleep(&log_drained_cond, &log_async_lock, 1);
+        tries++;
+    }
+    lock_basic_unlock(&log_async_lock);
+    return;
+}
+#endif /* HAVE_PTHREAD */
+
+
+/**
+ * Start asynchronous logging. The calling thread owns the writer: only it
+ * can stop it again.
+ *
+ */
+void
+ods_log_async_start(void)
+{
+#ifdef HAVE_PTHREAD
+    log_ring_type* ring = NULL;
+    char* batch = NULL;
+    sigset_t sigset;
+    sigset_t oldset;
+    int running = 0;
+#ifdef HAVE_SYSLOG_H
+    if (logging_to_syslog) {
+        return;
+    }
+#endif /* HAVE_SYSLOG_H */
+    lock_basic_lock(&log_async_lock);
+    running = log_async;
+    lock_basic_unlock(&log_async_lock);
+    if (running || !logfile || log_forked) {
+        return;
+    }
+    batch = (char*) malloc(LOG_BATCH_SIZE);
+    if (!batch) {
+        ods_log_warning("[%s] unable to start log writer: malloc failed",
+            log_str);
+        return;
+    }
+    (void) pthread_once(&log_ring_once, ods_log_ring_key);
+    if (!log_atfork) {
+        (void) pthread_atfork(NULL, NULL, ods_log_atfork_child);
+        log_atfork = 1;
+    }
+    lock_basic_lock(&log_async_lock);
+    log_writer_exit = 0;
+    log_wake = 0;
+    ring = log_rings;
+    lock_basic_unlock(&log_async_lock);
+    /* rings of a previous writer are used again */
+    for (; ring; ring = ring->next) {
+        lock_basic_lock(&ring->ring_lock);
+        ring->closed = 0;
+        lock_basic_unlock(&ring->ring_lock);
+    }
+    /* the writer does not handle signals */
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+    if (pthread_create(&log_writer, NULL, ods_log_writer, batch) != 0) {
+        pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+        free((void*) batch);
+        ods_log_warning("[%s] unable to start log writer: pthread_create() "
+            "failed", log_str);
+        return;
+    }
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+    log_owner = ods_thread_self();
+    lock_basic_lock(&log_async_lock);
+    log_async = 1;
+    lock_basic_unlock(&log_async_lock);
+    ods_log_debug("[%s] asynchronous logging started", log_str);
+#endif /* HAVE_PTHREAD */
+    return;
+}
+
+
+/**
+ * Stop asynchronous logging. Only the thread that started the writer does
+ * this, other threads return right away.
+ *
+ */
+void
+ods_log_async_stop(void)
+{
+#ifdef HAVE_PTHREAD
+    lock_basic_lock(&log_async_lock);
+    if (!log_async || !pthread_equal(log_owner, ods_thread_self())) {
+        lock_basic_unlock(&log_async_lock);
+        return;
+    }
+    /* no new rings, the writer closes the existing ones on its way out */
+    log_async = 0;
+    log_writer_exit = 1;
+    lock_basic_alarm(&log_async_cond);
+    lock_basic_unlock(&log_async_lock);
+    ods_thread_join(log_writer);
+#endif /* HAVE_PTHREAD */
+    return;
+}
+
+
+/**
+ * Write a message to the log target right away.
+ *
+ */
+static void
+ods_log_vmsg_sync(int priority, const char* t, const char* s, va_list args)
 {
     char message[ODS_SE_MAXLINE];
-    static char nowstr[CTIME_LENGTH];
-    time_t now = time_now();
+    char nowstr[CTIME_LENGTH];
+    time_t now = 0;
 
     vsnprintf(message, sizeof(message), s, args);
+    lock_basic_lock(&log_write_lock);
 
 #ifdef HAVE_SYSLOG_H
     if (logging_to_syslog) {
@@ -231,20 +707,43 @@ ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
 #else
         syslog(priority, "%s", message);
 #endif
+        lock_basic_unlock(&log_write_lock);
         return;
     }
 #endif /* HAVE_SYSLOG_H */
 
-    if (!logfile) {
-        return;
+    if (logfile) {
+        now = time_now();
+        (void) ctime_r(&now, nowstr);
+        nowstr[CTIME_LENGTH-2] = '\0'; /* remove trailing linefeed */
+        fprintf(logfile, "[%s] %s[%i] %s: %s\n", nowstr,
+            MY_PACKAGE_TARNAME, priority, t, message);
+        fflush(logfile);
     }
+    lock_basic_unlock(&log_write_lock);
+    return;
+}
 
-    (void) ctime_r(&now, nowstr);
-    nowstr[CTIME_LENGTH-2] = '\0'; /* remove trailing linefeed */
 
-    fprintf(logfile, "[%s] %s[%i] %s: %s\n", nowstr,
-        MY_PACKAGE_TARNAME, priority, t, message);
-    fflush(logfile);
+/**
+ * Log message wrapper.
+ *
+ */
+static void
+ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
+{
+#ifdef HAVE_PTHREAD
+    va_list copy;
+    int queued = 0;
+    va_copy(copy, args);
+    queued = ods_log_enqueue(priority, t, s, copy);
+    va_end(copy);
+    if (queued) {
+        return;
+    }
+#endif /* HAVE_PTHREAD */
+    ods_log_vmsg_sync(priority, t, s, args);
+    return;
 }
 
 
@@ -257,7 +756,7 @@ ods_log_deeebug(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_DEEEBUG) {
+    if (ods_log_level >= LOG_DEEEBUG) {
         ods_log_vmsg(LOG_DEBUG, "debug  ", format, args);
     }
     va_end(args);
@@ -273,7 +772,7 @@ ods_log_debug(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_DEBUG) {
+    if (ods_log_level >= LOG_DEBUG) {
         ods_log_vmsg(LOG_DEBUG, "debug  ", format, args);
     }
     va_end(args);
@@ -289,7 +788,7 @@ ods_log_verbose(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_INFO) {
+    if (ods_log_level >= LOG_INFO) {
         ods_log_vmsg(LOG_INFO, "verbose", format, args);
     }
     va_end(args);
@@ -305,7 +804,7 @@ ods_log_info(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_NOTICE) {
+    if (ods_log_level >= LOG_NOTICE) {
         ods_log_vmsg(LOG_NOTICE, "msg    ", format, args);
     }
     va_end(args);
@@ -321,7 +820,7 @@ ods_log_warning(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_WARNING) {
+    if (ods_log_level >= LOG_WARNING) {
         ods_log_vmsg(LOG_WARNING, "warning", format, args);
     }
     va_end(args);
@@ -337,7 +836,7 @@ ods_log_error(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_ERR) {
+    if (ods_log_level >= LOG_ERR) {
         ods_log_vmsg(LOG_ERR, "error  ", format, args);
     }
     va_end(args);
@@ -353,7 +852,7 @@ ods_log_crit(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_CRIT) {
+    if (ods_log_level >= LOG_CRIT) {
         ods_log_vmsg(LOG_CRIT, "crit   ", format, args);
     }
     va_end(args);
@@ -369,7 +868,7 @@ ods_log_alert(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_ALERT) {
+    if (ods_log_level >= LOG_ALERT) {
         ods_log_vmsg(LOG_ALERT, "alert  ", format, args);
     }
     va_end(args);
@@ -384,9 +883,13 @@ void
 ods_fatal_exit(const char *format, ...)
 {
     va_list args;
+#ifdef HAVE_PTHREAD
+    /* get the pending messages out before we go, the writer keeps running */
+    ods_log_async_flush();
+#endif /* HAVE_PTHREAD */
     va_start(args, format);
-    if (log_level >= LOG_CRIT) {
-        ods_log_vmsg(LOG_CRIT, "fatal  ", format, args);
+    if (ods_log_level >= LOG_CRIT) {
+        ods_log_vmsg_sync(LOG_CRIT, "fatal  ", format, args);
     }
     va_end(args);
     abort();
@@ -59,6 +59,7 @@
  * \param[in] filename logfile, stderr if NULL.
  * \param[in] use_syslog: use syslog(3) and ingore filename
  * \param[in] verbosity: log level
+ * Asynchronous logging, if running, continues on the new target.
  *
  */
 void ods_log_init(const char *filename, int use_syslog, int verbosity);
@@ -69,6 +70,22 @@ void ods_log_init(const char *filename, int use_syslog, int verbosity);
  */
 void ods_log_close(void);
 
+/**
+ * Start asynchronous logging: threads queue their messages and a writer
+ * thread writes them to the logfile. Not used when logging to syslog.
+ * Start it after forking, the writer thread does not survive fork().
+ * A thread whose queue is full waits for the writer.
+ *
+ */
+void ods_log_async_start(void);
+
+/**
+ * Stop asynchronous logging, after writing the queued messages.
+ * Only the thread that started it can stop it.
+ *
+ */
+void ods_log_async_stop(void);
+
 /**
  * Get the facility by string.
  * \param[in] facility string based facility
@@ -147,6 +164,31 @@ void ods_log_alert(const char *format, ...);
  */
 void ods_fatal_exit(const char *format, ...);
 
+/**
+ * Level checks, so that disabled debug messages don't cost a function
+ * call or the evaluation of their arguments. Define ODS_LOG_MAX_LEVEL
+ * to compile the noisier levels out altogether.
+ *
+ */
+#ifndef ODS_LOG_MAX_LEVEL
+#define ODS_LOG_MAX_LEVEL LOG_DEEEBUG
+#endif
+extern int ods_log_level;
+#define ods_log_enabled(level) \
+	((level) <= ODS_LOG_MAX_LEVEL && ods_log_level >= (level))
+#define ods_log_deeebug(...) \
+	do { if (ods_log_enabled(LOG_DEEEBUG)) \
+		(ods_log_deeebug)(__VA_ARGS__); \
+	} while (0)
+#define ods_log_debug(...) \
+	do { if (ods_log_enabled(LOG_DEBUG)) \
+		(ods_log_debug)(__VA_ARGS__); \
+	} while (0)
+#define ods_log_verbose(...) \
+	do { if (ods_log_enabled(LOG_INFO)) \
+		(ods_log_verbose)(__VA_ARGS__); \
+	} while (0)
+
 /**
  * Log assertion.
  *
@@ -36,9 +36,11 @@
 #include "shared/log.h"
 #include "shared/util.h"
 
+#include <ctype.h>
 #include <fcntl.h>
 #include <ldns/ldns.h>
 #include <signal.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -133,6 +135,76 @@ util_soa_compare(ldns_rr* rr1, ldns_rr* rr2)
 }
 
 
+/**
+ * Make a name index key.
+ * Label bytes 0 and 1 are escaped as 1 1 and 1 2, so that the 0 that
+ * ends each label sorts a label before any longer label it prefixes.
+ *
+ */
+size_t
+util_dname_key(ldns_rdf* dname, uint8_t* key, size_t offset)
+{
+    uint8_t* wire = NULL;
+    size_t labels[128];
+    size_t count = 0;
+    size_t size = 0;
+    size_t pos = 0;
+    size_t len = 0;
+    size_t i = 0;
+    uint8_t c = 0;
+    if (!dname || !key || offset > 8 ||
+        ldns_rdf_get_type(dname) != LDNS_RDF_TYPE_DNAME) {
+        return 0;
+    }
+    wire = ldns_rdf_data(dname);
+    size = ldns_rdf_size(dname);
+    while (pos < size && wire[pos]) {
+        if (count >= 128 || pos + wire[pos] >= size) {
+            return 0;
+        }
+        labels[count++] = pos;
+        pos += wire[pos] + 1;
+    }
+    len = 2 + offset;
+    while (count > 0) {
+        pos = labels[--count];
+        for (i = 1; i <= wire[pos]; i++) {
+            c = (uint8_t) tolower((int) wire[pos+i]);
+            if (c < 2) {
+                key[len++] = 1;
+                c++;
+            }
+            key[len++] = c;
+        }
+        key[len++] = 0;
+    }
+    key[0] = (uint8_t) ((len - 2) >> 8);
+    key[1] = (uint8_t) ((len - 2) & 0xff);
+    return len;
+}
+
+
+/**
+ * Compare name index keys.
+ *
+ */
+int
+util_dname_key_compare(const void* a, const void* b)
+{
+    const uint8_t* x = (const uint8_t*) a;
+    const uint8_t* y = (const uint8_t*) b;
+    size_t xlen = ((size_t) x[0] << 8) | x[1];
+    size_t ylen = ((size_t) y[0] << 8) | y[1];
+    int cmp = memcmp(x + 2, y + 2, xlen < ylen ? xlen : ylen);
+    if (cmp) {
+        return cmp;
+    }
+    if (xlen != ylen) {
+        return xlen < ylen ? -1 : 1;
+    }
+    return 0;
+}
+
 
 /**
  * Compare RRs only on RDATA.
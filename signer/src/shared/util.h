@@ -79,6 +79,34 @@ int util_serial_gt(uint32_t serial_new, uint32_t serial_old);
  */
 int util_soa_compare(ldns_rr* rr1, ldns_rr* rr2);
 
+/**
+ * Size of a buffer that holds any key made by util_dname_key().
+ *
+ */
+#define UTIL_DNAME_KEY_SIZE 520
+
+/**
+ * Make a name index key: a two byte length, followed by offset bytes
+ * filled in by the caller and the domain name with its labels reversed
+ * and lowercased. Keys compare with util_dname_key_compare() in the
+ * canonical order of ldns_dname_compare(), without parsing labels.
+ * \param[in] dname domain name
+ * \param[out] key key buffer of UTIL_DNAME_KEY_SIZE bytes
+ * \param[in] offset number of prefix bytes after the length, at most 8
+ * eturn size_t number of bytes in the key, 0 on error
+ *
+ */
+size_t util_dname_key(ldns_rdf* dname, uint8_t* key, size_t offset);
+
+/**
+ * Compare name index keys.
+ * \param[in] a key
+ * \param[in] b another key
+ * eturn int <0, 0 or >0, like memcmp()
+ *
+ */
+int util_dname_key_compare(const void* a, const void* b);
+
 /**
  * Compare RRs only on RDATA.
  * \param[in] rr1 RR
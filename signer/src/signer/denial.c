@@ -37,6 +37,8 @@
 #include "signer/domain.h"
 #include "signer/zone.h"
 
+#include <string.h>
+
 #define SE_MAX_RRTYPE_COUNT 65536
 
 static const char* denial_str = "denial";
@@ -62,16 +64,44 @@ denial_create(void* zoneptr, ldns_rdf* dname)
         return NULL;
     }
     denial->dname = dname;
+    denial->hash = NULL;
     denial->zone = zoneptr;
     denial->domain = NULL; /* no back reference yet */
     denial->node = NULL; /* not in db yet */
     denial->rrset = NULL;
+    denial->dirty_prev = NULL;
+    denial->dirty_next = NULL;
     denial->bitmap_changed = 0;
     denial->nxt_changed = 0;
+    denial->is_dirty = 0;
     return denial;
 }
 
 
+/**
+ * Set the NSEC3 hash.
+ *
+ */
+ods_status
+denial_set_hash(denial_type* denial, const uint8_t* hash, size_t hash_len)
+{
+    zone_type* zone = NULL;
+    if (!denial || !hash || !hash_len || hash_len > 255) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    zone = (zone_type*) denial->zone;
+    denial->hash = (uint8_t*) allocator_alloc(zone->allocator, hash_len + 1);
+    if (!denial->hash) {
+        ods_log_error("[%s] unable to set hash: allocator_alloc() failed",
+            denial_str);
+        return ODS_STATUS_MALLOC_ERR;
+    }
+    denial->hash[0] = (uint8_t) hash_len;
+    memcpy(denial->hash + 1, hash, hash_len);
+    return ODS_STATUS_OK;
+}
+
+
 /**
  * Create NSEC(3) Type Bitmaps Field.
  *
@@ -82,24 +112,27 @@ denial_create_bitmap(denial_type* denial, ldns_rr_type types[],
 {
     domain_type* domain = NULL;
     rrset_type* rrset = NULL;
+    ldns_rr_type dstatus = LDNS_RR_TYPE_FIRST;
 
     ods_log_assert(denial);
     ods_log_assert(denial->domain);
 
     domain = (domain_type*) denial->domain;
+    dstatus = domain_is_occluded(domain);
+    if (dstatus != LDNS_RR_TYPE_SOA) {
+        /* Occluded: no types */
+        return;
+    }
+    /* Authoritative or delegation */
+    dstatus = domain_is_delegpt(domain);
     rrset = domain->rrsets;
     while (rrset) {
-        ldns_rr_type dstatus = domain_is_occluded(domain);
-        if (dstatus == LDNS_RR_TYPE_SOA) {
-            /* Authoritative or delegation */
-            dstatus = domain_is_delegpt(domain);
-            if (dstatus == LDNS_RR_TYPE_SOA ||
-                rrset->rrtype == LDNS_RR_TYPE_NS ||
-                rrset->rrtype == LDNS_RR_TYPE_DS) {
+        if (dstatus == LDNS_RR_TYPE_SOA ||
+            rrset->rrtype == LDNS_RR_TYPE_NS ||
+            rrset->rrtype == LDNS_RR_TYPE_DS) {
 
-                types[*types_count] = rrset->rrtype;
-                *types_count = *types_count + 1;
-            }
+            types[*types_count] = rrset->rrtype;
+            *types_count = *types_count + 1;
         }
         rrset = rrset->next;
     }
@@ -108,41 +141,26 @@ denial_create_bitmap(denial_type* denial, ldns_rr_type types[],
 
 
 /**
- * Create NSEC3 Next Hashed Owner Name Field.
+ * Create NSEC3 Next Hashed Owner Name Field, from the raw hash of the next
+ * denial.
  *
  */
 static ldns_rdf*
-denial_create_nsec3_nxt(ldns_rdf* nxt)
+denial_create_nsec3_nxt(denial_type* nxt)
 {
-    ldns_status status = LDNS_STATUS_OK;
-    ldns_rdf* next_owner_label = NULL;
     ldns_rdf* next_owner_rdf = NULL;
-    char* next_owner_string = NULL;
-
     ods_log_assert(nxt);
-    next_owner_label = ldns_dname_label(nxt, 0);
-    if (!next_owner_label) {
-        ods_log_alert("[%s] unable to create NSEC3 Next: "
-            "ldns_dname_label() failed", denial_str);
-        return NULL;
-    }
-    next_owner_string = ldns_rdf2str(next_owner_label);
-    if (!next_owner_string) {
-        ods_log_alert("[%s] unable to create NSEC3 Next: "
-            "ldns_rdf2str() failed", denial_str);
-        ldns_rdf_deep_free(next_owner_label);
+    if (!nxt->hash) {
+        ods_log_alert("[%s] unable to create NSEC3 Next: next denial has "
+            "no hash", denial_str);
         return NULL;
     }
-    if (next_owner_string[strlen(next_owner_string)-1] == '.') {
-        next_owner_string[strlen(next_owner_string)-1] = '\0';
-    }
-    status = ldns_str2rdf_b32_ext(&next_owner_rdf, next_owner_string);
-    if (status != LDNS_STATUS_OK) {
+    next_owner_rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_NSEC3_NEXT_OWNER,
+        (size_t) nxt->hash[0] + 1, nxt->hash);
+    if (!next_owner_rdf) {
         ods_log_alert("[%s] unable to create NSEC3 Next: "
-            "ldns_str2rdf_b32_ext() failed", denial_str);
+            "ldns_rdf_new_frm_data() failed", denial_str);
     }
-    free((void*)next_owner_string);
-    ldns_rdf_deep_free(next_owner_label);
     return next_owner_rdf;
 }
 
@@ -198,7 +216,7 @@ denial_create_nsec(denial_type* denial, denial_type* nxt, uint32_t ttl,
     }
     /* NXT */
     if (n3p) {
-        rdf = denial_create_nsec3_nxt(nxt->dname);
+        rdf = denial_create_nsec3_nxt(nxt);
     } else {
         rdf = ldns_rdf_clone(nxt->dname);
     }
@@ -209,7 +227,26 @@ denial_create_nsec(denial_type* denial, denial_type* nxt, uint32_t ttl,
         return NULL;
     }
     ldns_rr_push_rdf(nsec_rr, rdf);
-    /* Type Bit Maps */
+    /* Type Bit Maps: unchanged types, reuse the current bitmap */
+    if (!denial->bitmap_changed && denial->rrset &&
+        denial->rrset->rr_count == 1 &&
+        ldns_rr_get_type(denial->rrset->rrs[0].rr) == rrtype) {
+        rdf = ldns_rr_rdf(denial->rrset->rrs[0].rr,
+            n3p?SE_NSEC3_RDATA_BITMAP:SE_NSEC_RDATA_BITMAP);
+        if (rdf) {
+            rdf = ldns_rdf_clone(rdf);
+            if (!rdf) {
+                ods_log_alert("[%s] unable to create NSEC(3) RR: "
+                    "ldns_rdf_clone(bitmap) failed", denial_str);
+                ldns_rr_free(nsec_rr);
+                return NULL;
+            }
+            ldns_rr_push_rdf(nsec_rr, rdf);
+            ldns_rr_set_ttl(nsec_rr, ttl);
+            ldns_rr_set_class(nsec_rr, klass);
+            return nsec_rr;
+        }
+    }
     denial_create_bitmap(denial, types, &types_count);
     if (n3p) {
         domain = (domain_type*) denial->domain;
@@ -322,6 +359,15 @@ denial_nsecify(denial_type* denial, denial_type* nxt, uint32_t* num_added)
             ods_fatal_exit("[%s] unable to nsecify: denial_create_nsec() "
                 "failed", denial_str);
         }
+        if (denial->rrset && denial->rrset->rr_count == 1 &&
+            ldns_rr_ttl(denial->rrset->rrs[0].rr) == ttl &&
+            ldns_rr_compare(denial->rrset->rrs[0].rr, nsec_rr) == 0) {
+            /* NSEC(3) did not change, keep its signatures */
+            ldns_rr_free(nsec_rr);
+            denial->bitmap_changed = 0;
+            denial->nxt_changed = 0;
+            return;
+        }
         denial_add_rr(denial, nsec_rr);
         if (num_added) {
             (*num_added)++;
@@ -366,6 +412,7 @@ denial_cleanup(denial_type* denial)
     }
     zone = (zone_type*) denial->zone;
     ldns_rdf_deep_free(denial->dname);
+    allocator_deallocate(zone->allocator, (void*) denial->hash);
     rrset_cleanup(denial->rrset);
     allocator_deallocate(zone->allocator, (void*) denial);
     return;
@@ -53,9 +53,13 @@ struct denial_struct {
     void* domain;
     ldns_rbnode_t* node;
     ldns_rdf* dname;
+    uint8_t* hash; /* NSEC3: raw hash of the original owner, length first */
     rrset_type* rrset;
+    denial_type* dirty_prev; /* changed denials, see namedb */
+    denial_type* dirty_next;
     unsigned bitmap_changed : 1;
     unsigned nxt_changed : 1;
+    unsigned is_dirty : 1; /* changed since the last sign */
 };
 
 /**
@@ -67,6 +71,17 @@ struct denial_struct {
  */
 denial_type* denial_create(void* zoneptr, ldns_rdf* dname);
 
+/**
+ * Set the NSEC3 hash of the Denial of Existence data point.
+ * \param[in] denial Denial of Existence data point
+ * \param[in] hash raw hash
+ * \param[in] hash_len hash length
+ * \return ods_status status
+ *
+ */
+ods_status denial_set_hash(denial_type* denial, const uint8_t* hash,
+    size_t hash_len);
+
 /**
  * Apply differences at denial.
  * \param[in] denial Denial of Existence data point
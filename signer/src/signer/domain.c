@@ -114,8 +114,14 @@ domain_create(void* zoneptr, ldns_rdf* dname)
     domain->node = NULL; /* not in db yet */
     domain->rrsets = NULL;
     domain->parent = NULL;
+    domain->dirty_prev = NULL;
+    domain->dirty_next = NULL;
+    domain->delegpt = LDNS_RR_TYPE_FIRST;
+    domain->occluded = 0;
     domain->is_apex = 0;
     domain->is_new = 0;
+    domain->is_dirty = 0;
+    domain->is_sealed = 0;
     return domain;
 }
 
@@ -183,6 +189,30 @@ domain_lookup_rrset(domain_type* domain, ldns_rr_type rrtype)
 }
 
 
+/**
+ * Invalidate cached delegation and occlusion status after an RRset of
+ * this type was added to or deleted from the domain.
+ *
+ */
+static void
+domain_rrset_changed(domain_type* domain, ldns_rr_type rrtype)
+{
+    zone_type* zone = (zone_type*) domain->zone;
+    if (rrtype == LDNS_RR_TYPE_NS || rrtype == LDNS_RR_TYPE_DS) {
+        domain->delegpt = LDNS_RR_TYPE_FIRST;
+    }
+    if ((rrtype == LDNS_RR_TYPE_NS || rrtype == LDNS_RR_TYPE_DNAME) &&
+        zone && zone->db) {
+        /* occlusion of the whole subtree may change */
+        zone->db->occluded_gen = (zone->db->occluded_gen + 1) & 0x3fffffff;
+        if (!zone->db->occluded_gen) {
+            zone->db->occluded_gen = 1;
+        }
+    }
+    return;
+}
+
+
 /**
  * Add RRset to domain.
  *
@@ -210,6 +240,7 @@ domain_add_rrset(domain_type* domain, rrset_type* rrset)
         denial = (denial_type*) domain->denial;
         denial->bitmap_changed = 1;
     }
+    domain_rrset_changed(domain, rrset->rrtype);
     return;
 }
 
@@ -241,6 +272,7 @@ domain_del_rrset(domain_type* domain, ldns_rr_type rrtype)
             denial = (denial_type*) domain->denial;
             denial->bitmap_changed = 1;
         }
+        domain_rrset_changed(domain, rrtype);
         return cur;
     }
     cur = domain->rrsets;
@@ -264,6 +296,7 @@ domain_del_rrset(domain_type* domain, ldns_rr_type rrtype)
                 denial = (denial_type*) domain->denial;
                 denial->bitmap_changed = 1;
             }
+            domain_rrset_changed(domain, rrtype);
             return cur;
         }
     }
@@ -305,6 +338,7 @@ domain_diff(domain_type* domain, unsigned is_ixfr, unsigned more_coming)
             }
             rrset->next = NULL;
             log_rrset(domain->dname, rrset->rrtype, "-RRSET", LOG_DEEEBUG);
+            domain_rrset_changed(domain, rrset->rrtype);
             rrset_cleanup(rrset);
             if (!prev_rrset) {
                 rrset = domain->rrsets;
@@ -325,6 +359,26 @@ domain_diff(domain_type* domain, unsigned is_ixfr, unsigned more_coming)
 }
 
 
+/**
+ * Apply added RRs at domain, ahead of the transaction.
+ *
+ */
+void
+domain_commit_added(domain_type* domain)
+{
+    rrset_type* rrset = NULL;
+    if (!domain) {
+        return;
+    }
+    rrset = domain->rrsets;
+    while (rrset) {
+        rrset_commit_added(rrset);
+        rrset = rrset->next;
+    }
+    return;
+}
+
+
 /**
  * Rollback differences at domain.
  *
@@ -333,14 +387,17 @@ void
 domain_rollback(domain_type* domain, int keepsc)
 {
     denial_type* denial = NULL;
+    zone_type* zone = NULL;
     rrset_type* rrset = NULL;
     rrset_type* prev_rrset = NULL;
     ldns_rr* del_rr = NULL;
     int del_rrset = 0;
+    int del_sigs = 0;
     uint16_t i = 0;
     if (!domain) {
         return;
     }
+    zone = (zone_type*) domain->zone;
     rrset = domain->rrsets;
     while (rrset) {
         if (keepsc) {
@@ -353,9 +410,19 @@ domain_rollback(domain_type* domain, int keepsc)
             }
         }
         /* walk rrs */
+        del_sigs = 0;
         for (i=0; i < rrset->rr_count; i++) {
             rrset->rrs[i].is_added = 0;
             rrset->rrs[i].is_removed = 0;
+            if (rrset->rrs[i].is_pending) {
+                /* committed ahead of the transaction, take back ixfr +RR */
+                lock_basic_lock(&zone->ixfr->ixfr_lock);
+                (void) ixfr_undo_add_rr(zone->ixfr, rrset->rrs[i].rr);
+                lock_basic_unlock(&zone->ixfr->ixfr_lock);
+                rrset->rrs[i].exists = 0;
+                rrset->rrs[i].is_pending = 0;
+                del_sigs = 1;
+            }
             if (!rrset->rrs[i].exists) {
                 /* can we delete the RRset? */
                 if(rrset->rr_count == 1) {
@@ -368,6 +435,23 @@ domain_rollback(domain_type* domain, int keepsc)
                 i--;
             }
         }
+        if (del_sigs) {
+            /**
+             * The RRset was signed while the zone was being read. Only a
+             * first read is pipelined, so none of its RRSIGs has been
+             * published yet: take them back as well.
+             */
+            while (rrset->rrsig_count > 0) {
+                del_rr = rrset->rrsigs[0].rr;
+                lock_basic_lock(&zone->ixfr->ixfr_lock);
+                (void) ixfr_undo_add_rr(zone->ixfr, del_rr);
+                lock_basic_unlock(&zone->ixfr->ixfr_lock);
+                rrset_del_rrsig(rrset, 0);
+                ldns_rr_free(del_rr);
+                del_rr = NULL;
+            }
+            rrset->needs_signing = 1;
+        }
         /* next rrset */
         if (del_rrset) {
             /* delete entire rrset */
@@ -378,6 +462,7 @@ domain_rollback(domain_type* domain, int keepsc)
             }
             rrset->next = NULL;
             log_rrset(domain->dname, rrset->rrtype, "-RRSET", LOG_DEEEBUG);
+            domain_rrset_changed(domain, rrset->rrtype);
             rrset_cleanup(rrset);
             if (!prev_rrset) {
                 rrset = domain->rrsets;
@@ -435,55 +520,136 @@ domain_ent2unsignedns(domain_type* domain)
 
 /**
  * Check whether the domain is a delegation point.
+ * Cached until an NS or DS RRset at the domain comes or goes.
  *
  */
 ldns_rr_type
 domain_is_delegpt(domain_type* domain)
 {
+    ldns_rr_type delegpt = LDNS_RR_TYPE_SOA;
     ods_log_assert(domain);
     if (domain->is_apex) {
         return LDNS_RR_TYPE_SOA;
     }
+    if (domain->delegpt != LDNS_RR_TYPE_FIRST) {
+        return domain->delegpt;
+    }
     if (domain_lookup_rrset(domain, LDNS_RR_TYPE_NS)) {
         if (domain_lookup_rrset(domain, LDNS_RR_TYPE_DS)) {
             /* Signed delegation */
-            return LDNS_RR_TYPE_DS;
+            delegpt = LDNS_RR_TYPE_DS;
         } else {
             /* Unsigned delegation */
-            return LDNS_RR_TYPE_NS;
+            delegpt = LDNS_RR_TYPE_NS;
         }
     }
-    /* Authoritative */
-    return LDNS_RR_TYPE_SOA;
+    /* else Authoritative */
+    domain->delegpt = delegpt;
+    return delegpt;
+}
+
+
+/**
+ * Decode a cached occlusion status.
+ *
+ */
+static ldns_rr_type
+domain_occluded_type(uint32_t cached)
+{
+    switch (cached & 0x3) {
+        case 1:
+            return LDNS_RR_TYPE_A;
+        case 2:
+            return LDNS_RR_TYPE_DNAME;
+        default:
+            return LDNS_RR_TYPE_SOA;
+    }
 }
 
 
 /**
  * Check whether the domain is occluded.
+ * The result is cached together with the generation of the name database
+ * it was computed in, so that NS or DNAME changes anywhere above the domain
+ * invalidate it. Value and generation share one word, as drudgers may fill
+ * the cache concurrently.
  *
  */
 ldns_rr_type
 domain_is_occluded(domain_type* domain)
 {
+    zone_type* zone = NULL;
     domain_type* parent = NULL;
+    ldns_rr_type occluded = LDNS_RR_TYPE_SOA;
+    uint32_t gen = 0;
+    uint32_t cached = 0;
     ods_log_assert(domain);
     if (domain->is_apex) {
         return LDNS_RR_TYPE_SOA;
     }
+    if (domain->is_sealed) {
+        /* resolved before the domain was handed out, see domain_seal() */
+        return domain_occluded_type(domain->occluded);
+    }
+    zone = (zone_type*) domain->zone;
+    if (zone && zone->db) {
+        gen = zone->db->occluded_gen;
+    }
+    cached = domain->occluded;
+    if (gen && (cached >> 2) == gen) {
+        return domain_occluded_type(cached);
+    }
     parent = domain->parent;
-    while (parent && !parent->is_apex) {
+    if (parent && !parent->is_apex) {
         if (domain_lookup_rrset(parent, LDNS_RR_TYPE_NS)) {
             /* Glue / Empty non-terminal to Glue */
-            return LDNS_RR_TYPE_A;
-        }
-        if (domain_lookup_rrset(parent, LDNS_RR_TYPE_DNAME)) {
+            occluded = LDNS_RR_TYPE_A;
+        } else if (domain_lookup_rrset(parent, LDNS_RR_TYPE_DNAME)) {
             /* Occluded data / Empty non-terminal to Occluded data */
-            return LDNS_RR_TYPE_DNAME;
+            occluded = LDNS_RR_TYPE_DNAME;
+        } else {
+            occluded = domain_is_occluded(parent);
+        }
+    }
+    /* else Authoritative or delegation */
+    if (gen) {
+        cached = (gen << 2);
+        if (occluded == LDNS_RR_TYPE_A) {
+            cached |= 1;
+        } else if (occluded == LDNS_RR_TYPE_DNAME) {
+            cached |= 2;
         }
-        parent = parent->parent;
+        domain->occluded = cached;
     }
-    /* Authoritative or delegation */
-    return LDNS_RR_TYPE_SOA;
+    return occluded;
+}
+
+
+/**
+ * Seal domain.
+ *
+ */
+void
+domain_seal(domain_type* domain)
+{
+    ods_log_assert(domain);
+    (void) domain_is_delegpt(domain);
+    (void) domain_is_occluded(domain);
+    domain->is_sealed = 1;
+    return;
+}
+
+
+/**
+ * Unseal domain.
+ *
+ */
+void
+domain_unseal(domain_type* domain)
+{
+    ods_log_assert(domain);
+    domain->is_sealed = 0;
+    return;
 }
 
 
@@ -60,8 +60,14 @@ struct domain_struct {
     ldns_rdf* dname;
     domain_type* parent;
     rrset_type* rrsets;
+    domain_type* dirty_prev; /* changed domains, see namedb */
+    domain_type* dirty_next;
+    ldns_rr_type delegpt; /* cached domain_is_delegpt(), 0 if unknown */
+    uint32_t occluded; /* cached domain_is_occluded(), see namedb */
     unsigned is_new : 1;
     unsigned is_apex : 1; /* apex */
+    unsigned is_dirty : 1; /* changed since the last sign */
+    unsigned is_sealed : 1; /* status cached, handed to the drudgers */
 };
 
 /**
@@ -133,6 +139,13 @@ rrset_type* domain_del_rrset(domain_type* domain, ldns_rr_type rrtype);
  */
 void domain_diff(domain_type* domain, unsigned is_ixfr, unsigned more_coming);
 
+/**
+ * Apply added RRs at domain, ahead of the transaction.
+ * \param[in] domain domain
+ *
+ */
+void domain_commit_added(domain_type* domain);
+
 /**
  * Rollback differences at domain.
  * \param[in] domain domain
@@ -171,6 +184,23 @@ ldns_rr_type domain_is_delegpt(domain_type* domain);
  */
 ldns_rr_type domain_is_occluded(domain_type* domain);
 
+/**
+ * Resolve the delegation and occlusion status of a domain and seal it, so
+ * that domain_is_delegpt() and domain_is_occluded() only read the cached
+ * status until domain_unseal(). Used while drudgers sign the domain and
+ * the zone is still being read.
+ * \param[in] domain domain
+ *
+ */
+void domain_seal(domain_type* domain);
+
+/**
+ * Let the status of a sealed domain be computed again.
+ * \param[in] domain domain
+ *
+ */
+void domain_unseal(domain_type* domain);
+
 /**
  * Print domain.
  * \param[in] fd file descriptor
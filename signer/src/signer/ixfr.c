@@ -186,6 +186,49 @@ ixfr_del_rr(ixfr_type* ixfr, ldns_rr* rr)
 }
 
 
+/**
+ * Take back a +RR that was added to the ixfr journal.
+ *
+ */
+int
+ixfr_undo_add_rr(ixfr_type* ixfr, ldns_rr* rr)
+{
+    zone_type* zone = NULL;
+    ldns_rr_list* plus = NULL;
+    size_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    if (!ixfr || !rr) {
+        return 0;
+    }
+    zone = (zone_type*) ixfr->zone;
+    ods_log_assert(zone);
+    ods_log_assert(zone->db);
+    if (!zone->db->is_initialized) {
+        /* no ixfr yet */
+        return 0;
+    }
+    ods_log_assert(ixfr->part[0]);
+    plus = ixfr->part[0]->plus;
+    ods_log_assert(plus);
+    count = ldns_rr_list_rr_count(plus);
+    /* most likely one of the last +RRs */
+    for (i = count; i > 0; i--) {
+        if (ldns_rr_list_rr(plus, i-1) == rr) {
+            for (j = i-1; j+1 < count; j++) {
+                (void) ldns_rr_list_set_rr(plus, ldns_rr_list_rr(plus, j+1), j);
+            }
+            (void) ldns_rr_list_pop_rr(plus);
+            if (ixfr->part[0]->soaplus == rr) {
+                ixfr->part[0]->soaplus = NULL;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
 /**
  * Print all RRs in list, except SOA RRs.
  *
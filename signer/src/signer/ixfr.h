@@ -88,6 +88,15 @@ void ixfr_add_rr(ixfr_type* ixfr, ldns_rr* rr);
  */
 void ixfr_del_rr(ixfr_type* ixfr, ldns_rr* rr);
 
+/**
+ * Take back a +RR that was added to the ixfr journal.
+ * \param[in] ixfr journal
+ * \param[in] rr +RR
+ * \return int 1 if the +RR was in the journal, 0 otherwise
+ *
+ */
+int ixfr_undo_add_rr(ixfr_type* ixfr, ldns_rr* rr);
+
 /**
  * Print the ixfr journal.
  * \param[in] fd file descriptor
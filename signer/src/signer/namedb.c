@@ -33,6 +33,7 @@
 
 #include "config.h"
 #include "shared/allocator.h"
+#include "shared/duration.h"
 #include "shared/file.h"
 #include "shared/log.h"
 #include "shared/util.h"
@@ -40,53 +41,83 @@
 #include "signer/namedb.h"
 #include "signer/zone.h"
 
+#include <string.h>
+
 const char* db_str = "namedb";
 
 
 /**
- * Convert a domain to a tree node.
+ * Make a tree node, with the name index key stored right behind it.
  *
  */
 static ldns_rbnode_t*
-domain2node(domain_type* domain)
+dname2node(ldns_rdf* dname, void* data)
 {
-    ldns_rbnode_t* node = (ldns_rbnode_t*) malloc(sizeof(ldns_rbnode_t));
+    uint8_t key[UTIL_DNAME_KEY_SIZE];
+    size_t len = util_dname_key(dname, key, 0);
+    ldns_rbnode_t* node = NULL;
+    if (!len) {
+        return NULL;
+    }
+    node = (ldns_rbnode_t*) malloc(sizeof(ldns_rbnode_t) + len);
     if (!node) {
         return NULL;
     }
-    node->key = domain->dname;
-    node->data = domain;
+    memcpy((uint8_t*) (node + 1), key, len);
+    node->key = (uint8_t*) (node + 1);
+    node->data = data;
     return node;
 }
 
 
 /**
- * Convert a denial to a tree node.
+ * Convert a domain to a tree node.
  *
  */
 static ldns_rbnode_t*
-denial2node(denial_type* denial)
+domain2node(domain_type* domain)
 {
-    ldns_rbnode_t* node = (ldns_rbnode_t*) malloc(sizeof(ldns_rbnode_t));
-    if (!node) {
-        return NULL;
-    }
-    node->key = denial->dname;
-    node->data = denial;
-    return node;
+    return dname2node(domain->dname, domain);
 }
 
 
 /**
- * Compare domains.
+ * Make the denial key of an NSEC3 hash: the raw hash sorts like the hashed
+ * owner names, and is much shorter to compare.
  *
  */
-static int
-domain_compare(const void* a, const void* b)
+static size_t
+hash2key(const uint8_t* hash, uint8_t* key)
 {
-    ldns_rdf* x = (ldns_rdf*)a;
-    ldns_rdf* y = (ldns_rdf*)b;
-    return ldns_dname_compare(x, y);
+    key[0] = 0;
+    key[1] = hash[0];
+    memcpy(key + 2, hash + 1, hash[0]);
+    return (size_t) hash[0] + 2;
+}
+
+
+/**
+ * Convert a denial to a tree node.
+ *
+ */
+static ldns_rbnode_t*
+denial2node(denial_type* denial)
+{
+    uint8_t key[UTIL_DNAME_KEY_SIZE];
+    size_t len = 0;
+    ldns_rbnode_t* node = NULL;
+    if (!denial->hash) {
+        return dname2node(denial->dname, denial);
+    }
+    len = hash2key(denial->hash, key);
+    node = (ldns_rbnode_t*) malloc(sizeof(ldns_rbnode_t) + len);
+    if (!node) {
+        return NULL;
+    }
+    memcpy((uint8_t*) (node + 1), key, len);
+    node->key = (uint8_t*) (node + 1);
+    node->data = denial;
+    return node;
 }
 
 
@@ -98,7 +129,7 @@ void
 namedb_init_denials(namedb_type* db)
 {
     if (db) {
-        db->denials = ldns_rbtree_create(domain_compare);
+        db->denials = ldns_rbtree_create(util_dname_key_compare);
     }
     return;
 }
@@ -112,7 +143,7 @@ static void
 namedb_init_domains(namedb_type* db)
 {
     if (db) {
-        db->domains = ldns_rbtree_create(domain_compare);
+        db->domains = ldns_rbtree_create(util_dname_key_compare);
     }
     return;
 }
@@ -162,6 +193,13 @@ namedb_create(void* zone)
     db->is_processed = 0;
     db->serial_updated = 0;
     db->force_serial = 0;
+    db->dirty_domains = NULL;
+    db->dirty_domains_last = NULL;
+    db->dirty_denials = NULL;
+    db->staged = NULL;
+    db->full_sign_time = 0;
+    db->occluded_gen = 1;
+    db->dirty_all = 1;
     return db;
 }
 
@@ -174,10 +212,11 @@ static void*
 namedb_domain_search(ldns_rbtree_t* tree, ldns_rdf* dname)
 {
     ldns_rbnode_t* node = LDNS_RBTREE_NULL;
-    if (!tree || !dname) {
+    uint8_t key[UTIL_DNAME_KEY_SIZE];
+    if (!tree || !dname || !util_dname_key(dname, key, 0)) {
         return NULL;
     }
-    node = ldns_rbtree_search(tree, dname);
+    node = ldns_rbtree_search(tree, key);
     if (node && node != LDNS_RBTREE_NULL) {
         return (void*) node->data;
     }
@@ -337,6 +376,158 @@ namedb_domain_entize(namedb_type* db, domain_type* domain, ldns_rdf* apex)
 }
 
 
+/**
+ * Unlink domain from the changed domains.
+ *
+ */
+static void
+namedb_unlink_domain(namedb_type* db, domain_type* domain)
+{
+    if (!domain->is_dirty) {
+        return;
+    }
+    if (domain->dirty_prev) {
+        domain->dirty_prev->dirty_next = domain->dirty_next;
+    } else {
+        db->dirty_domains = domain->dirty_next;
+    }
+    if (domain->dirty_next) {
+        domain->dirty_next->dirty_prev = domain->dirty_prev;
+    } else {
+        db->dirty_domains_last = domain->dirty_prev;
+    }
+    domain->dirty_prev = NULL;
+    domain->dirty_next = NULL;
+    domain->is_dirty = 0;
+    return;
+}
+
+
+/**
+ * Add domain to the changed domains, after its parents.
+ *
+ */
+static void
+namedb_link_domain(namedb_type* db, domain_type* domain)
+{
+    if (!domain || domain->is_dirty) {
+        return;
+    }
+    /* parents go first, like in the tree */
+    namedb_link_domain(db, domain->parent);
+    domain->dirty_prev = db->dirty_domains_last;
+    domain->dirty_next = NULL;
+    if (db->dirty_domains_last) {
+        db->dirty_domains_last->dirty_next = domain;
+    } else {
+        db->dirty_domains = domain;
+    }
+    db->dirty_domains_last = domain;
+    domain->is_dirty = 1;
+    return;
+}
+
+
+/**
+ * Unlink denial from the changed denials.
+ *
+ */
+static void
+namedb_unlink_denial(namedb_type* db, denial_type* denial)
+{
+    if (!denial->is_dirty) {
+        return;
+    }
+    if (denial->dirty_prev) {
+        denial->dirty_prev->dirty_next = denial->dirty_next;
+    } else {
+        db->dirty_denials = denial->dirty_next;
+    }
+    if (denial->dirty_next) {
+        denial->dirty_next->dirty_prev = denial->dirty_prev;
+    }
+    denial->dirty_prev = NULL;
+    denial->dirty_next = NULL;
+    denial->is_dirty = 0;
+    return;
+}
+
+
+/**
+ * Add denial to the changed denials.
+ *
+ */
+static void
+namedb_link_denial(namedb_type* db, denial_type* denial)
+{
+    if (!denial || denial->is_dirty) {
+        return;
+    }
+    denial->dirty_prev = NULL;
+    denial->dirty_next = db->dirty_denials;
+    if (db->dirty_denials) {
+        db->dirty_denials->dirty_prev = denial;
+    }
+    db->dirty_denials = denial;
+    denial->is_dirty = 1;
+    return;
+}
+
+
+/**
+ * Mark domain as changed.
+ *
+ */
+void
+namedb_dirty_domain(namedb_type* db, domain_type* domain,
+    ldns_rr_type rrtype)
+{
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    domain_type* sub = NULL;
+    if (!db || !domain) {
+        return;
+    }
+    namedb_link_domain(db, domain);
+    if (rrtype == LDNS_RR_TYPE_DNAME ||
+        (rrtype == LDNS_RR_TYPE_NS && !domain->is_apex)) {
+        /* names below may become (un)occluded, they follow in the tree */
+        if (domain->node) {
+            node = ldns_rbtree_next(domain->node);
+        }
+        while (node && node != LDNS_RBTREE_NULL) {
+            sub = (domain_type*) node->data;
+            if (!ldns_dname_is_subdomain(sub->dname, domain->dname)) {
+                break;
+            }
+            namedb_link_domain(db, sub);
+            node = ldns_rbtree_next(node);
+        }
+    }
+    return;
+}
+
+
+/**
+ * Forget about changed domains and denials.
+ *
+ */
+void
+namedb_clear_dirty(namedb_type* db)
+{
+    if (!db) {
+        return;
+    }
+    while (db->dirty_domains) {
+        namedb_unlink_domain(db, db->dirty_domains);
+    }
+    while (db->dirty_denials) {
+        namedb_unlink_denial(db, db->dirty_denials);
+    }
+    db->dirty_all = 0;
+    return;
+}
+
+
 /**
  * Lookup domain.
  *
@@ -407,13 +598,19 @@ namedb_del_domain(namedb_type* db, domain_type* domain)
         log_dname(domain->dname, "ERR -DOMAIN", LOG_ERR);
         return NULL;
     }
-    node = ldns_rbtree_delete(db->domains, (const void*)domain->dname);
+    if (!domain->node) {
+        ods_log_error("[%s] unable to delete domain: not found", db_str);
+        log_dname(domain->dname, "ERR -DOMAIN", LOG_ERR);
+        return NULL;
+    }
+    node = ldns_rbtree_delete(db->domains, domain->node->key);
     if (node) {
         ods_log_assert(domain->node == node);
         ods_log_assert(!domain->rrsets);
         ods_log_assert(!domain->denial);
         free((void*)node);
         domain->node = NULL;
+        namedb_unlink_domain(db, domain);
         log_dname(domain->dname, "-DOMAIN", LOG_DEEEBUG);
         return domain;
     }
@@ -423,6 +620,44 @@ namedb_del_domain(namedb_type* db, domain_type* domain)
 }
 
 
+/**
+ * Decode the base32hex first label of a hashed owner name into the raw
+ * hash, length first. Only used to find NSEC3 records read from a backup.
+ *
+ */
+static int
+owner2hash(ldns_rdf* owner, uint8_t* hash)
+{
+    uint8_t* label = ldns_rdf_data(owner);
+    uint32_t bits = 0;
+    size_t nbits = 0;
+    size_t len = 0;
+    size_t i = 0;
+    uint8_t c = 0;
+    if (ldns_rdf_size(owner) < 1 || ldns_rdf_size(owner) <= (size_t) label[0]) {
+        return 0;
+    }
+    for (i = 1; i <= label[0]; i++) {
+        c = label[i];
+        if (c >= '0' && c <= '9') {
+            c = c - '0';
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'v') {
+            c = (c | 0x20) - 'a' + 10;
+        } else {
+            return 0;
+        }
+        bits = (bits << 5) | c;
+        nbits += 5;
+        if (nbits >= 8) {
+            nbits -= 8;
+            hash[++len] = (uint8_t) ((bits >> nbits) & 0xff);
+        }
+    }
+    hash[0] = (uint8_t) len;
+    return len > 0;
+}
+
+
 /**
  * Lookup denial.
  *
@@ -430,10 +665,27 @@ namedb_del_domain(namedb_type* db, domain_type* domain)
 denial_type*
 namedb_lookup_denial(namedb_type* db, ldns_rdf* dname)
 {
+    zone_type* zone = NULL;
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    uint8_t hash[256];
+    uint8_t key[UTIL_DNAME_KEY_SIZE];
     if (!db) {
         return NULL;
     }
-    return (denial_type*) namedb_domain_search(db->denials, dname);
+    zone = (zone_type*) db->zone;
+    if (!zone || !zone->signconf || !zone->signconf->nsec3params) {
+        return (denial_type*) namedb_domain_search(db->denials, dname);
+    }
+    /* NSEC3 denials are keyed on the raw hash in the owner label */
+    if (!dname || !db->denials || !owner2hash(dname, hash)) {
+        return NULL;
+    }
+    (void) hash2key(hash, key);
+    node = ldns_rbtree_search(db->denials, key);
+    if (node && node != LDNS_RBTREE_NULL) {
+        return (denial_type*) node->data;
+    }
+    return NULL;
 }
 
 
@@ -674,34 +926,68 @@ namedb_del_denial_trigger(namedb_type* db, domain_type* domain, int rollback)
 
 
 /**
- * Hash domain name.
+ * Hash domain name. The raw hash is kept, the hashed owner name is the
+ * base32hex of it, prepended as a single label to the zone name.
  *
  */
 static ldns_rdf*
-dname_hash(ldns_rdf* dname, ldns_rdf* apex, nsec3params_type* nsec3params)
+dname_hash(ldns_rdf* dname, ldns_rdf* apex, nsec3params_type* nsec3params,
+    uint8_t* hash)
 {
-    ldns_rdf* hashed_ownername = NULL;
-    ldns_rdf* hashed_label = NULL;
+    ldns_rdf* cname = NULL;
+    uint8_t* buf = NULL;
+    size_t size = 0;
+    size_t salt_len = 0;
+    uint8_t owner[UTIL_DNAME_KEY_SIZE];
+    int len = 0;
+    uint16_t i = 0;
     ods_log_assert(dname);
     ods_log_assert(apex);
     ods_log_assert(nsec3params);
-    /**
-     * The owner name of the NSEC3 RR is the hash of the original owner
-     * name, prepended as a single label to the zone name.
-     */
-    hashed_label = ldns_nsec3_hash_name(dname, nsec3params->algorithm,
-        nsec3params->iterations, nsec3params->salt_len,
-        nsec3params->salt_data);
-    if (!hashed_label) {
+    if (nsec3params->algorithm != LDNS_SHA1) {
+        return NULL;
+    }
+    /* RFC 5155: hash the canonical owner name, then iterate */
+    cname = ldns_rdf_clone(dname);
+    if (!cname) {
+        return NULL;
+    }
+    ldns_dname2canonical(cname);
+    salt_len = nsec3params->salt_data ? nsec3params->salt_len : 0;
+    size = ldns_rdf_size(cname);
+    if (size < LDNS_SHA1_DIGEST_LENGTH) {
+        size = LDNS_SHA1_DIGEST_LENGTH;
+    }
+    buf = (uint8_t*) malloc(size + salt_len);
+    if (!buf) {
+        ldns_rdf_deep_free(cname);
         return NULL;
     }
-    hashed_ownername = ldns_dname_cat_clone((const ldns_rdf*) hashed_label,
-        (const ldns_rdf*) apex);
-    if (!hashed_ownername) {
+    memcpy(buf, ldns_rdf_data(cname), ldns_rdf_size(cname));
+    memcpy(buf + ldns_rdf_size(cname), nsec3params->salt_data, salt_len);
+    (void) ldns_sha1(buf, (unsigned int) (ldns_rdf_size(cname) + salt_len),
+        hash + 1);
+    for (i = 0; i < nsec3params->iterations; i++) {
+        memcpy(buf, hash + 1, LDNS_SHA1_DIGEST_LENGTH);
+        memcpy(buf + LDNS_SHA1_DIGEST_LENGTH, nsec3params->salt_data,
+            salt_len);
+        (void) ldns_sha1(buf, (unsigned int) (LDNS_SHA1_DIGEST_LENGTH +
+            salt_len), hash + 1);
+    }
+    hash[0] = LDNS_SHA1_DIGEST_LENGTH;
+    free((void*) buf);
+    ldns_rdf_deep_free(cname);
+    /* owner name: base32hex label in front of the apex */
+    len = ldns_b32_ntop_extended_hex(hash + 1, LDNS_SHA1_DIGEST_LENGTH,
+        (char*) owner + 1, 64);
+    if (len <= 0 || (size_t) len + 1 + ldns_rdf_size(apex) >
+        LDNS_MAX_DOMAINLEN + 1) {
         return NULL;
     }
-    ldns_rdf_deep_free(hashed_label);
-    return hashed_ownername;
+    owner[0] = (uint8_t) len;
+    memcpy(owner + 1 + len, ldns_rdf_data(apex), ldns_rdf_size(apex));
+    return ldns_rdf_new_frm_data(LDNS_RDF_TYPE_DNAME,
+        (size_t) len + 1 + ldns_rdf_size(apex), owner);
 }
 
 
@@ -718,6 +1004,8 @@ namedb_add_denial(namedb_type* db, ldns_rdf* dname, nsec3params_type* n3p)
     ldns_rdf* owner = NULL;
     denial_type* denial = NULL;
     denial_type* pdenial = NULL;
+    uint64_t start = 0;
+    uint8_t hash[1 + LDNS_SHA1_DIGEST_LENGTH];
 
     ods_log_assert(db);
     ods_log_assert(db->denials);
@@ -725,7 +1013,11 @@ namedb_add_denial(namedb_type* db, ldns_rdf* dname, nsec3params_type* n3p)
     /* nsec or nsec3 */
     if (n3p) {
         z = (zone_type*) db->zone;
-        owner = dname_hash(dname, z->apex, n3p);
+        start = time_monotonic_ns();
+        owner = dname_hash(dname, z->apex, n3p, hash);
+        if (z->stats) {
+            z->stats->nsec3_time += (time_monotonic_ns() - start);
+        }
     } else {
         owner = ldns_rdf_clone(dname);
     }
@@ -740,6 +1032,12 @@ namedb_add_denial(namedb_type* db, ldns_rdf* dname, nsec3params_type* n3p)
             db_str);
         return NULL;
     }
+    if (n3p && denial_set_hash(denial, hash + 1, hash[0]) != ODS_STATUS_OK) {
+        ods_log_error("[%s] unable to add denial: denial_set_hash() failed",
+            db_str);
+        denial_cleanup(denial);
+        return NULL;
+    }
     new_node = denial2node(denial);
     if (!new_node) {
         ods_log_error("[%s] unable to add denial: denial2node() failed",
@@ -757,6 +1055,7 @@ namedb_add_denial(namedb_type* db, ldns_rdf* dname, nsec3params_type* n3p)
     denial = (denial_type*) new_node->data;
     denial->node = new_node;
     denial->nxt_changed = 1;
+    namedb_link_denial(db, denial);
     pnode = ldns_rbtree_previous(new_node);
     if (!pnode || pnode == LDNS_RBTREE_NULL) {
         pnode = ldns_rbtree_last(db->denials);
@@ -765,6 +1064,7 @@ namedb_add_denial(namedb_type* db, ldns_rdf* dname, nsec3params_type* n3p)
     pdenial = (denial_type*) pnode->data;
     ods_log_assert(pdenial);
     pdenial->nxt_changed = 1;
+    namedb_link_denial(db, pdenial);
     log_dname(denial->dname, "+DENIAL", LOG_DEEEBUG);
     return denial;
 }
@@ -797,7 +1097,7 @@ namedb_del_denial(namedb_type* db, denial_type* denial)
     ods_log_assert(pnode);
     pdenial = (denial_type*) pnode->data;
     ods_log_assert(pdenial);
-    node = ldns_rbtree_delete(db->denials, (const void*)denial->dname);
+    node = ldns_rbtree_delete(db->denials, denial->node->key);
     if (!node) {
         ods_log_error("[%s] unable to delete denial: not found", db_str);
         log_dname(denial->dname, "ERR -DENIAL", LOG_ERR);
@@ -805,6 +1105,10 @@ namedb_del_denial(namedb_type* db, denial_type* denial)
     }
     ods_log_assert(denial->node == node);
     pdenial->nxt_changed = 1;
+    if (pdenial != denial) {
+        namedb_link_denial(db, pdenial);
+    }
+    namedb_unlink_denial(db, denial);
     free((void*)node);
     denial->domain = NULL;
     denial->node = NULL;
@@ -822,9 +1126,46 @@ namedb_diff(namedb_type* db, unsigned is_ixfr, unsigned more_coming)
 {
     ldns_rbnode_t* node = LDNS_RBTREE_NULL;
     domain_type* domain = NULL;
+    domain_type* next = NULL;
+    denial_type* denial = NULL;
+    size_t visited = 0;
     if (!db || !db->domains) {
         return;
     }
+    /* staged dynamic updates are committed from here on */
+    ldns_rr_list_deep_free(db->staged);
+    db->staged = NULL;
+    if (is_ixfr && !db->dirty_all) {
+        /**
+         * Only the changed domains and their parents need to be visited.
+         * Parents are in the list before their children, and the triggers
+         * only delete the current domain and its parents, so the next
+         * domain in the list stays valid.
+         */
+        for (domain = db->dirty_domains; domain; domain = domain->dirty_next) {
+            domain_diff(domain, is_ixfr, more_coming);
+            visited++;
+        }
+        domain = db->dirty_domains;
+        while (domain) {
+            next = domain->dirty_next;
+            if (!namedb_del_denial_trigger(db, domain, 0)) {
+                /* del_denial did not delete domain */
+                namedb_add_denial_trigger(db, domain);
+                denial = (denial_type*) domain->denial;
+                if (denial && denial->bitmap_changed) {
+                    namedb_link_denial(db, denial);
+                }
+            }
+            domain = next;
+        }
+        ods_log_debug("[%s] incremental diff visited %u of %u domains",
+            db_str, (unsigned) visited, (unsigned) db->domains->count);
+        return;
+    }
+    /* full diff, everything has to be nsecified and signed */
+    namedb_clear_dirty(db);
+    db->dirty_all = 1;
     node = ldns_rbtree_first(db->domains);
     if (!node || node == LDNS_RBTREE_NULL) {
         return;
@@ -872,6 +1213,8 @@ namedb_rollback(namedb_type* db, unsigned keepsc)
         domain_rollback(domain, keepsc);
         (void) namedb_del_denial_trigger(db, domain, 1);
     }
+    namedb_clear_dirty(db);
+    db->dirty_all = 1;
     return;
 }
 
@@ -887,8 +1230,40 @@ namedb_nsecify(namedb_type* db, uint32_t* num_added)
     ldns_rbnode_t* nxt_node = LDNS_RBTREE_NULL;
     denial_type* denial = NULL;
     denial_type* nxt = NULL;
+    denial_type* nxt_denial = NULL;
     uint32_t nsec_added = 0;
+    uint32_t added = 0;
+    size_t visited = 0;
     ods_log_assert(db);
+    if (!db->dirty_all) {
+        /**
+         * Inserted and deleted denials have marked their predecessor, so
+         * the chain is spliced by visiting the changed denials only. The
+         * ones whose NSEC(3) stayed the same need no new signature.
+         */
+        denial = db->dirty_denials;
+        while (denial) {
+            nxt_denial = denial->dirty_next;
+            nxt_node = ldns_rbtree_next(denial->node);
+            if (!nxt_node || nxt_node == LDNS_RBTREE_NULL) {
+                 nxt_node = ldns_rbtree_first(db->denials);
+            }
+            nxt = (denial_type*) nxt_node->data;
+            added = nsec_added;
+            denial_nsecify(denial, nxt, &nsec_added);
+            if (added == nsec_added) {
+                namedb_unlink_denial(db, denial);
+            }
+            visited++;
+            denial = nxt_denial;
+        }
+        ods_log_debug("[%s] incremental nsecify visited %u of %u denials",
+            db_str, (unsigned) visited, (unsigned) db->denials->count);
+        if (num_added) {
+            *num_added = nsec_added;
+        }
+        return;
+    }
     node = ldns_rbtree_first(db->denials);
     while (node && node != LDNS_RBTREE_NULL) {
         denial = (denial_type*) node->data;
@@ -986,6 +1361,7 @@ namedb_wipe_denial(namedb_type* db)
         ods_log_assert(zone->name);
         ods_log_debug("[%s] wipe denial of existence space zone %s", db_str,
             zone->name);
+        db->dirty_all = 1;
         node = ldns_rbtree_first(db->denials);
         while (node && node != LDNS_RBTREE_NULL) {
             denial = (denial_type*) node->data;
@@ -1108,6 +1484,8 @@ static void
 namedb_cleanup_domains(namedb_type* db)
 {
     if (db && db->domains) {
+        db->dirty_domains = NULL;
+        db->dirty_domains_last = NULL;
         domain_delfunc(db->domains->root);
         ldns_rbtree_free(db->domains);
         db->domains = NULL;
@@ -1124,6 +1502,10 @@ void
 namedb_cleanup_denials(namedb_type* db)
 {
     if (db && db->denials) {
+        while (db->dirty_denials) {
+            namedb_unlink_denial(db, db->dirty_denials);
+        }
+        db->dirty_all = 1;
         denial_delfunc(db->denials->root);
         ldns_rbtree_free(db->denials);
         db->denials = NULL;
@@ -1149,6 +1531,7 @@ namedb_cleanup(namedb_type* db)
     }
     namedb_cleanup_denials(db);
     namedb_cleanup_domains(db);
+    ldns_rr_list_deep_free(db->staged);
     allocator_deallocate(z->allocator, (void*) db);
     return;
 }
@@ -50,6 +50,12 @@ struct namedb_struct {
     void* zone;
     ldns_rbtree_t* domains;
     ldns_rbtree_t* denials;
+    domain_type* dirty_domains; /* domains changed since the last sign */
+    domain_type* dirty_domains_last;
+    denial_type* dirty_denials; /* denials changed since the last sign */
+    ldns_rr_list* staged; /* accepted dynamic updates, not diffed yet */
+    time_t full_sign_time; /* last time all RRsets were queued */
+    uint32_t occluded_gen; /* bumped when NS or DNAME RRsets come or go */
     uint32_t inbserial;
     uint32_t intserial;
     uint32_t outserial;
@@ -59,6 +65,7 @@ struct namedb_struct {
     unsigned serial_updated : 1;
     unsigned force_serial : 1;
     unsigned have_serial : 1;
+    unsigned dirty_all : 1; /* changes not tracked, visit everything */
 };
 
 /**
@@ -99,6 +106,27 @@ ods_status namedb_update_serial(namedb_type* db, const char* zone_name,
 ods_status namedb_domain_entize(namedb_type* db, domain_type* domain,
  ldns_rdf* apex);
 
+/**
+ * Mark domain as changed, so that the next incremental diff, nsecify and
+ * sign only need to visit the changed domains. Parent domains are marked
+ * as well, before the domain itself.
+ * \param[in] db namedb
+ * \param[in] domain domain
+ * \param[in] rrtype RRtype that changed, NS and DNAME changes also mark
+ *            the domains below, as their occlusion may change
+ *
+ */
+void namedb_dirty_domain(namedb_type* db, domain_type* domain,
+    ldns_rr_type rrtype);
+
+/**
+ * Forget about the changed domains and denials, after they have been
+ * queued for signing.
+ * \param[in] db namedb
+ *
+ */
+void namedb_clear_dirty(namedb_type* db);
+
 /**
  * Look up domain.
  * \param[in] db namedb
@@ -164,7 +192,8 @@ denial_type* namedb_del_denial(namedb_type* db, denial_type* denial);
 ods_status namedb_examine(namedb_type* db);
 
 /**
- * Apply differences in db.
+ * Apply differences in db. Incremental changes only visit the domains
+ * that have been marked as changed.
  * \param[in] db namedb
  * \param[in] is_ixfr true if incremental change
  * \param[in] more_coming more transactions possible
@@ -181,7 +210,8 @@ void namedb_diff(namedb_type* db, unsigned is_ixfr, unsigned more_coming);
 void namedb_rollback(namedb_type* db, unsigned keepsc);
 
 /**
- * Nsecify db.
+ * Nsecify db. Unless all denials need to be visited, only the denials
+ * that have been marked as changed are nsecified.
  * \param[in] db namedb
  * \param[out] num_added number of NSEC RRs added
  *
@@ -32,6 +32,7 @@
  */
 
 #include "config.h"
+#include "shared/duration.h"
 #include "shared/file.h"
 #include "shared/hsm.h"
 #include "shared/log.h"
@@ -295,6 +296,7 @@ rrset_add_rr(rrset_type* rrset, ldns_rr* rr)
     rrset->rrs[rrset->rr_count - 1].exists = 0;
     rrset->rrs[rrset->rr_count - 1].is_added = 1;
     rrset->rrs[rrset->rr_count - 1].is_removed = 0;
+    rrset->rrs[rrset->rr_count - 1].is_pending = 0;
     rrset->needs_signing = 1;
     log_rr(rr, "+RR", LOG_DEEEBUG);
     return &rrset->rrs[rrset->rr_count -1];
@@ -362,6 +364,7 @@ rrset_diff(rrset_type* rrset, unsigned is_ixfr, unsigned more_coming)
                 del_sigs = 1;
             }
             rrset->rrs[i].exists = 1;
+            rrset->rrs[i].is_pending = 0;
             if ((rrset->rrtype == LDNS_RR_TYPE_DNSKEY ||
                  rrset->rrtype == LDNS_RR_TYPE_NSEC3PARAMS) && more_coming) {
                 continue;
@@ -394,6 +397,34 @@ rrset_diff(rrset_type* rrset, unsigned is_ixfr, unsigned more_coming)
 }
 
 
+/**
+ * Apply added RRs at RRset, ahead of the transaction.
+ *
+ */
+void
+rrset_commit_added(rrset_type* rrset)
+{
+    zone_type* zone = NULL;
+    uint16_t i = 0;
+    if (!rrset) {
+        return;
+    }
+    zone = (zone_type*) rrset->zone;
+    for (i=0; i < rrset->rr_count; i++) {
+        if (rrset->rrs[i].is_added && !rrset->rrs[i].exists) {
+            /* ixfr +RR */
+            lock_basic_lock(&zone->ixfr->ixfr_lock);
+            ixfr_add_rr(zone->ixfr, rrset->rrs[i].rr);
+            lock_basic_unlock(&zone->ixfr->ixfr_lock);
+            /* keep is_added, the transaction will finish the diff */
+            rrset->rrs[i].exists = 1;
+            rrset->rrs[i].is_pending = 1;
+        }
+    }
+    return;
+}
+
+
 /**
  * Add RRSIG to RRset.
  *
@@ -706,16 +737,44 @@ rrset_sigvalid_period(signconf_type* sc, ldns_rr_type rrtype, time_t signtime,
 }
 
 
+/**
+ * Earliest expiration of the RRset signatures, 0 if there are none.
+ *
+ */
+static uint32_t
+rrset_sigexpire(rrset_type* rrset)
+{
+    uint32_t sigexp = 0;
+    uint32_t expire = 0;
+    size_t i = 0;
+    for (i=0; i < rrset->rrsig_count; i++) {
+        sigexp = ldns_rdf2native_int32(
+            ldns_rr_rrsig_expiration(rrset->rrsigs[i].rr));
+        if (!expire || sigexp < expire) {
+            expire = sigexp;
+        }
+    }
+    return expire;
+}
+
+
 /**
  * Sign RRset.
  *
  */
 ods_status
-rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime)
+rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime,
+    size_t slot)
 {
     zone_type* zone = NULL;
     uint32_t newsigs = 0;
     uint32_t reusedsigs = 0;
+    uint64_t hsm_start = 0;
+    uint64_t hsm_time = 0;
+    uint64_t hsm_total = 0;
+    uint32_t oldexp = 0;
+    uint32_t expire = 0;
+    key_type* key = NULL;
     ldns_rr* rrsig = NULL;
     ldns_rr_list* rr_list = NULL;
     rrsig_type* signature = NULL;
@@ -742,6 +801,7 @@ rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime)
         dstatus = domain_is_occluded(domain);
         delegpt = domain_is_delegpt(domain);
     }
+    oldexp = rrset_sigexpire(rrset);
     reusedsigs = rrset_recycle(rrset, signtime, dstatus, delegpt);
     rrset->needs_signing = 0;
 
@@ -752,11 +812,13 @@ rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime)
     if (dstatus != LDNS_RR_TYPE_SOA) {
         log_rrset(ldns_rr_owner(rrset->rrs[0].rr), rrset->rrtype,
             "skip signing occluded RRset", LOG_DEEEBUG);
+        stats_sig_add(zone->stats, slot, 0, 0, 0, 0, 0, oldexp);
         return ODS_STATUS_OK;
     }
     if (delegpt != LDNS_RR_TYPE_SOA && rrset->rrtype != LDNS_RR_TYPE_DS) {
         log_rrset(ldns_rr_owner(rrset->rrs[0].rr), rrset->rrtype,
             "skip signing delegation RRset", LOG_DEEEBUG);
+        stats_sig_add(zone->stats, slot, 0, 0, 0, 0, 0, oldexp);
         return ODS_STATUS_OK;
     }
 
@@ -774,6 +836,9 @@ rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime)
     if (ldns_rr_list_rr_count(rr_list) <= 0) {
         /* Empty RRset, no signatures needed */
         ldns_rr_list_free(rr_list);
+        expire = rrset_sigexpire(rrset);
+        stats_sig_add(zone->stats, slot, 0, 0, reusedsigs, 0, expire,
+            expire != oldexp ? oldexp : 0);
         return ODS_STATUS_OK;
     }
     /* Calculate signature validity */
@@ -812,8 +877,15 @@ rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime)
         /* Sign the RRset with this key */
         ods_log_deeebug("[%s] signing RRset[%i] with key %s", rrset_str,
             rrset->rrtype, zone->signconf->keys->keys[i].locator);
-        rrsig = lhsm_sign(ctx, rr_list, &zone->signconf->keys->keys[i],
-            zone->apex, inception, expiration);
+        key = &zone->signconf->keys->keys[i];
+        hsm_start = time_monotonic_ns();
+        rrsig = lhsm_sign(ctx, rr_list, key, zone->apex, inception,
+            expiration);
+        hsm_time = time_monotonic_ns() - hsm_start;
+        hsm_total += hsm_time;
+        if (key->hsmkey && key->hsmkey->module) {
+            stats_hsm_record(slot, key->hsmkey->module->name, hsm_time);
+        }
         if (!rrsig) {
             ods_log_crit("[%s] unable to sign RRset[%i]: lhsm_sign() failed",
                 rrset_str, rrset->rrtype);
@@ -834,13 +906,14 @@ rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime)
     }
     /* RRset signing completed */
     ldns_rr_list_free(rr_list);
-    lock_basic_lock(&zone->stats->stats_lock);
-    if (rrset->rrtype == LDNS_RR_TYPE_SOA) {
-        zone->stats->sig_soa_count += newsigs;
-    }
-    zone->stats->sig_count += newsigs;
-    zone->stats->sig_reuse += reusedsigs;
-    lock_basic_unlock(&zone->stats->stats_lock);
+    /**
+     * Earliest expiration, the zone has to be resigned before that. If
+     * the earliest signature was replaced, the worker can no longer tell
+     * the earliest expiration in the zone from this run alone.
+     */
+    expire = rrset_sigexpire(rrset);
+    stats_sig_add(zone->stats, slot, rrset->rrtype == LDNS_RR_TYPE_SOA,
+        newsigs, reusedsigs, hsm_total, expire, expire != oldexp ? oldexp : 0);
     return ODS_STATUS_OK;
 }
 
@@ -64,6 +64,7 @@ struct rr_struct {
     unsigned exists : 1;
     unsigned is_added : 1;
     unsigned is_removed : 1;
+    unsigned is_pending : 1; /* committed ahead of the transaction */
 };
 
 /**
@@ -182,15 +183,26 @@ void rrset_del_rrsig(rrset_type* rrset, uint16_t rrnum);
  */
 void rrset_diff(rrset_type* rrset, unsigned is_ixfr, unsigned more_coming);
 
+/**
+ * Apply added RRs at RRset, ahead of the transaction. The RRs stay marked
+ * as added and pending, so that a following full diff keeps them and a
+ * rollback removes them again.
+ * \param[in] rrset RRset
+ *
+ */
+void rrset_commit_added(rrset_type* rrset);
+
 /**
  * Sign RRset.
  * \param[in] ctx HSM context
  * \param[in] rrset RRset
  * \param[in] signtime time when the zone is being signed
+ * \param[in] slot statistics slot of the calling drudger
  * \return ods_status status
  *
  */
-ods_status rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime);
+ods_status rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime,
+    size_t slot);
 
 /**
  * Print RRset.
@@ -38,6 +38,10 @@
 #include "shared/status.h"
 #include "signer/signconf.h"
 
+#include <libxml/parser.h>
+#include <stdlib.h>
+#include <string.h>
+
 static const char* sc_str = "signconf";
 
 
@@ -89,71 +93,108 @@ signconf_create(void)
     /* Other useful information */
     sc->max_zone_ttl = NULL;
     sc->last_modified = 0;
+    memset(sc->hash, 0, sizeof(sc->hash));
     return sc;
 }
 
 
+/**
+ * Read signer configuration file into memory.
+ *
+ */
+static char*
+signconf_slurp(const char* scfile, size_t* len)
+{
+    FILE* fd = NULL;
+    char* buf = NULL;
+    long size = 0;
+
+    fd = ods_fopen(scfile, NULL, "r");
+    if (!fd) {
+        return NULL;
+    }
+    if (fseek(fd, 0, SEEK_END) != 0 || (size = ftell(fd)) < 0 ||
+        fseek(fd, 0, SEEK_SET) != 0) {
+        ods_fclose(fd);
+        return NULL;
+    }
+    buf = (char*) malloc((size_t) size + 1);
+    if (!buf) {
+        ods_fclose(fd);
+        return NULL;
+    }
+    *len = fread(buf, 1, (size_t) size, fd);
+    buf[*len] = '\0';
+    if (ferror(fd)) {
+        free(buf);
+        buf = NULL;
+    }
+    ods_fclose(fd);
+    return buf;
+}
+
+
 /**
  * Read signer configuration.
  *
  */
 static ods_status
-signconf_read(signconf_type* signconf, const char* scfile)
+signconf_read(signconf_type* signconf, const char* scfile, const char* buf,
+    size_t len)
 {
     const char* rngfile = ODS_SE_RNGDIR "/signconf.rng";
     ods_status status = ODS_STATUS_OK;
-    FILE* fd = NULL;
+    xmlDocPtr doc = NULL;
 
-    if (!scfile || !signconf) {
+    if (!scfile || !signconf || !buf) {
         return ODS_STATUS_ASSERT_ERR;
     }
     ods_log_debug("[%s] read signconf file %s", sc_str, scfile);
-    status = parse_file_check(scfile, rngfile);
+    doc = xmlReadMemory(buf, (int) len, scfile, NULL, 0);
+    if (!doc) {
+        ods_log_error("[%s] unable to read signconf: failed to load file %s",
+            sc_str, scfile);
+        return ODS_STATUS_XML_ERR;
+    }
+    status = parse_doc_check(doc, rngfile);
     if (status != ODS_STATUS_OK) {
         ods_log_error("[%s] unable to read signconf: parse error in "
             "file %s (%s)", sc_str, scfile, ods_status2str(status));
+        xmlFreeDoc(doc);
         return status;
     }
-    fd = ods_fopen(scfile, NULL, "r");
-    if (fd) {
-        signconf->filename = allocator_strdup(signconf->allocator, scfile);
-        signconf->sig_resign_interval = parse_sc_sig_resign_interval(scfile);
-        signconf->sig_refresh_interval = parse_sc_sig_refresh_interval(scfile);
-        signconf->sig_validity_default = parse_sc_sig_validity_default(scfile);
-        signconf->sig_validity_denial = parse_sc_sig_validity_denial(scfile);
-        signconf->sig_jitter = parse_sc_sig_jitter(scfile);
-        signconf->sig_inception_offset = parse_sc_sig_inception_offset(scfile);
-        signconf->nsec_type = parse_sc_nsec_type(scfile);
-        if (signconf->nsec_type == LDNS_RR_TYPE_NSEC3) {
-            signconf->nsec3param_ttl = parse_sc_nsec3param_ttl(scfile);
-            signconf->nsec3_optout = parse_sc_nsec3_optout(scfile);
-            signconf->nsec3_algo = parse_sc_nsec3_algorithm(scfile);
-            signconf->nsec3_iterations = parse_sc_nsec3_iterations(scfile);
-            signconf->nsec3_salt = parse_sc_nsec3_salt(signconf->allocator,
-                scfile);
-            signconf->nsec3params = nsec3params_create((void*) signconf,
-            (uint8_t) signconf->nsec3_algo, (uint8_t) signconf->nsec3_optout,
-            (uint16_t)signconf->nsec3_iterations, signconf->nsec3_salt);
-            if (!signconf->nsec3params) {
-                ods_log_error("[%s] unable to read signconf %s: "
-                    "nsec3params_create() failed", sc_str, scfile);
-                ods_fclose(fd);
-                return ODS_STATUS_MALLOC_ERR;
-            }
+    signconf->filename = allocator_strdup(signconf->allocator, scfile);
+    signconf->sig_resign_interval = parse_sc_sig_resign_interval(doc);
+    signconf->sig_refresh_interval = parse_sc_sig_refresh_interval(doc);
+    signconf->sig_validity_default = parse_sc_sig_validity_default(doc);
+    signconf->sig_validity_denial = parse_sc_sig_validity_denial(doc);
+    signconf->sig_jitter = parse_sc_sig_jitter(doc);
+    signconf->sig_inception_offset = parse_sc_sig_inception_offset(doc);
+    signconf->nsec_type = parse_sc_nsec_type(doc);
+    if (signconf->nsec_type == LDNS_RR_TYPE_NSEC3) {
+        signconf->nsec3param_ttl = parse_sc_nsec3param_ttl(doc);
+        signconf->nsec3_optout = parse_sc_nsec3_optout(doc);
+        signconf->nsec3_algo = parse_sc_nsec3_algorithm(doc);
+        signconf->nsec3_iterations = parse_sc_nsec3_iterations(doc);
+        signconf->nsec3_salt = parse_sc_nsec3_salt(signconf->allocator, doc);
+        signconf->nsec3params = nsec3params_create((void*) signconf,
+        (uint8_t) signconf->nsec3_algo, (uint8_t) signconf->nsec3_optout,
+        (uint16_t)signconf->nsec3_iterations, signconf->nsec3_salt);
+        if (!signconf->nsec3params) {
+            ods_log_error("[%s] unable to read signconf %s: "
+                "nsec3params_create() failed", sc_str, scfile);
+            xmlFreeDoc(doc);
+            return ODS_STATUS_MALLOC_ERR;
         }
-        signconf->keys = parse_sc_keys((void*) signconf, scfile);
-        signconf->dnskey_ttl = parse_sc_dnskey_ttl(scfile);
-        signconf->soa_ttl = parse_sc_soa_ttl(scfile);
-        signconf->soa_min = parse_sc_soa_min(scfile);
-        signconf->soa_serial = parse_sc_soa_serial(signconf->allocator,
-            scfile);
-        signconf->max_zone_ttl = parse_sc_max_zone_ttl(scfile);
-        ods_fclose(fd);
-        return ODS_STATUS_OK;
     }
-    ods_log_error("[%s] unable to read signconf: failed to open file %s",
-        sc_str, scfile);
-    return ODS_STATUS_ERR;
+    signconf->keys = parse_sc_keys((void*) signconf, doc);
+    signconf->dnskey_ttl = parse_sc_dnskey_ttl(doc);
+    signconf->soa_ttl = parse_sc_soa_ttl(doc);
+    signconf->soa_min = parse_sc_soa_min(doc);
+    signconf->soa_serial = parse_sc_soa_serial(signconf->allocator, doc);
+    signconf->max_zone_ttl = parse_sc_max_zone_ttl(doc);
+    xmlFreeDoc(doc);
+    return ODS_STATUS_OK;
 }
 
 
@@ -163,18 +204,37 @@ signconf_read(signconf_type* signconf, const char* scfile)
  */
 ods_status
 signconf_update(signconf_type** signconf, const char* scfile,
-    time_t last_modified)
+    signconf_type* current)
 {
     signconf_type* new_sc = NULL;
     time_t st_mtime = 0;
     ods_status status = ODS_STATUS_OK;
+    unsigned char hash[LDNS_SHA1_DIGEST_LENGTH];
+    char* buf = NULL;
+    size_t len = 0;
 
-    if (!scfile || !signconf) {
+    if (!scfile || !signconf || !current) {
         return ODS_STATUS_UNCHANGED;
     }
     /* is the file updated? */
     st_mtime = ods_file_lastmodified(scfile);
-    if (st_mtime <= last_modified) {
+    if (st_mtime <= current->last_modified) {
+        return ODS_STATUS_UNCHANGED;
+    }
+    buf = signconf_slurp(scfile, &len);
+    if (!buf) {
+        ods_log_error("[%s] unable to update signconf: failed to open file "
+            "%s", sc_str, scfile);
+        return ODS_STATUS_ERR;
+    }
+    /* rewritten with the same content? then skip parsing it */
+    (void) ldns_sha1((unsigned char*) buf, (unsigned int) len, hash);
+    if (current->filename && ods_strcmp(current->filename, scfile) == 0 &&
+        memcmp(current->hash, hash, sizeof(hash)) == 0) {
+        ods_log_debug("[%s] signconf file %s touched but not changed",
+            sc_str, scfile);
+        current->last_modified = st_mtime;
+        free(buf);
         return ODS_STATUS_UNCHANGED;
     }
     /* if so, read the new signer configuration */
@@ -182,11 +242,14 @@ signconf_update(signconf_type** signconf, const char* scfile,
     if (!new_sc) {
         ods_log_error("[%s] unable to update signconf: signconf_create() "
             "failed", sc_str);
+        free(buf);
         return ODS_STATUS_ERR;
     }
-    status = signconf_read(new_sc, scfile);
+    status = signconf_read(new_sc, scfile, buf, len);
+    free(buf);
     if (status == ODS_STATUS_OK) {
         new_sc->last_modified = st_mtime;
+        memcpy(new_sc->hash, hash, sizeof(hash));
         if (signconf_check(new_sc) != ODS_STATUS_OK) {
             ods_log_error("[%s] unable to update signconf: signconf %s has "
                 "errors", sc_str, scfile);
@@ -79,6 +79,7 @@ struct signconf_struct {
     duration_type* max_zone_ttl;
     const char* filename;
     time_t last_modified;
+    unsigned char hash[LDNS_SHA1_DIGEST_LENGTH]; /* of the file content */
 };
 
 /**
@@ -92,12 +93,13 @@ signconf_type* signconf_create(void);
  * Update signer configuration.
  * \param[out] signconf signer configuration
  * \param[in] scfile signer configuration file name
- * \param[in] last_modified last known modification
+ * \param[in] current current signer configuration, its last known
+ *            modification is updated if the file was only touched
  * \return ods_status status
  *
  */
 ods_status signconf_update(signconf_type** signconf, const char* scfile,
-    time_t last_modified);
+    signconf_type* current);
 
 /**
  * Backup signer configuration.
@@ -34,6 +34,120 @@
 #include "shared/log.h"
 #include "signer/stats.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#define NS2SEC(ns) (uint32_t) ((ns) / 1000000000), \
+    (uint32_t) (((ns) / 1000000) % 1000)
+#define NS2USEC(ns) (uint32_t) ((ns) / 1000)
+
+static const char* stats_str = "stats";
+
+/* process wide: number of drudger slots and HSM latency histograms */
+static size_t stats_num_slots = 0;
+static size_t stats_hsm_num = 0;
+static char** stats_hsm_names = NULL;
+static stats_hsm_type* stats_hsm_table = NULL;
+static void* stats_hsm_mem = NULL;
+static lock_basic_type stats_hsm_lock;
+static lock_basic_type stats_keycache_lock;
+static int stats_keycache_ready = 0;
+static uint64_t stats_keycache_hits = 0;
+static uint64_t stats_keycache_misses = 0;
+static uint64_t stats_keycache_saved = 0;
+
+
+/**
+ * Allocate zeroed memory, aligned on a cache line.
+ *
+ */
+static void*
+stats_alloc_aligned(size_t size, void** mem)
+{
+    uintptr_t ptr = 0;
+    *mem = calloc(1, size + STATS_CACHE_LINE - 1);
+    if (!*mem) {
+        return NULL;
+    }
+    ptr = (uintptr_t) *mem;
+    ptr = (ptr + STATS_CACHE_LINE - 1) & ~((uintptr_t) STATS_CACHE_LINE - 1);
+    return (void*) ptr;
+}
+
+
+/**
+ * Set up the process wide statistics.
+ *
+ */
+void
+stats_setup(size_t num_slots, hsm_repository_t* repositories)
+{
+    hsm_repository_t* repository = NULL;
+    size_t count = 0;
+    size_t i = 0;
+
+    stats_teardown();
+    if (!stats_keycache_ready) {
+        /* the key cache counters live as long as the process */
+        lock_basic_init(&stats_keycache_lock);
+        stats_keycache_ready = 1;
+    }
+    stats_num_slots = num_slots;
+    for (repository = repositories; repository;
+        repository = repository->next) {
+        count++;
+    }
+    if (!count) {
+        return;
+    }
+    stats_hsm_names = (char**) calloc(count, sizeof(char*));
+    stats_hsm_table = (stats_hsm_type*) stats_alloc_aligned(
+        count * (num_slots + 1) * sizeof(stats_hsm_type), &stats_hsm_mem);
+    if (!stats_hsm_names || !stats_hsm_table) {
+        ods_log_error("[%s] unable to set up hsm statistics: malloc failed",
+            stats_str);
+        free((void*) stats_hsm_names);
+        free(stats_hsm_mem);
+        stats_hsm_names = NULL;
+        stats_hsm_table = NULL;
+        stats_hsm_mem = NULL;
+        return;
+    }
+    for (repository = repositories; repository;
+        repository = repository->next) {
+        stats_hsm_names[i++] = strdup(repository->name?repository->name:"");
+    }
+    stats_hsm_num = count;
+    lock_basic_init(&stats_hsm_lock);
+    return;
+}
+
+
+/**
+ * Clean up the process wide statistics.
+ *
+ */
+void
+stats_teardown(void)
+{
+    size_t i = 0;
+    if (!stats_hsm_num) {
+        return;
+    }
+    for (i=0; i < stats_hsm_num; i++) {
+        free((void*) stats_hsm_names[i]);
+    }
+    free((void*) stats_hsm_names);
+    free(stats_hsm_mem);
+    stats_hsm_names = NULL;
+    stats_hsm_table = NULL;
+    stats_hsm_mem = NULL;
+    stats_hsm_num = 0;
+    lock_basic_destroy(&stats_hsm_lock);
+    return;
+}
+
+
 /**
  * Initialize statistics.
  *
@@ -42,12 +156,355 @@ stats_type*
 stats_create(void)
 {
     stats_type* stats = (stats_type*) malloc(sizeof(stats_type));
+    if (!stats) {
+        return NULL;
+    }
+    /* slot 0 is shared, drudgers have slot 1..num_slots */
+    stats->num_slots = stats_num_slots;
+    stats->slots = (stats_slot_type*) stats_alloc_aligned(
+        (stats->num_slots + 1) * sizeof(stats_slot_type), &stats->slots_mem);
+    if (!stats->slots) {
+        free((void*) stats);
+        return NULL;
+    }
     stats_clear(stats);
+    stats->backup_time = 0;
+    stats->total_sig_count = 0;
+    stats->total_sig_reuse = 0;
+    stats->xfr_in = 0;
+    stats->xfr_out = 0;
+    stats->last_sig_count = 0;
+    stats->last_sig_time = 0;
+    stats->last_publish = 0;
+    stats->last_sig_expire = 0;
     lock_basic_init(&stats->stats_lock);
     return stats;
 }
 
 
+/**
+ * Count signatures made for an RRset.
+ *
+ */
+void
+stats_sig_add(stats_type* stats, size_t slot, int soa, uint32_t newsigs,
+    uint32_t reusedsigs, uint64_t hsm_time, uint32_t expire,
+    uint32_t replaced)
+{
+    stats_slot_type* s = NULL;
+    int shared = 0;
+    if (!stats) {
+        return;
+    }
+    if (slot == 0 || slot > stats->num_slots) {
+        shared = 1;
+        slot = 0;
+        lock_basic_lock(&stats->stats_lock);
+    }
+    s = &stats->slots[slot];
+    if (soa) {
+        s->sig_soa_count += newsigs;
+    }
+    s->sig_count += newsigs;
+    s->sig_reuse += reusedsigs;
+    s->hsm_time += hsm_time;
+    if (expire && (!s->sig_expire || expire < s->sig_expire)) {
+        s->sig_expire = expire;
+    }
+    if (replaced && (!s->sig_replaced || replaced < s->sig_replaced)) {
+        s->sig_replaced = replaced;
+    }
+    if (shared) {
+        lock_basic_unlock(&stats->stats_lock);
+    }
+    return;
+}
+
+
+/**
+ * Aggregate the drudger slots into the signature counters.
+ *
+ */
+void
+stats_sig_sync(stats_type* stats)
+{
+    uint32_t sig_count = 0;
+    uint32_t sig_soa_count = 0;
+    uint32_t sig_reuse = 0;
+    uint32_t sig_expire = 0;
+    uint32_t sig_replaced = 0;
+    uint64_t hsm_time = 0;
+    size_t i = 0;
+    if (!stats) {
+        return;
+    }
+    lock_basic_lock(&stats->stats_lock);
+    for (i=0; i <= stats->num_slots; i++) {
+        sig_count += stats->slots[i].sig_count;
+        sig_soa_count += stats->slots[i].sig_soa_count;
+        sig_reuse += stats->slots[i].sig_reuse;
+        hsm_time += stats->slots[i].hsm_time;
+        if (stats->slots[i].sig_expire && (!sig_expire ||
+            stats->slots[i].sig_expire < sig_expire)) {
+            sig_expire = stats->slots[i].sig_expire;
+        }
+        if (stats->slots[i].sig_replaced && (!sig_replaced ||
+            stats->slots[i].sig_replaced < sig_replaced)) {
+            sig_replaced = stats->slots[i].sig_replaced;
+        }
+    }
+    stats->sig_count = sig_count;
+    stats->sig_soa_count = sig_soa_count;
+    stats->sig_reuse = sig_reuse;
+    stats->sig_expire = sig_expire;
+    stats->sig_replaced = sig_replaced;
+    stats->sig_hsm_time = hsm_time;
+    lock_basic_unlock(&stats->stats_lock);
+    return;
+}
+
+
+/**
+ * Reset the signature counters.
+ *
+ */
+void
+stats_sig_reset(stats_type* stats)
+{
+    if (!stats) {
+        return;
+    }
+    lock_basic_lock(&stats->stats_lock);
+    memset(stats->slots, 0, (stats->num_slots + 1) * sizeof(stats_slot_type));
+    stats->sig_count = 0;
+    stats->sig_soa_count = 0;
+    stats->sig_reuse = 0;
+    stats->sig_expire = 0;
+    stats->sig_replaced = 0;
+    stats->sig_hsm_time = 0;
+    lock_basic_unlock(&stats->stats_lock);
+    return;
+}
+
+
+/**
+ * Record the latency of an HSM sign call.
+ *
+ */
+void
+stats_hsm_record(size_t slot, const char* repository, uint64_t ns)
+{
+    stats_hsm_type* hsm = NULL;
+    uint64_t usec = ns / 1000;
+    size_t bucket = 0;
+    size_t i = 0;
+    if (!repository || !stats_hsm_num) {
+        return;
+    }
+    for (i=0; i < stats_hsm_num; i++) {
+        if (strcmp(stats_hsm_names[i], repository) == 0) {
+            break;
+        }
+    }
+    if (i >= stats_hsm_num) {
+        return;
+    }
+    while (usec && bucket < STATS_HSM_BUCKETS-1) {
+        usec >>= 1;
+        bucket++;
+    }
+    if (slot > stats_num_slots) {
+        slot = 0;
+    }
+    if (slot == 0) {
+        lock_basic_lock(&stats_hsm_lock);
+    }
+    hsm = &stats_hsm_table[i * (stats_num_slots + 1) + slot];
+    hsm->count++;
+    hsm->total += ns;
+    if (ns > hsm->max) {
+        hsm->max = ns;
+    }
+    hsm->buckets[bucket]++;
+    if (slot == 0) {
+        lock_basic_unlock(&stats_hsm_lock);
+    }
+    return;
+}
+
+
+/**
+ * Number of repositories with a latency histogram.
+ *
+ */
+size_t
+stats_hsm_count(void)
+{
+    return stats_hsm_num;
+}
+
+
+/**
+ * Aggregate the latency histogram of a repository over all drudgers.
+ *
+ */
+const char*
+stats_hsm_sum(size_t index, stats_hsm_type* hsm)
+{
+    stats_hsm_type* slot = NULL;
+    size_t i = 0;
+    size_t j = 0;
+    if (!hsm || index >= stats_hsm_num) {
+        return NULL;
+    }
+    memset(hsm, 0, sizeof(stats_hsm_type));
+    /* drudgers keep counting while we read, the sum is a snapshot */
+    for (i=0; i <= stats_num_slots; i++) {
+        slot = &stats_hsm_table[index * (stats_num_slots + 1) + i];
+        hsm->count += slot->count;
+        hsm->total += slot->total;
+        if (slot->max > hsm->max) {
+            hsm->max = slot->max;
+        }
+        for (j=0; j < STATS_HSM_BUCKETS; j++) {
+            hsm->buckets[j] += slot->buckets[j];
+        }
+    }
+    return stats_hsm_names[index];
+}
+
+
+/**
+ * Estimate a latency percentile from a histogram.
+ *
+ */
+uint64_t
+stats_hsm_percentile(stats_hsm_type* hsm, unsigned pct)
+{
+    uint64_t target = 0;
+    uint64_t seen = 0;
+    uint64_t bound = 0;
+    size_t i = 0;
+    if (!hsm || !hsm->count) {
+        return 0;
+    }
+    if (pct > 100) {
+        pct = 100;
+    }
+    target = (hsm->count * pct + 99) / 100;
+    if (!target) {
+        target = 1;
+    }
+    for (i=0; i < STATS_HSM_BUCKETS-1; i++) {
+        seen += hsm->buckets[i];
+        if (seen >= target) {
+            bound = ((uint64_t) 1 << i) * 1000;
+            return bound < hsm->max ? bound : hsm->max;
+        }
+    }
+    return hsm->max;
+}
+
+
+/**
+ * Log HSM latency histograms.
+ *
+ */
+void
+stats_hsm_log(void)
+{
+    stats_hsm_type hsm;
+    const char* name = NULL;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t saved = 0;
+    size_t i = 0;
+    for (i=0; i < stats_hsm_num; i++) {
+        name = stats_hsm_sum(i, &hsm);
+        if (!name || !hsm.count) {
+            continue;
+        }
+        ods_log_verbose("[STATS] HSM %s calls=%lu avg=%u(usec) "
+            "p50=%u(usec) p90=%u(usec) p99=%u(usec) max=%u(usec)", name,
+            (unsigned long) hsm.count, NS2USEC(hsm.total / hsm.count),
+            NS2USEC(stats_hsm_percentile(&hsm, 50)),
+            NS2USEC(stats_hsm_percentile(&hsm, 90)),
+            NS2USEC(stats_hsm_percentile(&hsm, 99)), NS2USEC(hsm.max));
+    }
+    stats_keycache_get(&hits, &misses, &saved);
+    if (hits || misses) {
+        ods_log_verbose("[STATS] HSM key cache hits=%lu misses=%lu "
+            "saved=%u(msec)", (unsigned long) hits, (unsigned long) misses,
+            (unsigned) (saved / 1000000));
+    }
+    return;
+}
+
+
+/**
+ * Count a lookup in the HSM key cache.
+ *
+ */
+void
+stats_keycache_record(int hit, uint64_t saved_ns)
+{
+    if (!stats_keycache_ready) {
+        return;
+    }
+    lock_basic_lock(&stats_keycache_lock);
+    if (hit) {
+        stats_keycache_hits++;
+        stats_keycache_saved += saved_ns;
+    } else {
+        stats_keycache_misses++;
+    }
+    lock_basic_unlock(&stats_keycache_lock);
+    return;
+}
+
+
+/**
+ * Get the HSM key cache counters.
+ *
+ */
+void
+stats_keycache_get(uint64_t* hits, uint64_t* misses, uint64_t* saved_ns)
+{
+    if (!stats_keycache_ready) {
+        return;
+    }
+    lock_basic_lock(&stats_keycache_lock);
+    if (hits) {
+        *hits = stats_keycache_hits;
+    }
+    if (misses) {
+        *misses = stats_keycache_misses;
+    }
+    if (saved_ns) {
+        *saved_ns = stats_keycache_saved;
+    }
+    lock_basic_unlock(&stats_keycache_lock);
+    return;
+}
+
+
+/**
+ * Remember the statistics of a published zone.
+ *
+ */
+void
+stats_publish(stats_type* stats, time_t now)
+{
+    ods_log_assert(stats);
+    stats->total_sig_count += stats->sig_count;
+    stats->total_sig_reuse += stats->sig_reuse;
+    stats->last_sig_count = stats->sig_count;
+    stats->last_sig_time = stats->sig_time;
+    stats->last_publish = now;
+    return;
+}
+
+
 /**
  * Clear statistics.
  *
@@ -61,12 +518,22 @@ stats_clear(stats_type* stats)
     stats->sort_done = 0;
     stats->nsec_count = 0;
     stats->nsec_time = 0;
+    stats->nsec3_time = 0;
     stats->sig_count = 0;
     stats->sig_soa_count = 0;
     stats->sig_reuse = 0;
+    stats->sig_expire = 0;
+    stats->sig_replaced = 0;
     stats->sig_time = 0;
+    stats->sig_hsm_time = 0;
+    stats->write_time = 0;
+    stats->pipe_count = 0;
+    stats->pipe_start = 0;
+    stats->pipe_time = 0;
+    stats->pipe_drain = 0;
     stats->start_time = 0;
     stats->end_time = 0;
+    memset(stats->slots, 0, (stats->num_slots + 1) * sizeof(stats_slot_type));
 }
 
 
@@ -85,18 +552,27 @@ stats_log(stats_type* stats, const char* name, uint32_t serial,
     }
     ods_log_assert(stats);
     if (stats->sig_time) {
-        avsign = (uint32_t) (stats->sig_count/stats->sig_time);
+        avsign = (uint32_t) (((uint64_t) stats->sig_count * 1000000000) /
+            stats->sig_time);
     }
-    ods_log_info("[STATS] %s %u RR[count=%u time=%u(sec)] "
-        "NSEC%s[count=%u time=%u(sec)] "
-        "RRSIG[new=%u reused=%u time=%u(sec) avg=%u(sig/sec)] "
-        "TOTAL[time=%u(sec)] ",
+    ods_log_info("[STATS] %s %u RR[count=%u time=%u.%03u(sec)] "
+        "NSEC%s[count=%u time=%u.%03u(sec) hash=%u.%03u(sec)] "
+        "RRSIG[new=%u reused=%u time=%u.%03u(sec) hsm=%u.%03u(sec) "
+        "avg=%u(sig/sec)] WRITE[time=%u.%03u(sec)] "
+        "BACKUP[time=%u.%03u(sec)] TOTAL[time=%u(sec)] ",
         name?name:"(null)", (unsigned) serial,
-        stats->sort_count, stats->sort_time,
+        stats->sort_count, NS2SEC(stats->sort_time),
         nsec_type==LDNS_RR_TYPE_NSEC3?"3":"", stats->nsec_count,
-        stats->nsec_time, stats->sig_count, stats->sig_reuse,
-        stats->sig_time, avsign,
-        (uint32_t) (stats->end_time - stats->start_time));
+        NS2SEC(stats->nsec_time), NS2SEC(stats->nsec3_time),
+        stats->sig_count, stats->sig_reuse, NS2SEC(stats->sig_time),
+        NS2SEC(stats->sig_hsm_time), avsign, NS2SEC(stats->write_time),
+        NS2SEC(stats->backup_time), (uint32_t) (stats->end_time - stats->start_time));
+    if (stats->pipe_count) {
+        ods_log_info("[STATS] %s %u PIPELINE[sigs=%u overlap=%u.%03u(sec) "
+            "drain=%u.%03u(sec)]", name?name:"(null)", (unsigned) serial,
+            stats->pipe_count, NS2SEC(stats->pipe_time),
+            NS2SEC(stats->pipe_drain));
+    }
     return;
 }
 
@@ -108,7 +584,11 @@ stats_log(stats_type* stats, const char* name, uint32_t serial,
 void
 stats_cleanup(stats_type* stats)
 {
+    if (!stats) {
+        return;
+    }
     lock_basic_destroy(&stats->stats_lock);
+    free(stats->slots_mem);
     free((void*) stats);
     return;
 }
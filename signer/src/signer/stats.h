@@ -48,27 +48,100 @@
 #endif
 
 #include <ldns/ldns.h>
+#include <libhsm.h>
+
+#define STATS_CACHE_LINE 64
+#define STATS_HSM_BUCKETS 29
 
 /**
- * Statistics structure.
+ * Signature counters of a single drudger. Each drudger owns one slot and
+ * updates it without locking. A slot fills a cache line of its own, so that
+ * drudgers don't bounce lines between cores. Slot 0 is shared by everyone
+ * else and is protected by the stats lock.
+ */
+typedef struct stats_slot_struct stats_slot_type;
+struct stats_slot_struct {
+    uint32_t    sig_count;
+    uint32_t    sig_soa_count;
+    uint32_t    sig_reuse;
+    uint32_t    sig_expire; /* earliest signature expiration, 0 if none */
+    uint32_t    sig_replaced; /* earliest expiration replaced, 0 if none */
+    uint64_t    hsm_time;
+    uint8_t     padding[STATS_CACHE_LINE - 4*sizeof(uint64_t)];
+};
+
+/**
+ * HSM sign call latency histogram. Bucket i counts the calls that took
+ * less than 2^i microseconds (and at least 2^(i-1)), the last bucket
+ * counts everything slower.
+ */
+typedef struct stats_hsm_struct stats_hsm_type;
+struct stats_hsm_struct {
+    uint64_t    count;
+    uint64_t    total;
+    uint64_t    max;
+    uint64_t    buckets[STATS_HSM_BUCKETS];
+};
+
+/**
+ * Statistics structure. Times are measured with the monotonic clock and
+ * are in nanoseconds, apart from the start, end, audit and publish time.
+ * The totals and the last_* values survive stats_clear(), they describe
+ * the zone since the daemon started and its last publication.
  */
 typedef struct stats_struct stats_type;
 struct stats_struct {
     uint32_t    sort_count;
-    time_t      sort_time;
+    uint64_t    sort_time;
     int         sort_done;
     uint32_t    nsec_count;
-    time_t      nsec_time;
+    uint64_t    nsec_time;
+    uint64_t    nsec3_time;
     uint32_t    sig_count;
     uint32_t    sig_soa_count;
     uint32_t    sig_reuse;
-    time_t      sig_time;
+    uint32_t    sig_expire;
+    uint32_t    sig_replaced;
+    uint64_t    sig_time;
+    uint64_t    sig_hsm_time;
+    uint64_t    write_time;
+    uint64_t    backup_time; /* last backup, it follows the write */
+    uint32_t    pipe_count;
+    uint64_t    pipe_start;
+    uint64_t    pipe_time;
+    uint64_t    pipe_drain;
     time_t      audit_time;
     time_t      start_time;
     time_t      end_time;
+    uint64_t    total_sig_count;
+    uint64_t    total_sig_reuse;
+    uint64_t    xfr_in;
+    uint64_t    xfr_out;
+    uint32_t    last_sig_count;
+    uint64_t    last_sig_time;
+    time_t      last_publish;
+    time_t      last_sig_expire; /* earliest signature expiration in zone */
+    stats_slot_type* slots;
+    size_t      num_slots;
+    void*       slots_mem;
     lock_basic_type stats_lock;
 };
 
+/**
+ * Set up the process wide statistics: the number of per drudger slots
+ * and the HSM latency histograms per repository.
+ * \param[in] num_slots number of drudgers
+ * \param[in] repositories configured repositories
+ *
+ */
+void stats_setup(size_t num_slots, hsm_repository_t* repositories);
+
+/**
+ * Clean up the process wide statistics.
+ *
+ */
+void stats_teardown(void);
+
 /**
  * Initialize statistics.
  * \return the initialized stats;
@@ -76,6 +149,96 @@ struct stats_struct {
  */
 stats_type* stats_create(void);
 
+/**
+ * Count signatures made for an RRset.
+ * \param[in] stats statistics
+ * \param[in] slot drudger slot
+ * \param[in] soa true if the signatures are over the SOA RRset
+ * \param[in] newsigs number of new signatures
+ * \param[in] reusedsigs number of reused signatures
+ * \param[in] hsm_time time spent in the HSM
+ * \param[in] expire earliest expiration of the RRset signatures, 0 if none
+ * \param[in] replaced earliest expiration of the signatures that were
+ *            replaced or dropped, 0 if none
+ *
+ */
+void stats_sig_add(stats_type* stats, size_t slot, int soa, uint32_t newsigs,
+    uint32_t reusedsigs, uint64_t hsm_time, uint32_t expire,
+    uint32_t replaced);
+
+/**
+ * Aggregate the drudger slots into the signature counters. The slots are
+ * left untouched, so this can be called as often as needed.
+ * \param[in] stats statistics
+ *
+ */
+void stats_sig_sync(stats_type* stats);
+
+/**
+ * Reset the signature counters, including the drudger slots. Only call
+ * this when no drudger is signing the zone.
+ * \param[in] stats statistics
+ *
+ */
+void stats_sig_reset(stats_type* stats);
+
+/**
+ * Record the latency of an HSM sign call.
+ * \param[in] slot drudger slot
+ * \param[in] repository repository name
+ * \param[in] ns latency in nanoseconds
+ *
+ */
+void stats_hsm_record(size_t slot, const char* repository, uint64_t ns);
+
+/**
+ * Number of repositories with a latency histogram.
+ * \return size_t number of repositories
+ *
+ */
+size_t stats_hsm_count(void);
+
+/**
+ * Aggregate the latency histogram of a repository over all drudgers.
+ * \param[in] index repository index
+ * \param[out] hsm aggregated histogram
+ * \return const char* repository name, NULL if out of range
+ *
+ */
+const char* stats_hsm_sum(size_t index, stats_hsm_type* hsm);
+
+/**
+ * Estimate a latency percentile from a histogram.
+ * \param[in] hsm histogram
+ * \param[in] pct percentile, between 0 and 100
+ * \return uint64_t upper bound of the latency in nanoseconds
+ *
+ */
+uint64_t stats_hsm_percentile(stats_hsm_type* hsm, unsigned pct);
+
+/**
+ * Log HSM latency histograms.
+ *
+ */
+void stats_hsm_log(void);
+
+/**
+ * Count a lookup in the HSM key cache. The caller serializes calls.
+ * \param[in] hit true if the key was found
+ * \param[in] saved_ns HSM time that the hit saved, in nanoseconds
+ *
+ */
+void stats_keycache_record(int hit, uint64_t saved_ns);
+
+/**
+ * Get the HSM key cache counters.
+ * \param[out] hits number of keys found in the cache
+ * \param[out] misses number of keys looked up in the HSM
+ * \param[out] saved_ns HSM time saved, in nanoseconds
+ *
+ */
+void stats_keycache_get(uint64_t* hits, uint64_t* misses, uint64_t* saved_ns);
+
 /**
  * Log statistics.
  * \param[in] stats statistics
@@ -87,6 +250,15 @@ stats_type* stats_create(void);
 void stats_log(stats_type* stats, const char* name, uint32_t serial,
     ldns_rr_type nsec_type);
 
+/**
+ * Remember the statistics of a published zone. Call this with the stats
+ * lock held, before the statistics are cleared.
+ * \param[in] stats statistics
+ * \param[in] now publication time
+ *
+ */
+void stats_publish(stats_type* stats, time_t now);
+
 /**
  * Clear statistics.
  * \param[in] stats statistics to be cleared
@@ -33,18 +33,40 @@
 
 #include "config.h"
 #include "daemon/dnshandler.h"
+#include "adapter/adapi.h"
 #include "adapter/adapter.h"
+#include "shared/duration.h"
 #include "shared/log.h"
 #include "signer/tools.h"
 #include "signer/zone.h"
 
 #include <errno.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 static const char* tools_str = "tools";
 
+/**
+ * Notify commands that have not been reaped yet. Only these are waited
+ * for, other children of the signer are none of our business.
+ *
+ */
+typedef struct tools_notify_struct tools_notify_type;
+struct tools_notify_struct {
+    pid_t pid;
+    tools_notify_type* next;
+};
+static tools_notify_type* tools_notify_list = NULL;
+static size_t tools_notify_count = 0;
+#ifdef HAVE_PTHREAD
+static lock_basic_type tools_notify_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 
 /**
  * Load zone signconf.
@@ -79,6 +101,8 @@ tools_signconf(zone_type* zone)
         zone->signconf = new_signconf;
         signconf_log(zone->signconf, zone->name);
         zone->default_ttl = (uint32_t) duration2time(zone->signconf->soa_min);
+        /* keys or parameters may have changed, sign everything again */
+        zone->db->dirty_all = 1;
     } else if (status != ODS_STATUS_UNCHANGED) {
         ods_log_error("[%s] unable to load signconf for zone %s: %s",
             tools_str, zone->name, ods_status2str(status));
@@ -96,7 +120,8 @@ tools_input(zone_type* zone)
 {
     ods_status status = ODS_STATUS_OK;
     time_t start = 0;
-    time_t end = 0;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
 
     ods_log_assert(zone);
     ods_log_assert(zone->name);
@@ -110,7 +135,7 @@ tools_input(zone_type* zone)
             ods_status2str(status));
         zone_rollback_dnskeys(zone);
         zone_rollback_nsec3param(zone);
-        namedb_rollback(zone->db, 0);
+        adapi_rollback(zone, 0);
         return status;
     }
     /* Denial of Existence Rollover? */
@@ -121,7 +146,7 @@ tools_input(zone_type* zone)
             ods_status2str(status));
         zone_rollback_dnskeys(zone);
         zone_rollback_nsec3param(zone);
-        namedb_rollback(zone->db, 0);
+        adapi_rollback(zone, 0);
         return status;
     }
 
@@ -134,20 +159,21 @@ tools_input(zone_type* zone)
     }
     /* Input Adapter */
     start = time(NULL);
+    start_ns = time_monotonic_ns();
     status = adapter_read((void*)zone);
     if (status != ODS_STATUS_OK && status != ODS_STATUS_UNCHANGED) {
         ods_log_error("[%s] unable to read zone %s: adapter failed (%s)",
             tools_str, zone->name, ods_status2str(status));
         zone_rollback_dnskeys(zone);
         zone_rollback_nsec3param(zone);
-        namedb_rollback(zone->db, 0);
+        adapi_rollback(zone, 0);
     }
-    end = time(NULL);
+    end_ns = time_monotonic_ns();
     if ((status == ODS_STATUS_OK || status == ODS_STATUS_UNCHANGED)
         && zone->stats) {
         lock_basic_lock(&zone->stats->stats_lock);
         zone->stats->start_time = start;
-        zone->stats->sort_time = (end-start);
+        zone->stats->sort_time = (end_ns-start_ns);
         zone->stats->sort_done = 1;
         lock_basic_unlock(&zone->stats->stats_lock);
     }
@@ -170,6 +196,93 @@ ods_closeall(int fd)
 }
 
 
+/**
+ * Remember a forked notify command.
+ *
+ */
+static void
+tools_notify_add(pid_t pid)
+{
+    tools_notify_type* notify = (tools_notify_type*) malloc(
+        sizeof(tools_notify_type));
+    if (!notify) {
+        ods_log_error("[%s] unable to track notify command [%i]: malloc "
+            "failed", tools_str, (int) pid);
+        return;
+    }
+    notify->pid = pid;
+    lock_basic_lock(&tools_notify_lock);
+    notify->next = tools_notify_list;
+    tools_notify_list = notify;
+    tools_notify_count++;
+    lock_basic_unlock(&tools_notify_lock);
+    return;
+}
+
+
+/**
+ * Number of notify commands that have not been reaped yet.
+ *
+ */
+size_t
+tools_notify_pending(void)
+{
+    size_t count = 0;
+    lock_basic_lock(&tools_notify_lock);
+    count = tools_notify_count;
+    lock_basic_unlock(&tools_notify_lock);
+    return count;
+}
+
+
+/**
+ * Reap notify commands that have finished.
+ *
+ */
+void
+tools_reap_notify(void)
+{
+    tools_notify_type** entry = NULL;
+    tools_notify_type* notify = NULL;
+    int status = 0;
+    pid_t pid = 0;
+    lock_basic_lock(&tools_notify_lock);
+    entry = &tools_notify_list;
+    while (*entry) {
+        notify = *entry;
+        pid = waitpid(notify->pid, &status, WNOHANG);
+        if (pid == -1 && errno == EINTR) {
+            continue;
+        }
+        if (pid == 0) {
+            /* still running */
+            entry = &notify->next;
+            continue;
+        }
+        if (pid == -1) {
+            ods_log_warning("[%s] unable to reap notify command [%i]: "
+                "waitpid() failed (%s)", tools_str, (int) notify->pid,
+                strerror(errno));
+        } else if (!WIFEXITED(status)) {
+            ods_log_error("[%s] notify nameserver failed: notify command "
+                "[%i] did not terminate normally", tools_str, (int) pid);
+        } else if (WEXITSTATUS(status) != 0) {
+            ods_log_error("[%s] notify nameserver failed: notify command "
+                "[%i] exited with %i", tools_str, (int) pid,
+                WEXITSTATUS(status));
+        } else {
+            ods_log_verbose("[%s] notify nameserver [%i] ok", tools_str,
+                (int) pid);
+        }
+        *entry = notify->next;
+        tools_notify_count--;
+        free((void*) notify);
+    }
+    lock_basic_unlock(&tools_notify_lock);
+    return;
+}
+
+
 /**
  * Write zone to output adapter.
  *
@@ -178,6 +291,7 @@ ods_status
 tools_output(zone_type* zone, engine_type* engine)
 {
     ods_status status = ODS_STATUS_OK;
+    uint64_t start_ns = 0;
     ods_log_assert(engine);
     ods_log_assert(engine->config);
     ods_log_assert(zone);
@@ -202,22 +316,27 @@ tools_output(zone_type* zone, engine_type* engine)
         lock_basic_unlock(&zone->stats->stats_lock);
     }
     /* Output Adapter */
+    start_ns = time_monotonic_ns();
     status = adapter_write((void*)zone);
     if (status != ODS_STATUS_OK) {
         ods_log_error("[%s] unable to write zone %s: adapter failed (%s)",
             tools_str, zone->name, ods_status2str(status));
         return status;
     }
+    if (zone->stats) {
+        lock_basic_lock(&zone->stats->stats_lock);
+        zone->stats->write_time = (time_monotonic_ns() - start_ns);
+        lock_basic_unlock(&zone->stats->stats_lock);
+    }
     zone->db->outserial = zone->db->intserial;
     zone->db->is_initialized = 1;
     zone->db->have_serial = 1;
     lock_basic_lock(&zone->ixfr->ixfr_lock);
     ixfr_purge(zone->ixfr);
     lock_basic_unlock(&zone->ixfr->ixfr_lock);
-    /* kick the nameserver */
+    /* kick the nameserver, do not wait for the command to finish */
     if (zone->notify_ns) {
-        int status;
-        pid_t pid, wpid;
+        pid_t pid;
         ods_log_verbose("[%s] notify nameserver: %s", tools_str,
             zone->notify_ns);
 	/** fork */
@@ -237,23 +356,10 @@ tools_output(zone_type* zone, engine_type* engine)
                 exit(1);
                 break;
             default: /* parent */
-                ods_log_debug("[%s] notify nameserver process forked",
-                    tools_str);
-                /** wait for completion  */
-                while((wpid = waitpid(pid, &status, 0)) <= 0) {
-                    if (errno != EINTR) {
-                        break;
-                    }
-                }
-                if (wpid == -1) {
-                    ods_log_error("[%s] notify nameserver failed: waitpid() ",
-                        "failed (%s)", tools_str, strerror(errno));
-                } else if (!WIFEXITED(status)) {
-                    ods_log_error("[%s] notify nameserver failed: notify ",
-                        "command did not terminate normally", tools_str);
-                } else {
-                    ods_log_verbose("[%s] notify nameserver ok", tools_str);
-                }
+                /** reaped by the engine */
+                ods_log_debug("[%s] notify nameserver process [%i] forked",
+                    tools_str, (int) pid);
+                tools_notify_add(pid);
                 break;
         }
     }
@@ -265,8 +371,10 @@ tools_output(zone_type* zone, engine_type* engine)
             zone->name?zone->name:"(null)", (unsigned) zone->db->outserial);
         stats_log(zone->stats, zone->name, zone->db->outserial,
             zone->signconf->nsec_type);
+        stats_publish(zone->stats, zone->stats->end_time);
         stats_clear(zone->stats);
         lock_basic_unlock(&zone->stats->stats_lock);
+        stats_hsm_log();
     }
     if (engine->dnshandler) {
         dnshandler_fwd_notify(engine->dnshandler, (uint8_t*) ODS_SE_NOTIFY_CMD,
@@ -64,4 +64,18 @@ ods_status tools_input(zone_type* zone);
  */
 ods_status tools_output(zone_type* zone, engine_type* engine);
 
+/**
+ * Number of notify commands that have not been reaped yet.
+ * \return size_t number of notify commands
+ *
+ */
+size_t tools_notify_pending(void);
+
+/**
+ * Reap notify commands that have finished, without blocking. Only the
+ * forked notify commands are waited for.
+ *
+ */
+void tools_reap_notify(void);
+
 #endif /* SIGNER_TOOLS_H */
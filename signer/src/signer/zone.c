@@ -99,7 +99,11 @@ zone_create(char* name, ldns_rr_class klass)
     zone->adinbound = NULL;
     zone->adoutbound = NULL;
     zone->zl_status = ZONE_ZL_OK;
+    zone->zl_next = NULL;
+    zone->zl_queued = 0;
     zone->task = NULL;
+    zone->pipeline = NULL;
+    zone->pipeline_owner = NULL;
     zone->xfrd = NULL;
     zone->notify = NULL;
     zone->db = namedb_create((void*)zone);
@@ -150,7 +154,7 @@ zone_load_signconf(zone_type* zone, signconf_type** new_signconf)
         return ODS_STATUS_INSECURE;
     }
     status = signconf_update(&signconf, zone->signconf_filename,
-        zone->signconf->last_modified);
+        zone->signconf);
     if (status == ODS_STATUS_OK) {
         if (!signconf) {
             /* this is unexpected */
@@ -187,6 +191,18 @@ zone_load_signconf(zone_type* zone, signconf_type** new_signconf)
  */
 ods_status
 zone_reschedule_task(zone_type* zone, schedule_type* taskq, task_id what)
+{
+    return zone_reschedule_task_at(zone, taskq, what, time_now());
+}
+
+
+/**
+ * Reschedule task for zone, no later than a given time.
+ *
+ */
+ods_status
+zone_reschedule_task_at(zone_type* zone, schedule_type* taskq, task_id what,
+    time_t when)
 {
      task_type* task = NULL;
      ods_status status = ODS_STATUS_OK;
@@ -208,7 +224,9 @@ zone_reschedule_task(zone_type* zone, schedule_type* taskq, task_id what)
          if (task->what > what) {
              task->what = what;
          }
-         task->when = time_now();
+         if (when < task->when) {
+             task->when = when;
+         }
          status = schedule_task(taskq, task, 0);
      } else {
          /* task not queued, being worked on? */
@@ -244,13 +262,6 @@ zone_publish_dnskeys(zone_type* zone)
     }
     ods_log_assert(zone->name);
 
-    /* hsm access */
-    ctx = hsm_create_context();
-    if (ctx == NULL) {
-        ods_log_error("[%s] unable to publish keys for zone %s: "
-            "error creating libhsm context", zone_str, zone->name);
-        return ODS_STATUS_HSM_ERR;
-    }
     ttl = zone->default_ttl;
     /* dnskey ttl */
     if (zone->signconf->dnskey_ttl) {
@@ -262,9 +273,22 @@ zone_publish_dnskeys(zone_type* zone)
             continue;
         }
         if (!zone->signconf->keys->keys[i].dnskey) {
-            /* get dnskey */
-            status = lhsm_get_key(ctx, zone->apex,
+            /* get dnskey, the hsm is only accessed if it is not cached */
+            status = lhsm_get_cached_key(zone->apex,
                 &zone->signconf->keys->keys[i]);
+            if (status == ODS_STATUS_UNCHANGED && !ctx) {
+                ctx = hsm_create_context();
+                if (ctx == NULL) {
+                    ods_log_error("[%s] unable to publish keys for zone %s: "
+                        "error creating libhsm context", zone_str,
+                        zone->name);
+                    return ODS_STATUS_HSM_ERR;
+                }
+            }
+            if (status == ODS_STATUS_UNCHANGED) {
+                status = lhsm_get_key(ctx, zone->apex,
+                    &zone->signconf->keys->keys[i]);
+            }
             if (status != ODS_STATUS_OK) {
                 ods_log_error("[%s] unable to publish dnskeys for zone %s: "
                     "error creating dnskey", zone_str, zone->name);
@@ -296,7 +320,9 @@ zone_publish_dnskeys(zone_type* zone)
         }
     }
     /* done */
-    hsm_destroy_context(ctx);
+    if (ctx) {
+        hsm_destroy_context(ctx);
+    }
     return status;
 }
 
@@ -439,17 +465,24 @@ zone_prepare_keys(zone_type* zone)
         return ODS_STATUS_ASSERT_ERR;
     }
     ods_log_assert(zone->name);
-    /* hsm access */
-    ctx = hsm_create_context();
-    if (ctx == NULL) {
-        ods_log_error("[%s] unable to prepare signing keys for zone %s: "
-            "error creating libhsm context", zone_str, zone->name);
-        return ODS_STATUS_HSM_ERR;
-    }
     /* prepare keys */
     for (i=0; i < zone->signconf->keys->count; i++) {
-        /* get dnskey */
-        status = lhsm_get_key(ctx, zone->apex, &zone->signconf->keys->keys[i]);
+        /* get dnskey, the hsm is only accessed if it is not cached */
+        status = lhsm_get_cached_key(zone->apex,
+            &zone->signconf->keys->keys[i]);
+        if (status == ODS_STATUS_UNCHANGED && !ctx) {
+            ctx = hsm_create_context();
+            if (ctx == NULL) {
+                ods_log_error("[%s] unable to prepare signing keys for zone "
+                    "%s: error creating libhsm context", zone_str,
+                    zone->name);
+                return ODS_STATUS_HSM_ERR;
+            }
+        }
+        if (status == ODS_STATUS_UNCHANGED) {
+            status = lhsm_get_key(ctx, zone->apex,
+                &zone->signconf->keys->keys[i]);
+        }
         if (status != ODS_STATUS_OK) {
             ods_log_error("[%s] unable to prepare signing keys for zone %s: "
                 "error getting dnskey", zone_str, zone->name);
@@ -460,7 +493,9 @@ zone_prepare_keys(zone_type* zone)
         ods_log_assert(zone->signconf->keys->keys[i].params);
     }
     /* done */
-    hsm_destroy_context(ctx);
+    if (ctx) {
+        hsm_destroy_context(ctx);
+    }
     return status;
 }
 
@@ -610,12 +645,14 @@ zone_add_rr(zone_type* zone, ldns_rr* rr, int do_stats)
             ldns_rr_set_ttl(record->rr, ldns_rr_ttl(rr));
             rrset->needs_signing = 1;
         }
+        namedb_dirty_domain(zone->db, domain, ldns_rr_get_type(rr));
         return ODS_STATUS_UNCHANGED;
     } else {
         record = rrset_add_rr(rrset, rr);
         ods_log_assert(record);
         ods_log_assert(record->rr);
         ods_log_assert(record->is_added);
+        namedb_dirty_domain(zone->db, domain, ldns_rr_get_type(rr));
     }
     /* update stats */
     if (do_stats && zone->stats) {
@@ -661,6 +698,7 @@ zone_del_rr(zone_type* zone, ldns_rr* rr, int do_stats)
 
     record->is_removed = 1;
     record->is_added = 0; /* unset is_added */
+    namedb_dirty_domain(zone->db, domain, ldns_rr_get_type(rr));
     /* update stats */
     if (do_stats && zone->stats) {
         zone->stats->sort_count -= 1;
@@ -724,12 +762,14 @@ zone_merge(zone_type* z1, zone_type* z2)
         z2->adinbound = z1->adinbound;
         z1->adinbound = adtmp;
         adtmp = NULL;
+        z1->zl_status = ZONE_ZL_UPDATED;
     }
     if (adapter_compare(z2->adoutbound, z1->adoutbound) != 0) {
         adtmp = z2->adoutbound;
         z2->adoutbound = z1->adoutbound;
         z1->adoutbound = adtmp;
         adtmp = NULL;
+        z1->zl_status = ZONE_ZL_UPDATED;
     }
     return;
 }
@@ -752,6 +792,9 @@ zone_cleanup(zone_type* zone)
     zone_lock = zone->zone_lock;
     xfr_lock = zone->xfr_lock;
     ldns_rdf_deep_free(zone->apex);
+    if (zone->pipeline_owner) {
+        ldns_rdf_deep_free(zone->pipeline_owner);
+    }
     adapter_cleanup(zone->adinbound);
     adapter_cleanup(zone->adoutbound);
     namedb_cleanup(zone->db);
@@ -79,6 +79,8 @@ struct zone_struct {
     const char* policy_name; /* policy identifier */
     const char* signconf_filename; /* signconf filename */
     zone_zl_status zl_status; /* zonelist status */
+    zone_type* zl_next; /* next zone in the zonelist change set */
+    int zl_queued; /* zone is in the zonelist change set */
     /* adapters */
     adapter_type* adinbound; /* inbound adapter */
     adapter_type* adoutbound; /* outbound adapter */
@@ -92,6 +94,8 @@ struct zone_struct {
     notify_type* notify;
     /* worker variables */
     void* task; /* next assigned task */
+    void* pipeline; /* worker signing while the zone is being read */
+    ldns_rdf* pipeline_owner; /* last owner name read while pipelining */
     /* statistics */
     stats_type* stats;
     lock_basic_type zone_lock;
@@ -130,6 +134,19 @@ ods_status zone_load_signconf(zone_type* zone, signconf_type** new_signconf);
 ods_status zone_reschedule_task(zone_type* zone, schedule_type* taskq,
     task_id what);
 
+/**
+ * Reschedule task for zone, no later than a given time. A task that is
+ * already due earlier keeps its time.
+ * \param[in] zone zone
+ * \param[in] taskq task queue
+ * \param[in] what new task identifier
+ * \param[in] when time to run the task
+ * \return ods_status status
+ *
+ */
+ods_status zone_reschedule_task_at(zone_type* zone, schedule_type* taskq,
+    task_id what, time_t when);
+
 /**
  * Publish the keys as indicated by the signer configuration.
  * \param[in] zone zone
@@ -39,33 +39,27 @@
 #include "shared/file.h"
 #include "shared/log.h"
 #include "shared/status.h"
+#include "shared/util.h"
 #include "signer/zone.h"
 #include "signer/zonelist.h"
 
 #include <ldns/ldns.h>
 #include <stdlib.h>
+#include <string.h>
 
 static const char* zl_str = "zonelist";
 
 
 /**
- * Compare two zones.
+ * Make the name index key of a zone: class, then apex.
  *
  */
-static int
-zone_compare(const void* a, const void* b)
+static size_t
+zone2key(ldns_rdf* apex, ldns_rr_class klass, uint8_t* key)
 {
-    zone_type* x = (zone_type*)a;
-    zone_type* y = (zone_type*)b;
-    ods_log_assert(x);
-    ods_log_assert(y);
-    if (x->klass != y->klass) {
-        if (x->klass < y->klass) {
-            return -1;
-        }
-        return 1;
-    }
-    return ldns_dname_compare(x->apex, y->apex);
+    key[2] = (uint8_t) (klass >> 8);
+    key[3] = (uint8_t) (klass & 0xff);
+    return util_dname_key(apex, key, 2);
 }
 
 
@@ -86,7 +80,7 @@ zonelist_create(allocator_type* allocator)
         return NULL;
     }
     zlist->allocator = allocator;
-    zlist->zones = ldns_rbtree_create(zone_compare);
+    zlist->zones = ldns_rbtree_create(util_dname_key_compare);
     if (!zlist->zones) {
         ods_log_error("[%s] unable to create zonelist: ldns_rbtree_create() "
             "failed", zl_str);
@@ -94,7 +88,16 @@ zonelist_create(allocator_type* allocator)
         return NULL;
     }
     zlist->last_modified = 0;
+    zlist->just_added = 0;
+    zlist->just_updated = 0;
+    zlist->just_removed = 0;
+    zlist->changes = NULL;
+    zlist->num_changes = 0;
+    zlist->file_changes = 0;
+    zlist->file_written = 0;
     lock_basic_init(&zlist->zl_lock);
+    lock_basic_init(&zlist->commit_lock);
+    lock_basic_init(&zlist->file_lock);
     return zlist;
 }
 
@@ -121,40 +124,63 @@ zonelist_read(zonelist_type* zl, const char* zlfile)
 
 
 /**
- * Convert a zone to a tree node.
+ * Convert a zone to a tree node, with the key stored right behind it.
  *
  */
 static ldns_rbnode_t*
 zone2node(zone_type* zone)
 {
-    ldns_rbnode_t* node = (ldns_rbnode_t*) malloc(sizeof(ldns_rbnode_t));
+    uint8_t key[UTIL_DNAME_KEY_SIZE];
+    size_t len = zone2key(zone->apex, zone->klass, key);
+    ldns_rbnode_t* node = NULL;
+    if (!len) {
+        return NULL;
+    }
+    node = (ldns_rbnode_t*) malloc(sizeof(ldns_rbnode_t) + len);
     if (!node) {
         return NULL;
     }
-    node->key = zone;
+    memcpy((uint8_t*) (node + 1), key, len);
+    node->key = (uint8_t*) (node + 1);
     node->data = zone;
     return node;
 }
 
 
 /**
- * Lookup zone.
+ * Search zone node.
  *
  */
-static zone_type*
-zonelist_lookup_zone(zonelist_type* zonelist, zone_type* zone)
+static ldns_rbnode_t*
+zonelist_search(zonelist_type* zonelist, ldns_rdf* apex, ldns_rr_class klass)
 {
+    uint8_t key[UTIL_DNAME_KEY_SIZE];
     ldns_rbnode_t* node = LDNS_RBTREE_NULL;
-    if (zonelist && zonelist->zones && zone) {
-        node = ldns_rbtree_search(zonelist->zones, zone);
-        if (node) {
-            return (zone_type*) node->data;
+    if (zonelist && zonelist->zones && zone2key(apex, klass, key)) {
+        node = ldns_rbtree_search(zonelist->zones, key);
+        if (node && node != LDNS_RBTREE_NULL) {
+            return node;
         }
     }
     return NULL;
 }
 
 
+/**
+ * Lookup zone.
+ *
+ */
+static zone_type*
+zonelist_lookup_zone(zonelist_type* zonelist, zone_type* zone)
+{
+    ldns_rbnode_t* node = NULL;
+    if (zone) {
+        node = zonelist_search(zonelist, zone->apex, zone->klass);
+    }
+    return node ? (zone_type*) node->data : NULL;
+}
+
+
 /**
  * Lookup zone by name.
  *
@@ -163,17 +189,17 @@ zone_type*
 zonelist_lookup_zone_by_name(zonelist_type* zonelist, const char* name,
     ldns_rr_class klass)
 {
-    zone_type* zone = NULL;
+    ldns_rdf* dname = NULL;
     zone_type* result = NULL;
     if (zonelist && zonelist->zones && name  && klass) {
-        zone = zone_create((char*) name, klass);
-        if (!zone) {
+        dname = ldns_dname_new_frm_str(name);
+        if (!dname) {
             ods_log_error("[%s] unable to lookup zone %s: "
-                "zone_create() failed", zl_str, name);
+                "ldns_dname_new_frm_str() failed", zl_str, name);
             /* result stays NULL */
         } else {
-            result = zonelist_lookup_zone(zonelist, zone);
-            zone_cleanup(zone);
+            result = zonelist_lookup_zone_by_dname(zonelist, dname, klass);
+            ldns_rdf_deep_free(dname);
         }
     }
     return result;
@@ -188,14 +214,48 @@ zone_type*
 zonelist_lookup_zone_by_dname(zonelist_type* zonelist, ldns_rdf* dname,
     ldns_rr_class klass)
 {
-    char* name = NULL;
-    zone_type* result = NULL;
+    ldns_rbnode_t* node = NULL;
     if (zonelist && zonelist->zones && dname && klass) {
-        name = ldns_rdf2str(dname);
-        result = zonelist_lookup_zone_by_name(zonelist, name, klass);
-        free((void*)name);
+        node = zonelist_search(zonelist, dname, klass);
     }
-    return result;
+    return node ? (zone_type*) node->data : NULL;
+}
+
+
+/**
+ * Put zone in the change set.
+ *
+ */
+static void
+zonelist_queue_zone(zonelist_type* zlist, zone_type* zone)
+{
+    if (zone->zl_queued) {
+        return;
+    }
+    zone->zl_next = zlist->changes;
+    zone->zl_queued = 1;
+    zlist->changes = zone;
+    zlist->num_changes++;
+    return;
+}
+
+
+/**
+ * Empty the change set, without committing.
+ *
+ */
+static void
+zonelist_clear_changes(zonelist_type* zlist)
+{
+    zone_type* zone = NULL;
+    while (zlist->changes) {
+        zone = zlist->changes;
+        zlist->changes = zone->zl_next;
+        zone->zl_next = NULL;
+        zone->zl_queued = 0;
+    }
+    zlist->num_changes = 0;
+    return;
 }
 
 
@@ -223,7 +283,7 @@ zonelist_add_zone(zonelist_type* zlist, zone_type* zone)
     }
     /* add */
     new_node = zone2node(zone);
-    if (ldns_rbtree_insert(zlist->zones, new_node) == NULL) {
+    if (!new_node || ldns_rbtree_insert(zlist->zones, new_node) == NULL) {
         ods_log_error("[%s] unable to add zone %s: ldns_rbtree_insert() "
             "failed", zl_str, zone->name);
         free((void*) new_node);
@@ -232,6 +292,7 @@ zonelist_add_zone(zonelist_type* zlist, zone_type* zone)
     }
     zone->zl_status = ZONE_ZL_ADDED;
     zlist->just_added++;
+    zonelist_queue_zone(zlist, zone);
     return zone;
 }
 
@@ -250,7 +311,10 @@ zonelist_del_zone(zonelist_type* zlist, zone_type* zone)
     if (!zlist || !zlist->zones) {
         goto zone_not_present;
     }
-    old_node = ldns_rbtree_delete(zlist->zones, zone);
+    old_node = zonelist_search(zlist, zone->apex, zone->klass);
+    if (old_node) {
+        old_node = ldns_rbtree_delete(zlist->zones, old_node->key);
+    }
     if (!old_node) {
         goto zone_not_present;
     }
@@ -264,6 +328,33 @@ zone_not_present:
 }
 
 
+/**
+ * Merge new values into zone.
+ *
+ */
+static ods_status
+zonelist_merge_zone(zonelist_type* zl, zone_type* z1, zone_type* z2)
+{
+    zone_zl_status zl_status = z1->zl_status;
+    z1->zl_status = ZONE_ZL_OK;
+    zone_merge(z1, z2);
+    zone_cleanup(z2);
+    if (zl_status == ZONE_ZL_ADDED) {
+        /* not committed yet, will be fully configured anyway */
+        z1->zl_status = ZONE_ZL_ADDED;
+        return ODS_STATUS_OK;
+    } else if (z1->zl_status == ZONE_ZL_UPDATED ||
+        zl_status != ZONE_ZL_OK) {
+        /* changed now, or still pending from an earlier update */
+        z1->zl_status = ZONE_ZL_UPDATED;
+        zl->just_updated++;
+        zonelist_queue_zone(zl, z1);
+        return ODS_STATUS_OK;
+    }
+    return ODS_STATUS_UNCHANGED;
+}
+
+
 /**
  * Merge zone lists.
  *
@@ -305,12 +396,11 @@ zonelist_merge(zonelist_type* zl1, zonelist_type* zl2)
             n2 = ldns_rbtree_next(n2);
         } else {
             /* compare the zones z1 and z2 */
-            ret = zone_compare(z1, z2);
+            ret = util_dname_key_compare(n1->key, n2->key);
             if (ret < 0) {
                 /* remove zone z1, it is not present in the new list zl2 */
-                z1->zl_status = ZONE_ZL_REMOVED;
-                zl1->just_removed++;
                 n1 = ldns_rbtree_next(n1);
+                zonelist_remove_zone(zl1, z1);
             } else if (ret > 0) {
                 /* add the new zone z2 */
                 z2 = zonelist_add_zone(zl1, z2);
@@ -320,30 +410,221 @@ zonelist_merge(zonelist_type* zl1, zonelist_type* zl2)
                 }
                 n2 = ldns_rbtree_next(n2);
             } else {
-                /* just update zone z1 */
+                /* update zone z1, only if something changed */
                 n1 = ldns_rbtree_next(n1);
                 n2 = ldns_rbtree_next(n2);
-                zone_merge(z1, z2);
-                zone_cleanup(z2);
-                if (z1->zl_status == ZONE_ZL_UPDATED) {
-                    zl1->just_updated++;
-                }
-                z1->zl_status = ZONE_ZL_UPDATED;
+                (void)zonelist_merge_zone(zl1, z1, z2);
             }
         }
     }
     /* remove remaining zones from z1 */
     while (n1 && n1 != LDNS_RBTREE_NULL) {
         z1 = (zone_type*) n1->data;
-        z1->zl_status = ZONE_ZL_REMOVED;
-        zl1->just_removed++;
         n1 = ldns_rbtree_next(n1);
+        zonelist_remove_zone(zl1, z1);
     }
     zl1->last_modified = zl2->last_modified;
     return;
 }
 
 
+/**
+ * Add or update zone.
+ *
+ */
+ods_status
+zonelist_update_zone(zonelist_type* zl, zone_type* zone)
+{
+    zone_type* z1 = NULL;
+    ods_status status = ODS_STATUS_OK;
+    if (!zone) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    if (!zl || !zl->zones) {
+        zone_cleanup(zone);
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    z1 = zonelist_lookup_zone(zl, zone);
+    if (!z1) {
+        if (!zonelist_add_zone(zl, zone)) {
+            return ODS_STATUS_ERR;
+        }
+        zl->file_changes++;
+        return ODS_STATUS_OK;
+    }
+    status = zonelist_merge_zone(zl, z1, zone);
+    if (status == ODS_STATUS_OK) {
+        zl->file_changes++;
+    }
+    return status;
+}
+
+
+/**
+ * Mark zone for removal.
+ *
+ */
+void
+zonelist_remove_zone(zonelist_type* zl, zone_type* zone)
+{
+    zone_type** prev = NULL;
+    if (!zl || !zone) {
+        return;
+    }
+    zl->file_changes++;
+    if (zone->zl_status == ZONE_ZL_ADDED && !zone->task) {
+        /* nothing refers to it yet, no need to wait for the commit */
+        for (prev = &zl->changes; *prev; prev = &(*prev)->zl_next) {
+            if (*prev == zone) {
+                *prev = zone->zl_next;
+                zl->num_changes--;
+                break;
+            }
+        }
+        if (zl->just_added > 0) {
+            zl->just_added--;
+        }
+        ods_log_debug("[%s] removed zone %s, not committed yet", zl_str,
+            zone->name);
+        zone_cleanup(zonelist_del_zone(zl, zone));
+        return;
+    }
+    zone->zl_status = ZONE_ZL_REMOVED;
+    zl->just_removed++;
+    zonelist_queue_zone(zl, zone);
+    return;
+}
+
+
+/**
+ * Put zone back in the change set.
+ *
+ */
+void
+zonelist_requeue_zone(zonelist_type* zl, zone_type* zone)
+{
+    if (!zl || !zone) {
+        return;
+    }
+    zonelist_queue_zone(zl, zone);
+    return;
+}
+
+
+/**
+ * Commit zone list changes.
+ *
+ */
+zone_type**
+zonelist_commit(zonelist_type* zl, int all, size_t* count)
+{
+    zone_type** zones = NULL;
+    zone_type* zone = NULL;
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    size_t num = 0;
+    size_t i = 0;
+
+    if (!count) {
+        return NULL;
+    }
+    *count = 0;
+    if (!zl || !zl->zones) {
+        return NULL;
+    }
+    num = zl->num_changes;
+    if (all) {
+        num += zl->zones->count;
+    }
+    if (num == 0) {
+        return NULL;
+    }
+    zones = (zone_type**) malloc(num * sizeof(zone_type*));
+    if (!zones) {
+        ods_log_error("[%s] unable to commit zonelist: malloc() failed",
+            zl_str);
+        return NULL;
+    }
+    if (all) {
+        /* unchanged zones first, the change set is taken below */
+        node = ldns_rbtree_first(zl->zones);
+        while (node && node != LDNS_RBTREE_NULL) {
+            zone = (zone_type*) node->data;
+            if (!zone->zl_queued) {
+                zones[i++] = zone;
+            }
+            node = ldns_rbtree_next(node);
+        }
+    }
+    while (zl->changes) {
+        zone = zl->changes;
+        zl->changes = zone->zl_next;
+        zone->zl_next = NULL;
+        zone->zl_queued = 0;
+        if (zone->zl_status == ZONE_ZL_REMOVED) {
+            (void)zonelist_del_zone(zl, zone);
+        }
+        zones[i++] = zone;
+    }
+    zl->num_changes = 0;
+    ods_log_debug("[%s] commit %u zones", zl_str, (unsigned) i);
+    *count = i;
+    return zones;
+}
+
+
+/**
+ * Write the zonelist file, if it is behind. Caller holds the file lock.
+ *
+ */
+static ods_status
+zonelist_flush(zonelist_type* zl, const char* zlfile)
+{
+    xmlDocPtr doc = NULL;
+    unsigned changes = 0;
+    ods_status status = ODS_STATUS_OK;
+
+    lock_basic_lock(&zl->zl_lock);
+    changes = zl->file_changes;
+    if (changes == zl->file_written) {
+        /* an earlier write took these changes along */
+        lock_basic_unlock(&zl->zl_lock);
+        return ODS_STATUS_OK;
+    }
+    doc = export_zonelist((void*) zl);
+    lock_basic_unlock(&zl->zl_lock);
+    if (!doc) {
+        return ODS_STATUS_MALLOC_ERR;
+    }
+    status = write_zonelist_file(zlfile, doc);
+    xmlFreeDoc(doc);
+    if (status == ODS_STATUS_OK) {
+        ods_log_debug("[%s] zonelist file %s written", zl_str, zlfile);
+        zl->file_written = changes;
+        /* no need to read back what we just wrote */
+        zl->last_modified = ods_file_lastmodified(zlfile);
+    }
+    return status;
+}
+
+
+/**
+ * Write zone list.
+ *
+ */
+ods_status
+zonelist_write(zonelist_type* zl, const char* zlfile)
+{
+    ods_status status = ODS_STATUS_OK;
+    if (!zl || !zl->zones || !zlfile) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    lock_basic_lock(&zl->file_lock);
+    status = zonelist_flush(zl, zlfile);
+    lock_basic_unlock(&zl->file_lock);
+    return status;
+}
+
+
 /**
  * Update zone list.
  *
@@ -361,9 +642,16 @@ zonelist_update(zonelist_type* zl, const char* zlfile)
     if (!zl|| !zl->zones || !zlfile) {
         return ODS_STATUS_ASSERT_ERR;
     }
+    lock_basic_lock(&zl->file_lock);
+    /* do not read back a file that lacks our own changes */
+    if (zonelist_flush(zl, zlfile) != ODS_STATUS_OK) {
+        ods_log_warning("[%s] zonelist file %s is behind, changes made by "
+            "add or remove may be undone", zl_str, zlfile);
+    }
     /* is the file updated? */
     st_mtime = ods_file_lastmodified(zlfile);
     if (st_mtime <= zl->last_modified) {
+        lock_basic_unlock(&zl->file_lock);
         (void)time_datestamp(zl->last_modified, "%Y-%m-%d %T", &datestamp);
         ods_log_debug("[%s] zonelist file %s is unchanged since %s",
             zl_str, zlfile, datestamp?datestamp:"Unknown");
@@ -373,23 +661,30 @@ zonelist_update(zonelist_type* zl, const char* zlfile)
     /* create new zonelist */
     tmp_alloc = allocator_create(malloc, free);
     if (!tmp_alloc) {
+        lock_basic_unlock(&zl->file_lock);
         return ODS_STATUS_MALLOC_ERR;
     }
     new_zlist = zonelist_create(tmp_alloc);
     if (!new_zlist) {
+        lock_basic_unlock(&zl->file_lock);
         ods_log_error("[%s] unable to update zonelist: zonelist_create() "
             "failed", zl_str);
         allocator_cleanup(tmp_alloc);
         return ODS_STATUS_ERR;
     }
-    /* read zonelist */
+    /* read zonelist, without blocking zone lookups */
     status = zonelist_read(new_zlist, zlfile);
     if (status == ODS_STATUS_OK) {
+        zonelist_clear_changes(new_zlist);
+        new_zlist->last_modified = st_mtime;
+        lock_basic_lock(&zl->zl_lock);
         zl->just_removed = 0;
         zl->just_added = 0;
         zl->just_updated = 0;
-        new_zlist->last_modified = st_mtime;
         zonelist_merge(zl, new_zlist);
+        /* the zone list is what the file says now */
+        zl->file_written = zl->file_changes;
+        lock_basic_unlock(&zl->zl_lock);
         (void)time_datestamp(zl->last_modified, "%Y-%m-%d %T", &datestamp);
         ods_log_debug("[%s] file %s is modified since %s", zl_str, zlfile,
             datestamp?datestamp:"Unknown");
@@ -398,6 +693,7 @@ zonelist_update(zonelist_type* zl, const char* zlfile)
         ods_log_error("[%s] unable to update zonelist: read file %s failed "
             "(%s)", zl_str, zlfile, ods_status2str(status));
     }
+    lock_basic_unlock(&zl->file_lock);
     zonelist_free(new_zlist);
     allocator_cleanup(tmp_alloc);
     return status;
@@ -449,6 +745,8 @@ zonelist_cleanup(zonelist_type* zl)
 {
     allocator_type* allocator;
     lock_basic_type zl_lock;
+    lock_basic_type commit_lock;
+    lock_basic_type file_lock;
     if (!zl) {
         return;
     }
@@ -460,8 +758,12 @@ zonelist_cleanup(zonelist_type* zl)
     }
     allocator = zl->allocator;
     zl_lock = zl->zl_lock;
+    commit_lock = zl->commit_lock;
+    file_lock = zl->file_lock;
     allocator_deallocate(allocator, (void*) zl);
     lock_basic_destroy(&zl_lock);
+    lock_basic_destroy(&commit_lock);
+    lock_basic_destroy(&file_lock);
     return;
 }
 
@@ -475,6 +777,8 @@ zonelist_free(zonelist_type* zl)
 {
     allocator_type* allocator;
     lock_basic_type zl_lock;
+    lock_basic_type commit_lock;
+    lock_basic_type file_lock;
     if (!zl) {
         return;
     }
@@ -485,7 +789,11 @@ zonelist_free(zonelist_type* zl)
     }
     allocator = zl->allocator;
     zl_lock = zl->zl_lock;
+    commit_lock = zl->commit_lock;
+    file_lock = zl->file_lock;
     allocator_deallocate(allocator, (void*) zl);
     lock_basic_destroy(&zl_lock);
+    lock_basic_destroy(&commit_lock);
+    lock_basic_destroy(&file_lock);
     return;
 }
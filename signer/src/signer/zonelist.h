@@ -54,7 +54,13 @@ struct zonelist_struct {
     int just_added;
     int just_updated;
     int just_removed;
+    zone_type* changes; /* zones with uncommitted zonelist status */
+    size_t num_changes;
     lock_basic_type zl_lock;
+    lock_basic_type commit_lock; /* serializes zonelist updates and commits */
+    unsigned file_changes; /* add/remove changes, under zl_lock */
+    unsigned file_written; /* changes in the file, under file_lock */
+    lock_basic_type file_lock; /* serializes writing the zonelist file */
 };
 
 /**
@@ -106,7 +112,53 @@ zone_type* zonelist_add_zone(zonelist_type* zl, zone_type* zone);
 zone_type* zonelist_del_zone(zonelist_type* zlist, zone_type* zone);
 
 /**
- * Update zonelist.
+ * Add a zone, or merge it into the zone with the same name.
+ * Caller must hold the zonelist lock.
+ * \param[in] zl zone list
+ * \param[in] zone zone, consumed
+ * \return ods_status status
+ *         ODS_STATUS_OK: zone added or updated, change set not empty
+ *         ODS_STATUS_UNCHANGED: zone is already present with these values
+ *         other: zone not added
+ *
+ */
+ods_status zonelist_update_zone(zonelist_type* zl, zone_type* zone);
+
+/**
+ * Mark zone for removal on the next commit. A zone that was added and
+ * not committed yet is deleted and cleaned up right away.
+ * Caller must hold the zonelist lock.
+ * \param[in] zl zone list
+ * \param[in] zone zone
+ *
+ */
+void zonelist_remove_zone(zonelist_type* zl, zone_type* zone);
+
+/**
+ * Put a zone that failed to commit back in the change set, so that the
+ * next commit retries it. Caller must hold the zonelist lock.
+ * \param[in] zl zone list
+ * \param[in] zone zone
+ *
+ */
+void zonelist_requeue_zone(zonelist_type* zl, zone_type* zone);
+
+/**
+ * Take the zonelist change set. Zones that are marked for removal are
+ * taken out of the zone list, the caller is responsible for cleaning
+ * them up. Caller must hold the zonelist lock.
+ * \param[in] zl zone list
+ * \param[in] all also return the zones that have not changed
+ * \param[out] count number of zones returned
+ * \return zone_type** zones, to be freed by the caller
+ *
+ */
+zone_type** zonelist_commit(zonelist_type* zl, int all, size_t* count);
+
+/**
+ * Update zonelist. The file is read without holding the zonelist lock,
+ * which is only taken to merge the differences. Caller must hold the
+ * commit lock.
  * \param[in] zl zone list
  * \param[in] zlfile zone list filename
  * \return ods_status status
@@ -114,6 +166,18 @@ zone_type* zonelist_del_zone(zonelist_type* zlist, zone_type* zone);
  */
 ods_status zonelist_update(zonelist_type* zl, const char* zlfile);
 
+/**
+ * Write the zones that have been added or removed since the zonelist file
+ * was last written or read. The file is written from the zone list in
+ * memory, so changes that pile up while a write is in progress go out in
+ * the next write together. Caller must not hold the zonelist lock.
+ * \param[in] zl zone list
+ * \param[in] zlfile zone list filename
+ * \return ods_status status
+ *
+ */
+ods_status zonelist_write(zonelist_type* zl, const char* zlfile);
+
 /**
  * Clean up zone list.
  * \param[in] zl zone list
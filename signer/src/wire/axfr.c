@@ -47,6 +47,23 @@
 const char* axfr_str = "axfr";
 
 
+/**
+ * Count outgoing zone transfer bytes.
+ *
+ */
+static void
+axfr_count(query_type* q)
+{
+    if (!q->zone || !q->zone->stats) {
+        return;
+    }
+    lock_basic_lock(&q->zone->stats->stats_lock);
+    q->zone->stats->xfr_out += buffer_position(q->buffer);
+    lock_basic_unlock(&q->zone->stats->stats_lock);
+    return;
+}
+
+
 /**
  * Handle SOA request.
  *
@@ -349,6 +366,7 @@ return_axfr:
     if (q->tcp) {
         ods_log_debug("[%s] return part axfr zone %s", axfr_str,
             q->zone->name);
+        axfr_count(q);
         buffer_pkt_set_ancount(q->buffer, total_added);
         buffer_pkt_set_nscount(q->buffer, 0);
         buffer_pkt_set_arcount(q->buffer, 0);
@@ -603,6 +621,7 @@ ixfr(query_type* q, engine_type* engine)
 
 return_ixfr:
     ods_log_debug("[%s] return part ixfr zone %s", axfr_str, q->zone->name);
+    axfr_count(q);
     buffer_pkt_set_ancount(q->buffer, total_added);
     buffer_pkt_set_nscount(q->buffer, 0);
     buffer_pkt_set_arcount(q->buffer, 0);
@@ -39,6 +39,7 @@
 #include "wire/notify.h"
 #include "wire/xfrd.h"
 
+#include <fcntl.h>
 #include <sys/socket.h>
 
 static const char* notify_str = "notify";
@@ -116,6 +117,7 @@ notify_create(void* xfrhandler, void* zone)
     notify->zone = zone;
     notify->xfrhandler = xfrhandler;
     notify->waiting_next = NULL;
+    notify->id_next = NULL;
     notify->secondary = NULL;
     notify->soa = NULL;
     notify->tsig_rr = tsig_rr_create(allocator);
@@ -126,18 +128,63 @@ notify_create(void* xfrhandler, void* zone)
     notify->retry = 0;
     notify->query_id = 0;
     notify->is_waiting = 0;
+    notify->is_sent = 0;
     notify->handler.fd = -1;
     notify->timeout.tv_sec = 0;
     notify->timeout.tv_nsec = 0;
     notify->handler.timeout = NULL;
     notify->handler.user_data = notify;
-    notify->handler.event_types =
-        NETIO_EVENT_READ|NETIO_EVENT_TIMEOUT;
+    notify->handler.event_types = NETIO_EVENT_TIMEOUT;
     notify->handler.event_handler = notify_handle_zone;
     return notify;
 }
 
 
+/**
+ * Add notify to the outstanding query ids.
+ *
+ */
+static void
+notify_link_id(notify_type* notify)
+{
+    xfrhandler_type* xfrhandler = (xfrhandler_type*) notify->xfrhandler;
+    notify_type** bucket = NULL;
+    ods_log_assert(xfrhandler);
+    ods_log_assert(!notify->is_sent);
+    bucket = &xfrhandler->notify_ids[notify->query_id % NOTIFY_ID_HASH];
+    notify->id_next = *bucket;
+    *bucket = notify;
+    notify->is_sent = 1;
+    return;
+}
+
+
+/**
+ * Remove notify from the outstanding query ids.
+ *
+ */
+static void
+notify_unlink_id(notify_type* notify)
+{
+    xfrhandler_type* xfrhandler = (xfrhandler_type*) notify->xfrhandler;
+    notify_type** bucket = NULL;
+    if (!notify->is_sent || !xfrhandler) {
+        return;
+    }
+    bucket = &xfrhandler->notify_ids[notify->query_id % NOTIFY_ID_HASH];
+    while (*bucket) {
+        if (*bucket == notify) {
+            *bucket = notify->id_next;
+            break;
+        }
+        bucket = &(*bucket)->id_next;
+    }
+    notify->id_next = NULL;
+    notify->is_sent = 0;
+    return;
+}
+
+
 /**
  * Setup notify.
  *
@@ -183,10 +230,7 @@ notify_disable(notify_type* notify)
     ods_log_assert(zone->name);
     notify->secondary = NULL;
     notify->handler.timeout = NULL;
-    if (notify->handler.fd != -1) {
-        close(notify->handler.fd);
-        notify->handler.fd = -1;
-    }
+    notify_unlink_id(notify);
     if (xfrhandler->notify_udp_num == NOTIFY_MAX_UDP) {
         while (xfrhandler->notify_waiting_first) {
             notify_type* wn = xfrhandler->notify_waiting_first;
@@ -235,27 +279,32 @@ notify_next(notify_type* notify)
 
 
 /**
- * Read packet from udp.
+ * Check whether a reply came from the secondary it was sent to.
  *
  */
 static int
-notify_udp_read_packet(notify_type* notify)
+notify_from_secondary(notify_type* notify, struct sockaddr_storage* from)
 {
-    xfrhandler_type* xfrhandler = NULL;
-    ssize_t received = 0;
+    struct sockaddr_storage to;
     ods_log_assert(notify);
-    xfrhandler = (xfrhandler_type*) notify->xfrhandler;
-    ods_log_assert(xfrhandler);
-    buffer_clear(xfrhandler->packet);
-    received = recvfrom(notify->handler.fd, buffer_begin(xfrhandler->packet),
-        buffer_remaining(xfrhandler->packet), 0, NULL, NULL);
-    if (received == -1) {
-        ods_log_error("[%s] unable to read packet: recvfrom() failed fd %d "
-            "(%s)", notify_str, notify->handler.fd, strerror(errno));
+    ods_log_assert(notify->secondary);
+    (void) xfrd_acl_sockaddr_to(notify->secondary, &to);
+    if (to.ss_family != from->ss_family) {
         return 0;
     }
-    buffer_set_limit(xfrhandler->packet, received);
-    return 1;
+#ifdef INET6
+    if (from->ss_family == AF_INET6) {
+        struct sockaddr_in6* a = (struct sockaddr_in6*) &to;
+        struct sockaddr_in6* b = (struct sockaddr_in6*) from;
+        return (a->sin6_port == b->sin6_port &&
+            memcmp(&a->sin6_addr, &b->sin6_addr,
+            sizeof(struct in6_addr)) == 0);
+    }
+#endif /* INET6 */
+    return (((struct sockaddr_in*) &to)->sin_port ==
+        ((struct sockaddr_in*) from)->sin_port &&
+        ((struct sockaddr_in*) &to)->sin_addr.s_addr ==
+        ((struct sockaddr_in*) from)->sin_addr.s_addr);
 }
 
 
@@ -303,6 +352,34 @@ notify_handle_reply(notify_type* notify)
 }
 
 
+/**
+ * Get the shared notify socket for an address family.
+ *
+ */
+static int
+notify_socket(xfrhandler_type* xfrhandler, int family)
+{
+    netio_handler_type* handler = &xfrhandler->notify_udp;
+    if (family == PF_INET6) {
+        handler = &xfrhandler->notify_udp6;
+    }
+    if (handler->fd != -1) {
+        return handler->fd;
+    }
+    handler->fd = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    if (handler->fd == -1) {
+        ods_log_error("[%s] unable to create notify socket: socket() "
+            "failed (%s)", notify_str, strerror(errno));
+        return -1;
+    }
+    if (fcntl(handler->fd, F_SETFL, O_NONBLOCK) == -1) {
+        ods_log_error("[%s] unable to set notify socket non-blocking: "
+            "fcntl() failed (%s)", notify_str, strerror(errno));
+    }
+    return handler->fd;
+}
+
+
 /**
  * Send notify over udp.
  *
@@ -325,16 +402,11 @@ notify_send_udp(notify_type* notify, buffer_type* buffer)
     if (notify->secondary->family == AF_INET6) {
         family = PF_INET6;
     }
-    /* create socket */
-    fd = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    /* all notifies of a family go out over the same socket */
+    fd = notify_socket((xfrhandler_type*) notify->xfrhandler, family);
     if (fd == -1) {
-        ods_log_error("[%s] unable to send data over udp to %s: "
-            "socket() failed (%s)", notify_str, notify->secondary->address,
-            strerror(errno));
         return -1;
     }
-    /* bind it? */
-
     /* send it (udp) */
     ods_log_deeebug("[%s] send %d bytes over udp to %s", notify_str,
         buffer_remaining(buffer), notify->secondary->address);
@@ -344,10 +416,9 @@ notify_send_udp(notify_type* notify, buffer_type* buffer)
         ods_log_error("[%s] unable to send data over udp to %s: "
             "sendto() failed (%s)", notify_str, notify->secondary->address,
             strerror(errno));
-        close(fd);
         return -1;
     }
-    return fd;
+    return 0;
 }
 
 
@@ -409,13 +480,11 @@ notify_send(notify_type* notify)
     ods_log_assert(xfrhandler);
     ods_log_assert(zone);
     ods_log_assert(zone->name);
-    if (notify->handler.fd != -1) {
-        close(notify->handler.fd);
-    }
-    notify->handler.fd = -1;
+    notify_unlink_id(notify);
     notify->timeout.tv_sec = notify_time(notify) + NOTIFY_RETRY_TIMEOUT;
     buffer_pkt_notify(xfrhandler->packet, zone->apex, LDNS_RR_CLASS_IN);
     notify->query_id = buffer_pkt_id(xfrhandler->packet);
+    notify_link_id(notify);
     buffer_pkt_set_aa(xfrhandler->packet);
     /* add current SOA to answer section */
     if (notify->soa) {
@@ -427,8 +496,7 @@ notify_send(notify_type* notify)
         notify_tsig_sign(notify, xfrhandler->packet);
     }
     buffer_flip(xfrhandler->packet);
-    notify->handler.fd = notify_send_udp(notify, xfrhandler->packet);
-    if (notify->handler.fd == -1) {
+    if (notify_send_udp(notify, xfrhandler->packet) == -1) {
         ods_log_error("[%s] unable to send notify retry %u for zone %s to "
             "%s: notify_send_udp() failed", notify_str, notify->retry,
             zone->name, notify->secondary->address);
@@ -440,6 +508,30 @@ notify_send(notify_type* notify)
 }
 
 
+/**
+ * Send notify again, or to the next secondary.
+ *
+ */
+static void
+notify_retry(notify_type* notify)
+{
+    zone_type* zone = (zone_type*) notify->zone;
+    /* see if notify is still enabled */
+    if (notify->secondary) {
+        ods_log_assert(notify->secondary->address);
+        notify->retry++;
+        if (notify->retry > NOTIFY_MAX_RETRY) {
+            ods_log_verbose("[%s] notify max retry for zone %s, %s unreachable",
+                notify_str, zone->name, notify->secondary->address);
+            notify_next(notify);
+        } else {
+            notify_send(notify);
+        }
+    }
+    return;
+}
+
+
 /**
  * Handle notify.
  *
@@ -466,34 +558,74 @@ notify_handle_zone(netio_type* ATTR_UNUSED(netio),
     if (notify->is_waiting) {
         ods_log_debug("[%s] already waiting, skipping notify for zone %s",
             notify_str, zone->name);
-        ods_log_assert(notify->handler.fd == -1);
+        ods_log_assert(!notify->is_sent);
         return;
     }
-    if (event_types & NETIO_EVENT_READ) {
-        ods_log_debug("[%s] read notify ok for zone %s", notify_str,
-            zone->name);
-        ods_log_assert(notify->handler.fd != -1);
-        if (notify_udp_read_packet(notify)) {
-            if (notify_handle_reply(notify)) {
-                notify_next(notify);
-            }
-        }
-    } else if(event_types & NETIO_EVENT_TIMEOUT) {
+    if (event_types & NETIO_EVENT_TIMEOUT) {
         ods_log_debug("[%s] notify timeout for zone %s", notify_str,
             zone->name);
         /* timeout, try again */
     }
-    /* see if notify is still enabled */
-    if (notify->secondary) {
-        ods_log_assert(notify->secondary->address);
-        notify->retry++;
-        if (notify->retry > NOTIFY_MAX_RETRY) {
-            ods_log_verbose("[%s] notify max retry for zone %s, %s unreachable",
-                notify_str, zone->name, notify->secondary->address);
+    notify_retry(notify);
+    return;
+}
+
+
+/**
+ * Handle replies on the shared notify socket.
+ *
+ */
+void
+notify_handle_udp(netio_type* ATTR_UNUSED(netio),
+    netio_handler_type* handler, netio_events_type event_types)
+{
+    xfrhandler_type* xfrhandler = NULL;
+    notify_type* notify = NULL;
+    struct sockaddr_storage from;
+    socklen_t from_len = sizeof(from);
+    ssize_t received = 0;
+    uint16_t query_id = 0;
+    if (!handler || !(event_types & NETIO_EVENT_READ)) {
+        return;
+    }
+    xfrhandler = (xfrhandler_type*) handler->user_data;
+    ods_log_assert(xfrhandler);
+    /* drain the socket, replies of many zones may be queued up */
+    while (1) {
+        buffer_clear(xfrhandler->packet);
+        from_len = sizeof(from);
+        received = recvfrom(handler->fd, buffer_begin(xfrhandler->packet),
+            buffer_remaining(xfrhandler->packet), 0,
+            (struct sockaddr*) &from, &from_len);
+        if (received == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                ods_log_error("[%s] unable to read packet: recvfrom() failed "
+                    "fd %d (%s)", notify_str, handler->fd, strerror(errno));
+            }
+            return;
+        }
+        buffer_set_limit(xfrhandler->packet, received);
+        if ((size_t) received < BUFFER_PKT_HEADER_SIZE) {
+            ods_log_debug("[%s] dropped short notify reply", notify_str);
+            continue;
+        }
+        query_id = buffer_pkt_id(xfrhandler->packet);
+        notify = xfrhandler->notify_ids[query_id % NOTIFY_ID_HASH];
+        while (notify && (notify->query_id != query_id ||
+            !notify->secondary || !notify_from_secondary(notify, &from))) {
+            notify = notify->id_next;
+        }
+        if (!notify) {
+            ods_log_debug("[%s] dropped notify reply id=%u: no outstanding "
+                "notify", notify_str, query_id);
+            continue;
+        }
+        ods_log_debug("[%s] read notify ok for zone %s", notify_str,
+            ((zone_type*) notify->zone)->name);
+        if (notify_handle_reply(notify)) {
             notify_next(notify);
-        } else {
-            notify_send(notify);
         }
+        notify_retry(notify);
     }
     return;
 }
@@ -586,10 +718,7 @@ notify_cleanup(notify_type* notify)
         return;
     }
     allocator = notify->allocator;
-    if (notify->handler.fd != -1) {
-        close(notify->handler.fd);
-        notify->handler.fd = -1;
-    }
+    notify_unlink_id(notify);
     if (notify->soa) {
         ldns_rr_free(notify->soa);
     }
@@ -43,9 +43,10 @@
 
 #include <ldns/ldns.h>
 
-#define NOTIFY_MAX_UDP 50
+#define NOTIFY_MAX_UDP 512 /* outstanding notifies, sharing one socket */
 #define NOTIFY_MAX_RETRY 5
 #define NOTIFY_RETRY_TIMEOUT 15
+#define NOTIFY_ID_HASH 256
 
 /**
  * Notify.
@@ -54,6 +55,7 @@
 typedef struct notify_struct notify_type;
 struct notify_struct {
     notify_type* waiting_next;
+    notify_type* id_next; /* outstanding notifies by query id */
     allocator_type* allocator;
     ldns_rr* soa;
     tsig_rr_type* tsig_rr;
@@ -65,6 +67,7 @@ struct notify_struct {
     uint16_t query_id;
     uint8_t retry;
     unsigned is_waiting : 1;
+    unsigned is_sent : 1; /* on the query id list */
 };
 
 /**
@@ -91,6 +94,16 @@ void notify_enable(notify_type* notify, ldns_rr* soa);
  */
 void notify_send(notify_type* notify);
 
+/**
+ * Handle replies on the shared notify socket.
+ * \param[in] netio network I/O
+ * \param[in] handler socket handler of the zone transfer handler
+ * \param[in] event_types events that occurred
+ *
+ */
+void notify_handle_udp(netio_type* netio, netio_handler_type* handler,
+    netio_events_type event_types);
+
 /**
  * Cleanup notify structure.
  * \param[in] notify notify structure.
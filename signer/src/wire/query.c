@@ -32,6 +32,7 @@
  */
 
 #include "config.h"
+#include "adapter/adapi.h"
 #include "daemon/dnshandler.h"
 #include "daemon/engine.h"
 #include "shared/file.h"
@@ -669,18 +670,529 @@ query_process_query(query_type* q, ldns_rr_type qtype, engine_type* engine)
 }
 
 
+/**
+ * Whether an RR is in the zone, counting changes not yet applied.
+ *
+ */
+static int
+query_update_live(rr_type* rr)
+{
+    return (!rr->is_removed && (rr->exists || rr->is_added));
+}
+
+
+/**
+ * Count the RRs in an RRset that are in the zone.
+ *
+ */
+static size_t
+query_update_count(rrset_type* rrset)
+{
+    size_t count = 0;
+    size_t i = 0;
+    if (!rrset) {
+        return 0;
+    }
+    for (i=0; i < rrset->rr_count; i++) {
+        if (query_update_live(&rrset->rrs[i])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+/**
+ * Whether a name owns RRs in the zone.
+ *
+ */
+static int
+query_update_in_use(zone_type* zone, ldns_rdf* dname)
+{
+    domain_type* domain = namedb_lookup_domain(zone->db, dname);
+    rrset_type* rrset = NULL;
+    if (!domain) {
+        return 0;
+    }
+    for (rrset = domain->rrsets; rrset; rrset = rrset->next) {
+        if (query_update_count(rrset)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Whether an RR owner is in the zone.
+ *
+ */
+static int
+query_update_in_zone(zone_type* zone, ldns_rr* rr)
+{
+    return (ldns_dname_compare(ldns_rr_owner(rr), zone->apex) == 0 ||
+        ldns_dname_is_subdomain(ldns_rr_owner(rr), zone->apex));
+}
+
+
+/**
+ * Check the prerequisites of an UPDATE (RFC 2136, section 3.2).
+ *
+ */
+static ldns_pkt_rcode
+query_update_prereq(zone_type* zone, ldns_rr_list* prereqs)
+{
+    ldns_rr* rr = NULL;
+    ldns_rr* other = NULL;
+    rrset_type* rrset = NULL;
+    rr_type* found = NULL;
+    size_t group = 0;
+    size_t i = 0;
+    size_t j = 0;
+    for (i=0; i < ldns_rr_list_rr_count(prereqs); i++) {
+        rr = ldns_rr_list_rr(prereqs, i);
+        if (ldns_rr_ttl(rr) != 0) {
+            return LDNS_RCODE_FORMERR;
+        }
+        if (!query_update_in_zone(zone, rr)) {
+            return LDNS_RCODE_NOTZONE;
+        }
+        rrset = zone_lookup_rrset(zone, ldns_rr_owner(rr),
+            ldns_rr_get_type(rr));
+        if (ldns_rr_get_class(rr) == LDNS_RR_CLASS_ANY) {
+            if (ldns_rr_rd_count(rr) != 0) {
+                return LDNS_RCODE_FORMERR;
+            }
+            if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_ANY) {
+                if (!query_update_in_use(zone, ldns_rr_owner(rr))) {
+                    return LDNS_RCODE_NXDOMAIN;
+                }
+            } else if (!query_update_count(rrset)) {
+                return LDNS_RCODE_NXRRSET;
+            }
+        } else if (ldns_rr_get_class(rr) == LDNS_RR_CLASS_NONE) {
+            if (ldns_rr_rd_count(rr) != 0) {
+                return LDNS_RCODE_FORMERR;
+            }
+            if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_ANY) {
+                if (query_update_in_use(zone, ldns_rr_owner(rr))) {
+                    return LDNS_RCODE_YXDOMAIN;
+                }
+            } else if (query_update_count(rrset)) {
+                return LDNS_RCODE_YXRRSET;
+            }
+        } else if (ldns_rr_get_class(rr) == zone->klass) {
+            /* value dependent: the RRset must match exactly */
+            if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_ANY) {
+                return LDNS_RCODE_FORMERR;
+            }
+            group = 0;
+            for (j=0; j < ldns_rr_list_rr_count(prereqs); j++) {
+                other = ldns_rr_list_rr(prereqs, j);
+                if (ldns_rr_get_class(other) == zone->klass &&
+                    ldns_rr_get_type(other) == ldns_rr_get_type(rr) &&
+                    ldns_dname_compare(ldns_rr_owner(other),
+                        ldns_rr_owner(rr)) == 0) {
+                    group++;
+                }
+            }
+            found = rrset_lookup_rr(rrset, rr);
+            if (!found || !query_update_live(found) ||
+                query_update_count(rrset) != group) {
+                return LDNS_RCODE_NXRRSET;
+            }
+        } else {
+            return LDNS_RCODE_FORMERR;
+        }
+    }
+    return LDNS_RCODE_NOERROR;
+}
+
+
+/**
+ * Whether an RRtype is a meta type.
+ *
+ */
+static int
+query_update_meta(ldns_rr_type type)
+{
+    return (type == LDNS_RR_TYPE_ANY || type == LDNS_RR_TYPE_AXFR ||
+        type == LDNS_RR_TYPE_IXFR || type == LDNS_RR_TYPE_MAILA ||
+        type == LDNS_RR_TYPE_MAILB);
+}
+
+
+/**
+ * Prescan the update section of an UPDATE (RFC 2136, section 3.4.1).
+ *
+ */
+static ldns_pkt_rcode
+query_update_prescan(zone_type* zone, ldns_rr_list* updates)
+{
+    ldns_rr* rr = NULL;
+    ldns_rr_type type = 0;
+    size_t i = 0;
+    for (i=0; i < ldns_rr_list_rr_count(updates); i++) {
+        rr = ldns_rr_list_rr(updates, i);
+        type = ldns_rr_get_type(rr);
+        if (!query_update_in_zone(zone, rr)) {
+            return LDNS_RCODE_NOTZONE;
+        }
+        if (ldns_rr_get_class(rr) == zone->klass) {
+            if (query_update_meta(type)) {
+                return LDNS_RCODE_FORMERR;
+            }
+        } else if (ldns_rr_get_class(rr) == LDNS_RR_CLASS_ANY) {
+            if (ldns_rr_ttl(rr) != 0 || ldns_rr_rd_count(rr) != 0 ||
+                (type != LDNS_RR_TYPE_ANY && query_update_meta(type))) {
+                return LDNS_RCODE_FORMERR;
+            }
+        } else if (ldns_rr_get_class(rr) == LDNS_RR_CLASS_NONE) {
+            if (ldns_rr_ttl(rr) != 0 || query_update_meta(type)) {
+                return LDNS_RCODE_FORMERR;
+            }
+        } else {
+            return LDNS_RCODE_FORMERR;
+        }
+        /* the signer maintains the DNSSEC records itself */
+        if (util_is_dnssec_rr(rr)) {
+            return LDNS_RCODE_REFUSED;
+        }
+    }
+    return LDNS_RCODE_NOERROR;
+}
+
+
+/**
+ * Remember a staged change of an UPDATE, deletions with class NONE.
+ *
+ */
+static int
+query_update_record(ldns_rr_list* changes, ldns_rr* rr, int del)
+{
+    ldns_rr* change = ldns_rr_clone(rr);
+    if (!change) {
+        return 0;
+    }
+    if (del) {
+        ldns_rr_set_class(change, LDNS_RR_CLASS_NONE);
+    }
+    if (!ldns_rr_list_push_rr(changes, change)) {
+        ldns_rr_free(change);
+        return 0;
+    }
+    return 1;
+}
+
+
+/**
+ * Delete the RRs of an RRset that are in the zone.
+ *
+ */
+static int
+query_update_del_rrset(zone_type* zone, rrset_type* rrset,
+    ldns_rr_list* changes)
+{
+    ldns_rr* del = NULL;
+    ods_status status = ODS_STATUS_OK;
+    size_t i = 0;
+    int count = 0;
+    if (!rrset || rrset->rrtype == LDNS_RR_TYPE_SOA ||
+        rrset->rrtype == LDNS_RR_TYPE_DNSKEY ||
+        rrset->rrtype == LDNS_RR_TYPE_NSEC3PARAMS) {
+        /* SOA and signer published records stay */
+        return 0;
+    }
+    if (rrset->rrtype == LDNS_RR_TYPE_NS &&
+        ((domain_type*) rrset->domain)->is_apex) {
+        return 0;
+    }
+    for (i=0; i < rrset->rr_count; i++) {
+        if (!query_update_live(&rrset->rrs[i])) {
+            continue;
+        }
+        del = ldns_rr_clone(rrset->rrs[i].rr);
+        if (!del) {
+            return -1;
+        }
+        status = adapi_del_rr(zone, del, 0);
+        if (status == ODS_STATUS_OK &&
+            !query_update_record(changes, del, 1)) {
+            ldns_rr_free(del);
+            return -1;
+        }
+        if (status == ODS_STATUS_OK) {
+            count++;
+        }
+        ldns_rr_free(del);
+    }
+    return count;
+}
+
+
+/**
+ * Whether adding an RR would put a CNAME next to other data
+ * (RFC 2136, section 3.4.2.2). The DNSSEC records the signer adds do
+ * not count.
+ *
+ */
+static int
+query_update_cname_conflict(zone_type* zone, ldns_rr* rr)
+{
+    domain_type* domain = namedb_lookup_domain(zone->db, ldns_rr_owner(rr));
+    rrset_type* rrset = NULL;
+    int is_cname = (ldns_rr_get_type(rr) == LDNS_RR_TYPE_CNAME);
+    if (!domain) {
+        return 0;
+    }
+    for (rrset = domain->rrsets; rrset; rrset = rrset->next) {
+        if (rrset->rrtype == LDNS_RR_TYPE_RRSIG ||
+            rrset->rrtype == LDNS_RR_TYPE_NSEC ||
+            rrset->rrtype == LDNS_RR_TYPE_NSEC3 ||
+            rrset->rrtype == LDNS_RR_TYPE_CNAME) {
+            continue;
+        }
+        if (is_cname && query_update_count(rrset)) {
+            return 1;
+        }
+    }
+    if (!is_cname) {
+        return (query_update_count(domain_lookup_rrset(domain,
+            LDNS_RR_TYPE_CNAME)) > 0);
+    }
+    return 0;
+}
+
+
+/**
+ * Apply the update section of an UPDATE to the unsigned zone
+ * (RFC 2136, section 3.4.2). The changes are applied by the next read,
+ * until then they are kept in changes.
+ *
+ */
+static int
+query_update_apply(zone_type* zone, ldns_rr_list* updates,
+    ldns_rr_list* changes)
+{
+    domain_type* domain = NULL;
+    rrset_type* rrset = NULL;
+    ldns_rr* rr = NULL;
+    ldns_rr* change = NULL;
+    ods_status status = ODS_STATUS_OK;
+    size_t i = 0;
+    int count = 0;
+    int ret = 0;
+    for (i=0; i < ldns_rr_list_rr_count(updates); i++) {
+        rr = ldns_rr_list_rr(updates, i);
+        if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
+            ods_log_debug("[%s] zone %s update: soa is maintained by the "
+                "signer, skipping", query_str, zone->name);
+            continue;
+        }
+        if (ldns_rr_get_class(rr) == LDNS_RR_CLASS_ANY) {
+            /* delete an RRset, or all RRsets at a name */
+            if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_ANY) {
+                domain = namedb_lookup_domain(zone->db, ldns_rr_owner(rr));
+                rrset = domain ? domain->rrsets : NULL;
+                for (; rrset; rrset = rrset->next) {
+                    ret = query_update_del_rrset(zone, rrset, changes);
+                    if (ret < 0) {
+                        return ret;
+                    }
+                    count += ret;
+                }
+            } else {
+                ret = query_update_del_rrset(zone, zone_lookup_rrset(zone,
+                    ldns_rr_owner(rr), ldns_rr_get_type(rr)), changes);
+                if (ret < 0) {
+                    return ret;
+                }
+                count += ret;
+            }
+            continue;
+        }
+        if (ldns_rr_get_class(rr) != LDNS_RR_CLASS_NONE &&
+            query_update_cname_conflict(zone, rr)) {
+            ods_log_debug("[%s] zone %s update: cname and other data, "
+                "skipping", query_str, zone->name);
+            continue;
+        }
+        if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_CNAME &&
+            ldns_rr_get_class(rr) == zone->klass) {
+            /* a CNAME replaces the CNAME that is there */
+            rrset = zone_lookup_rrset(zone, ldns_rr_owner(rr),
+                LDNS_RR_TYPE_CNAME);
+            if (rrset && !rrset_lookup_rr(rrset, rr)) {
+                ret = query_update_del_rrset(zone, rrset, changes);
+                if (ret < 0) {
+                    return ret;
+                }
+                count += ret;
+            }
+        }
+        change = ldns_rr_clone(rr);
+        if (!change) {
+            return -1;
+        }
+        if (ldns_rr_get_class(rr) == LDNS_RR_CLASS_NONE) {
+            /* delete an RR, but not the last NS RR at the apex */
+            rrset = zone_lookup_rrset(zone, ldns_rr_owner(rr),
+                ldns_rr_get_type(rr));
+            ldns_rr_set_class(change, zone->klass);
+            if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_NS &&
+                ldns_dname_compare(ldns_rr_owner(rr), zone->apex) == 0 &&
+                query_update_count(rrset) <= 1) {
+                status = ODS_STATUS_UNCHANGED;
+            } else {
+                status = adapi_del_rr(zone, change, 0);
+            }
+            if (status == ODS_STATUS_OK &&
+                !query_update_record(changes, change, 1)) {
+                status = ODS_STATUS_MALLOC_ERR;
+            }
+            ldns_rr_free(change);
+        } else if (!query_update_record(changes, rr, 0)) {
+            /* also an unchanged RR is marked added again, stage it */
+            ldns_rr_free(change);
+            status = ODS_STATUS_MALLOC_ERR;
+        } else {
+            status = adapi_add_rr(zone, change, 0);
+            if (status != ODS_STATUS_OK) {
+                ldns_rr_free(change);
+            }
+        }
+        if (status == ODS_STATUS_OK) {
+            count++;
+        } else if (status != ODS_STATUS_UNCHANGED) {
+            ods_log_error("[%s] zone %s update failed: %s", query_str,
+                zone->name, ods_status2str(status));
+            return -1;
+        }
+    }
+    return count;
+}
+
+
+/**
+ * Reply to UPDATE.
+ *
+ */
+static query_state
+query_update_reply(query_type* q, size_t pos, ldns_pkt_rcode rcode)
+{
+    buffer_pkt_set_qr(q->buffer);
+    buffer_pkt_set_rcode(q->buffer, rcode);
+    buffer_pkt_set_ancount(q->buffer, 0);
+    buffer_pkt_set_nscount(q->buffer, 0);
+    buffer_pkt_set_arcount(q->buffer, 0);
+    buffer_clear(q->buffer); /* lim = pos, pos = 0; */
+    buffer_set_position(q->buffer, pos);
+    buffer_set_limit(q->buffer, buffer_capacity(q->buffer));
+    q->reserved_space = edns_rr_reserved_space(q->edns_rr);
+    q->reserved_space += tsig_rr_reserved_space(q->tsig_rr);
+    return QUERY_PROCESSED;
+}
+
+
 /**
  * UPDATE.
  *
  */
 static query_state
-query_process_update(query_type* q)
+query_process_update(query_type* q, ldns_pkt* pkt, void* engine)
 {
-    if (!q || !q->zone) {
+    engine_type* e = (engine_type*) engine;
+    dnsin_type* dnsin = NULL;
+    ldns_rr* rr = NULL;
+    ldns_pkt_rcode rcode = LDNS_RCODE_NOERROR;
+    ldns_rr_list* changes = NULL;
+    ods_status status = ODS_STATUS_OK;
+    size_t pos = 0;
+    int count = 0;
+    char address[128];
+    if (!e || !q || !q->zone || !pkt) {
         return QUERY_DISCARDED;
     }
-    ods_log_debug("[%s] dynamic update not implemented", query_str);
-    return query_notimpl(q);
+    ods_log_assert(q->zone->name);
+    ods_log_debug("[%s] incoming update for zone %s", query_str,
+        q->zone->name);
+    /* zone section: one SOA RR of the zone class */
+    rr = ldns_rr_list_rr(ldns_pkt_question(pkt), 0);
+    if (buffer_pkt_qr(q->buffer) || buffer_pkt_tc(q->buffer) ||
+        buffer_pkt_qdcount(q->buffer) != 1 ||
+        ldns_rr_get_type(rr) != LDNS_RR_TYPE_SOA) {
+        return query_formerr(q);
+    }
+    buffer_set_position(q->buffer, BUFFER_PKT_HEADER_SIZE);
+    if (!buffer_skip_rr(q->buffer, 1)) {
+        return query_formerr(q);
+    }
+    pos = buffer_position(q->buffer);
+    /* acl */
+    if (!q->zone->adinbound || q->zone->adinbound->type != ADAPTER_DNS) {
+        ods_log_error("[%s] zone %s is not configured to have input dns "
+            "adapter", query_str, q->zone->name);
+        return query_update_reply(q, pos, LDNS_RCODE_NOTAUTH);
+    }
+    ods_log_assert(q->zone->adinbound->config);
+    dnsin = (dnsin_type*) q->zone->adinbound->config;
+    if (!acl_find(dnsin->allow_update, &q->addr, q->tsig_rr)) {
+        if (addr2ip(q->addr, address, sizeof(address))) {
+            ods_log_info("[%s] unauthorized update for zone %s from client "
+                "%s: no acl matches", query_str, q->zone->name, address);
+        } else {
+            ods_log_info("[%s] unauthorized update for zone %s from unknown "
+                "client: no acl matches", query_str, q->zone->name);
+        }
+        return query_update_reply(q, pos, LDNS_RCODE_REFUSED);
+    }
+    /* check and apply against the unsigned zone */
+    lock_basic_lock(&q->zone->zone_lock);
+    if (!q->zone->db || !q->zone->db->is_initialized) {
+        lock_basic_unlock(&q->zone->zone_lock);
+        ods_log_warning("[%s] zone %s update refused: zone not read yet",
+            query_str, q->zone->name);
+        return query_update_reply(q, pos, LDNS_RCODE_SERVFAIL);
+    }
+    rcode = query_update_prereq(q->zone, ldns_pkt_answer(pkt));
+    if (rcode == LDNS_RCODE_NOERROR) {
+        rcode = query_update_prescan(q->zone, ldns_pkt_authority(pkt));
+    }
+    if (rcode == LDNS_RCODE_NOERROR) {
+        changes = ldns_rr_list_new();
+        count = changes ? query_update_apply(q->zone,
+            ldns_pkt_authority(pkt), changes) : -1;
+        if (count < 0) {
+            /**
+             * All or nothing: roll back, earlier accepted updates that are
+             * not read yet are staged and applied again.
+             */
+            ldns_rr_list_deep_free(changes);
+            adapi_rollback(q->zone, 1);
+            rcode = LDNS_RCODE_SERVFAIL;
+        } else {
+            adapi_stage_update(q->zone, changes);
+        }
+    }
+    lock_basic_unlock(&q->zone->zone_lock);
+    if (rcode != LDNS_RCODE_NOERROR) {
+        ods_log_verbose("[%s] zone %s update rejected: %s", query_str,
+            q->zone->name, buffer_rcode2str(rcode));
+        return query_update_reply(q, pos, rcode);
+    }
+    ods_log_verbose("[%s] zone %s update accepted: %i changes", query_str,
+        q->zone->name, count);
+    if (count > 0) {
+        /* read and sign the changes right away */
+        status = zone_reschedule_task(q->zone, e->taskq, TASK_READ);
+        if (status != ODS_STATUS_OK) {
+            ods_log_error("[%s] unable to reschedule task for zone %s: %s",
+                query_str, q->zone->name, ods_status2str(status));
+        } else {
+            engine_wakeup_workers(e);
+        }
+    }
+    return query_update_reply(q, pos, LDNS_RCODE_NOERROR);
 }
 
 
@@ -822,6 +1334,7 @@ query_process(query_type* q, void* engine)
     ldns_pkt_rcode rcode = LDNS_RCODE_NOERROR;
     ldns_pkt_opcode opcode = LDNS_PACKET_QUERY;
     ldns_rr_type qtype = LDNS_RR_TYPE_SOA;
+    query_state state = QUERY_PROCESSED;
     engine_type* e = (engine_type*) engine;
     ods_log_assert(e);
     ods_log_assert(q);
@@ -886,6 +1399,12 @@ query_process(query_type* q, void* engine)
     /* handle incoming request */
     opcode = ldns_pkt_get_opcode(pkt);
     qtype = ldns_rr_get_type(rr);
+    if (opcode == LDNS_PACKET_UPDATE) {
+        /* update sections are read from the parsed packet */
+        state = query_process_update(q, pkt, engine);
+        ldns_pkt_free(pkt);
+        return state;
+    }
     ldns_pkt_free(pkt);
 
     switch (opcode) {
@@ -893,8 +1412,6 @@ query_process(query_type* q, void* engine)
             return query_process_notify(q, qtype, engine);
         case LDNS_PACKET_QUERY:
             return query_process_query(q, qtype, engine);
-        case LDNS_PACKET_UPDATE:
-            return query_process_update(q);
         default:
             break;
     }
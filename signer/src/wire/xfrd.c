@@ -132,6 +132,7 @@ xfrd_create(void* xfrhandler, void* zone)
     xfrd->serial_xfr_acquired = 0;
     xfrd->serial_disk_acquired = 0;
     xfrd->serial_notify_acquired = 0;
+    xfrd->coalesce_until = 0;
     lock_basic_unlock(&xfrd->serial_lock);
     xfrd->query_id = 0;
     xfrd->msg_seq_nr = 0;
@@ -486,12 +487,28 @@ xfrd_commit_packet(xfrd_type* xfrd)
         engine_type* engine = (engine_type*) xfrhandler->engine;
         ods_log_assert(xfrhandler);
         ods_log_assert(engine);
+        xfrhandler->xfr_count++;
+        if (xfrd->serial_disk_acquired < xfrd->coalesce_until) {
+            /**
+             * Transfers accumulate in the .xfrd file, the zone read
+             * at the end of the window picks this one up as well.
+             */
+            xfrhandler->xfr_coalesced++;
+            ods_log_verbose("[%s] coalesce transfer for zone %s: serial=%u "
+                "read at %u", xfrd_str, zone->name, xfrd->serial_disk,
+                (unsigned) xfrd->coalesce_until);
+        } else {
+            xfrd->coalesce_until = xfrd->serial_disk_acquired +
+                engine->config->xfr_coalesce;
+        }
         ods_log_debug("[%s] reschedule task for zone %s: disk serial=%u "
             "acquired=%u, memory serial=%u acquired=%u", xfrd_str,
             zone->name, xfrd->serial_disk,
             xfrd->serial_disk_acquired, xfrd->serial_xfr,
             xfrd->serial_xfr_acquired);
-        ret = zone_reschedule_task(zone, engine->taskq, TASK_READ);
+        /* no-op if the read is pending, reads again if it went early */
+        ret = zone_reschedule_task_at(zone, engine->taskq, TASK_READ,
+            xfrd->coalesce_until);
         if (ret != ODS_STATUS_OK) {
             ods_log_crit("[%s] unable to reschedule task for zone %s: %s",
                 xfrd_str, zone->name, ods_status2str(ret));
@@ -523,6 +540,11 @@ xfrd_dump_packet(xfrd_type* xfrd, buffer_type* buffer)
     zone = (zone_type*) xfrd->zone;
     ods_log_assert(zone);
     ods_log_assert(zone->name);
+    if (zone->stats) {
+        lock_basic_lock(&zone->stats->stats_lock);
+        zone->stats->xfr_in += buffer_limit(buffer);
+        lock_basic_unlock(&zone->stats->stats_lock);
+    }
     status = ldns_wire2pkt(&pkt, buffer_begin(buffer), buffer_limit(buffer));
     if (status != LDNS_STATUS_OK) {
         ods_log_crit("[%s] unable to dump packet zone %s: ldns_wire2pkt() "
@@ -112,6 +112,7 @@ struct xfrd_struct
     time_t serial_xfr_acquired;
     time_t serial_notify_acquired;
     time_t serial_disk_acquired;
+    time_t coalesce_until; /* transfers until then share one zone read */
     soa_type soa;
 
     /* timeout and event handling */
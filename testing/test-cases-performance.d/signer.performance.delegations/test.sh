@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+#
+#TEST: Sign a TLD like zone with many NS delegations, a tenth of them with
+#TEST: a DS and all of them with glue, and report the NSEC and RRSIG times
+#TEST: of a full sign and a re-sign. The delegation, occlusion and type
+#TEST: bitmap status of a name is looked up for every RRset and NSEC, run
+#TEST: this on builds before and after a change to compare. Set DELEGATIONS
+#TEST: to change the size of the zone (default 100000).
+
+DELEGATIONS=${DELEGATIONS:-100000}
+UNSIGNED="$INSTALL_ROOT/var/opendnssec/unsigned/tld"
+SIGNED="$INSTALL_ROOT/var/opendnssec/signed/tld"
+
+## Append the [STATS] line of the given run to the results
+record_stats () {
+	$GREP -- 'ods-signerd: .*\[STATS\] tld [0-9]* RR' "_syslog.$BUILD_TAG" | sed -n "$1p" |
+		sed -e 's/.*\[STATS\] /'"$2"': /' >> performance_results.log
+}
+
+rm -f performance_results.log
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+## Delegations with glue, every tenth one is secure
+awk -v n=$DELEGATIONS 'BEGIN {
+	for (i = 1; i <= n; i++) {
+		printf("d%d.tld. 600 IN NS ns1.d%d.tld.\n", i, i);
+		printf("d%d.tld. 600 IN NS ns2.tld.\n", i);
+		printf("ns1.d%d.tld. 600 IN A 192.0.2.%d\n", i, i % 250 + 1);
+		if (i % 10 == 0)
+			printf("d%d.tld. 600 IN DS %d 8 2 %064d\n", i, i % 65536, i);
+	}
+}' >> "$UNSIGNED" &&
+echo "signer.performance.delegations: $DELEGATIONS delegations" >> performance_results.log &&
+
+ods_start_ods-control &&
+
+syslog_waitfor 3600 'ods-signerd: .*\[STATS\] tld' &&
+record_stats 1 "full sign" &&
+
+## Sign again, the cached status of every name is used
+log_this ods-signer-sign ods-signer sign tld &&
+syslog_waitfor_count 3600 2 'ods-signerd: .*\[STATS\] tld' &&
+record_stats 2 "re-sign" &&
+
+## Only the apex NS RRset and DS RRsets are signed, glue is left alone
+! $GREP -v -- '^tld\.' "$SIGNED" | $GREP -q -- 'IN[[:space:]]*RRSIG[[:space:]]*NS[[:space:]]' &&
+! $GREP -q -- '^ns1\.d[0-9]*\.tld\..*IN[[:space:]]*RRSIG' "$SIGNED" &&
+! $GREP -q -- '^ns1\.d[0-9]*\.tld\..*IN[[:space:]]*NSEC' "$SIGNED" &&
+$GREP -q -- '^d10\.tld\..*IN[[:space:]]*RRSIG[[:space:]]*DS[[:space:]]' "$SIGNED" &&
+$GREP -q -- '^d10\.tld\..*IN[[:space:]]*NSEC[[:space:]].*NS DS RRSIG NSEC' "$SIGNED" &&
+$GREP -q -- '^d11\.tld\..*IN[[:space:]]*NSEC[[:space:]].*NS RRSIG NSEC' "$SIGNED" &&
+test "`$GREP -c -- 'IN[[:space:]]*NSEC[[:space:]]' "$SIGNED"`" -eq $(( DELEGATIONS + 3 )) &&
+
+ods_stop_ods-control &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat performance_results.log &&
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+ods_kill
+return 1
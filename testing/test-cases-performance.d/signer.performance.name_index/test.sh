@@ -0,0 +1,76 @@
+#!/usr/bin/env bash
+#
+#TEST: Sign a zone with many names and report the times of the name index:
+#TEST: RR (inserting every name), NSEC (the ordered walk that links the
+#TEST: chain) and a re-sign that looks up every name again. Run this on
+#TEST: builds before and after a change of the index to compare. Set NAMES
+#TEST: to change the size of the zone (default 1000000, use 5000000 for a
+#TEST: large TLD).
+
+NAMES=${NAMES:-1000000}
+UNSIGNED="$INSTALL_ROOT/var/opendnssec/unsigned/ods"
+SIGNED="$INSTALL_ROOT/var/opendnssec/signed/ods"
+
+## Append the [STATS] line of the given run to the results
+record_stats () {
+	$GREP -- 'ods-signerd: .*\[STATS\] ods [0-9]* RR' "_syslog.$BUILD_TAG" | sed -n "$1p" |
+		sed -e 's/.*\[STATS\] /'"$2"': /' >> performance_results.log
+}
+
+rm -f performance_results.log
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+## Names one to three labels below the apex, some in upper case so that
+## the canonical order has to fold case
+awk -v n=$NAMES 'BEGIN {
+	for (i = 1; i <= n; i++) {
+		if (i % 50 == 0)
+			printf("Www.Sub.H%d.ods. 600 IN A 192.0.2.1\n", i);
+		else if (i % 5 == 0)
+			printf("sub.h%d.ods. 600 IN A 192.0.2.1\n", i);
+		else
+			printf("h%d.ods. 600 IN A 192.0.2.1\n", i);
+	}
+}' >> "$UNSIGNED" &&
+echo "signer.performance.name_index: $NAMES names" >> performance_results.log &&
+
+ods_start_ods-control &&
+
+syslog_waitfor 7200 'ods-signerd: .*\[STATS\] ods' &&
+record_stats 1 "full sign" &&
+
+## Read the zone again, every name is looked up in the index
+log_this ods-signer-sign ods-signer sign ods &&
+syslog_waitfor_count 7200 2 'ods-signerd: .*\[STATS\] ods' &&
+record_stats 2 "re-sign" &&
+
+## The NSEC chain links every owner name exactly once
+awk '$4 == "NSEC" { owner[tolower($1)]++; nxt[tolower($5)]++; n++ }
+	END {
+		for (x in owner) if (owner[x] != 1 || nxt[x] != 1) exit 1;
+		for (x in nxt) if (!(x in owner)) exit 1;
+		print n
+	}' "$SIGNED" > _nsec_count &&
+echo "NSEC records: `cat _nsec_count`" &&
+test "`cat _nsec_count`" -ge "$NAMES" &&
+rm -f _nsec_count &&
+
+ods_stop_ods-control &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat performance_results.log &&
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+rm -f _nsec_count
+ods_kill
+return 1
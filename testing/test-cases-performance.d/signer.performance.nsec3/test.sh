@@ -0,0 +1,87 @@
+#!/usr/bin/env bash
+#
+#TEST: Sign two zones with NSEC3, one with opt-out and one without, and
+#TEST: report the NSEC3 chain build and hash times. Half of the names are
+#TEST: insecure delegations, which opt-out leaves out of the chain. Run this
+#TEST: on builds before and after a change to the NSEC3 code to compare.
+#TEST: Set NAMES to change the size of the zones (default 200000).
+
+NAMES=${NAMES:-200000}
+
+## Append the [STATS] line of the given zone and run to the results
+record_stats () {
+	$GREP -- "ods-signerd: .*\[STATS\] $1 [0-9]* RR" "_syslog.$BUILD_TAG" | sed -n "$2p" |
+		sed -e 's/.*\[STATS\] /'"$3"': /' >> performance_results.log
+}
+
+## Check that the NSEC3 chain of a zone links every hashed owner name once
+## and print the number of NSEC3 records
+nsec3_chain () {
+	awk '$4 == "NSEC3" {
+		split(tolower($1), label, ".");
+		if (tolower($9) !~ /^[0-9a-v]+$/ || length($9) != 32) bad = 1;
+		owner[label[1]]++; nxt[tolower($9)]++; n++
+	}
+	END {
+		if (bad) exit 1;
+		for (x in owner) if (owner[x] != 1 || nxt[x] != 1) exit 1;
+		for (x in nxt) if (!(x in owner)) exit 1;
+		print n
+	}' "$INSTALL_ROOT/var/opendnssec/signed/$1"
+}
+
+rm -f performance_results.log
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+## The same names in both zones, every other one an insecure delegation
+for zone in nsec3 optout; do
+	awk -v n=$NAMES -v z=$zone 'BEGIN {
+		for (i = 1; i <= n; i++) {
+			if (i % 2)
+				printf("h%d.%s. 600 IN A 192.0.2.1\n", i, z);
+			else
+				printf("d%d.%s. 600 IN NS ns1.%s.\n", i, z, z);
+		}
+	}' >> "$INSTALL_ROOT/var/opendnssec/unsigned/$zone" || return 1
+done &&
+echo "signer.performance.nsec3: $NAMES names" >> performance_results.log &&
+
+ods_start_ods-control &&
+
+syslog_waitfor 3600 'ods-signerd: .*\[STATS\] nsec3' &&
+syslog_waitfor 3600 'ods-signerd: .*\[STATS\] optout' &&
+record_stats nsec3 1 "full sign" &&
+record_stats optout 1 "full sign" &&
+
+## Rebuild the chains
+log_this ods-signer-sign ods-signer sign --all &&
+syslog_waitfor_count 3600 2 'ods-signerd: .*\[STATS\] nsec3' &&
+syslog_waitfor_count 3600 2 'ods-signerd: .*\[STATS\] optout' &&
+record_stats nsec3 2 "re-sign" &&
+record_stats optout 2 "re-sign" &&
+
+## Both chains are closed and opt-out skips the insecure delegations
+nsec3_count=`nsec3_chain nsec3` &&
+optout_count=`nsec3_chain optout` &&
+echo "NSEC3 records: $nsec3_count without opt-out, $optout_count with opt-out" &&
+test "$nsec3_count" -gt "$NAMES" &&
+test "$optout_count" -lt "$nsec3_count" &&
+
+ods_stop_ods-control &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat performance_results.log &&
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+ods_kill
+return 1
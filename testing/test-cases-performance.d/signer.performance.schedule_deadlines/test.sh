@@ -0,0 +1,105 @@
+#!/usr/bin/env bash
+#
+#TEST: Simulate a signer with many zones of very different sizes and short
+#TEST: signature validity: zone N has about BIG/N^2 names, so one zone is
+#TEST: large and most are small. While the large zones are being re-signed,
+#TEST: no zone may be served after its signature refresh deadline, and the
+#TEST: number of sign runs per period should stay flat. Set ZONES (default
+#TEST: 200), BIG (default 200000) and DURATION in seconds (default 900).
+
+ZONES=${ZONES:-200}
+BIG=${BIG:-200000}
+DURATION=${DURATION:-900}
+
+## Number of sign runs so far
+sign_runs () {
+	$GREP -c -- 'ods-signerd: .*\[STATS\] z[0-9]* [0-9]* RR' "_syslog.$BUILD_TAG"
+}
+
+rm -f performance_results.log
+
+## A zone list with all the zones
+{
+	echo '<?xml version="1.0" encoding="UTF-8"?>'
+	echo '<ZoneList>'
+	for (( i = 1 ; i <= $ZONES ; i++ )); do
+		echo "	<Zone name=\"z$i\">"
+		echo '		<Policy>default</Policy>'
+		echo "		<SignerConfiguration>@INSTALL_ROOT@/var/opendnssec/signconf/z$i.xml</SignerConfiguration>"
+		echo '		<Adapters>'
+		echo "			<Input><File>@INSTALL_ROOT@/var/opendnssec/unsigned/z$i</File></Input>"
+		echo "			<Output><File>@INSTALL_ROOT@/var/opendnssec/signed/z$i</File></Output>"
+		echo '		</Adapters>'
+		echo '	</Zone>'
+	done
+	echo '</ZoneList>'
+} > _zonelist.xml &&
+ods_setup_conf zonelist.xml _zonelist.xml &&
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+## Zones of skewed sizes
+awk -v zones=$ZONES -v big=$BIG -v dir="$INSTALL_ROOT/var/opendnssec/unsigned" 'BEGIN {
+	for (z = 1; z <= zones; z++) {
+		f = dir "/z" z;
+		printf("$ORIGIN z%d.\n", z) > f;
+		printf("z%d. 600 IN SOA ns1.z%d. postmaster.z%d. 1000 1200 180 1209600 300\n", z, z, z) > f;
+		printf("z%d. 600 IN NS ns1.z%d.\n", z, z) > f;
+		printf("ns1.z%d. 600 IN A 192.0.2.1\n", z) > f;
+		n = int(big / (z * z)) + 5;
+		for (i = 1; i <= n; i++)
+			printf("h%d.z%d. 600 IN A 192.0.2.1\n", i, z) > f;
+		close(f);
+	}
+}' &&
+echo "signer.performance.schedule_deadlines: $ZONES zones, largest $BIG names, $DURATION seconds" >> performance_results.log &&
+
+ods_start_ods-control &&
+
+## The largest zone is signed once
+syslog_waitfor 3600 "ods-signerd: .*\[STATS\] z1 [0-9]* RR" &&
+
+## Count the sign runs in two periods
+runs0=`sign_runs` &&
+sleep $(( DURATION / 2 )) &&
+runs1=`sign_runs` &&
+sleep $(( DURATION / 2 )) &&
+runs2=`sign_runs` &&
+echo "sign runs: $(( runs1 - runs0 )) in the first period, $(( runs2 - runs1 )) in the second" >> performance_results.log &&
+
+## Every zone was signed again, none of them late
+$GREP -o -- '\[STATS\] z[0-9]* [0-9]* RR' "_syslog.$BUILD_TAG" | awk -v zones=$ZONES '{
+	signed[$2]++;
+} END {
+	for (z = 1; z <= zones; z++) {
+		if (signed["z" z] < 2) {
+			printf("zone z%d was signed %d time(s)\n", z, signed["z" z]);
+			exit 1;
+		}
+	}
+}' &&
+! syslog_grep 'ods-signerd: .*\[scheduler\] zone .* is past its signature refresh deadline' &&
+
+## Throughput stays flat
+test $(( runs1 - runs0 )) -gt 0 &&
+test $(( (runs2 - runs1) * 2 )) -ge $(( runs1 - runs0 )) &&
+
+ods_stop_ods-control &&
+rm -f _zonelist.xml &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat performance_results.log &&
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+rm -f _zonelist.xml
+ods_kill
+return 1
@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+
+#TEST: Fire a burst of 100 NOTIFYs at a zone with an Input DNS Adapter and
+#TEST: check that the transfers they cause are coalesced into a bounded
+#TEST: number of sign passes.
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+## Start master name server
+ods_ldns_testns 15353 ods.datafile &&
+
+## Start OpenDNSSEC
+ods_start_ods-control &&
+
+## Wait for signed zone file
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+test -f "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+
+ods-signer verbosity 5 &&
+
+## Burst of notifies for the new serial
+for i in `seq 1 100`; do
+	ldns-notify -p 15354 -s 1001 -r 0 -z ods 127.0.0.1 >/dev/null 2>&1
+done &&
+
+## The transfer gets in and the zone is signed again
+syslog_waitfor 60 'ods-signerd: .*\[xfrd\] reschedule task for zone ods: disk serial=1001' &&
+syslog_waitfor_count 60 2 'ods-signerd: .*\[STATS\] ods' &&
+
+## Give late passes a chance to show up, then count them
+sleep 10 &&
+{ syslog_grep_count 2 'ods-signerd: .*\[STATS\] ods' ||
+	test "$syslog_grep_count_variable" -le 3 2>/dev/null; } &&
+
+## Stop
+ods_stop_ods-control &&
+ods_ldns_testns_kill &&
+return 0
+
+## Test failed. Kill stuff
+ods_ldns_testns_kill
+ods_kill
+return 1
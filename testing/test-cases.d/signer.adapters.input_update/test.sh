@@ -0,0 +1,68 @@
+#!/usr/bin/env bash
+
+#TEST: Send dynamic updates (RFC 2136) to a zone with an Input DNS Adapter
+#TEST: over the loopback and measure the time until the signed zone has the
+#TEST: change. An update that would put a CNAME next to other data is
+#TEST: ignored.
+
+TSIG="hmac-sha256:secret.example.com:sw0nMPCswVbes1tmQTm1pcMmpNRK+oGMYN+qKNR/BwQ="
+SIGNED="$INSTALL_ROOT/var/opendnssec/signed/ods"
+
+if ! command -v nsupdate >/dev/null 2>&1; then
+	echo "nsupdate not found" >&2
+	return 1
+fi
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+## Start master name server
+ods_ldns_testns 15353 ods.datafile &&
+
+## Start OpenDNSSEC
+ods_start_ods-control &&
+
+## Wait for signed zone file
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+test -f "$SIGNED" &&
+
+ods-signer verbosity 5 &&
+
+## Add one record and time it until the signed zone has it
+time_start=`$DATE '+%s'` &&
+log_this nsupdate-add nsupdate -y "$TSIG" <<"EOF2" &&
+server 127.0.0.1 15354
+zone ods
+update add update1.ods. 600 IN A 192.0.2.53
+send
+EOF2
+syslog_waitfor 10 'ods-signerd: .*\[query\] zone ods update accepted: 1 changes' &&
+syslog_waitfor_count 10 2 'ods-signerd: .*\[STATS\] ods' &&
+time_stop=`$DATE '+%s'` &&
+echo "update latency: $(( time_stop - time_start )) second(s)" &&
+test $(( time_stop - time_start )) -le 2 &&
+$GREP -q -- '^update1\.ods\.[[:space:]]*600[[:space:]]*IN[[:space:]]*A[[:space:]]*192\.0\.2\.53' "$SIGNED" &&
+
+## A CNAME next to the A record is ignored
+log_this nsupdate-cname nsupdate -y "$TSIG" <<"EOF2" &&
+server 127.0.0.1 15354
+zone ods
+update add update1.ods. 600 IN CNAME mail.ods.
+send
+EOF2
+syslog_waitfor 10 'ods-signerd: .*\[query\] zone ods update: cname and other data, skipping' &&
+syslog_waitfor 10 'ods-signerd: .*\[query\] zone ods update accepted: 0 changes' &&
+! $GREP -q -- '^update1\.ods\..*CNAME' "$SIGNED" &&
+
+## Stop
+ods_stop_ods-control &&
+ods_ldns_testns_kill &&
+return 0
+
+## Test failed. Kill stuff
+ods_ldns_testns_kill
+ods_kill
+return 1
@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+
+#TEST: Test NOTIFY retries of the Output DNS Adapter and NotifyCommand reaping
+#TEST: The first secondary answers the NOTIFY, the second one is not running
+#TEST: and should get retries over the same socket. The NotifyCommand should
+#TEST: be reaped as soon as it exits, not left behind as a zombie.
+
+cat >"$INSTALL_ROOT/var/opendnssec/signer/test-notify-command.sh" 2>/dev/null <<"EOF2"
+#!/usr/bin/env bash
+
+echo "zone: $1" >`dirname "$0"`/test-notify.output
+EOF2
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+test -f "$INSTALL_ROOT/var/opendnssec/signer/test-notify-command.sh" &&
+chmod a+x "$INSTALL_ROOT/var/opendnssec/signer/test-notify-command.sh" &&
+
+ods_reset_env 20 &&
+
+## Start the secondary name server that answers
+ods_ldns_testns 15353 ods.datafile &&
+
+## Start OpenDNSSEC
+ods_start_ods-control &&
+
+## Wait for signed zone file
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+
+## The NotifyCommand ran and was reaped with its exit status
+syslog_waitfor 60 'ods-signerd: .*\[tools\] notify nameserver \[[0-9]*\] ok' &&
+test -f "$INSTALL_ROOT/var/opendnssec/signer/test-notify.output" &&
+$GREP -q -- "zone: ods" "$INSTALL_ROOT/var/opendnssec/signer/test-notify.output" &&
+
+## The first secondary accepts the NOTIFY
+log_waitfor ldns-testns stdout 5 'comparepkt: match!' &&
+
+## The second secondary does not answer and is retried
+syslog_waitfor_count 60 2 'ods-signerd: .*\[notify\] notify retry 0 for zone ods sent to 127\.0\.0\.1' &&
+syslog_waitfor 60 'ods-signerd: .*\[notify\] notify retry 1 for zone ods sent to 127\.0\.0\.1' &&
+
+## Stop
+ods_stop_ods-control &&
+ods_ldns_testns_kill &&
+rm "$INSTALL_ROOT/var/opendnssec/signer/test-notify-command.sh" "$INSTALL_ROOT/var/opendnssec/signer/test-notify.output" &&
+return 0
+
+## Test failed. Kill stuff
+ods_ldns_testns_kill
+ods_kill
+return 1
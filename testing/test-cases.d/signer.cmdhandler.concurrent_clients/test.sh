@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+
+#TEST: Keep a zone busy with 'ods-signer sign' and 'ods-signer update --all'
+#TEST: while hundreds of other clients connect to the command handler, all of
+#TEST: them should get their answer without waiting for the zone. Then hold
+#TEST: every client slot (256) open: one more client is refused, and once
+#TEST: the slots are free again clients are accepted.
+
+## Two connections per client round, with sign and update that stays below
+## the 256 client slots of the command handler
+CLIENTS=120
+MAX_CLIENTS=256
+UNSIGNED="$INSTALL_ROOT/var/opendnssec/unsigned/ods"
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+## A zone big enough to keep a worker busy for a while
+for i in `seq 1 20000`; do
+	echo "host$i.ods. 600 IN A 192.0.2.1"
+done >> "$UNSIGNED" &&
+
+ods_start_ods-control &&
+
+syslog_waitfor 300 'ods-signerd: .*\[STATS\] ods' &&
+
+## Commands that wait for the zone and the zone list
+rm -f _clients.ok &&
+{ ods-signer sign ods >_clients.sign 2>&1 & } &&
+{ ods-signer update --all >_clients.update 2>&1 & } &&
+
+## Meanwhile, many clients asking for things that never wait on a zone
+start=`$DATE +%s` &&
+for i in `seq 1 $CLIENTS`; do
+	( ods-signer queue 2>&1 | $GREP -q 'It is now' && echo queue >> _clients.ok ) &
+	( ods-signer zones 2>&1 | $GREP -q 'zones configured' && echo zones >> _clients.ok ) &
+done &&
+wait &&
+end=`$DATE +%s` &&
+echo "concurrent clients took $(( end - start )) seconds" &&
+
+## Every client got its answer, in reasonable time
+test "`wc -l < _clients.ok`" -eq $(( CLIENTS * 2 )) &&
+test $(( end - start )) -le 60 &&
+$GREP -q 'Zone ods scheduled for immediate re-sign.' _clients.sign &&
+$GREP -q 'Zone list has not changed.\|Zone list updated' _clients.update &&
+syslog_waitfor_count 300 2 'ods-signerd: .*\[STATS\] ods' &&
+! syslog_grep 'ods-signerd: .*unable to accept client: too many clients' &&
+
+## Hold every client slot with an idle interactive client
+for i in `seq 1 $MAX_CLIENTS`; do
+	( sleep 30 | ods-signer >/dev/null 2>&1 ) &
+done &&
+sleep 5 &&
+
+## Once they are all in, the next client is refused without an answer
+refused=0 &&
+for try in `seq 1 25`; do
+	if ! ods-signer queue 2>&1 | $GREP -q 'It is now'; then
+		refused=1
+		break
+	fi
+	sleep 1
+done &&
+test $refused -eq 1 &&
+syslog_grep 'ods-signerd: .*unable to accept client: too many clients' &&
+
+## When the idle clients are gone, clients are accepted again
+wait &&
+ods-signer queue 2>&1 | $GREP -q 'It is now' &&
+ods-signer zones 2>&1 | $GREP -q 'zones configured' &&
+
+## The signer still stops at once
+ods_stop_ods-control &&
+rm -f _clients.ok _clients.sign _clients.update &&
+return 0
+
+rm -f _clients.ok _clients.sign _clients.update
+ods_kill
+return 1
@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+
+#TEST: The signer only parses a signer configuration again when its content
+#TEST: changed. Touch the signconf of a zone and update the zone: the file
+#TEST: should be skipped. Change it: it should be loaded. Break it: the
+#TEST: zone should keep its last good signconf and still sign.
+
+SIGNCONF="$INSTALL_ROOT/var/opendnssec/signconf/ods.xml"
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+ods_start_ods-control &&
+
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+test -f "$SIGNCONF" &&
+
+## Touched, same content
+sleep 1 &&
+touch "$SIGNCONF" &&
+log_this ods-signer-update-touched ods-signer update ods &&
+log_grep ods-signer-update-touched stdout 'Zone ods config being updated.' &&
+syslog_waitfor 60 "ods-signerd: .*\[signconf\] signconf file $SIGNCONF touched but not changed" &&
+syslog_waitfor 60 'ods-signerd: .*\[zone\] zone ods signconf file .* is unchanged since' &&
+! syslog_grep 'ods-signerd: .*\[zone\] zone ods signconf file .* is modified since' &&
+
+## Changed content
+sleep 1 &&
+sed 's%<Resign>[^<]*</Resign>%<Resign>PT181S</Resign>%' "$SIGNCONF" > _signconf.xml &&
+! cmp -s _signconf.xml "$SIGNCONF" &&
+cp -- _signconf.xml "$SIGNCONF" &&
+log_this ods-signer-update-changed ods-signer update ods &&
+log_grep ods-signer-update-changed stdout 'Zone ods config being updated.' &&
+syslog_waitfor 60 'ods-signerd: .*\[zone\] zone ods signconf file .* is modified since' &&
+
+## Broken content
+sleep 1 &&
+echo '<SignerConfiguration>' > "$SIGNCONF" &&
+log_this ods-signer-update-broken ods-signer update ods &&
+log_grep ods-signer-update-broken stdout 'Zone ods config being updated.' &&
+syslog_waitfor 60 'ods-signerd: .*\[zone\] unable to load signconf for zone ods' &&
+
+## The zone is still signed with the last good signconf
+{ syslog_grep_count 1 'ods-signerd: .*\[STATS\] ods' >/dev/null; true; } &&
+signed=$syslog_grep_count_variable &&
+log_this ods-signer-sign ods-signer sign ods &&
+syslog_waitfor_count 60 $(( signed + 1 )) 'ods-signerd: .*\[STATS\] ods' &&
+
+ods_stop_ods-control &&
+rm -f _signconf.xml &&
+return 0
+
+rm -f _signconf.xml
+ods_kill
+return 1
@@ -0,0 +1,84 @@
+/*
+ * PKCS#11 shim for testing: forwards every call to the module named by
+ * FAULTY_PKCS11_MODULE, but fails every FAULTY_PKCS11_SIGN_FAIL'th C_Sign
+ * call with CKR_DEVICE_ERROR.
+ */
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pkcs11.h>
+
+static CK_FUNCTION_LIST faulty_functions;
+static CK_C_Sign real_sign = NULL;
+static pthread_mutex_t faulty_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long faulty_rate = 0;
+static unsigned long faulty_count = 0;
+
+/**
+ * Sign, unless it is time for a fault. Length queries are not counted.
+ *
+ */
+static CK_RV
+faulty_sign(CK_SESSION_HANDLE session, CK_BYTE_PTR data, CK_ULONG data_len,
+    CK_BYTE_PTR signature, CK_ULONG_PTR signature_len)
+{
+    int fail = 0;
+    if (signature && faulty_rate) {
+        pthread_mutex_lock(&faulty_lock);
+        fail = (++faulty_count % faulty_rate) == 0;
+        pthread_mutex_unlock(&faulty_lock);
+    }
+    if (fail) {
+        return CKR_DEVICE_ERROR;
+    }
+    return real_sign(session, data, data_len, signature, signature_len);
+}
+
+/**
+ * Load the real module and hand out its function list with C_Sign
+ * replaced.
+ *
+ */
+CK_RV
+C_GetFunctionList(CK_FUNCTION_LIST_PTR_PTR function_list)
+{
+    CK_C_GetFunctionList get_function_list = NULL;
+    CK_FUNCTION_LIST_PTR real_functions = NULL;
+    const char* module = getenv("FAULTY_PKCS11_MODULE");
+    const char* rate = getenv("FAULTY_PKCS11_SIGN_FAIL");
+    void* handle = NULL;
+    CK_RV rv;
+
+    if (!function_list || !module) {
+        return CKR_ARGUMENTS_BAD;
+    }
+    pthread_mutex_lock(&faulty_lock);
+    if (!real_sign) {
+        handle = dlopen(module, RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            pthread_mutex_unlock(&faulty_lock);
+            return CKR_GENERAL_ERROR;
+        }
+        get_function_list = (CK_C_GetFunctionList) dlsym(handle,
+            "C_GetFunctionList");
+        if (!get_function_list) {
+            pthread_mutex_unlock(&faulty_lock);
+            return CKR_GENERAL_ERROR;
+        }
+        rv = get_function_list(&real_functions);
+        if (rv != CKR_OK) {
+            pthread_mutex_unlock(&faulty_lock);
+            return rv;
+        }
+        memcpy(&faulty_functions, real_functions, sizeof(faulty_functions));
+        real_sign = faulty_functions.C_Sign;
+        faulty_functions.C_Sign = faulty_sign;
+        faulty_rate = rate ? strtoul(rate, NULL, 10) : 0;
+    }
+    pthread_mutex_unlock(&faulty_lock);
+    *function_list = &faulty_functions;
+    return CKR_OK;
+}
@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+
+#TEST: Sign through a PKCS#11 shim that fails every tenth C_Sign call with
+#TEST: CKR_DEVICE_ERROR. The drudger that hits the fault should retry the
+#TEST: RRset with new sessions of its own, without the signer reopening
+#TEST: the HSM connection for everybody, and the zone should get signed.
+
+FAULTY_PKCS11="$INSTALL_ROOT/var/opendnssec/faulty-pkcs11.so"
+
+export FAULTY_PKCS11_MODULE="$SOFTHSM_MODULE"
+export FAULTY_PKCS11_SIGN_FAIL=10
+
+${CC:-cc} -shared -fPIC -I../../../libhsm/src/lib/cryptoki_compat -o "$FAULTY_PKCS11" faulty-pkcs11.c -ldl -lpthread &&
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+ods_start_ods-control &&
+
+syslog_waitfor 120 'ods-signerd: .*\[STATS\] ods' &&
+test -f "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+
+## The faults were retried by the drudgers alone
+syslog_grep 'ods-signerd: .*hsm error, retry [0-9]* with new sessions' &&
+! syslog_grep 'ods-signerd: .*idle libhsm connection, trying to reopen' &&
+
+## And once more after a resign
+log_this ods-signer-sign ods-signer sign ods &&
+syslog_waitfor_count 120 2 'ods-signerd: .*\[STATS\] ods' &&
+! syslog_grep 'ods-signerd: .*idle libhsm connection, trying to reopen' &&
+
+ods_stop_ods-control &&
+rm -f "$FAULTY_PKCS11" &&
+return 0
+
+rm -f "$FAULTY_PKCS11"
+ods_kill
+return 1
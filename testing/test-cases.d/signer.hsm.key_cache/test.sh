@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+
+#TEST: Keys are looked up in the HSM once and then come from the process
+#TEST: wide key cache. A zone added with the signer configuration of a zone
+#TEST: that is already signed should find all its keys in the cache.
+
+## Value of a key cache counter in the output of 'ods-signer metrics'
+key_cache_counter () {
+	$GREP -- "^ods_signer_key_cache_$2_total " "_log.$BUILD_TAG.$1.stdout" | awk '{ print $2 }'
+}
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+ods_start_ods-control &&
+
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+
+log_this ods-signer-metrics-before ods-signer metrics &&
+hits_before=`key_cache_counter ods-signer-metrics-before hits` &&
+misses_before=`key_cache_counter ods-signer-metrics-before misses` &&
+test -n "$hits_before" -a -n "$misses_before" &&
+test "$misses_before" -gt 0 &&
+
+## A second zone with the same keys
+log_this ods-signer-add ods-signer add ods2 default "$INSTALL_ROOT/var/opendnssec/signconf/ods.xml" "$INSTALL_ROOT/var/opendnssec/unsigned/ods2" "$INSTALL_ROOT/var/opendnssec/signed/ods2" &&
+log_grep ods-signer-add stdout 'Zone ods2 added.' &&
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods2' &&
+
+## Its keys came from the cache, the HSM was not asked again
+log_this ods-signer-metrics-after ods-signer metrics &&
+hits_after=`key_cache_counter ods-signer-metrics-after hits` &&
+misses_after=`key_cache_counter ods-signer-metrics-after misses` &&
+echo "key cache hits $hits_before -> $hits_after, misses $misses_before -> $misses_after" &&
+test "$hits_after" -gt "$hits_before" &&
+test "$misses_after" -eq "$misses_before" &&
+
+ods_stop_ods-control &&
+return 0
+
+ods_kill
+return 1
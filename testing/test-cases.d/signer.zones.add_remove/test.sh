@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+
+#TEST: Add a zone with 'ods-signer add' and remove it again with
+#TEST: 'ods-signer remove', both changes should be written to the zone list
+#TEST: file so they survive a restart of the signer.
+
+ZONELIST="$INSTALL_ROOT/etc/opendnssec/zonelist.xml"
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+ods_start_ods-control &&
+
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+
+## Add a second zone, signed with the signer configuration of the first
+log_this ods-signer-add ods-signer add ods2 default "$INSTALL_ROOT/var/opendnssec/signconf/ods.xml" "$INSTALL_ROOT/var/opendnssec/unsigned/ods2" "$INSTALL_ROOT/var/opendnssec/signed/ods2" &&
+log_grep ods-signer-add stdout 'Zone ods2 added.' &&
+$GREP -q -- '<Zone name="ods2">' "$ZONELIST" &&
+$GREP -q -- '<Zone name="ods">' "$ZONELIST" &&
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods2' &&
+test -f "$INSTALL_ROOT/var/opendnssec/signed/ods2" &&
+
+## Remove it again
+log_this ods-signer-remove ods-signer remove ods2 &&
+log_grep ods-signer-remove stdout 'Zone ods2 removed.' &&
+! $GREP -q -- '<Zone name="ods2">' "$ZONELIST" &&
+$GREP -q -- '<Zone name="ods">' "$ZONELIST" &&
+
+## The zone list file is still valid for the signer
+log_this ods-signer-update ods-signer update --all &&
+log_grep ods-signer-update stdout 'Zone list has not changed.\|Zone list updated: 0 removed, 0 added, 0 updated.' &&
+
+ods_stop_ods-control &&
+return 0
+
+ods_kill
+return 1
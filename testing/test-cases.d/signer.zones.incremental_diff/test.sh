@@ -0,0 +1,77 @@
+#!/usr/bin/env bash
+
+#TEST: Sign a zone of a few thousand names, then change one name with a
+#TEST: dynamic update. The incremental diff and nsecify should only visit
+#TEST: the changed names, not the whole zone.
+
+TSIG="hmac-sha256:secret.example.com:sw0nMPCswVbes1tmQTm1pcMmpNRK+oGMYN+qKNR/BwQ="
+NAMES=2000
+
+## Print the visited and total counts of the last line matching $1
+visited_counts () {
+	$GREP -- "$1" "_syslog.$BUILD_TAG" | tail -n 1 |
+		sed -e 's/.* visited \([0-9]*\) of \([0-9]*\) .*/\1 \2/'
+}
+
+if ! command -v nsupdate >/dev/null 2>&1; then
+	echo "nsupdate not found" >&2
+	return 1
+fi
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+## The zone transfer of the master gets $NAMES more names, and the master
+## keeps serial 1000 so that no IXFR interferes with the update
+awk -v names=$NAMES '{ sub(/postmaster\.ods\. 1001 /, "postmaster.ods. 1000 "); print }
+	/^mail\.ods\. 600 IN A/ && !done {
+		for (i = 1; i <= names; i++)
+			printf("host%d.ods. 600 IN A 192.0.2.%d\n", i, i % 250 + 1);
+		done = 1
+	}' ods.datafile > _ods.datafile &&
+
+## Start master name server
+ods_ldns_testns 15353 _ods.datafile &&
+
+## Start OpenDNSSEC
+ods_start_ods-control &&
+
+## Wait for signed zone file
+syslog_waitfor 300 'ods-signerd: .*\[STATS\] ods' &&
+ods-signer verbosity 5 &&
+
+## Change a single name
+log_this nsupdate-add nsupdate -y "$TSIG" <<"EOF2" &&
+server 127.0.0.1 15354
+zone ods
+update add update1.ods. 600 IN A 192.0.2.53
+send
+EOF2
+syslog_waitfor 60 'ods-signerd: .*\[query\] zone ods update accepted: 1 changes' &&
+syslog_waitfor 60 'ods-signerd: .*\[namedb\] incremental diff visited' &&
+syslog_waitfor 60 'ods-signerd: .*\[namedb\] incremental nsecify visited' &&
+syslog_waitfor_count 60 2 'ods-signerd: .*\[STATS\] ods' &&
+
+## The work depends on the size of the change, not of the zone
+set -- `visited_counts '\[namedb\] incremental diff visited'` &&
+echo "incremental diff visited $1 of $2 domains" &&
+test "$2" -ge $NAMES && test "$1" -le 10 &&
+set -- `visited_counts '\[namedb\] incremental nsecify visited'` &&
+echo "incremental nsecify visited $1 of $2 denials" &&
+test "$2" -ge $NAMES && test "$1" -le 10 &&
+$GREP -q -- '^update1\.ods\.[[:space:]]*600[[:space:]]*IN[[:space:]]*A[[:space:]]*192\.0\.2\.53' "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+
+## Stop
+ods_stop_ods-control &&
+ods_ldns_testns_kill &&
+rm -f _ods.datafile &&
+return 0
+
+## Test failed. Kill stuff
+ods_ldns_testns_kill
+ods_kill
+rm -f _ods.datafile
+return 1
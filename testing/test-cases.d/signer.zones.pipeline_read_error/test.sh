@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+
+#TEST: Fail reading a sorted zone file halfway through, while the domains
+#TEST: read so far are already being signed. The rollback should remove
+#TEST: those RRs and their RRSIGs, so they don't show up in the zone that is
+#TEST: signed once the zone file has been fixed.
+
+if [ -n "$HAVE_MYSQL" ]; then
+	ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env 20 &&
+
+ods_start_ods-control &&
+
+## The first read is pipelined and fails at the bad A record
+syslog_waitfor 60 'ods-signerd: .*pipelined signing zone ods' &&
+syslog_waitfor 60 'ods-signerd: .*\[adapter\] error reading RR at line' &&
+syslog_waitfor 60 'ods-signerd: .*\[tools\] unable to read zone ods: adapter failed' &&
+! test -f "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+
+## Fix the zone file and sign again
+cp -- ods.fixed "$INSTALL_ROOT/var/opendnssec/unsigned/ods" &&
+log_this ods-signer-sign ods-signer sign ods &&
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+test -f "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+
+## Nothing from the failed read should be left behind
+$GREP -q -- '^mail\.ods\..*IN[[:space:]]*A[[:space:]]*192\.0\.2\.25' "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+! $GREP -q -- 'label' "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+
+ods_stop_ods-control &&
+return 0
+
+ods_kill
+return 1